@@ -0,0 +1,573 @@
+/*
+    esp.c - ESP-IDF system services on POSIX (host build)
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+//
+// Logging, time, CRC, the default event loop and flash partitions.
+//
+// NVS keeps its blobs in memory, for the run of the daemon.
+//
+// Partitions are backed by files ( esp_host_partition_file() ), mapped in
+// memory so that esp_partition_mmap() returns a plain pointer. Erased flash
+// reads 0xFF and writes can only clear bits, as on the chip.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_cpu.h"
+#include "esp_rom_crc.h"
+#include "esp_event.h"
+#include "esp_partition.h"
+#include "nvs_flash.h"
+#include "host.h"
+
+#define ESP_HOST_MAX_LOG_TAGS           32
+#define ESP_HOST_MAX_EVENT_HANDLERS     8
+#define ESP_HOST_MAX_PARTITIONS         4
+#define ESP_HOST_FLASH_SECTOR_SIZE      4096
+#define ESP_HOST_MAX_NVS_NAMESPACES     4
+#define ESP_HOST_MAX_NVS_ENTRIES        16
+#define ESP_HOST_MAX_NVS_KEY            16          // namespace and key names ( with the terminating 0 )
+#define ESP_HOST_MAX_NVS_BLOB           64
+
+static struct {
+    const char      *tag ;
+    esp_log_level_t  level ;
+} esp_host_log_tag[ESP_HOST_MAX_LOG_TAGS] ;
+
+static unsigned int     esp_host_log_tags ;
+static esp_log_level_t  esp_host_log_default = CONFIG_LOG_DEFAULT_LEVEL ;
+static pthread_mutex_t  esp_host_log_lock = PTHREAD_MUTEX_INITIALIZER ;
+
+static struct {
+    esp_event_base_t     base ;
+    int32_t              id ;
+    esp_event_handler_t  handler ;
+    void                *arg ;
+} esp_host_event_handler[ESP_HOST_MAX_EVENT_HANDLERS] ;
+
+static unsigned int esp_host_event_handlers ;
+
+static struct {
+    esp_partition_t  partition ;
+    unsigned char   *data ;
+} esp_host_partition[ESP_HOST_MAX_PARTITIONS] ;
+
+static unsigned int esp_host_partitions ;
+
+static char esp_host_nvs_namespace[ESP_HOST_MAX_NVS_NAMESPACES][ESP_HOST_MAX_NVS_KEY] ;
+
+static struct {
+    nvs_handle_t     handle ;                       // namespace ( 0 : free entry )
+    char             key[ESP_HOST_MAX_NVS_KEY] ;
+    unsigned char    value[ESP_HOST_MAX_NVS_BLOB] ;
+    size_t           length ;
+} esp_host_nvs_entry[ESP_HOST_MAX_NVS_ENTRIES] ;
+
+static pthread_mutex_t  esp_host_nvs_lock = PTHREAD_MUTEX_INITIALIZER ;
+
+esp_event_base_t const WIFI_EVENT = "WIFI_EVENT" ;
+
+// FUNCTION PROTOTYPES
+static int64_t esp_host_now_ns(void) ;
+static esp_log_level_t esp_host_log_level(const char *tag) ;
+static unsigned char *esp_host_partition_data(const esp_partition_t *partition, size_t offset, size_t size) ;
+static int esp_host_nvs_find(nvs_handle_t handle, const char *key) ;
+
+//
+// Monotonic time since the first call ( nano-seconds )
+//
+static int64_t esp_host_now_ns(void)
+{
+    static int64_t origin ;
+    struct timespec t ;
+    int64_t now ;
+
+    clock_gettime(CLOCK_MONOTONIC, &t) ;
+    now = (int64_t) t.tv_sec * 1000000000LL + t.tv_nsec ;
+    if (!origin) origin = now - 1 ;
+
+    return now - origin ;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return esp_host_now_ns() / 1000 ;
+}
+
+uint32_t esp_cpu_get_ccount(void)
+{
+    return (uint32_t) ((esp_host_now_ns() * CONFIG_ESP32S2_DEFAULT_CPU_FREQ_MHZ) / 1000) ;
+}
+
+//
+// The heap is not accounted on the host
+//
+uint32_t esp_get_free_heap_size(void)
+{
+    return 0 ;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+    return 0 ;
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code)
+    {
+        case ESP_OK                 : return "ESP_OK" ;
+        case ESP_FAIL               : return "ESP_FAIL" ;
+        case ESP_ERR_NO_MEM         : return "ESP_ERR_NO_MEM" ;
+        case ESP_ERR_INVALID_ARG    : return "ESP_ERR_INVALID_ARG" ;
+        case ESP_ERR_INVALID_STATE  : return "ESP_ERR_INVALID_STATE" ;
+        case ESP_ERR_INVALID_SIZE   : return "ESP_ERR_INVALID_SIZE" ;
+        case ESP_ERR_NOT_FOUND      : return "ESP_ERR_NOT_FOUND" ;
+        case ESP_ERR_NOT_SUPPORTED  : return "ESP_ERR_NOT_SUPPORTED" ;
+        case ESP_ERR_TIMEOUT        : return "ESP_ERR_TIMEOUT" ;
+        case ESP_ERR_NVS_NOT_FOUND  : return "ESP_ERR_NVS_NOT_FOUND" ;
+    }
+    return "UNKNOWN ERROR" ;
+}
+
+//
+// CRC-32 ( reflected polynomial 0xEDB88320 )
+//
+uint32_t esp_rom_crc32_le(uint32_t crc, uint8_t const *buf, uint32_t len)
+{
+    uint32_t k ;
+
+    crc = ~crc ;
+    while (len--)
+    {
+        crc ^= *buf++ ;
+        for (k=0; k<8; k++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1))) ;
+        }
+    }
+    return ~crc ;
+}
+
+//
+// LOGGING ( per tag levels , same output format as the chip console )
+//
+static esp_log_level_t esp_host_log_level(const char *tag)
+{
+    unsigned int k ;
+
+    for (k=0; k<esp_host_log_tags; k++)
+    {
+        if (!strcmp(tag, esp_host_log_tag[k].tag))
+            return esp_host_log_tag[k].level ;
+    }
+    return esp_host_log_default ;
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    unsigned int k ;
+
+    pthread_mutex_lock(&esp_host_log_lock) ;
+
+    if (!strcmp(tag, "*"))
+    {
+        esp_host_log_default = level ;
+    }
+    else
+    {
+        for (k=0; (k<esp_host_log_tags) && strcmp(tag, esp_host_log_tag[k].tag); k++) ;
+
+        if (k < ESP_HOST_MAX_LOG_TAGS)
+        {
+            if (k == esp_host_log_tags)
+            {
+                esp_host_log_tag[k].tag = strdup(tag) ;
+                esp_host_log_tags++ ;
+            }
+            esp_host_log_tag[k].level = level ;
+        }
+    }
+
+    pthread_mutex_unlock(&esp_host_log_lock) ;
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    static const char letter[] = "NEWIDV" ;
+    va_list args ;
+
+    pthread_mutex_lock(&esp_host_log_lock) ;
+
+    if (level <= esp_host_log_level(tag))
+    {
+        fprintf(stdout, "%c (%lld) %s: ", letter[level], (long long) (esp_timer_get_time() / 1000), tag) ;
+        va_start(args, format) ;
+        vfprintf(stdout, format, args) ;
+        va_end(args) ;
+        fputc('\n', stdout) ;
+        fflush(stdout) ;
+    }
+
+    pthread_mutex_unlock(&esp_host_log_lock) ;
+}
+
+//
+// DEFAULT EVENT LOOP ( handlers are called by the posting task )
+//
+esp_err_t esp_event_loop_create_default(void)
+{
+    return ESP_OK ;
+}
+
+esp_err_t esp_event_handler_instance_register(esp_event_base_t event_base, int32_t event_id,
+                                              esp_event_handler_t event_handler, void *event_handler_arg,
+                                              esp_event_handler_instance_t *instance)
+{
+    unsigned int k ;
+
+    portENTER_CRITICAL(0) ;
+    if ( (k = esp_host_event_handlers) < ESP_HOST_MAX_EVENT_HANDLERS )
+    {
+        esp_host_event_handler[k].base = event_base ;
+        esp_host_event_handler[k].id = event_id ;
+        esp_host_event_handler[k].handler = event_handler ;
+        esp_host_event_handler[k].arg = event_handler_arg ;
+        esp_host_event_handlers++ ;
+    }
+    portEXIT_CRITICAL(0) ;
+
+    if (k >= ESP_HOST_MAX_EVENT_HANDLERS)
+        return ESP_ERR_NO_MEM ;
+
+    if (instance) *instance = &esp_host_event_handler[k] ;
+    return ESP_OK ;
+}
+
+esp_err_t esp_event_post(esp_event_base_t event_base, int32_t event_id,
+                         const void *event_data, size_t event_data_size, uint32_t ticks_to_wait)
+{
+    unsigned int k ;
+
+    for (k=0; k<esp_host_event_handlers; k++)
+    {
+        if ( (esp_host_event_handler[k].base == event_base) &&
+             ((esp_host_event_handler[k].id == ESP_EVENT_ANY_ID) || (esp_host_event_handler[k].id == event_id)) )
+        {
+            esp_host_event_handler[k].handler(esp_host_event_handler[k].arg, event_base, event_id, (void *) event_data) ;
+        }
+    }
+    return ESP_OK ;
+}
+
+//
+// FLASH PARTITIONS
+//
+
+//
+// Back a data partition with a file ( created erased when missing )
+//
+// returns 0 on failure
+//
+unsigned int esp_host_partition_file(const char *label, int subtype, const char *path, uint32_t size)
+{
+    esp_partition_t *p ;
+    struct stat st ;
+    unsigned char *data ;
+    int fd, created ;
+
+    if (esp_host_partitions >= ESP_HOST_MAX_PARTITIONS)
+        return 0 ;
+
+    size = (size + ESP_HOST_FLASH_SECTOR_SIZE - 1) & ~(ESP_HOST_FLASH_SECTOR_SIZE - 1) ;
+
+    if ( (fd = open(path, O_RDWR | O_CREAT, 0644)) < 0 )
+        return 0 ;
+
+    created = (fstat(fd, &st) == 0) && (st.st_size == 0) ;
+
+    if (ftruncate(fd, size) != 0)
+    {
+        close(fd) ;
+        return 0 ;
+    }
+
+    data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) ;
+    close(fd) ;
+
+    if (data == MAP_FAILED)
+        return 0 ;
+
+    if (created) memset(data, 0xFF, size) ;
+
+    p = &esp_host_partition[esp_host_partitions].partition ;
+    p->type = ESP_PARTITION_TYPE_DATA ;
+    p->subtype = subtype ;
+    p->address = 0 ;
+    p->size = size ;
+    strncpy(p->label, label, sizeof(p->label) - 1) ;
+    esp_host_partition[esp_host_partitions].data = data ;
+    esp_host_partitions++ ;
+
+    return 1 ;
+}
+
+//
+// Memory of a partition range ( 0 when out of bounds )
+//
+static unsigned char *esp_host_partition_data(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    unsigned int k ;
+
+    for (k=0; k<esp_host_partitions; k++)
+    {
+        if (partition == &esp_host_partition[k].partition)
+        {
+            if ( (offset > partition->size) || (size > partition->size - offset) )
+                return 0 ;
+            return esp_host_partition[k].data + offset ;
+        }
+    }
+    return 0 ;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label)
+{
+    unsigned int k ;
+
+    for (k=0; k<esp_host_partitions; k++)
+    {
+        esp_partition_t *p = &esp_host_partition[k].partition ;
+
+        if ( (p->type == type) && (p->subtype == subtype) && (!label || !strcmp(label, p->label)) )
+            return p ;
+    }
+    return NULL ;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    unsigned char *data = esp_host_partition_data(partition, src_offset, size) ;
+
+    if (!data)
+        return ESP_ERR_INVALID_SIZE ;
+
+    memcpy(dst, data, size) ;
+    return ESP_OK ;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+    unsigned char *data = esp_host_partition_data(partition, dst_offset, size) ;
+    const unsigned char *s = (const unsigned char *) src ;
+    size_t k ;
+
+    if (!data)
+        return ESP_ERR_INVALID_SIZE ;
+
+    // NOR flash : programming only clears bits
+    for (k=0; k<size; k++)
+    {
+        data[k] &= s[k] ;
+    }
+    return ESP_OK ;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    unsigned char *data = esp_host_partition_data(partition, offset, size) ;
+
+    if (!data)
+        return ESP_ERR_INVALID_SIZE ;
+
+    if ( (offset % ESP_HOST_FLASH_SECTOR_SIZE) || (size % ESP_HOST_FLASH_SECTOR_SIZE) )
+        return ESP_ERR_INVALID_ARG ;
+
+    memset(data, 0xFF, size) ;
+    return ESP_OK ;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t *partition, size_t offset, size_t size,
+                             spi_flash_mmap_memory_t memory, const void **out_ptr,
+                             spi_flash_mmap_handle_t *out_handle)
+{
+    unsigned char *data = esp_host_partition_data(partition, offset, size) ;
+
+    if (!data)
+        return ESP_ERR_INVALID_SIZE ;
+
+    *out_ptr = data ;
+    *out_handle = 1 ;
+    return ESP_OK ;
+}
+
+void spi_flash_munmap(spi_flash_mmap_handle_t handle)
+{
+}
+
+//
+// NVS
+//
+
+//
+// Entry of a key ( -1 : not found )
+//
+static int esp_host_nvs_find(nvs_handle_t handle, const char *key)
+{
+    for (int k=0; k<ESP_HOST_MAX_NVS_ENTRIES; k++)
+    {
+        if ( (esp_host_nvs_entry[k].handle == handle) && !strcmp(esp_host_nvs_entry[k].key, key) )
+            return k ;
+    }
+    return -1 ;
+}
+
+//
+// The handle of a namespace is its index + 1 ( namespaces are created on the first read-write open )
+//
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    esp_err_t err = ESP_ERR_NVS_NOT_FOUND ;
+    unsigned int k ;
+
+    if (strlen(name) >= ESP_HOST_MAX_NVS_KEY)
+        return ESP_ERR_INVALID_ARG ;
+
+    pthread_mutex_lock(&esp_host_nvs_lock) ;
+    for (k=0; k<ESP_HOST_MAX_NVS_NAMESPACES; k++)
+    {
+        if (!esp_host_nvs_namespace[k][0] && (open_mode == NVS_READWRITE))
+            strcpy(esp_host_nvs_namespace[k], name) ;
+
+        if (!strcmp(esp_host_nvs_namespace[k], name))
+        {
+            *out_handle = k + 1 ;
+            err = ESP_OK ;
+            break ;
+        }
+    }
+    pthread_mutex_unlock(&esp_host_nvs_lock) ;
+
+    return err ;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    esp_err_t err = ESP_OK ;
+    int k ;
+
+    pthread_mutex_lock(&esp_host_nvs_lock) ;
+    if ((k = esp_host_nvs_find(handle, key)) < 0)
+    {
+        err = ESP_ERR_NVS_NOT_FOUND ;
+    }
+    else if (!out_value)
+    {
+        *length = esp_host_nvs_entry[k].length ;
+    }
+    else if (*length < esp_host_nvs_entry[k].length)
+    {
+        err = ESP_ERR_INVALID_SIZE ;
+    }
+    else
+    {
+        *length = esp_host_nvs_entry[k].length ;
+        memcpy(out_value, esp_host_nvs_entry[k].value, *length) ;
+    }
+    pthread_mutex_unlock(&esp_host_nvs_lock) ;
+
+    return err ;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    esp_err_t err = ESP_OK ;
+    int k ;
+
+    if ( (strlen(key) >= ESP_HOST_MAX_NVS_KEY) || (length > ESP_HOST_MAX_NVS_BLOB) )
+        return ESP_ERR_INVALID_ARG ;
+
+    pthread_mutex_lock(&esp_host_nvs_lock) ;
+    if ((k = esp_host_nvs_find(handle, key)) < 0)
+        k = esp_host_nvs_find(0, "") ;
+
+    if (k < 0)
+    {
+        err = ESP_ERR_NO_MEM ;
+    }
+    else
+    {
+        esp_host_nvs_entry[k].handle = handle ;
+        strcpy(esp_host_nvs_entry[k].key, key) ;
+        memcpy(esp_host_nvs_entry[k].value, value, length) ;
+        esp_host_nvs_entry[k].length = length ;
+    }
+    pthread_mutex_unlock(&esp_host_nvs_lock) ;
+
+    return err ;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    esp_err_t err = ESP_OK ;
+    int k ;
+
+    pthread_mutex_lock(&esp_host_nvs_lock) ;
+    if ((k = esp_host_nvs_find(handle, key)) < 0)
+        err = ESP_ERR_NVS_NOT_FOUND ;
+    else
+        memset(&esp_host_nvs_entry[k], 0, sizeof(esp_host_nvs_entry[k])) ;
+    pthread_mutex_unlock(&esp_host_nvs_lock) ;
+
+    return err ;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return ESP_OK ;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+}
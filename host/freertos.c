@@ -0,0 +1,479 @@
+/*
+    freertos.c - FreeRTOS API on POSIX threads (host build)
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include "freertos/FreeRTOS.h"
+
+struct host_task {
+    pthread_t       thread ;
+    char            name[16] ;
+    uint32_t        stack_depth ;
+    TaskFunction_t  function ;
+    void           *parameters ;
+} ;
+
+struct host_semaphore {
+    pthread_mutex_t lock ;
+    pthread_cond_t  cond ;
+    unsigned int    count ;
+    unsigned int    max_count ;
+    unsigned int    is_static ;
+} ;
+
+struct host_queue {
+    pthread_mutex_t lock ;
+    pthread_cond_t  not_empty ;
+    pthread_cond_t  not_full ;
+    unsigned int    length ;
+    unsigned int    item_size ;
+    unsigned int    head ;
+    unsigned int    count ;
+    unsigned char  *items ;
+} ;
+
+struct host_event {
+    pthread_mutex_t lock ;
+    pthread_cond_t  cond ;
+    EventBits_t     bits ;
+} ;
+
+_Static_assert(sizeof(struct host_semaphore) <= sizeof(StaticSemaphore_t), "StaticSemaphore_t too small") ;
+
+static pthread_mutex_t host_critical ;
+static pthread_once_t  host_critical_once = PTHREAD_ONCE_INIT ;
+static __thread struct host_task *host_current_task ;
+static struct host_task host_main_task = { .name = "main" } ;
+
+// FUNCTION PROTOTYPES
+static void  host_critical_init(void) ;
+static void  host_deadline(TickType_t ticks, struct timespec *deadline) ;
+static int   host_wait(pthread_cond_t *cond, pthread_mutex_t *lock, TickType_t ticks, const struct timespec *deadline) ;
+static void *host_task_entry(void *arg) ;
+static void  host_semaphore_setup(struct host_semaphore *s, unsigned int max_count, unsigned int initial_count) ;
+static void  host_cond_init(pthread_cond_t *cond) ;
+
+//
+// Critical sections ( a single recursive mutex , <mux> is not used )
+//
+static void host_critical_init(void)
+{
+    pthread_mutexattr_t attr ;
+
+    pthread_mutexattr_init(&attr) ;
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE) ;
+    pthread_mutex_init(&host_critical, &attr) ;
+    pthread_mutexattr_destroy(&attr) ;
+}
+
+void host_enter_critical(portMUX_TYPE *mux)
+{
+    pthread_once(&host_critical_once, host_critical_init) ;
+    pthread_mutex_lock(&host_critical) ;
+}
+
+void host_exit_critical(portMUX_TYPE *mux)
+{
+    pthread_mutex_unlock(&host_critical) ;
+}
+
+//
+// Absolute deadline <ticks> from now ( CLOCK_MONOTONIC , as used by the condition variables )
+//
+static void host_deadline(TickType_t ticks, struct timespec *deadline)
+{
+    uint64_t ns = (uint64_t) ticks * (1000000000ULL / configTICK_RATE_HZ) ;
+
+    clock_gettime(CLOCK_MONOTONIC, deadline) ;
+    deadline->tv_sec += ns / 1000000000ULL ;
+    deadline->tv_nsec += ns % 1000000000ULL ;
+    if (deadline->tv_nsec >= 1000000000L)
+    {
+        deadline->tv_sec++ ;
+        deadline->tv_nsec -= 1000000000L ;
+    }
+}
+
+//
+// Wait on a condition variable until signaled or until the deadline
+//
+// returns 0 when the deadline expired
+//
+static int host_wait(pthread_cond_t *cond, pthread_mutex_t *lock, TickType_t ticks, const struct timespec *deadline)
+{
+    if (ticks == portMAX_DELAY)
+    {
+        pthread_cond_wait(cond, lock) ;
+        return 1 ;
+    }
+    return (pthread_cond_timedwait(cond, lock, deadline) != ETIMEDOUT) ;
+}
+
+static void host_cond_init(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr ;
+
+    pthread_condattr_init(&attr) ;
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC) ;
+    pthread_cond_init(cond, &attr) ;
+    pthread_condattr_destroy(&attr) ;
+}
+
+//
+// TASKS
+//
+static void *host_task_entry(void *arg)
+{
+    struct host_task *task = (struct host_task *) arg ;
+
+    host_current_task = task ;
+    task->function(task->parameters) ;
+    return NULL ;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stack_depth,
+                       void *parameters, UBaseType_t priority, TaskHandle_t *handle)
+{
+    struct host_task *task = calloc(1, sizeof(struct host_task)) ;
+
+    if (!task)
+        return pdFAIL ;
+
+    strncpy(task->name, name ? name : "", sizeof(task->name) - 1) ;
+    task->stack_depth = stack_depth ;
+    task->function = function ;
+    task->parameters = parameters ;
+
+    if (pthread_create(&task->thread, NULL, host_task_entry, task))
+    {
+        free(task) ;
+        return pdFAIL ;
+    }
+    pthread_detach(task->thread) ;
+
+    if (handle) *handle = task ;
+    return pdPASS ;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (!task || (task == host_current_task))
+    {
+        pthread_exit(NULL) ;
+    }
+    pthread_cancel(task->thread) ;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    struct timespec t ;
+    uint64_t ns = (uint64_t) ticks * (1000000000ULL / configTICK_RATE_HZ) ;
+
+    t.tv_sec = ns / 1000000000ULL ;
+    t.tv_nsec = ns % 1000000000ULL ;
+    while (nanosleep(&t, &t) && (errno == EINTR)) ;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    struct timespec t ;
+
+    clock_gettime(CLOCK_MONOTONIC, &t) ;
+    return (TickType_t) (((uint64_t) t.tv_sec * configTICK_RATE_HZ) + ((uint64_t) t.tv_nsec * configTICK_RATE_HZ / 1000000000ULL)) ;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return host_current_task ? host_current_task : &host_main_task ;
+}
+
+char *pcTaskGetTaskName(TaskHandle_t task)
+{
+    return task ? task->name : xTaskGetCurrentTaskHandle()->name ;
+}
+
+//
+// Stack usage is not tracked on the host : the whole stack depth is reported as free
+//
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    return task ? task->stack_depth : 0 ;
+}
+
+//
+// SEMAPHORES ( mutexes are binary semaphores created "given" )
+//
+static void host_semaphore_setup(struct host_semaphore *s, unsigned int max_count, unsigned int initial_count)
+{
+    pthread_mutex_init(&s->lock, NULL) ;
+    host_cond_init(&s->cond) ;
+    s->count = initial_count ;
+    s->max_count = max_count ;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    struct host_semaphore *s = calloc(1, sizeof(struct host_semaphore)) ;
+
+    if (s) host_semaphore_setup(s, 1, 1) ;
+    return s ;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    struct host_semaphore *s = calloc(1, sizeof(struct host_semaphore)) ;
+
+    if (s) host_semaphore_setup(s, 1, 0) ;
+    return s ;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *buffer)
+{
+    struct host_semaphore *s = (struct host_semaphore *) buffer ;
+
+    memset(buffer, 0, sizeof(StaticSemaphore_t)) ;
+    host_semaphore_setup(s, 1, 0) ;
+    s->is_static = 1 ;
+    return s ;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCountingStatic(UBaseType_t max_count, UBaseType_t initial_count,
+                                                 StaticSemaphore_t *buffer)
+{
+    struct host_semaphore *s = (struct host_semaphore *) buffer ;
+
+    memset(buffer, 0, sizeof(StaticSemaphore_t)) ;
+    host_semaphore_setup(s, max_count, initial_count) ;
+    s->is_static = 1 ;
+    return s ;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t ticks)
+{
+    struct timespec deadline ;
+    BaseType_t ret = pdTRUE ;
+
+    if (ticks != portMAX_DELAY) host_deadline(ticks, &deadline) ;
+
+    pthread_mutex_lock(&s->lock) ;
+    while (!s->count)
+    {
+        if (!ticks || !host_wait(&s->cond, &s->lock, ticks, &deadline))
+        {
+            if (!s->count) ret = pdFALSE ;
+            break ;
+        }
+    }
+    if (ret == pdTRUE) s->count-- ;
+    pthread_mutex_unlock(&s->lock) ;
+
+    return ret ;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s)
+{
+    BaseType_t ret = pdFALSE ;
+
+    pthread_mutex_lock(&s->lock) ;
+    if (s->count < s->max_count)
+    {
+        s->count++ ;
+        pthread_cond_signal(&s->cond) ;
+        ret = pdTRUE ;
+    }
+    pthread_mutex_unlock(&s->lock) ;
+
+    return ret ;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t s)
+{
+    pthread_cond_destroy(&s->cond) ;
+    pthread_mutex_destroy(&s->lock) ;
+    if (!s->is_static) free(s) ;
+}
+
+//
+// QUEUES ( items are copied , FIFO order )
+//
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct host_queue *q = calloc(1, sizeof(struct host_queue)) ;
+
+    if (!q)
+        return NULL ;
+
+    if ( !(q->items = calloc(length, item_size)) )
+    {
+        free(q) ;
+        return NULL ;
+    }
+
+    pthread_mutex_init(&q->lock, NULL) ;
+    host_cond_init(&q->not_empty) ;
+    host_cond_init(&q->not_full) ;
+    q->length = length ;
+    q->item_size = item_size ;
+    return q ;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks)
+{
+    struct timespec deadline ;
+    BaseType_t ret = pdTRUE ;
+
+    if (ticks != portMAX_DELAY) host_deadline(ticks, &deadline) ;
+
+    pthread_mutex_lock(&q->lock) ;
+    while (q->count == q->length)
+    {
+        if (!ticks || !host_wait(&q->not_full, &q->lock, ticks, &deadline))
+        {
+            if (q->count == q->length) ret = pdFALSE ;
+            break ;
+        }
+    }
+    if (ret == pdTRUE)
+    {
+        memcpy(q->items + ((q->head + q->count) % q->length) * q->item_size, item, q->item_size) ;
+        q->count++ ;
+        pthread_cond_signal(&q->not_empty) ;
+    }
+    pthread_mutex_unlock(&q->lock) ;
+
+    return ret ;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks)
+{
+    struct timespec deadline ;
+    BaseType_t ret = pdTRUE ;
+
+    if (ticks != portMAX_DELAY) host_deadline(ticks, &deadline) ;
+
+    pthread_mutex_lock(&q->lock) ;
+    while (!q->count)
+    {
+        if (!ticks || !host_wait(&q->not_empty, &q->lock, ticks, &deadline))
+        {
+            if (!q->count) ret = pdFALSE ;
+            break ;
+        }
+    }
+    if (ret == pdTRUE)
+    {
+        memcpy(item, q->items + q->head * q->item_size, q->item_size) ;
+        q->head = (q->head + 1) % q->length ;
+        q->count-- ;
+        pthread_cond_signal(&q->not_full) ;
+    }
+    pthread_mutex_unlock(&q->lock) ;
+
+    return ret ;
+}
+
+//
+// EVENT GROUPS
+//
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    struct host_event *e = calloc(1, sizeof(struct host_event)) ;
+
+    if (e)
+    {
+        pthread_mutex_init(&e->lock, NULL) ;
+        host_cond_init(&e->cond) ;
+    }
+    return e ;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t e, EventBits_t bits)
+{
+    EventBits_t value ;
+
+    pthread_mutex_lock(&e->lock) ;
+    e->bits |= bits ;
+    value = e->bits ;
+    pthread_cond_broadcast(&e->cond) ;
+    pthread_mutex_unlock(&e->lock) ;
+
+    return value ;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t e, EventBits_t bits)
+{
+    EventBits_t value ;
+
+    pthread_mutex_lock(&e->lock) ;
+    value = e->bits ;
+    e->bits &= ~bits ;
+    pthread_mutex_unlock(&e->lock) ;
+
+    return value ;
+}
+
+//
+// returns the bits at the time the wait ended ( before clear_on_exit )
+//
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t e, EventBits_t bits,
+                                BaseType_t clear_on_exit, BaseType_t wait_for_all, TickType_t ticks)
+{
+    struct timespec deadline ;
+    EventBits_t value ;
+
+    if (ticks != portMAX_DELAY) host_deadline(ticks, &deadline) ;
+
+    pthread_mutex_lock(&e->lock) ;
+    for (;;)
+    {
+        unsigned int met = wait_for_all ? ((e->bits & bits) == bits) : ((e->bits & bits) != 0) ;
+
+        if (met)
+        {
+            value = e->bits ;
+            if (clear_on_exit) e->bits &= ~bits ;
+            break ;
+        }
+        if (!ticks || !host_wait(&e->cond, &e->lock, ticks, &deadline))
+        {
+            met = wait_for_all ? ((e->bits & bits) == bits) : ((e->bits & bits) != 0) ;
+            value = e->bits ;
+            if (met && clear_on_exit) e->bits &= ~bits ;
+            break ;
+        }
+    }
+    pthread_mutex_unlock(&e->lock) ;
+
+    return value ;
+}
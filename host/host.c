@@ -0,0 +1,171 @@
+/*
+    host.c - Linux Host Daemon
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+//
+// Runs the firmware core ( command parsing, FTM sessions, history, journal,
+// metrics, trace and the TCP server ) as a local daemon speaking the same
+// protocol, with the Wi-Fi driver replaced by wifi_mock.c.
+//
+// usage : chronos_host [-p port] [-P stream_port] [-r responders.conf] [-j journal.bin]
+//                      [-c capture.bin] [-f frame_us] [-s scan_ms] [-S seed]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_event.h"
+#include "esp_wifi.h"
+#include "server.h"
+#include "ftm.h"
+#include "pool.h"
+#include "history.h"
+#include "journal.h"
+#include "metrics.h"
+#include "trace.h"
+#include "capture.h"
+#include "stream.h"
+#include "udp.h"
+#include "radio.h"
+#include "responder.h"
+#include "bus.h"
+#include "host.h"
+
+static const char *TAG = "Main App" ;
+
+int host_server_port = CONFIG_ESP_PORT_DEFAULT ;
+int host_stream_port = CONFIG_ESP_STREAM_PORT_DEFAULT ;
+
+// FUNCTION PROTOTYPES
+static void host_usage(const char *program) ;
+int main(int argc, char *argv[]) ;
+
+static void host_usage(const char *program)
+{
+    fprintf(stderr, "usage: %s [-p port] [-P stream_port] [-r responders.conf] [-j journal.bin] [-c capture.bin] [-f frame_us] [-s scan_ms] [-S seed]\n"
+                    "  -p  TCP port (default %d)\n"
+                    "  -P  stream TCP port (default %d)\n"
+                    "  -r  responder table: ssid mac channel distance_m rssi sigma_ps drift_ppm fail [replay.csv]\n"
+                    "  -j  file backing the \"journal\" partition (default: journal disabled)\n"
+                    "  -c  file backing the \"capture\" partition, or a capture dump to replay (default: capture disabled)\n"
+                    "  -f  air time of an FTM frame exchange in uSec (default %d)\n"
+                    "  -s  scan duration in mSec (default %d)\n"
+                    "  -S  random seed of the synthetic responders\n",
+                    program, CONFIG_ESP_PORT_DEFAULT, CONFIG_ESP_STREAM_PORT_DEFAULT, HOST_DEFAULT_FRAME_US, HOST_DEFAULT_SCAN_MS) ;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *journal = 0 ;
+    const char *capture = 0 ;
+    unsigned int frame_us = HOST_DEFAULT_FRAME_US ;
+    unsigned int scan_ms = HOST_DEFAULT_SCAN_MS ;
+    unsigned int seed = 1 ;
+    wifi_config_t wifi_config ;
+    int opt ;
+
+    while ( (opt = getopt(argc, argv, "p:P:r:j:c:f:s:S:h")) != -1 )
+    {
+        switch (opt)
+        {
+            case 'p' : host_server_port = atoi(optarg) ;
+                       break ;
+            case 'P' : host_stream_port = atoi(optarg) ;
+                       break ;
+            case 'r' : if (!wifi_mock_load(optarg)) return 1 ;
+                       break ;
+            case 'j' : journal = optarg ;
+                       break ;
+            case 'c' : capture = optarg ;
+                       break ;
+            case 'f' : frame_us = atoi(optarg) ;
+                       break ;
+            case 's' : scan_ms = atoi(optarg) ;
+                       break ;
+            case 'S' : seed = atoi(optarg) ;
+                       break ;
+            default  : host_usage(argv[0]) ;
+                       return (opt == 'h') ? 0 : 1 ;
+        }
+    }
+
+    // a client closing its socket must not stop the daemon
+    signal(SIGPIPE, SIG_IGN) ;
+
+    // GLOBAL INITIALIZATION ( as main.c on the chip , without NVS )
+    metrics_init() ;
+    trace_init() ;
+    pool_init() ;
+    history_init() ;
+
+    if (journal && !esp_host_partition_file(JOURNAL_PARTITION_LABEL, JOURNAL_PARTITION_SUBTYPE, journal, HOST_JOURNAL_SIZE))
+    {
+        ESP_LOGE(TAG, "cannot map %s", journal) ;
+        return 1 ;
+    }
+    journal_init() ;
+
+    if (capture && !esp_host_partition_file(CAPTURE_PARTITION_LABEL, CAPTURE_PARTITION_SUBTYPE, capture, HOST_CAPTURE_SIZE))
+    {
+        ESP_LOGE(TAG, "cannot map %s", capture) ;
+        return 1 ;
+    }
+    capture_init() ;
+    udp_init() ;
+
+    // MOCKED WIFI DRIVER AND FTM
+    wifi_mock_init(seed, frame_us, scan_ms) ;
+    bus_init() ;
+    responder_init() ;
+    radio_init() ;
+    memset(&wifi_config, 0, sizeof(wifi_config)) ;
+    radio_setup(&wifi_config) ;
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_AP, &wifi_config)) ;
+    radio_start() ;
+    responder_start() ;
+    ftm_init() ;
+
+    // TCP/IP SERVER AND STREAMS
+    server_init() ;
+    stream_init() ;
+
+    ESP_LOGI(TAG, "chronos host daemon , port %d , streams port %d", host_server_port, host_stream_port) ;
+
+    while (1)
+    {
+        pause() ;
+    }
+
+    return 0 ;
+}
@@ -0,0 +1,74 @@
+/*
+    host.h - Linux Host Build
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+#ifndef _HOST_H
+
+#define _HOST_H	1
+
+    #ifdef __cplusplus
+    extern "C" {
+    #endif
+
+        #include <stdint.h>
+
+        #define HOST_DEFAULT_FRAME_US       500         // air time of an FTM frame exchange
+        #define HOST_DEFAULT_SCAN_MS        100         // duration of a scan
+        #define HOST_JOURNAL_SIZE           0x230000    // "journal" partition ( as in partitions.csv )
+        #define HOST_CAPTURE_SIZE           0x40000     // "capture" partition
+
+        //
+        // Simulated FTM responder ( synthetic model , or replay of recorded report entries )
+        //
+        typedef struct {
+            char          ssid[33] ;
+            unsigned char mac[6] ;
+            unsigned int  channel ;
+            double        distance_m ;                  // true distance
+            int           rssi ;                        // mean RSSI ( dBm )
+            double        sigma_ps ;                    // timestamp noise ( standard deviation )
+            double        drift_ppm ;                   // responder clock rate error
+            double        fail ;                        // probability of a failed session [0,1]
+            char          replay[256] ;                 // recorded entries ( CSV ) , "" : synthetic
+        } host_responder_t ;
+
+        // CONFIG_ESP_PORT of the host build ( sdkconfig.h )
+        extern int host_server_port ;
+
+        extern unsigned int esp_host_partition_file(const char *label, int subtype, const char *path, uint32_t size) ;
+
+        extern unsigned int wifi_mock_add_responder(const host_responder_t *responder) ;
+        extern unsigned int wifi_mock_load(const char *path) ;
+        extern void wifi_mock_init(unsigned int seed, unsigned int frame_us, unsigned int scan_ms) ;
+
+    #ifdef __cplusplus
+    }
+    #endif
+
+#endif
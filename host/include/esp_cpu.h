@@ -0,0 +1,48 @@
+/*
+    esp_cpu.h - ESP-IDF CPU cycle counter (host build)
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+#ifndef _HOST_ESP_CPU_H
+
+#define _HOST_ESP_CPU_H	1
+
+    #ifdef __cplusplus
+    extern "C" {
+    #endif
+
+        #include <stdint.h>
+
+        // cycles of a CONFIG_ESP32S2_DEFAULT_CPU_FREQ_MHZ clock , derived from the monotonic clock
+        extern uint32_t esp_cpu_get_ccount(void) ;
+
+    #ifdef __cplusplus
+    }
+    #endif
+
+#endif
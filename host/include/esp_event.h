@@ -0,0 +1,65 @@
+/*
+    esp_event.h - ESP-IDF default event loop (host build)
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+//
+// Handlers run in the context of the task posting the event ( the mocked driver )
+//
+
+#ifndef _HOST_ESP_EVENT_H
+
+#define _HOST_ESP_EVENT_H	1
+
+    #ifdef __cplusplus
+    extern "C" {
+    #endif
+
+        #include <stdint.h>
+        #include "esp_err.h"
+
+        typedef const char *esp_event_base_t ;
+        typedef void       *esp_event_handler_instance_t ;
+        typedef void (*esp_event_handler_t)(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data) ;
+
+        #define ESP_EVENT_ANY_ID        -1
+
+        extern esp_event_base_t const WIFI_EVENT ;
+
+        extern esp_err_t esp_event_loop_create_default(void) ;
+        extern esp_err_t esp_event_handler_instance_register(esp_event_base_t event_base, int32_t event_id,
+                                                             esp_event_handler_t event_handler, void *event_handler_arg,
+                                                             esp_event_handler_instance_t *instance) ;
+        extern esp_err_t esp_event_post(esp_event_base_t event_base, int32_t event_id,
+                                        const void *event_data, size_t event_data_size, uint32_t ticks_to_wait) ;
+
+    #ifdef __cplusplus
+    }
+    #endif
+
+#endif
@@ -0,0 +1,64 @@
+/*
+    esp_log.h - ESP-IDF logging on the standard output (host build)
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+#ifndef _HOST_ESP_LOG_H
+
+#define _HOST_ESP_LOG_H	1
+
+    #ifdef __cplusplus
+    extern "C" {
+    #endif
+
+        #include "esp_err.h"
+
+        typedef enum {
+            ESP_LOG_NONE,
+            ESP_LOG_ERROR,
+            ESP_LOG_WARN,
+            ESP_LOG_INFO,
+            ESP_LOG_DEBUG,
+            ESP_LOG_VERBOSE
+        } esp_log_level_t ;
+
+        extern void esp_log_level_set(const char *tag, esp_log_level_t level) ;
+        extern void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+                    __attribute__ ((format (printf, 3, 4))) ;
+
+        #define ESP_LOGE(tag, format, ...)  esp_log_write(ESP_LOG_ERROR,   tag, format, ##__VA_ARGS__)
+        #define ESP_LOGW(tag, format, ...)  esp_log_write(ESP_LOG_WARN,    tag, format, ##__VA_ARGS__)
+        #define ESP_LOGI(tag, format, ...)  esp_log_write(ESP_LOG_INFO,    tag, format, ##__VA_ARGS__)
+        #define ESP_LOGD(tag, format, ...)  esp_log_write(ESP_LOG_DEBUG,   tag, format, ##__VA_ARGS__)
+        #define ESP_LOGV(tag, format, ...)  esp_log_write(ESP_LOG_VERBOSE, tag, format, ##__VA_ARGS__)
+
+    #ifdef __cplusplus
+    }
+    #endif
+
+#endif
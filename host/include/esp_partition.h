@@ -0,0 +1,81 @@
+/*
+    esp_partition.h - ESP-IDF flash partitions on a file (host build)
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+#ifndef _HOST_ESP_PARTITION_H
+
+#define _HOST_ESP_PARTITION_H	1
+
+    #ifdef __cplusplus
+    extern "C" {
+    #endif
+
+        #include <stdint.h>
+        #include <stddef.h>
+        #include <stdbool.h>
+        #include "esp_err.h"
+
+        typedef enum {
+            ESP_PARTITION_TYPE_APP  = 0x00,
+            ESP_PARTITION_TYPE_DATA = 0x01,
+        } esp_partition_type_t ;
+
+        typedef int esp_partition_subtype_t ;
+
+        typedef enum {
+            SPI_FLASH_MMAP_DATA,
+            SPI_FLASH_MMAP_INST,
+        } spi_flash_mmap_memory_t ;
+
+        typedef uint32_t spi_flash_mmap_handle_t ;
+
+        typedef struct {
+            esp_partition_type_t    type ;
+            esp_partition_subtype_t subtype ;
+            uint32_t                address ;
+            uint32_t                size ;
+            char                    label[17] ;
+            bool                    encrypted ;
+        } esp_partition_t ;
+
+        extern const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                               const char *label) ;
+        extern esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size) ;
+        extern esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size) ;
+        extern esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size) ;
+        extern esp_err_t esp_partition_mmap(const esp_partition_t *partition, size_t offset, size_t size,
+                                            spi_flash_mmap_memory_t memory, const void **out_ptr,
+                                            spi_flash_mmap_handle_t *out_handle) ;
+        extern void      spi_flash_munmap(spi_flash_mmap_handle_t handle) ;
+
+    #ifdef __cplusplus
+    }
+    #endif
+
+#endif
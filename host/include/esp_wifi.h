@@ -0,0 +1,175 @@
+/*
+    esp_wifi.h - ESP-IDF Wi-Fi scan and FTM initiator API (host build)
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+//
+// The mocked driver ( wifi_mock.c ) answers scans and FTM sessions from a
+// table of synthetic or recorded responders. The SoftAP configuration,
+// bandwidth and TX power are only stored.
+//
+
+#ifndef _HOST_ESP_WIFI_H
+
+#define _HOST_ESP_WIFI_H	1
+
+    #ifdef __cplusplus
+    extern "C" {
+    #endif
+
+        #include <stdint.h>
+        #include <stdbool.h>
+        #include "esp_err.h"
+        #include "esp_event.h"
+
+        #define MACSTR      "%02x:%02x:%02x:%02x:%02x:%02x"
+        #define MAC2STR(a)  (a)[0], (a)[1], (a)[2], (a)[3], (a)[4], (a)[5]
+
+        typedef enum {
+            WIFI_EVENT_SCAN_DONE = 1,
+            WIFI_EVENT_AP_STACONNECTED,
+            WIFI_EVENT_AP_STADISCONNECTED,
+            WIFI_EVENT_FTM_REPORT,
+        } wifi_event_t ;
+
+        typedef enum {
+            FTM_STATUS_SUCCESS = 0,
+            FTM_STATUS_UNSUPPORTED,
+            FTM_STATUS_CONF_REJECTED,
+            FTM_STATUS_NO_RESPONSE,
+            FTM_STATUS_FAIL,
+        } wifi_ftm_status_t ;
+
+        typedef enum {
+            WIFI_IF_STA = 0,
+            WIFI_IF_AP,
+        } wifi_interface_t ;
+
+        #define ESP_IF_WIFI_STA     WIFI_IF_STA
+        #define ESP_IF_WIFI_AP      WIFI_IF_AP
+
+        typedef enum {
+            WIFI_BW_HT20 = 1,
+            WIFI_BW_HT40,
+        } wifi_bandwidth_t ;
+
+        typedef struct {
+            uint8_t  ssid[32] ;
+            uint8_t  password[64] ;
+            uint8_t  ssid_len ;
+            uint8_t  channel ;
+            int      authmode ;
+            uint8_t  max_connection ;
+            bool     ftm_responder ;
+        } wifi_ap_config_t ;
+
+        typedef union {
+            wifi_ap_config_t ap ;
+        } wifi_config_t ;
+
+        typedef struct {
+            uint8_t *ssid ;
+            uint8_t *bssid ;
+            uint8_t  channel ;
+            bool     show_hidden ;
+        } wifi_scan_config_t ;
+
+        typedef struct {
+            uint8_t  bssid[6] ;
+            uint8_t  ssid[33] ;
+            uint8_t  primary ;
+            int      second ;
+            int8_t   rssi ;
+            int      authmode ;
+            uint32_t ftm_responder:1 ;
+            uint32_t ftm_initiator:1 ;
+        } wifi_ap_record_t ;
+
+        typedef struct {
+            uint8_t  resp_mac[6] ;
+            uint8_t  channel ;
+            uint8_t  frm_count ;
+            uint16_t burst_period ;
+        } wifi_ftm_initiator_cfg_t ;
+
+        typedef struct {
+            uint8_t  dlog_token ;
+            int8_t   rssi ;
+            uint32_t rtt ;                                  // pico-seconds
+            uint64_t t1 ;                                   // pico-seconds
+            uint64_t t2 ;
+            uint64_t t3 ;
+            uint64_t t4 ;
+        } wifi_ftm_report_entry_t ;
+
+        typedef struct {
+            uint8_t                  peer_mac[6] ;
+            wifi_ftm_status_t        status ;
+            uint32_t                 rtt_raw ;              // nano-seconds
+            uint32_t                 rtt_est ;              // nano-seconds
+            uint32_t                 dist_est ;             // centi-meters
+            wifi_ftm_report_entry_t *ftm_report_data ;      // released by the event handler ( free() )
+            uint8_t                  ftm_report_num_entries ;
+        } wifi_event_ftm_report_t ;
+
+        typedef struct {
+            uint32_t status ;                               // 0 : success
+            uint8_t  number ;
+            uint8_t  scan_id ;
+        } wifi_event_sta_scan_done_t ;
+
+        typedef struct {
+            uint8_t  mac[6] ;
+            uint8_t  aid ;
+            bool     is_mesh_child ;
+        } wifi_event_ap_staconnected_t ;
+
+        typedef struct {
+            uint8_t  mac[6] ;
+            uint8_t  aid ;
+            bool     is_mesh_child ;
+        } wifi_event_ap_stadisconnected_t ;
+
+        extern esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t *conf) ;
+        extern esp_err_t esp_wifi_get_config(wifi_interface_t interface, wifi_config_t *conf) ;
+        extern esp_err_t esp_wifi_set_bandwidth(wifi_interface_t ifx, wifi_bandwidth_t bw) ;
+        extern esp_err_t esp_wifi_get_bandwidth(wifi_interface_t ifx, wifi_bandwidth_t *bw) ;
+        extern esp_err_t esp_wifi_set_max_tx_power(int8_t power) ;
+        extern esp_err_t esp_wifi_get_max_tx_power(int8_t *power) ;
+        extern esp_err_t esp_wifi_scan_start(const wifi_scan_config_t *config, bool block) ;
+        extern esp_err_t esp_wifi_scan_get_ap_num(uint16_t *number) ;
+        extern esp_err_t esp_wifi_scan_get_ap_records(uint16_t *number, wifi_ap_record_t *ap_records) ;
+        extern esp_err_t esp_wifi_ftm_initiate_session(wifi_ftm_initiator_cfg_t *cfg) ;
+        extern esp_err_t esp_wifi_ftm_end_session(void) ;
+        extern esp_err_t esp_wifi_ftm_resp_set_offset(int16_t offset_cm) ;
+
+    #ifdef __cplusplus
+    }
+    #endif
+
+#endif
@@ -0,0 +1,135 @@
+/*
+    FreeRTOS.h - FreeRTOS API on POSIX threads (host build)
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+//
+// Tasks, queues, semaphores and event groups of the firmware run on POSIX
+// threads. Ticks follow CONFIG_FREERTOS_HZ, so deadlines computed by the
+// firmware ( ms / portTICK_PERIOD_MS ) keep their meaning on the host.
+//
+// Critical sections ( portENTER_CRITICAL ) share a single recursive mutex.
+//
+
+#ifndef _HOST_FREERTOS_H
+
+#define _HOST_FREERTOS_H	1
+
+    #ifdef __cplusplus
+    extern "C" {
+    #endif
+
+        #include <stdint.h>
+        #include <stdbool.h>
+        #include <stddef.h>
+        #include <strings.h>
+        #include "sdkconfig.h"
+
+        typedef int             BaseType_t ;
+        typedef unsigned int    UBaseType_t ;
+        typedef uint32_t        TickType_t ;
+        typedef uint32_t        EventBits_t ;
+        typedef int             portMUX_TYPE ;
+
+        #define pdTRUE                          1
+        #define pdFALSE                         0
+        #define pdPASS                          1
+        #define pdFAIL                          0
+        #define portMAX_DELAY                   ((TickType_t) 0xffffffffUL)
+        #define configTICK_RATE_HZ              CONFIG_FREERTOS_HZ
+        #define portTICK_PERIOD_MS              ((TickType_t) 1000 / configTICK_RATE_HZ)
+        #define pdMS_TO_TICKS(ms)               ((TickType_t) (((uint64_t) (ms) * configTICK_RATE_HZ) / 1000))
+        #define portMUX_INITIALIZER_UNLOCKED    0
+
+        #define portENTER_CRITICAL(mux)         host_enter_critical(mux)
+        #define portEXIT_CRITICAL(mux)          host_exit_critical(mux)
+        #define portENTER_CRITICAL_ISR(mux)     host_enter_critical(mux)
+        #define portEXIT_CRITICAL_ISR(mux)      host_exit_critical(mux)
+
+        #define BIT0    0x00000001
+        #define BIT1    0x00000002
+        #define BIT2    0x00000004
+        #define BIT3    0x00000008
+        #define BIT4    0x00000010
+        #define BIT5    0x00000020
+        #define BIT6    0x00000040
+        #define BIT7    0x00000080
+
+        typedef struct host_task      *TaskHandle_t ;
+        typedef struct host_semaphore *SemaphoreHandle_t ;
+        typedef struct host_queue     *QueueHandle_t ;
+        typedef struct host_event     *EventGroupHandle_t ;
+
+        // storage of the static semaphores ( large enough for a struct host_semaphore )
+        typedef struct {
+            uint64_t storage[16] ;
+        } StaticSemaphore_t ;
+
+        typedef void (*TaskFunction_t)(void *) ;
+
+        extern void host_enter_critical(portMUX_TYPE *mux) ;
+        extern void host_exit_critical(portMUX_TYPE *mux) ;
+
+        // TASKS
+        extern BaseType_t   xTaskCreate(TaskFunction_t function, const char *name, uint32_t stack_depth,
+                                        void *parameters, UBaseType_t priority, TaskHandle_t *task) ;
+        extern void         vTaskDelete(TaskHandle_t task) ;
+        extern void         vTaskDelay(TickType_t ticks) ;
+        extern TickType_t   xTaskGetTickCount(void) ;
+        extern TaskHandle_t xTaskGetCurrentTaskHandle(void) ;
+        extern char        *pcTaskGetTaskName(TaskHandle_t task) ;
+        extern UBaseType_t  uxTaskGetStackHighWaterMark(TaskHandle_t task) ;
+
+        // SEMAPHORES
+        extern SemaphoreHandle_t xSemaphoreCreateMutex(void) ;
+        extern SemaphoreHandle_t xSemaphoreCreateBinary(void) ;
+        extern SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *buffer) ;
+        extern SemaphoreHandle_t xSemaphoreCreateCountingStatic(UBaseType_t max_count, UBaseType_t initial_count,
+                                                                StaticSemaphore_t *buffer) ;
+        extern BaseType_t        xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) ;
+        extern BaseType_t        xSemaphoreGive(SemaphoreHandle_t semaphore) ;
+        extern void              vSemaphoreDelete(SemaphoreHandle_t semaphore) ;
+
+        // QUEUES
+        extern QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) ;
+        extern BaseType_t    xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks) ;
+        extern BaseType_t    xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks) ;
+
+        // EVENT GROUPS
+        extern EventGroupHandle_t xEventGroupCreate(void) ;
+        extern EventBits_t        xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) ;
+        extern EventBits_t        xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) ;
+        extern EventBits_t        xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits,
+                                                      BaseType_t clear_on_exit, BaseType_t wait_for_all,
+                                                      TickType_t ticks) ;
+
+    #ifdef __cplusplus
+    }
+    #endif
+
+#endif
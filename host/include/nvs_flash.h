@@ -0,0 +1,67 @@
+/*
+    nvs_flash.h - ESP-IDF NVS (host build)
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+//
+// Key/value blobs kept in memory ( lost when the daemon exits ).
+//
+
+#ifndef _HOST_NVS_FLASH_H
+
+#define _HOST_NVS_FLASH_H	1
+
+    #ifdef __cplusplus
+    extern "C" {
+    #endif
+
+        #include <stdint.h>
+        #include <stddef.h>
+        #include "esp_err.h"
+
+        #define ESP_ERR_NVS_NOT_FOUND       0x1102
+
+        typedef uint32_t nvs_handle_t ;
+
+        typedef enum {
+            NVS_READONLY,
+            NVS_READWRITE,
+        } nvs_open_mode_t ;
+
+        extern esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle) ;
+        extern esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length) ;
+        extern esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length) ;
+        extern esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key) ;
+        extern esp_err_t nvs_commit(nvs_handle_t handle) ;
+        extern void nvs_close(nvs_handle_t handle) ;
+
+    #ifdef __cplusplus
+    }
+    #endif
+
+#endif
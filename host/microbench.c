@@ -0,0 +1,604 @@
+/*
+    microbench.c - Host Microbenchmarks
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+//
+// Measures the CPU hot spots of the command path on the host, one unit at a
+// time : the FIFOs, the command framing ( command_processing() ) of a mixed
+// command stream and of single commands of each type, and the report
+// formatting ( ftm_process_report() , tool_scan_report() ).
+//
+// The TCP server is replaced by an in-memory one ( same FIFOs , the output is
+// drained instead of transmitted ) and the console logging is disabled.
+// Heap ( malloc ) and memory pool allocations are counted per operation.
+//
+// usage : chronos_microbench [-t ms] [-b name] [-o results.csv]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_event.h"
+#include "esp_wifi.h"
+#include "fifo.h"
+#include "server.h"
+#include "command.h"
+#include "ftm.h"
+#include "tool.h"
+#include "pool.h"
+#include "history.h"
+#include "journal.h"
+#include "metrics.h"
+#include "trace.h"
+#include "capture.h"
+#include "udp.h"
+#include "radio.h"
+#include "responder.h"
+#include "bus.h"
+#include "host.h"
+
+#define MICROBENCH_FIFO_SIZE            16384       // as server.c
+#define MICROBENCH_DEFAULT_MS           200         // minimum run time of each benchmark
+#define MICROBENCH_REPORT_ENTRIES       64
+#define MICROBENCH_SCAN_RECORDS         (POOL_LARGE_BLOCK_SIZE / sizeof(wifi_ap_record_t))
+
+int host_server_port = CONFIG_ESP_PORT_DEFAULT ;
+int host_stream_port = CONFIG_ESP_STREAM_PORT_DEFAULT ;
+
+//
+// Benchmark ( one operation per call of <run> , <bytes> processed per operation )
+//
+typedef struct {
+    const char   *name ;
+    const char   *unit ;                            // what an operation is
+    void        (*setup)(void) ;
+    void        (*run)(void) ;
+} microbench_t ;
+
+static struct {
+    fifo_type     fifo[2] ;                         // incoming , outgoing ( server.c )
+    unsigned char buffer[2][MICROBENCH_FIFO_SIZE] ;
+    uint64_t      rx_bytes ;                        // bytes handed to the server / the sink
+    uint64_t      tx_bytes ;
+    uint64_t      commands ;
+} microbench_server ;
+
+static volatile uint64_t microbench_heap_allocs ;
+
+static const char   *microbench_stream ;            // mixed command stream
+static size_t        microbench_stream_len ;
+static unsigned int  microbench_stream_commands ;
+static const char   *microbench_command ;           // command of the dispatch benchmarks
+static size_t        microbench_command_len ;
+static ftm_session_t microbench_session ;
+static wifi_ftm_report_entry_t microbench_entries[MICROBENCH_REPORT_ENTRIES] ;
+static wifi_ap_record_t *microbench_records ;
+
+// heap allocations are counted by wrapping the glibc allocator ( not under a sanitizer , which owns it )
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+    #define MICROBENCH_COUNT_HEAP   1
+#else
+    #define MICROBENCH_COUNT_HEAP   0
+#endif
+
+// FUNCTION PROTOTYPES
+#if (MICROBENCH_COUNT_HEAP)
+void *__libc_malloc(size_t size) ;
+void *__libc_calloc(size_t n, size_t size) ;
+void *__libc_realloc(void *ptr, size_t size) ;
+void *malloc(size_t size) ;
+void *calloc(size_t n, size_t size) ;
+void *realloc(void *ptr, size_t size) ;
+#endif
+unsigned int server_get_byte(unsigned char *c) ;
+unsigned int server_put_byte(unsigned char c) ;
+void server_put_bytes(unsigned char *buffer, unsigned int len) ;
+void server_stream_bytes(unsigned char *buffer, unsigned int len) ;
+void server_flush(void) ;
+uint32_t server_peer_address(void) ;
+void server_init(void) ;
+static void microbench_drain(void) ;
+static void microbench_sink(unsigned char *buffer, unsigned int len) ;
+static uint64_t microbench_now_ns(void) ;
+static unsigned int microbench_pool_allocs(void) ;
+static void microbench_fifo(void) ;
+static void microbench_stream_setup(void) ;
+static void microbench_stream_run(void) ;
+static void microbench_command_ftm_ssid(void) ;
+static void microbench_command_ftm_mac(void) ;
+static void microbench_command_scan(void) ;
+static void microbench_command_stats(void) ;
+static void microbench_command_unknown(void) ;
+static void microbench_command_run(void) ;
+static void microbench_report_setup(void) ;
+static void microbench_report_all(void) ;
+static void microbench_report_rtt_rssi(void) ;
+static void microbench_report_run(void) ;
+static void microbench_scan_setup(void) ;
+static void microbench_scan_run(void) ;
+static void microbench_init(void) ;
+int main(int argc, char *argv[]) ;
+
+#if (MICROBENCH_COUNT_HEAP)
+//
+// Heap allocations ( glibc ) , counted
+//
+void *malloc(size_t size)
+{
+    __atomic_add_fetch(&microbench_heap_allocs, 1, __ATOMIC_RELAXED) ;
+    return __libc_malloc(size) ;
+}
+
+void *calloc(size_t n, size_t size)
+{
+    __atomic_add_fetch(&microbench_heap_allocs, 1, __ATOMIC_RELAXED) ;
+    return __libc_calloc(n, size) ;
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    __atomic_add_fetch(&microbench_heap_allocs, 1, __ATOMIC_RELAXED) ;
+    return __libc_realloc(ptr, size) ;
+}
+#endif
+
+//
+// In-memory server ( the interface of server.c used by the command path )
+//
+unsigned int server_get_byte(unsigned char *c)
+{
+    return fifo_get(&microbench_server.fifo[0], c) ;
+}
+
+unsigned int server_put_byte(unsigned char c)
+{
+    // the output task of server.c drains the FIFO while it fills
+    if (!fifo_put(&microbench_server.fifo[1], c))
+    {
+        microbench_drain() ;
+        fifo_put(&microbench_server.fifo[1], c) ;
+    }
+    return 1 ;
+}
+
+void server_put_bytes(unsigned char *buffer, unsigned int len)
+{
+    unsigned int k ;
+
+    for (k=0; k<len; k++) server_put_byte(buffer[k]) ;
+}
+
+void server_stream_bytes(unsigned char *buffer, unsigned int len)
+{
+    microbench_drain() ;
+    microbench_server.tx_bytes += len ;
+}
+
+void server_flush(void)
+{
+    microbench_drain() ;
+}
+
+uint32_t server_peer_address(void)
+{
+    return 0 ;
+}
+
+void server_init(void)
+{
+    fifo_config(&microbench_server.fifo[0], microbench_server.buffer[0], MICROBENCH_FIFO_SIZE) ;
+    fifo_config(&microbench_server.fifo[1], microbench_server.buffer[1], MICROBENCH_FIFO_SIZE) ;
+}
+
+//
+// Empty the outgoing FIFO ( as a TCP transmission , without the socket )
+//
+static void microbench_drain(void)
+{
+    unsigned char c ;
+
+    while (fifo_get(&microbench_server.fifo[1], &c)) microbench_server.tx_bytes++ ;
+}
+
+//
+// Output callback of the formatting benchmarks
+//
+static void microbench_sink(unsigned char *buffer, unsigned int len)
+{
+    microbench_server.tx_bytes += len ;
+}
+
+static uint64_t microbench_now_ns(void)
+{
+    struct timespec t ;
+
+    clock_gettime(CLOCK_MONOTONIC, &t) ;
+    return (uint64_t) t.tv_sec * 1000000000ULL + t.tv_nsec ;
+}
+
+static unsigned int microbench_pool_allocs(void)
+{
+    pool_stats_t stats ;
+    unsigned int k, allocs = 0 ;
+
+    for (k=0; k<POOL_NUM_CLASSES; k++)
+    {
+        if (pool_get_stats(k, &stats)) allocs += stats.allocs + stats.fallbacks ;
+    }
+    return allocs ;
+}
+
+//
+// FIFO : fill the incoming FIFO , then empty it ( byte by byte , as server.c )
+//
+static void microbench_fifo(void)
+{
+    unsigned int k ;
+    unsigned char c ;
+
+    for (k=0; k<MICROBENCH_FIFO_SIZE-1; k++) fifo_put(&microbench_server.fifo[0], (unsigned char) k) ;
+    while (fifo_get(&microbench_server.fifo[0], &c)) microbench_server.rx_bytes++ ;
+}
+
+//
+// Mixed command stream : framing , parsing and dispatch , execution and the output FIFO
+//
+// ( FTM commands are answered from the result cache , filled by the warm-up run , scans by the mocked driver )
+//
+static void microbench_stream_setup(void)
+{
+    static const char *commands[] = {
+        "{ \"function\" : \"ftm\" , \"parameters\" : { \"mac\" : \"02:00:00:00:01:00\" , \"channel\" : 1 , \"count\" : 8 , \"max_age_ms\" : 3600000 }} ;\r\n",
+        "{ \"function\" : \"scan\" } ;\r\n",
+        "{ \"function\" : \"ftm\" , \"parameters\" : { \"mac\" : \"02:00:00:00:01:00\" , \"channel\" : 1 , \"count\" : 8 , \"max_age_ms\" : 3600000 , \"timing\" : true }} ;\r\n",
+        "{ \"function\" : \"stats\" } ;\r\n",
+        "{ \"function\" : \"ftm\" , \"parameters\" : { \"mac\" : \"02:00:00:00:01:00\" , \"channel\" : 1 , \"count\" : 12 }} ;\r\n",
+        "{ \"function\" : \"scan\" , \"parameters\" : { \"ssid\" : \"FTM-BENCH-07\" }} ;\r\n",
+        "{ \"function\" : \"pool\" } ;\r\n",
+        "{ \"function\" : \"log\" } ;\r\n",
+        "{ \"function\" : \"history\" , \"parameters\" : { \"max\" : 4 }} ;\r\n",
+        "{ \"function\" : \"unknown\" } ;\r\n",
+        "{ \"function\" : ftm ;\r\n",
+    } ;
+    static char stream[4096] ;
+    unsigned int k ;
+
+    stream[0] = 0 ;
+    for (k=0; k<sizeof(commands)/sizeof(commands[0]); k++) strcat(stream, commands[k]) ;
+
+    microbench_stream = stream ;
+    microbench_stream_len = strlen(stream) ;
+    microbench_stream_commands = k ;
+}
+
+static void microbench_stream_run(void)
+{
+    size_t k ;
+
+    // as server_process_data() : the received frame goes through the incoming FIFO
+    for (k=0; k<microbench_stream_len; k++) fifo_put(&microbench_server.fifo[0], (unsigned char) microbench_stream[k]) ;
+    command_processing() ;
+    microbench_drain() ;
+
+    microbench_server.rx_bytes += microbench_stream_len ;
+    microbench_server.commands += microbench_stream_commands ;
+}
+
+//
+// Dispatch of a single command through command_processing() : framing , parsing , the
+// command_table[] lookup , execution and the output FIFO
+//
+// ( FTM commands are answered from the result cache , filled by the warm-up run , scans by the mocked driver )
+//
+static void microbench_command_ftm_ssid(void)
+{
+    microbench_command = "{ \"function\" : \"ftm\" , \"parameters\" : { \"ssid\" : \"FTM-BENCH-07\" , \"count\" : 64 , \"burst\" : 2 , "
+                         "\"max_age_ms\" : 3600000 , \"fields\" : \"all\" }} ;\r\n" ;
+    microbench_command_len = strlen(microbench_command) ;
+}
+
+static void microbench_command_ftm_mac(void)
+{
+    microbench_command = "{ \"function\" : \"ftm\" , \"parameters\" : { \"mac\" : \"02:00:00:00:01:07\" , \"channel\" : 8 , \"count\" : 64 , "
+                         "\"timeout\" : 5000 , \"retries\" : 2 , \"backoff\" : 50 , \"max_age_ms\" : 3600000 , \"timing\" : true , "
+                         "\"fields\" : [ \"diag\" , \"rtt\" , \"rssi\" ] }} ;\r\n" ;
+    microbench_command_len = strlen(microbench_command) ;
+}
+
+static void microbench_command_scan(void)
+{
+    microbench_command = "{ \"function\" : \"scan\" , \"parameters\" : { \"ssid\" : \"FTM-BENCH-07\" , \"timing\" : true }} ;\r\n" ;
+    microbench_command_len = strlen(microbench_command) ;
+}
+
+static void microbench_command_stats(void)
+{
+    microbench_command = "{ \"function\" : \"stats\" , \"parameters\" : { \"format\" : \"binary\" }} ;\r\n" ;
+    microbench_command_len = strlen(microbench_command) ;
+}
+
+static void microbench_command_unknown(void)
+{
+    microbench_command = "{ \"function\" : \"unknown\" , \"parameters\" : { \"count\" : 8 }} ;\r\n" ;
+    microbench_command_len = strlen(microbench_command) ;
+}
+
+static void microbench_command_run(void)
+{
+    size_t k ;
+
+    // as server_process_data() : the received frame goes through the incoming FIFO
+    for (k=0; k<microbench_command_len; k++) fifo_put(&microbench_server.fifo[0], (unsigned char) microbench_command[k]) ;
+    command_processing() ;
+    microbench_drain() ;
+
+    microbench_server.rx_bytes += microbench_command_len ;
+    microbench_server.commands++ ;
+}
+
+//
+// FTM report formatting ( 64 entries )
+//
+static void microbench_report_setup(void)
+{
+    unsigned int k ;
+
+    for (k=0; k<MICROBENCH_REPORT_ENTRIES; k++)
+    {
+        microbench_entries[k].dlog_token = k + 1 ;
+        microbench_entries[k].rssi = -45 - (int) (k % 7) ;
+        microbench_entries[k].rtt = 33350 + (k * 7919) % 900 ;
+        microbench_entries[k].t1 = 1000000000000ULL + k * 2000000000ULL ;
+        microbench_entries[k].t2 = 173000000000000ULL + k * 2000010000ULL + 16675 ;
+        microbench_entries[k].t3 = microbench_entries[k].t2 + 10000000 ;
+        microbench_entries[k].t4 = microbench_entries[k].t1 + 10000000 + 33350 + (k * 7919) % 900 ;
+    }
+
+    memset(&microbench_session, 0, sizeof(microbench_session)) ;
+    ftm_options_default(&microbench_session.options) ;
+    microbench_session.report = microbench_entries ;
+    microbench_session.report_num_entries = MICROBENCH_REPORT_ENTRIES ;
+    microbench_session.callback = microbench_sink ;
+}
+
+static void microbench_report_all(void)
+{
+    microbench_report_setup() ;
+    microbench_session.options.fields = FTM_FIELD_ALL ;
+}
+
+static void microbench_report_rtt_rssi(void)
+{
+    microbench_report_setup() ;
+    microbench_session.options.fields = FTM_FIELD_RTT | FTM_FIELD_RSSI ;
+}
+
+static void microbench_report_run(void)
+{
+    ftm_process_report(&microbench_session) ;
+}
+
+//
+// Scan report formatting ( as many records as the scan list holds )
+//
+static void microbench_scan_setup(void)
+{
+    unsigned int k ;
+
+    if (!microbench_records) microbench_records = calloc(MICROBENCH_SCAN_RECORDS, sizeof(wifi_ap_record_t)) ;
+
+    for (k=0; k<MICROBENCH_SCAN_RECORDS; k++)
+    {
+        sprintf((char *) microbench_records[k].ssid, "FTM-BENCH-%02u", k) ;
+        microbench_records[k].bssid[0] = 0x02 ;
+        microbench_records[k].bssid[4] = 0x01 ;
+        microbench_records[k].bssid[5] = (uint8_t) k ;
+        microbench_records[k].primary = 1 + k % 11 ;
+        microbench_records[k].rssi = -40 - (int) (k % 50) ;
+        microbench_records[k].ftm_responder = k & 1 ;
+    }
+}
+
+static void microbench_scan_run(void)
+{
+    tool_scan_report(microbench_records, MICROBENCH_SCAN_RECORDS, microbench_sink) ;
+}
+
+static const microbench_t microbench[] = {
+    { "fifo_put+fifo_get",          "byte",     0,                              microbench_fifo },
+    { "command stream (mixed)",     "command",  microbench_stream_setup,        microbench_stream_run },
+    { "dispatch ftm by ssid",       "command",  microbench_command_ftm_ssid,    microbench_command_run },
+    { "dispatch ftm by mac",        "command",  microbench_command_ftm_mac,     microbench_command_run },
+    { "dispatch scan",              "command",  microbench_command_scan,        microbench_command_run },
+    { "dispatch stats",             "command",  microbench_command_stats,       microbench_command_run },
+    { "dispatch unknown function",  "command",  microbench_command_unknown,     microbench_command_run },
+    { "ftm report 64 x all",        "report",   microbench_report_all,          microbench_report_run },
+    { "ftm report 64 x rtt,rssi",   "report",   microbench_report_rtt_rssi,     microbench_report_run },
+    { "scan report",                "report",   microbench_scan_setup,          microbench_scan_run },
+} ;
+
+#define MICROBENCH_COUNT    (sizeof(microbench) / sizeof(microbench[0]))
+
+//
+// Firmware core ( as host.c , without the TCP server )
+//
+static void microbench_init(void)
+{
+    host_responder_t responder ;
+    unsigned char mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x01, 0x00 } ;
+    wifi_config_t wifi_config ;
+    unsigned int k ;
+
+    esp_log_level_set("*", ESP_LOG_NONE) ;
+    tool_log_set_console(false) ;
+
+    metrics_init() ;
+    trace_init() ;
+    pool_init() ;
+    history_init() ;
+    journal_init() ;
+    capture_init() ;
+    udp_init() ;
+
+    // SIMULATED RESPONDERS ( as many as the mocked driver holds )
+    for (k=0; ; k++)
+    {
+        memset(&responder, 0, sizeof(responder)) ;
+        sprintf(responder.ssid, "FTM-BENCH-%02u", k) ;
+        memcpy(responder.mac, mac, 6) ;
+        responder.mac[5] = (unsigned char) k ;
+        responder.channel = 1 + k % 11 ;
+        responder.distance_m = 2.0 + k ;
+        responder.rssi = -40 - (int) k ;
+        responder.sigma_ps = 200.0 ;
+        responder.drift_ppm = 5.0 ;
+
+        if (!wifi_mock_add_responder(&responder))
+            break ;
+    }
+
+    wifi_mock_init(1, 0, 0) ;
+    bus_init() ;
+    responder_init() ;
+    radio_init() ;
+    memset(&wifi_config, 0, sizeof(wifi_config)) ;
+    radio_setup(&wifi_config) ;
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_AP, &wifi_config)) ;
+    radio_start() ;
+    responder_start() ;
+    ftm_init() ;
+    server_init() ;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int min_ms = MICROBENCH_DEFAULT_MS ;
+    const char *filter = 0 ;
+    const char *output = 0 ;
+    FILE *csv = 0 ;
+    unsigned int k ;
+    int opt ;
+
+    while ( (opt = getopt(argc, argv, "t:b:o:h")) != -1 )
+    {
+        switch (opt)
+        {
+            case 't' : min_ms = atoi(optarg) ;
+                       break ;
+            case 'b' : filter = optarg ;
+                       break ;
+            case 'o' : output = optarg ;
+                       break ;
+            default  : fprintf(stderr, "usage: %s [-t ms] [-b name] [-o results.csv]\n"
+                                       "  -t  minimum run time of each benchmark (default %d mSec)\n"
+                                       "  -b  only run the benchmarks whose name contains this string\n"
+                                       "  -o  also write the results as CSV\n",
+                                       argv[0], MICROBENCH_DEFAULT_MS) ;
+                       return (opt == 'h') ? 0 : 1 ;
+        }
+    }
+
+    microbench_init() ;
+
+    if (output && !(csv = fopen(output, "w")))
+    {
+        perror(output) ;
+        return 1 ;
+    }
+    if (csv) fprintf(csv, "benchmark,unit,operations,ns_per_op,bytes_in_per_op,bytes_out_per_op,ns_per_byte,heap_allocs_per_op,pool_allocs_per_op\n") ;
+
+    if (!MICROBENCH_COUNT_HEAP) printf("( heap allocations are not counted in this build )\n") ;
+
+    printf("%-28s %-8s %10s %12s %10s %10s %9s %10s %10s\n",
+           "benchmark", "unit", "ops", "ns/op", "in B/op", "out B/op", "ns/byte", "heap/op", "pool/op") ;
+
+    for (k=0; k<MICROBENCH_COUNT; k++)
+    {
+        const microbench_t *b = &microbench[k] ;
+        uint64_t iterations = 1, n, start, elapsed ;
+        uint64_t heap, pool, rx, tx, ops ;
+        double per_op, bytes ;
+
+        if (filter && !strstr(b->name, filter))
+            continue ;
+
+        if (b->setup) b->setup() ;
+        b->run() ;                                  // warm-up
+
+        // double the iterations up to the minimum run time
+        while (1)
+        {
+            heap = microbench_heap_allocs ;
+            pool = microbench_pool_allocs() ;
+            rx = microbench_server.rx_bytes ;
+            tx = microbench_server.tx_bytes ;
+            ops = microbench_server.commands ;
+            start = microbench_now_ns() ;
+
+            for (n=0; n<iterations; n++) b->run() ;
+
+            elapsed = microbench_now_ns() - start ;
+            if ( (elapsed >= (uint64_t) min_ms * 1000000ULL) || (iterations >= (1ULL << 32)) )
+                break ;
+            iterations *= 2 ;
+        }
+
+        heap = microbench_heap_allocs - heap ;
+        pool = microbench_pool_allocs() - pool ;
+        rx = microbench_server.rx_bytes - rx ;
+        tx = microbench_server.tx_bytes - tx ;
+        ops = microbench_server.commands - ops ;
+
+        // operations : bytes for the FIFO , commands of the stream , calls otherwise
+        if (!strcmp(b->unit, "byte")) ops = rx ;
+        else if (ops == 0) ops = iterations ;
+
+        per_op = (double) elapsed / ops ;
+        bytes = (double) (rx ? rx : tx) ;
+
+        printf("%-28s %-8s %10llu %12.1f %10.1f %10.1f %9.2f %10.2f %10.2f\n",
+               b->name, b->unit, (unsigned long long) ops, per_op,
+               (double) rx / ops, (double) tx / ops, bytes ? elapsed / bytes : 0.0,
+               (double) heap / ops, (double) pool / ops) ;
+
+        if (csv) fprintf(csv, "%s,%s,%llu,%.1f,%.1f,%.1f,%.3f,%.3f,%.3f\n",
+                         b->name, b->unit, (unsigned long long) ops, per_op,
+                         (double) rx / ops, (double) tx / ops, bytes ? elapsed / bytes : 0.0,
+                         (double) heap / ops, (double) pool / ops) ;
+    }
+
+    if (csv) fclose(csv) ;
+
+    return 0 ;
+}
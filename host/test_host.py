@@ -0,0 +1,191 @@
+#! /usr/local/bin/python
+
+#
+# Created on Thu Dec 30 2021
+#
+# Copyright (c) 2021 Cezar Menezes
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#
+# Contact: cezar.menezes@live.com
+#
+#
+
+#
+# Load generator and latency benchmark of the Chronos TCP command protocol
+#
+# Scripted test of the host build : starts chronos_host on free local ports with the
+# responder table of host/responders.conf , then checks the responses of the "scan" ,
+# "ftm" and "history" commands against the simulated responders ( run by ctest ).
+# A replayed responder without any valid T1..T4 exchange is added to the table.
+#
+# usage : test_host.py build-host/chronos_host host/responders.conf
+#
+
+import re
+import sys
+import json
+import time
+import socket
+import tempfile
+import subprocess
+
+# simulated responders of host/responders.conf : ssid , mac , channel , distance ( meters )
+RESPONDERS = [
+    ('FTM-HOST-1', '02:00:00:00:00:01', 6, 5.0),
+    ('FTM-HOST-2', '02:00:00:00:00:02', 6, 12.5),
+    ('FTM-HOST-3', '02:00:00:00:00:03', 11, 30.0),
+]
+
+# replayed responder whose exchanges all lack T1 ( no usable timestamps )
+INVALID = ('FTM-HOST-4', '02:00:00:00:00:04', 6)
+
+TOLERANCE_M = 0.5
+TIMEOUT_S = 20.0
+
+failures = []
+
+def check(condition, what):
+    print('%s : %s' % ('ok  ' if condition else 'FAIL', what))
+    if not condition:
+        failures.append(what)
+
+def free_port():
+    probe = socket.socket()
+    probe.bind(('127.0.0.1', 0))
+    port = probe.getsockname()[1]
+    probe.close()
+    return port
+
+#
+# Start the daemon and connect to it
+#
+def spawn(binary, responders):
+
+    port, stream_port = free_port(), free_port()
+    command = [ binary, '-p', str(port), '-P', str(stream_port), '-r', responders, '-f', '100', '-S', '1' ]
+    process = subprocess.Popen(command, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+
+    for k in range(50):
+        try:
+            return process, socket.create_connection(('127.0.0.1', port), timeout=TIMEOUT_S)
+        except OSError:
+            time.sleep(0.1)
+
+    process.kill()
+    sys.exit('chronos_host did not accept connections on port %d' % port)
+
+#
+# Send a command and collect its lines until one matches the terminator
+#
+def request(sock, command, terminator):
+
+    sock.sendall((json.dumps(command) + ' ;').encode())
+
+    data, lines, deadline = b'', [], time.time() + TIMEOUT_S
+    while time.time() < deadline:
+        while b'\n' in data:
+            line, data = data.split(b'\n', 1)
+            line = line.decode(errors='replace').strip()
+            lines.append(line)
+            if re.search(terminator, line):
+                return lines
+        chunk = sock.recv(65536)
+        if not chunk:
+            break
+        data += chunk
+
+    check(False, '%s : no line matching "%s" ( got %d lines )' % (command['function'], terminator, len(lines)))
+    return lines
+
+def distance(lines):
+    for line in lines:
+        m = re.search(r'Distance - ([0-9.]+) meters, Precision', line)
+        if m:
+            return float(m.group(1))
+    return None
+
+def main():
+
+    if len(sys.argv) != 3:
+        sys.exit('usage : test_host.py chronos_host responders.conf')
+
+    scratch = tempfile.TemporaryDirectory()
+    replay, responders = scratch.name + '/invalid.csv', scratch.name + '/responders.conf'
+    with open(replay, 'w') as f:
+        for k in range(8):
+            f.write('%d,-50,33000,0,%d,%d,%d\n' % (k + 1, 3000000000000 + k, 3000010000000 + k, 1000010033000 + k))
+    with open(sys.argv[2]) as src, open(responders, 'w') as f:
+        f.write(src.read())
+        f.write('%s  %s  %d  8.00  -50  0  0  0.00  %s\n' % (INVALID + (replay,)))
+
+    process, sock = spawn(sys.argv[1], responders)
+
+    try:
+        # SCAN : EVERY RESPONDER , FTM CAPABLE
+        lines = request(sock, { 'function' : 'scan' }, r'^sta scan done')
+        for ssid, mac, channel, meters in RESPONDERS:
+            check(any(('[%s]' % ssid in l) and ('[ch %d][mac %s][FTM]' % (channel, mac) in l) for l in lines),
+                  'scan lists %s ( ch %d , %s )' % (ssid, channel, mac))
+
+        # FTM BY SSID AND BY MAC
+        ranged = []
+        for ssid, mac, channel, meters in RESPONDERS[:2]:
+            for target, parameters in ((ssid, { 'ssid' : ssid, 'count' : 16 }),
+                                       (mac, { 'mac' : mac, 'channel' : channel, 'count' : 16 })):
+                lines = request(sock, { 'function' : 'ftm', 'parameters' : parameters }, r'^Session Status - ')
+                check(any(l.startswith('Session Status - 0 (success)') for l in lines), 'ftm %s succeeds' % target)
+                d = distance(lines)
+                check((d is not None) and (abs(d - meters) <= TOLERANCE_M),
+                      'ftm %s distance %s m ( expected %.1f m )' % (target, d, meters))
+                ranged.append((mac, meters))
+
+        # HISTORY : ONE RECORD PER SESSION , OLDEST FIRST
+        lines = request(sock, { 'function' : 'history', 'parameters' : { 'max' : 16 } }, r'"seq":%d,' % len(ranged))
+        header, records = json.loads(lines[0]), [ json.loads(l) for l in lines[1:] ]
+        check(header.get('history') == len(ranged), 'history holds %d records ( %s )' % (len(ranged), header.get('history')))
+        check([ r['mac'] for r in records ] == [ mac for mac, meters in ranged ], 'history records follow the sessions')
+        check(all(abs(r['dist_cm'] - meters * 100) <= TOLERANCE_M * 100 for r, (mac, meters) in zip(records, ranged)),
+              'history distances match the responders')
+
+        lines = request(sock, { 'function' : 'history', 'parameters' : { 'mac' : RESPONDERS[1][1], 'max' : 1 } }, r'^\{"seq"')
+        check(json.loads(lines[-1])['seq'] == len(ranged), 'history "max" keeps the newest record of a responder')
+
+        lines = request(sock, { 'function' : 'history', 'parameters' : { 'mac' : 'zz' } }, r'^Invalid ')
+        check(lines[-1].startswith('Invalid History Query!'), 'history rejects a malformed mac')
+
+        lines = request(sock, { 'function' : 'ftm', 'parameters' : { 'ssid' : RESPONDERS[0][0], 'max_age_ms' : -1 } }, r'^Invalid ')
+        check(lines[-1].startswith('Invalid Session Options!'), 'ftm rejects a negative max_age_ms')
+
+        # ADAPTIVE : NO USABLE EXCHANGE NEVER MEETS THE PRECISION TARGET
+        lines = request(sock, { 'function' : 'ftm', 'parameters' : { 'ssid' : INVALID[0], 'precision' : 10 } },
+                        r'^Adaptive Parameters - ')
+        check(lines[-1].startswith('Adaptive Parameters - Frm Count 64,') and lines[-1].endswith('not met)'),
+              'adaptive ftm %s escalates and misses the target ( %s )' % (INVALID[0], lines[-1]))
+
+    finally:
+        sock.close()
+        process.terminate()
+        process.wait()
+        scratch.cleanup()
+
+    if failures:
+        sys.exit('%d check(s) failed' % len(failures))
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,629 @@
+/*
+    wifi_mock.c - Mocked Wi-Fi Scan and FTM Initiator Driver (host build)
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+//
+// Scans list the configured responders. An FTM session lasts the air time of
+// its frames ( and of its burst periods ), then a WIFI_EVENT_FTM_REPORT event
+// is posted to the default event loop from the driver thread, as the Wi-Fi
+// task does on the chip.
+//
+// Synthetic responders build the T1..T4 timestamps of every exchange from the
+// true time of flight, a responder clock drift and gaussian timestamp noise :
+//
+//      T1 = Tr(t)                      T2 = Ti(t + tof)
+//      T4 = Tr(t + 2 tof + turn)       T3 = T2 + turn
+//
+// Replayed responders return recorded report entries, one session after the
+// other ( "dlog_token,rssi,rtt,t1,t2,t3,t4" per line , pico-seconds ).
+//
+// Sessions with unknown responders end with FTM_STATUS_NO_RESPONSE.
+//
+// The station bandwidth scales the timestamp noise : HT40 halves it.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_event.h"
+#include "esp_wifi.h"
+#include "host.h"
+
+#define WIFI_MOCK_MAX_RESPONDERS        16
+#define WIFI_MOCK_MAX_ENTRIES           64          // report entries of a session
+#define WIFI_MOCK_DEFAULT_FRAMES        16          // frm_count == 0 ( no preference )
+#define WIFI_MOCK_FRAMES_PER_BURST      8
+#define WIFI_MOCK_TURNAROUND_PS         10000000.0  // T3 - T2 ( 10 uSec )
+#define WIFI_MOCK_NO_RESPONSE_MS        300         // air time of a session without responder
+#define WIFI_MOCK_SPEED_OF_LIGHT        299792458.0 // meters / second
+
+typedef struct {
+    host_responder_t          config ;
+    wifi_ftm_report_entry_t  *replay ;              // recorded entries
+    unsigned int              replay_count ;
+    unsigned int              replay_next ;
+} wifi_mock_responder_t ;
+
+static const char *TAG = "wifi mock" ;
+
+static struct {
+    wifi_mock_responder_t     responder[WIFI_MOCK_MAX_RESPONDERS] ;
+    unsigned int              responders ;
+    wifi_ap_record_t          scan[WIFI_MOCK_MAX_RESPONDERS] ;
+    uint16_t                  scan_count ;
+    unsigned int              frame_us ;
+    unsigned int              scan_ms ;
+    unsigned int              seed ;
+    int16_t                   resp_offset_cm ;
+    wifi_config_t             ap_config ;
+    wifi_bandwidth_t          bandwidth[2] ;        // WIFI_IF_STA , WIFI_IF_AP
+    int8_t                    max_tx_power ;        // quarters of dBm
+    // SESSION
+    pthread_t                 thread ;
+    pthread_mutex_t           lock ;
+    pthread_cond_t            cond ;
+    unsigned int              busy ;
+    unsigned int              cancel ;
+    wifi_ftm_initiator_cfg_t  cfg ;
+    uint64_t                  clock_ps ;            // true time of the simulated air
+} wifi_mock ;
+
+// FUNCTION PROTOTYPES
+unsigned int wifi_mock_add_responder(const host_responder_t *responder) ;
+unsigned int wifi_mock_load(const char *path) ;
+void wifi_mock_init(unsigned int seed, unsigned int frame_us, unsigned int scan_ms) ;
+static unsigned int wifi_mock_load_replay(wifi_mock_responder_t *r) ;
+static wifi_mock_responder_t *wifi_mock_find(const unsigned char *mac) ;
+static double wifi_mock_gauss(void) ;
+static unsigned int wifi_mock_synthesize(wifi_mock_responder_t *r, wifi_ftm_report_entry_t *entry, unsigned int count) ;
+static unsigned int wifi_mock_replay(wifi_mock_responder_t *r, wifi_ftm_report_entry_t *entry, unsigned int count) ;
+static void wifi_mock_report(wifi_event_ftm_report_t *event, const wifi_ftm_initiator_cfg_t *cfg) ;
+static unsigned int wifi_mock_air_us(const wifi_ftm_initiator_cfg_t *cfg) ;
+static void *wifi_mock_task(void *arg) ;
+
+//
+// Add a responder to the simulated air
+//
+// returns 0 if the table is full or the replay file cannot be read
+//
+unsigned int wifi_mock_add_responder(const host_responder_t *responder)
+{
+    wifi_mock_responder_t *r ;
+
+    if (wifi_mock.responders >= WIFI_MOCK_MAX_RESPONDERS)
+        return 0 ;
+
+    r = &wifi_mock.responder[wifi_mock.responders] ;
+    memset(r, 0, sizeof(*r)) ;
+    r->config = *responder ;
+
+    if (r->config.replay[0] && !wifi_mock_load_replay(r))
+        return 0 ;
+
+    wifi_mock.responders++ ;
+    return 1 ;
+}
+
+//
+// Load the responders of a configuration file , one per line :
+//
+//   ssid mac channel distance_m rssi sigma_ps drift_ppm fail [replay.csv]
+//
+// returns the number of responders added
+//
+unsigned int wifi_mock_load(const char *path)
+{
+    FILE *f ;
+    char line[512], mac[32] ;
+    unsigned int added = 0, number = 0 ;
+    unsigned int m[6] ;
+    host_responder_t r ;
+
+    if ( !(f = fopen(path, "r")) )
+    {
+        ESP_LOGE(TAG, "cannot open %s", path) ;
+        return 0 ;
+    }
+
+    while (fgets(line, sizeof(line), f))
+    {
+        number++ ;
+        if ( (line[strspn(line, " \t")] == '#') || (line[strspn(line, " \t\r\n")] == 0) )
+            continue ;
+
+        memset(&r, 0, sizeof(r)) ;
+        if ( (sscanf(line, "%32s %31s %u %lf %d %lf %lf %lf %255s", r.ssid, mac, &r.channel, &r.distance_m,
+                           &r.rssi, &r.sigma_ps, &r.drift_ppm, &r.fail, r.replay) < 8) ||
+             (sscanf(mac, "%x:%x:%x:%x:%x:%x", &m[0], &m[1], &m[2], &m[3], &m[4], &m[5]) != 6) )
+        {
+            ESP_LOGE(TAG, "%s:%u : malformed responder", path, number) ;
+            continue ;
+        }
+
+        for (int k=0; k<6; k++) r.mac[k] = (unsigned char) m[k] ;
+
+        if (wifi_mock_add_responder(&r)) added++ ;
+        else ESP_LOGE(TAG, "%s:%u : responder not added", path, number) ;
+    }
+
+    fclose(f) ;
+    return added ;
+}
+
+//
+// Read the recorded entries of a responder
+//
+static unsigned int wifi_mock_load_replay(wifi_mock_responder_t *r)
+{
+    FILE *f ;
+    char line[256] ;
+    unsigned int token ;
+    int rssi ;
+    unsigned long long rtt, t1, t2, t3, t4 ;
+    wifi_ftm_report_entry_t *entries ;
+
+    if ( !(f = fopen(r->config.replay, "r")) )
+    {
+        ESP_LOGE(TAG, "cannot open %s", r->config.replay) ;
+        return 0 ;
+    }
+
+    while (fgets(line, sizeof(line), f))
+    {
+        if (sscanf(line, "%u,%d,%llu,%llu,%llu,%llu,%llu", &token, &rssi, &rtt, &t1, &t2, &t3, &t4) != 7)
+            continue ;
+
+        if ( !(entries = realloc(r->replay, (r->replay_count + 1) * sizeof(wifi_ftm_report_entry_t))) )
+            break ;
+
+        r->replay = entries ;
+        entries[r->replay_count].dlog_token = (uint8_t) token ;
+        entries[r->replay_count].rssi = (int8_t) rssi ;
+        entries[r->replay_count].rtt = (uint32_t) rtt ;
+        entries[r->replay_count].t1 = t1 ;
+        entries[r->replay_count].t2 = t2 ;
+        entries[r->replay_count].t3 = t3 ;
+        entries[r->replay_count].t4 = t4 ;
+        r->replay_count++ ;
+    }
+
+    fclose(f) ;
+
+    if (!r->replay_count)
+    {
+        ESP_LOGE(TAG, "no entries in %s", r->config.replay) ;
+        return 0 ;
+    }
+
+    ESP_LOGI(TAG, "%s : %u recorded entries", r->config.ssid, r->replay_count) ;
+    return 1 ;
+}
+
+static wifi_mock_responder_t *wifi_mock_find(const unsigned char *mac)
+{
+    unsigned int k ;
+
+    for (k=0; k<wifi_mock.responders; k++)
+    {
+        if (!memcmp(wifi_mock.responder[k].config.mac, mac, 6))
+            return &wifi_mock.responder[k] ;
+    }
+    return NULL ;
+}
+
+//
+// Standard normal deviate ( Box-Muller )
+//
+static double wifi_mock_gauss(void)
+{
+    double u1 = (rand_r(&wifi_mock.seed) + 1.0) / ((double) RAND_MAX + 2.0) ;
+    double u2 = (rand_r(&wifi_mock.seed) + 1.0) / ((double) RAND_MAX + 2.0) ;
+
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2) ;
+}
+
+//
+// Synthetic report entries of a session ( see the clock model above )
+//
+static unsigned int wifi_mock_synthesize(wifi_mock_responder_t *r, wifi_ftm_report_entry_t *entry, unsigned int count)
+{
+    const double tof = r->config.distance_m / WIFI_MOCK_SPEED_OF_LIGHT * 1e12 ;     // pico-seconds
+    const double rate = 1.0 + r->config.drift_ppm * 1e-6 ;
+    const double responder_offset = 1e12 ;          // responder and initiator clocks start apart
+    const double initiator_offset = 3e12 ;
+    const double sigma_ps = (wifi_mock.bandwidth[WIFI_IF_STA] == WIFI_BW_HT40) ? r->config.sigma_ps / 2.0 : r->config.sigma_ps ;
+    unsigned int k ;
+
+    for (k=0; k<count; k++)
+    {
+        double t = (double) wifi_mock.clock_ps + (double) k * wifi_mock.frame_us * 1e6 ;
+        double t1 = t * rate + responder_offset ;
+        double t2 = t + tof + initiator_offset + sigma_ps * wifi_mock_gauss() ;
+        double t3 = t2 + WIFI_MOCK_TURNAROUND_PS ;
+        double t4 = (t + 2.0 * tof + WIFI_MOCK_TURNAROUND_PS) * rate + responder_offset + sigma_ps * wifi_mock_gauss() ;
+        double rtt = (t4 - t1) - (t3 - t2) ;
+
+        entry[k].dlog_token = (uint8_t) (k + 1) ;
+        entry[k].rssi = (int8_t) lround(r->config.rssi + 2.0 * wifi_mock_gauss()) ;
+        entry[k].rtt = (rtt > 0.0) ? (uint32_t) rtt : 0 ;
+        entry[k].t1 = (uint64_t) t1 ;
+        entry[k].t2 = (uint64_t) t2 ;
+        entry[k].t3 = (uint64_t) t3 ;
+        entry[k].t4 = (uint64_t) t4 ;
+    }
+    return count ;
+}
+
+//
+// Next recorded entries of a responder ( the recording wraps around )
+//
+static unsigned int wifi_mock_replay(wifi_mock_responder_t *r, wifi_ftm_report_entry_t *entry, unsigned int count)
+{
+    unsigned int k ;
+
+    for (k=0; k<count; k++)
+    {
+        entry[k] = r->replay[r->replay_next] ;
+        r->replay_next = (r->replay_next + 1) % r->replay_count ;
+    }
+    return count ;
+}
+
+//
+// Build the report event of a session ( report data is released by the event handler )
+//
+static void wifi_mock_report(wifi_event_ftm_report_t *event, const wifi_ftm_initiator_cfg_t *cfg)
+{
+    wifi_mock_responder_t *r = wifi_mock_find(cfg->resp_mac) ;
+    unsigned int count = cfg->frm_count ? cfg->frm_count : WIFI_MOCK_DEFAULT_FRAMES ;
+    double sum = 0.0 ;
+    unsigned int k ;
+
+    memset(event, 0, sizeof(*event)) ;
+    memcpy(event->peer_mac, cfg->resp_mac, 6) ;
+
+    if (!r || (r->config.channel != cfg->channel))
+    {
+        event->status = FTM_STATUS_NO_RESPONSE ;
+        return ;
+    }
+
+    if ( (r->config.fail > 0.0) && (rand_r(&wifi_mock.seed) < r->config.fail * RAND_MAX) )
+    {
+        event->status = FTM_STATUS_FAIL ;
+        return ;
+    }
+
+    if (count > WIFI_MOCK_MAX_ENTRIES) count = WIFI_MOCK_MAX_ENTRIES ;
+
+    if ( !(event->ftm_report_data = malloc(count * sizeof(wifi_ftm_report_entry_t))) )
+    {
+        event->status = FTM_STATUS_FAIL ;
+        return ;
+    }
+
+    count = r->replay ? wifi_mock_replay(r, event->ftm_report_data, count)
+                      : wifi_mock_synthesize(r, event->ftm_report_data, count) ;
+
+    for (k=0; k<count; k++)
+    {
+        sum += event->ftm_report_data[k].rtt ;
+    }
+
+    event->status = FTM_STATUS_SUCCESS ;
+    event->ftm_report_num_entries = (uint8_t) count ;
+    event->rtt_raw = (uint32_t) (sum / count / 1000.0) ;
+    event->rtt_est = event->rtt_raw ;
+    event->dist_est = (uint32_t) (sum / count * 1e-12 * WIFI_MOCK_SPEED_OF_LIGHT * 100.0 / 2.0) ;
+}
+
+//
+// Air time of a session ( frames , plus the burst periods between bursts )
+//
+static unsigned int wifi_mock_air_us(const wifi_ftm_initiator_cfg_t *cfg)
+{
+    unsigned int count = cfg->frm_count ? cfg->frm_count : WIFI_MOCK_DEFAULT_FRAMES ;
+    unsigned int bursts = (count + WIFI_MOCK_FRAMES_PER_BURST - 1) / WIFI_MOCK_FRAMES_PER_BURST ;
+
+    if (!wifi_mock_find(cfg->resp_mac))
+        return WIFI_MOCK_NO_RESPONSE_MS * 1000 ;
+
+    return count * wifi_mock.frame_us + (bursts - 1) * cfg->burst_period * 100000 ;
+}
+
+//
+// Driver thread : runs one session at a time
+//
+static void *wifi_mock_task(void *arg)
+{
+    wifi_ftm_initiator_cfg_t cfg ;
+    wifi_event_ftm_report_t event ;
+    struct timespec deadline ;
+    unsigned int air_us ;
+
+    pthread_mutex_lock(&wifi_mock.lock) ;
+
+    while (1)
+    {
+        while (!wifi_mock.busy)
+        {
+            pthread_cond_wait(&wifi_mock.cond, &wifi_mock.lock) ;
+        }
+
+        cfg = wifi_mock.cfg ;
+        air_us = wifi_mock_air_us(&cfg) ;
+
+        clock_gettime(CLOCK_MONOTONIC, &deadline) ;
+        deadline.tv_sec += air_us / 1000000 ;
+        deadline.tv_nsec += (air_us % 1000000) * 1000 ;
+        if (deadline.tv_nsec >= 1000000000L)
+        {
+            deadline.tv_sec++ ;
+            deadline.tv_nsec -= 1000000000L ;
+        }
+
+        while (!wifi_mock.cancel)
+        {
+            if (pthread_cond_timedwait(&wifi_mock.cond, &wifi_mock.lock, &deadline) == ETIMEDOUT)
+                break ;
+        }
+
+        if (!wifi_mock.cancel)
+        {
+            wifi_mock_report(&event, &cfg) ;
+            wifi_mock.clock_ps += (uint64_t) air_us * 1000000ULL ;
+        }
+
+        if (wifi_mock.cancel)
+        {
+            wifi_mock.cancel = 0 ;
+            wifi_mock.busy = 0 ;
+            pthread_cond_broadcast(&wifi_mock.cond) ;
+            continue ;
+        }
+
+        wifi_mock.busy = 0 ;
+        pthread_cond_broadcast(&wifi_mock.cond) ;
+        pthread_mutex_unlock(&wifi_mock.lock) ;
+
+        esp_event_post(WIFI_EVENT, WIFI_EVENT_FTM_REPORT, &event, sizeof(event), 0) ;
+
+        pthread_mutex_lock(&wifi_mock.lock) ;
+    }
+    return NULL ;
+}
+
+//
+// SCAN
+//
+esp_err_t esp_wifi_scan_start(const wifi_scan_config_t *config, bool block)
+{
+    struct timespec t = { wifi_mock.scan_ms / 1000, (wifi_mock.scan_ms % 1000) * 1000000L } ;
+    wifi_event_sta_scan_done_t done = { 0 } ;
+    unsigned int k ;
+
+    nanosleep(&t, NULL) ;
+
+    pthread_mutex_lock(&wifi_mock.lock) ;
+    wifi_mock.scan_count = 0 ;
+    for (k=0; k<wifi_mock.responders; k++)
+    {
+        host_responder_t *r = &wifi_mock.responder[k].config ;
+        wifi_ap_record_t *ap = &wifi_mock.scan[wifi_mock.scan_count] ;
+
+        if (config && config->ssid && strcmp((const char *) config->ssid, r->ssid))
+            continue ;
+
+        memset(ap, 0, sizeof(*ap)) ;
+        memcpy(ap->bssid, r->mac, 6) ;
+        strncpy((char *) ap->ssid, r->ssid, sizeof(ap->ssid) - 1) ;
+        ap->primary = r->channel ;
+        ap->rssi = r->rssi ;
+        ap->ftm_responder = 1 ;
+        wifi_mock.scan_count++ ;
+    }
+    done.number = wifi_mock.scan_count ;
+    pthread_mutex_unlock(&wifi_mock.lock) ;
+
+    esp_event_post(WIFI_EVENT, WIFI_EVENT_SCAN_DONE, &done, sizeof(done), 0) ;
+
+    return ESP_OK ;
+}
+
+esp_err_t esp_wifi_scan_get_ap_num(uint16_t *number)
+{
+    *number = wifi_mock.scan_count ;
+    return ESP_OK ;
+}
+
+esp_err_t esp_wifi_scan_get_ap_records(uint16_t *number, wifi_ap_record_t *ap_records)
+{
+    if (*number > wifi_mock.scan_count) *number = wifi_mock.scan_count ;
+    memcpy(ap_records, wifi_mock.scan, *number * sizeof(wifi_ap_record_t)) ;
+    return ESP_OK ;
+}
+
+//
+// SOFTAP AND RADIO
+//
+esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t *conf)
+{
+    if (interface != WIFI_IF_AP)
+        return ESP_ERR_NOT_SUPPORTED ;
+    if ( (conf->ap.channel < 1) || (conf->ap.channel > 13) )
+        return ESP_ERR_INVALID_ARG ;
+
+    wifi_mock.ap_config = *conf ;
+    return ESP_OK ;
+}
+
+esp_err_t esp_wifi_get_config(wifi_interface_t interface, wifi_config_t *conf)
+{
+    if (interface != WIFI_IF_AP)
+        return ESP_ERR_NOT_SUPPORTED ;
+
+    *conf = wifi_mock.ap_config ;
+    return ESP_OK ;
+}
+
+esp_err_t esp_wifi_set_bandwidth(wifi_interface_t ifx, wifi_bandwidth_t bw)
+{
+    if ( (ifx > WIFI_IF_AP) || ((bw != WIFI_BW_HT20) && (bw != WIFI_BW_HT40)) )
+        return ESP_ERR_INVALID_ARG ;
+
+    wifi_mock.bandwidth[ifx] = bw ;
+    return ESP_OK ;
+}
+
+esp_err_t esp_wifi_get_bandwidth(wifi_interface_t ifx, wifi_bandwidth_t *bw)
+{
+    if (ifx > WIFI_IF_AP)
+        return ESP_ERR_INVALID_ARG ;
+
+    *bw = wifi_mock.bandwidth[ifx] ;
+    return ESP_OK ;
+}
+
+esp_err_t esp_wifi_set_max_tx_power(int8_t power)
+{
+    if ( (power < 8) || (power > 84) )
+        return ESP_ERR_INVALID_ARG ;
+
+    wifi_mock.max_tx_power = power ;
+    return ESP_OK ;
+}
+
+esp_err_t esp_wifi_get_max_tx_power(int8_t *power)
+{
+    *power = wifi_mock.max_tx_power ;
+    return ESP_OK ;
+}
+
+//
+// FTM INITIATOR
+//
+esp_err_t esp_wifi_ftm_initiate_session(wifi_ftm_initiator_cfg_t *cfg)
+{
+    esp_err_t err = ESP_OK ;
+
+    pthread_mutex_lock(&wifi_mock.lock) ;
+    if (wifi_mock.busy)
+    {
+        err = ESP_ERR_INVALID_STATE ;
+    }
+    else
+    {
+        wifi_mock.cfg = *cfg ;
+        wifi_mock.busy = 1 ;
+        pthread_cond_broadcast(&wifi_mock.cond) ;
+    }
+    pthread_mutex_unlock(&wifi_mock.lock) ;
+
+    return err ;
+}
+
+//
+// Cancel the current session ( returns when the driver is idle )
+//
+esp_err_t esp_wifi_ftm_end_session(void)
+{
+    pthread_mutex_lock(&wifi_mock.lock) ;
+    if (wifi_mock.busy)
+    {
+        wifi_mock.cancel = 1 ;
+        pthread_cond_broadcast(&wifi_mock.cond) ;
+        while (wifi_mock.busy)
+        {
+            pthread_cond_wait(&wifi_mock.cond, &wifi_mock.lock) ;
+        }
+    }
+    pthread_mutex_unlock(&wifi_mock.lock) ;
+
+    return ESP_OK ;
+}
+
+esp_err_t esp_wifi_ftm_resp_set_offset(int16_t offset_cm)
+{
+    wifi_mock.resp_offset_cm = offset_cm ;
+    return ESP_OK ;
+}
+
+//
+// Driver Initialization ( a default responder is added when none was configured )
+//
+void wifi_mock_init(unsigned int seed, unsigned int frame_us, unsigned int scan_ms)
+{
+    pthread_condattr_t attr ;
+
+    wifi_mock.seed = seed ;
+    wifi_mock.frame_us = frame_us ;
+    wifi_mock.scan_ms = scan_ms ;
+    wifi_mock.bandwidth[WIFI_IF_STA] = WIFI_BW_HT20 ;
+    wifi_mock.bandwidth[WIFI_IF_AP] = WIFI_BW_HT20 ;
+    wifi_mock.max_tx_power = 80 ;
+    wifi_mock.ap_config.ap.channel = 1 ;
+    wifi_mock.ap_config.ap.ftm_responder = true ;
+
+    if (!wifi_mock.responders)
+    {
+        host_responder_t r = {
+            .ssid = "FTM-HOST-1",
+            .mac = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 },
+            .channel = 6,
+            .distance_m = 5.0,
+            .rssi = -45,
+            .sigma_ps = 300.0,
+            .drift_ppm = 5.0,
+            .fail = 0.0,
+        } ;
+        wifi_mock_add_responder(&r) ;
+    }
+
+    for (unsigned int k=0; k<wifi_mock.responders; k++)
+    {
+        host_responder_t *r = &wifi_mock.responder[k].config ;
+        ESP_LOGI(TAG, "responder %s "MACSTR" ch %u at %.2f m (%s)", r->ssid, MAC2STR(r->mac), r->channel,
+                 r->distance_m, r->replay[0] ? r->replay : "synthetic") ;
+    }
+
+    pthread_mutex_init(&wifi_mock.lock, NULL) ;
+    pthread_condattr_init(&attr) ;
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC) ;
+    pthread_cond_init(&wifi_mock.cond, &attr) ;
+    pthread_condattr_destroy(&attr) ;
+
+    pthread_create(&wifi_mock.thread, NULL, wifi_mock_task, NULL) ;
+    pthread_detach(wifi_mock.thread) ;
+}
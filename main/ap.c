@@ -39,6 +39,9 @@
 #include "lwip/err.h"
 #include "lwip/sys.h"
 #include "ftm.h"
+#include "bus.h"
+#include "radio.h"
+#include "responder.h"
 
 
 /* The examples use WiFi configuration that you can set via project configuration menu.
@@ -48,7 +51,6 @@
 */
 #define PARAM_WIFI_SSID           CONFIG_ESP_WIFI_SSID
 #define PARAM_WIFI_PASS           CONFIG_ESP_WIFI_PASSWORD
-#define PARAM_WIFI_CHANNEL        CONFIG_ESP_WIFI_CHANNEL
 #define PARAM_MAX_STA_CONN        CONFIG_ESP_MAX_STA_CONN
 #define PARAM_INTERFACE_IP        CONFIG_ESP_INTERFACE_IP
 #define PARAM_INTERFACE_GW        CONFIG_ESP_INTERFACE_GW
@@ -58,35 +60,18 @@ static const char *TAG = "wifi softAP";
 
 
 /* FUNCTION PROTOTYPES */
-static void ap_event_handler(void* arg, esp_event_base_t event_base,
-                                    int32_t event_id, void* event_data) ;
+static void ap_station_event(const bus_event_t *event, void *arg) ;
 static void ap_create_and_setup_interface(void) ;
 void ap_init(void) ;
 
 //
-// Access Point Event Handler
+// Access Point Station Events ( bus worker )
 //
-static void ap_event_handler(void* arg, esp_event_base_t event_base,
-                                    int32_t event_id, void* event_data)
+static void ap_station_event(const bus_event_t *event, void *arg)
 {
-    if (event_id == WIFI_EVENT_AP_STACONNECTED)
-    {
-        wifi_event_ap_staconnected_t* event = (wifi_event_ap_staconnected_t*) event_data ;
-        ESP_LOGI(TAG, "station "MACSTR" join, AID=%d",
-                 MAC2STR(event->mac), event->aid) ;
-    } 
-    else if (event_id == WIFI_EVENT_AP_STADISCONNECTED) 
-    {
-        wifi_event_ap_stadisconnected_t* event = (wifi_event_ap_stadisconnected_t*) event_data ;
-        ESP_LOGI(TAG, "station "MACSTR" leave, AID=%d",
-                 MAC2STR(event->mac), event->aid) ;
-
-    }     
-    else 
-    {
-        // FTM EVENT HANDLER
-        ftm_event_handler(arg, event_base, event_id, event_data) ; 
-    }
+    ESP_LOGI(TAG, "station "MACSTR" %s, AID=%d",
+             MAC2STR(event->data.station.mac), (event->type == BUS_STA_CONNECTED) ? "join" : "leave",
+             event->data.station.aid) ;
 }
 
 //
@@ -123,15 +108,18 @@ void ap_init(void)
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT() ;
     ESP_ERROR_CHECK(esp_wifi_init(&cfg)) ;
 
+    // Internal Event Bus ( the only WiFi event handler : typed events to the subscribed modules )
+    bus_init() ;
+    bus_subscribe(BUS_MASK(BUS_STA_CONNECTED) | BUS_MASK(BUS_STA_DISCONNECTED), BUS_WORKER, ap_station_event, NULL) ;
+
     // Initialize FTM module
     ftm_init() ;
 
-    // Event Handler registration
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT,
-                                                        ESP_EVENT_ANY_ID,
-                                                        &ap_event_handler,
-                                                        NULL,
-                                                        NULL)) ;
+    // Responder accounting ( subscribed to the station events before the driver starts )
+    responder_init() ;
+
+    // Radio configuration ( stored in NVS by the "radio" command , or the build configuration )
+    radio_init() ;
 
     // Prepare configuration data for ESP32 AP or STA.
     wifi_config_t wifi_config = 
@@ -139,11 +127,9 @@ void ap_init(void)
         .ap = {
             .ssid = PARAM_WIFI_SSID,
             .ssid_len = strlen(PARAM_WIFI_SSID),
-            .channel = PARAM_WIFI_CHANNEL,
             .password = PARAM_WIFI_PASS,
             .max_connection = PARAM_MAX_STA_CONN,
             .authmode = WIFI_AUTH_WPA_WPA2_PSK,
-            .ftm_responder = true
         },
     };
 
@@ -155,17 +141,20 @@ void ap_init(void)
 
     // Set the WiFi operating mode ( the Chronos Utility works in "WiFi station + soft-AP mode" )
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_APSTA)) ;  
-    // Set the bandwidth of ESP32 specified interface
+    // Set the bandwidth of ESP32 specified interface, the channel and the FTM responder of the AP
     // If the device is used in some special environment, e.g. there are too many other Wi-Fi devices around the ESP32 device, 
     // the performance of HT40 may be degraded. So if the applications need to support same or similar scenarios, it’s recommended 
-    // that the bandwidth is always configured to HT20.
-    esp_wifi_set_bandwidth(ESP_IF_WIFI_STA, WIFI_BW_HT20) ;
-    esp_wifi_set_bandwidth(ESP_IF_WIFI_AP, WIFI_BW_HT20) ;
+    // that the bandwidth is always configured to HT20 ( CONFIG_ESP_RADIO_HT40 , "radio" command ).
+    radio_setup(&wifi_config) ;
     // Set the configuration of the ESP32 STA or AP
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_AP, &wifi_config)) ;
     // Start WiFi according to current configuration
     ESP_ERROR_CHECK(esp_wifi_start()) ;
+    // Set the maximum TX power ( WiFi started )
+    radio_start() ;
+    // Stored responder offset ( WiFi started )
+    responder_start() ;
 
     ESP_LOGI(TAG, "wifi_init_softap finished. SSID:%s password:%s channel:%d",
-             PARAM_WIFI_SSID, PARAM_WIFI_PASS, PARAM_WIFI_CHANNEL) ;
+             PARAM_WIFI_SSID, PARAM_WIFI_PASS, wifi_config.ap.channel) ;
 }
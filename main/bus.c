@@ -0,0 +1,347 @@
+/*
+    bus.c - Internal Event Bus
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+//
+// The WiFi driver events are translated once into typed events ( bus_event_t ) and
+// delivered to the modules that subscribed to their types :
+//
+// BUS_INLINE - called right away by the publisher ( the driver event task ). For the
+// latency critical handlers , as the FTM report that completes a session.
+//
+// BUS_WORKER - called by the bus worker task. The event is copied into a lock-free ring
+// ( multiple publishers , one consumer ) and the driver event task returns at once ;
+// station accounting , logging and other heavy handlers run here. A full ring drops the
+// event ( bus_drops ).
+//
+// The subscriber table is fixed ( BUS_MAX_SUBSCRIBERS ) and only grows : subscriptions
+// happen at initialization , before the driver starts.
+//
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "metrics.h"
+#include "bus.h"
+
+#define BUS_WORKER_IDLE_WAIT_MS     1000
+
+_Static_assert((BUS_QUEUE_LENGTH & (BUS_QUEUE_LENGTH - 1)) == 0, "ESP_BUS_QUEUE_LENGTH must be a power of two") ;
+
+typedef struct {
+    uint32_t      mask ;                            // BUS_MASK() of the event types
+    unsigned int  delivery ;                        // BUS_INLINE or BUS_WORKER
+    bus_handler_t handler ;
+    void         *arg ;
+} bus_subscriber_t ;
+
+//
+// Ring slot ( seq : publication sequence number that may fill the slot , + 1 once filled )
+//
+typedef struct {
+    uint32_t      seq ;
+    bus_event_t   event ;
+} bus_slot_t ;
+
+static struct {
+    bus_subscriber_t subscriber[BUS_MAX_SUBSCRIBERS] ;
+    unsigned int  subscribers ;
+    uint32_t      worker_mask ;                     // types with worker subscribers
+    bus_slot_t    ring[BUS_QUEUE_LENGTH] ;
+    uint32_t      head ;                            // next publication ( publishers )
+    uint32_t      tail ;                            // next delivery ( worker )
+    unsigned int  running ;
+} bus_control ;
+
+static portMUX_TYPE bus_spinlock = portMUX_INITIALIZER_UNLOCKED ;
+static SemaphoreHandle_t bus_wake ;
+
+static const char *TAG = "bus" ;
+
+// FUNCTION PROTOTYPES
+void bus_init(void) ;
+unsigned int bus_subscribe(uint32_t mask, unsigned int delivery, bus_handler_t handler, void *arg) ;
+void bus_publish(const bus_event_t *event) ;
+static unsigned int bus_push(const bus_event_t *event) ;
+static unsigned int bus_pop(bus_event_t *event) ;
+static void bus_dispatch(const bus_event_t *event, unsigned int delivery) ;
+static void bus_wifi_event_handler(void *arg, esp_event_base_t event_base,
+                                   int32_t event_id, void *event_data) ;
+static void bus_worker_task(void *pvParameters) ;
+
+//
+// Subscribe a handler to the event types of <mask>
+//
+// returns 0 if the subscriber table is full
+//
+unsigned int bus_subscribe(uint32_t mask, unsigned int delivery, bus_handler_t handler, void *arg)
+{
+    unsigned int k ;
+
+    if (!handler || !mask)
+        return 0 ;
+
+    portENTER_CRITICAL(&bus_spinlock) ;
+    if ( (k = bus_control.subscribers) < BUS_MAX_SUBSCRIBERS )
+    {
+        bus_control.subscriber[k].mask = mask ;
+        bus_control.subscriber[k].delivery = delivery ;
+        bus_control.subscriber[k].handler = handler ;
+        bus_control.subscriber[k].arg = arg ;
+        if (delivery == BUS_WORKER) bus_control.worker_mask |= mask ;
+        // PUBLISHED AFTER THE ENTRY ( the publishers read the table without the lock )
+        __atomic_store_n(&bus_control.subscribers, k + 1, __ATOMIC_RELEASE) ;
+    }
+    portEXIT_CRITICAL(&bus_spinlock) ;
+
+    if (k >= BUS_MAX_SUBSCRIBERS)
+    {
+        ESP_LOGE(TAG, "subscriber table full (%d)", BUS_MAX_SUBSCRIBERS) ;
+        return 0 ;
+    }
+    return 1 ;
+}
+
+//
+// Copy an event into the ring ( any task , lock-free )
+//
+// returns 0 if the ring is full
+//
+static unsigned int bus_push(const bus_event_t *event)
+{
+    uint32_t pos = __atomic_load_n(&bus_control.head, __ATOMIC_RELAXED) ;
+    bus_slot_t *slot ;
+    int32_t dif ;
+
+    while (1)
+    {
+        slot = &bus_control.ring[pos & (BUS_QUEUE_LENGTH - 1)] ;
+        dif = (int32_t) (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos) ;
+
+        if (dif == 0)
+        {
+            // FREE SLOT : CLAIM IT ( or retry with the position another publisher left )
+            if (__atomic_compare_exchange_n(&bus_control.head, &pos, pos + 1, false,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break ;
+        }
+        else if (dif < 0)
+        {
+            // THE WORKER HAS NOT RELEASED THIS SLOT YET
+            return 0 ;
+        }
+        else
+        {
+            pos = __atomic_load_n(&bus_control.head, __ATOMIC_RELAXED) ;
+        }
+    }
+
+    slot->event = *event ;
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE) ;
+
+    return 1 ;
+}
+
+//
+// Take the oldest event of the ring ( worker task only )
+//
+// returns 0 if the ring is empty
+//
+static unsigned int bus_pop(bus_event_t *event)
+{
+    uint32_t pos = bus_control.tail ;
+    bus_slot_t *slot = &bus_control.ring[pos & (BUS_QUEUE_LENGTH - 1)] ;
+
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos + 1)
+        return 0 ;
+
+    *event = slot->event ;
+    __atomic_store_n(&bus_control.tail, pos + 1, __ATOMIC_RELAXED) ;
+    __atomic_store_n(&slot->seq, pos + BUS_QUEUE_LENGTH, __ATOMIC_RELEASE) ;
+
+    return 1 ;
+}
+
+//
+// Call the subscribers of an event
+//
+static void bus_dispatch(const bus_event_t *event, unsigned int delivery)
+{
+    unsigned int k , n = __atomic_load_n(&bus_control.subscribers, __ATOMIC_ACQUIRE) ;
+    bus_subscriber_t *s ;
+
+    for (k=0; k<n; k++)
+    {
+        s = &bus_control.subscriber[k] ;
+        if ( (s->delivery == delivery) && (s->mask & BUS_MASK(event->type)) )
+        {
+            s->handler(event, s->arg) ;
+        }
+    }
+}
+
+//
+// Publish an event : inline subscribers first , then the worker subscribers ( queued )
+//
+void bus_publish(const bus_event_t *event)
+{
+    bus_event_t queued ;
+
+    if (event->type >= BUS_NUM_TYPES)
+        return ;
+
+    metrics_count(METRICS_BUS_EVENTS, 1) ;
+
+    bus_dispatch(event, BUS_INLINE) ;
+
+    if ( bus_control.running && (bus_control.worker_mask & BUS_MASK(event->type)) )
+    {
+        queued = *event ;
+        if (queued.type == BUS_FTM_REPORT)
+        {
+            // THE REPORT ENTRIES WERE CONSUMED ( OR RELEASED ) BY THE INLINE SUBSCRIBER
+            queued.data.ftm_report.ftm_report_data = 0 ;
+        }
+
+        if (bus_push(&queued))
+        {
+            metrics_gauge(METRICS_BUS_QUEUE_LEVEL, __atomic_load_n(&bus_control.head, __ATOMIC_RELAXED) -
+                                                  __atomic_load_n(&bus_control.tail, __ATOMIC_RELAXED)) ;
+            xSemaphoreGive(bus_wake) ;
+        }
+        else
+        {
+            metrics_count(METRICS_BUS_DROPS, 1) ;
+        }
+    }
+}
+
+//
+// WiFi driver events ( driver event task ) : translated into typed events
+//
+static void bus_wifi_event_handler(void *arg, esp_event_base_t event_base,
+                                   int32_t event_id, void *event_data)
+{
+    bus_event_t event ;
+
+    event.time_us = esp_timer_get_time() ;
+
+    if (event_id == WIFI_EVENT_FTM_REPORT)
+    {
+        event.type = BUS_FTM_REPORT ;
+        event.data.ftm_report = *(wifi_event_ftm_report_t *) event_data ;
+    }
+    else if ( (event_id == WIFI_EVENT_AP_STACONNECTED) || (event_id == WIFI_EVENT_AP_STADISCONNECTED) )
+    {
+        if (event_id == WIFI_EVENT_AP_STACONNECTED)
+        {
+            wifi_event_ap_staconnected_t *sta = (wifi_event_ap_staconnected_t *) event_data ;
+            event.type = BUS_STA_CONNECTED ;
+            memcpy(event.data.station.mac, sta->mac, 6) ;
+            event.data.station.aid = sta->aid ;
+        }
+        else
+        {
+            wifi_event_ap_stadisconnected_t *sta = (wifi_event_ap_stadisconnected_t *) event_data ;
+            event.type = BUS_STA_DISCONNECTED ;
+            memcpy(event.data.station.mac, sta->mac, 6) ;
+            event.data.station.aid = sta->aid ;
+        }
+    }
+    else if (event_id == WIFI_EVENT_SCAN_DONE)
+    {
+        wifi_event_sta_scan_done_t *scan = (wifi_event_sta_scan_done_t *) event_data ;
+        event.type = BUS_SCAN_DONE ;
+        event.data.scan.status = scan->status ;
+        event.data.scan.number = scan->number ;
+    }
+    else
+    {
+        // NO SUBSCRIBER
+        return ;
+    }
+
+    bus_publish(&event) ;
+}
+
+//
+// Deliver the queued events to the worker subscribers
+//
+static void bus_worker_task(void *pvParameters)
+{
+    bus_event_t event ;
+
+    while (1)
+    {
+        xSemaphoreTake(bus_wake, BUS_WORKER_IDLE_WAIT_MS / portTICK_PERIOD_MS) ;
+
+        while (bus_pop(&event))
+        {
+            bus_dispatch(&event, BUS_WORKER) ;
+        }
+    }
+
+    vTaskDelete(NULL) ;
+}
+
+//
+// Event Bus Initialization ( before the modules subscribe and the driver starts )
+//
+void bus_init(void)
+{
+    TaskHandle_t task ;
+    unsigned int k ;
+
+    for (k=0; k<BUS_QUEUE_LENGTH; k++)
+    {
+        bus_control.ring[k].seq = k ;
+    }
+    bus_control.head = 0 ;
+    bus_control.tail = 0 ;
+
+    bus_wake = xSemaphoreCreateBinary() ;
+
+    if (xTaskCreate(bus_worker_task, "bus_worker", 4096, (void*) 0, 4, &task) == pdPASS)
+    {
+        metrics_register_task(task) ;
+        bus_control.running = 1 ;
+    }
+    else
+    {
+        ESP_LOGE(TAG, "worker task not created : worker subscribers disabled") ;
+    }
+
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID,
+                                                        &bus_wifi_event_handler, NULL, NULL)) ;
+}
@@ -0,0 +1,90 @@
+/*
+    bus.h - Internal Event Bus
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+#ifndef _BUS_H
+
+#define _BUS_H	1
+
+    #ifdef __cplusplus
+    extern "C" {
+    #endif
+
+        #include <stdint.h>
+        #include "esp_wifi.h"               // { wifi_event_ftm_report_t }
+
+        #define BUS_QUEUE_LENGTH            CONFIG_ESP_BUS_QUEUE_LENGTH     // events waiting for the worker ( power of two )
+        #define BUS_MAX_SUBSCRIBERS         8
+
+        // EVENT TYPES
+        #define BUS_FTM_REPORT              0       // FTM session completed ( report or failure )
+        #define BUS_STA_CONNECTED           1       // station joined the SoftAP
+        #define BUS_STA_DISCONNECTED        2       // station left the SoftAP
+        #define BUS_SCAN_DONE               3       // WiFi scan completed
+        #define BUS_NUM_TYPES               4
+
+        #define BUS_MASK(type)              (1U << (type))
+
+        // DELIVERY
+        #define BUS_INLINE                  0       // called by the publisher ( the driver event task ) : short and non-blocking
+        #define BUS_WORKER                  1       // called by the bus worker task , in publication order
+
+        //
+        // Typed event ( copied into the worker queue )
+        //
+        // ftm_report.ftm_report_data belongs to the inline subscriber that consumes the report
+        // ( the FTM module ) : worker subscribers get the summary with ftm_report_data = 0.
+        //
+        typedef struct {
+            uint8_t  type ;
+            int64_t  time_us ;                      // publication time
+            union {
+                wifi_event_ftm_report_t ftm_report ;
+                struct {
+                    uint8_t mac[6] ;
+                    uint8_t aid ;
+                } station ;
+                struct {
+                    uint32_t status ;               // 0 : success
+                    uint8_t  number ;               // APs found
+                } scan ;
+            } data ;
+        } bus_event_t ;
+
+        typedef void (*bus_handler_t)(const bus_event_t *event, void *arg) ;
+
+        extern void bus_init(void) ;
+        extern unsigned int bus_subscribe(uint32_t mask, unsigned int delivery, bus_handler_t handler, void *arg) ;
+        extern void bus_publish(const bus_event_t *event) ;
+
+    #ifdef __cplusplus
+    }
+    #endif
+
+#endif
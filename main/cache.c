@@ -0,0 +1,201 @@
+/*
+    cache.c - Recent FTM Result Cache
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+//
+// Per-responder cache of the latest FTM session results.
+//
+// A request carrying "max_age_ms" is served from the cache when a result for the
+// same BSSID and session parameters is younger than max_age_ms. Otherwise the
+// caller runs the session and publishes its result with cache_complete().
+//
+// Commands are served one at a time ( a single tcp_input task , one client
+// connection ), so two lookups never overlap and requests are not coalesced :
+// an entry still in flight is bypassed ( the session runs uncached ), never
+// waited for.
+//
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "ftm.h"
+#include "cache.h"
+
+typedef struct {
+    cache_key_t    key ;
+    unsigned int   used ;                   // entry holds a key
+    unsigned int   valid ;                  // result is a successful report
+    unsigned int   in_flight ;              // owner is running the session
+    uint32_t       last_ms ;                // last use ( recycling order )
+    cache_result_t result ;
+} cache_entry_t ;
+
+static cache_entry_t cache_entry[CACHE_ENTRIES] ;
+static SemaphoreHandle_t cache_mutex ;
+
+// FUNCTION PROTOTYPES
+void cache_init(void) ;
+unsigned int cache_acquire(const cache_key_t *key, unsigned int max_age_ms,
+                           cache_result_t *result, int *slot) ;
+void cache_complete(int slot, const cache_result_t *result) ;
+static int cache_find(const cache_key_t *key) ;
+static int cache_recycle(void) ;
+
+//
+// Entry holding a key ( -1 if none , caller holds the mutex )
+//
+static int cache_find(const cache_key_t *key)
+{
+    unsigned int k ;
+
+    for (k=0; k<CACHE_ENTRIES; k++)
+    {
+        if (cache_entry[k].used && !memcmp(&cache_entry[k].key, key, sizeof(cache_key_t)))
+            return k ;
+    }
+    return -1 ;
+}
+
+//
+// Free entry, or the least recently used idle one ( -1 if none , caller holds the mutex )
+//
+static int cache_recycle(void)
+{
+    int k, lru = -1 ;
+
+    for (k=0; k<CACHE_ENTRIES; k++)
+    {
+        cache_entry_t *e = &cache_entry[k] ;
+
+        if (!e->used)
+            return k ;
+
+        if ( !e->in_flight &&
+             ((lru < 0) || ((int32_t) (e->last_ms - cache_entry[lru].last_ms) < 0)) )
+        {
+            lru = k ;
+        }
+    }
+    return lru ;
+}
+
+//
+// Look up a result ( max_age_ms == 0 : never served from the cache , only refreshed )
+//
+// CACHE_HIT    : <result> holds the result
+// CACHE_MISS   : <slot> is owned by the caller until cache_complete()
+// CACHE_BYPASS : the entry of <key> is in flight , or every entry is
+//
+
+unsigned int cache_acquire(const cache_key_t *key, unsigned int max_age_ms,
+                           cache_result_t *result, int *slot)
+{
+    uint32_t now_ms = (uint32_t) (esp_timer_get_time() / 1000) ;
+    cache_entry_t *e ;
+    int k ;
+
+    *slot = -1 ;
+
+    xSemaphoreTake(cache_mutex, portMAX_DELAY) ;
+
+    k = cache_find(key) ;
+
+    if (k >= 0)
+    {
+        e = &cache_entry[k] ;
+        e->last_ms = now_ms ;
+
+        // FRESH RESULT
+        if ( max_age_ms && e->valid && !e->in_flight && ((now_ms - e->result.time_ms) <= max_age_ms) )
+        {
+            *result = e->result ;
+            xSemaphoreGive(cache_mutex) ;
+            return CACHE_HIT ;
+        }
+
+        if (e->in_flight)
+        {
+            xSemaphoreGive(cache_mutex) ;
+            return CACHE_BYPASS ;
+        }
+    }
+    else if ( (k = cache_recycle()) >= 0 )
+    {
+        e = &cache_entry[k] ;
+        e->key = *key ;
+        e->used = 1 ;
+        e->valid = 0 ;
+        e->last_ms = now_ms ;
+    }
+    else
+    {
+        xSemaphoreGive(cache_mutex) ;
+        return CACHE_BYPASS ;
+    }
+
+    // NEW SESSION OWNED BY THE CALLER
+    cache_entry[k].in_flight = 1 ;
+    *slot = k ;
+
+    xSemaphoreGive(cache_mutex) ;
+
+    return CACHE_MISS ;
+}
+
+//
+// Publish the result of an owned session
+//
+void cache_complete(int slot, const cache_result_t *result)
+{
+    cache_entry_t *e ;
+
+    if ( (slot < 0) || (slot >= CACHE_ENTRIES) )
+        return ;
+
+    e = &cache_entry[slot] ;
+
+    xSemaphoreTake(cache_mutex, portMAX_DELAY) ;
+
+    e->result = *result ;
+    e->result.time_ms = (uint32_t) (esp_timer_get_time() / 1000) ;
+    e->valid = (result->outcome == FTM_SESSION_REPORT) ;
+    e->in_flight = 0 ;
+
+    xSemaphoreGive(cache_mutex) ;
+}
+
+//
+// Cache Initialization
+//
+void cache_init(void)
+{
+    memset(cache_entry, 0, sizeof(cache_entry)) ;
+    cache_mutex = xSemaphoreCreateMutex() ;
+}
@@ -0,0 +1,86 @@
+/*
+    cache.h - Recent FTM Result Cache
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+#ifndef _CACHE_H
+
+#define _CACHE_H	1
+
+    #ifdef __cplusplus
+    extern "C" {
+    #endif
+
+        #include <stdint.h>
+        #include "rtt.h"                    // { rtt_estimate_t }
+
+        #define CACHE_ENTRIES               CONFIG_ESP_FTM_CACHE_ENTRIES
+
+        // LOOKUP RESULT
+        #define CACHE_MISS                  0       // caller owns the session and must call cache_complete()
+        #define CACHE_HIT                   1       // fresh result copied
+        #define CACHE_BYPASS                2       // identical session in flight : run the session uncached
+
+        //
+        // Session parameters identifying a cached result
+        //
+        typedef struct {
+            unsigned char mac[6] ;
+            unsigned int  channel ;
+            unsigned int  count ;
+            unsigned int  burst_period ;
+            unsigned int  precision_cm ;
+        } cache_key_t ;
+
+        //
+        // Cached session result ( report entries are not kept )
+        //
+        typedef struct {
+            uint32_t      time_ms ;                         // completion time ( milli-seconds since boot )
+            unsigned int  outcome ;
+            unsigned int  attempts ;
+            unsigned int  status ;
+            uint32_t      rtt_raw ;
+            uint32_t      rtt_est ;
+            uint32_t      dist_est ;
+            unsigned int  count ;                           // frame count actually used ( adaptive sessions )
+            unsigned int  burst_period ;
+            rtt_estimate_t estimate ;
+        } cache_result_t ;
+
+        extern void cache_init(void) ;
+        extern unsigned int cache_acquire(const cache_key_t *key, unsigned int max_age_ms,
+                                          cache_result_t *result, int *slot) ;
+        extern void cache_complete(int slot, const cache_result_t *result) ;
+
+    #ifdef __cplusplus
+    }
+    #endif
+
+#endif
+
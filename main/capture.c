@@ -0,0 +1,788 @@
+/*
+    capture.c - Raw Driver Event Capture and Replay
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+//
+// Records the raw FTM driver events ( wifi_event_ftm_report_t with all its report
+// entries ) and the scan records, as they come from the driver, to the "capture"
+// data partition. A capture survives a power cycle, is dumped over TCP in the same
+// binary form, and can be replayed through ftm_event_handler() and the whole
+// processing and output pipeline, back to back or with its recorded timing.
+//
+// Layout ( partition and dump ) :
+//
+//   preamble : "CHRC" , version (u16) , record header size (u16) , entry size (u16) ,
+//              AP record size (u16) , reserved (u32)
+//   records  : header ( magic (u16) , type (u8) , reserved (u8) , length (u16) ,
+//              count (u16) , uSec since the previous record (u32) ) , payload
+//
+//   FTM report payload : peer mac (6) , status (u8) , reserved (u8) , rtt_raw (u32) ,
+//                        rtt_est (u32) , dist_est (u32) , <count> entries ( dlog_token (u8) ,
+//                        rssi (i8) , rtt (u32) , t1 , t2 , t3 , t4 (u64) )
+//   Scan payload       : <count> AP records ( bssid (6) , ssid (33) , primary (u8) ,
+//                        rssi (i8) , flags (u8) : bit 0 FTM responder )
+//
+// The partition is written sequentially from its start ( sectors are erased right
+// before they are entered ). The event handlers only pack their records into a RAM
+// staging ring ( they run on the Wi-Fi driver event task , which must not wait for
+// flash ) ; the capture_flush task moves the staged records to the sector image and
+// programs them , erasing the next sector when one fills up. A record that doesn't
+// fit in the staging ring is dropped.
+// The capture ends at the first erased record header ; a dump ends with a header of
+// type CAPTURE_RECORD_END.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "tool.h"
+#include "pool.h"
+#include "ftm.h"
+#include "metrics.h"
+#include "capture.h"
+
+#define CAPTURE_SECTOR_SIZE             4096
+#define CAPTURE_MMAP_WINDOW             0x10000                 // dump mapping window ( 64 KB MMU page )
+#define CAPTURE_LINE_BUFFER_LENGTH      256
+
+#define CAPTURE_MAGIC                   "CHRC"
+#define CAPTURE_VERSION                 1
+#define CAPTURE_RECORD_MAGIC            0xC3A5
+
+#define CAPTURE_PREAMBLE_SIZE           16
+#define CAPTURE_HEADER_SIZE             12
+#define CAPTURE_FTM_FIXED_SIZE          20                      // FTM report payload without entries
+#define CAPTURE_ENTRY_SIZE              38
+#define CAPTURE_AP_SIZE                 42
+#define CAPTURE_MAX_ENTRIES             64
+#define CAPTURE_MAX_AP_RECORDS          64
+
+#define CAPTURE_STAGE_SIZE              8192                    // staging ring ( power of two , ~3 full reports )
+#define CAPTURE_FLUSH_IDLE_WAIT_MS      1000                    // capture_flush task wake up without records
+
+_Static_assert((CAPTURE_STAGE_SIZE & (CAPTURE_STAGE_SIZE - 1)) == 0, "CAPTURE_STAGE_SIZE must be a power of two") ;
+
+typedef struct {
+    uint16_t magic ;
+    uint8_t  type ;                 // CAPTURE_RECORD_xxx
+    uint8_t  reserved ;
+    uint16_t length ;               // payload length
+    uint16_t count ;                // report entries or AP records in the payload
+    uint32_t delta_us ;             // time since the previous record
+} capture_header_t ;
+
+static const char *TAG = "capture" ;
+
+static struct {
+    const esp_partition_t *partition ;      // 0 : capture disabled
+    unsigned int  reserved ;                // bytes used , staged records included ( capture_stage_mutex )
+    unsigned int  offset ;                  // bytes in the sector image ( write position )
+    unsigned int  flushed ;                 // bytes already programmed
+    volatile unsigned int capturing ;
+    volatile unsigned int replaying ;
+    int64_t       last_us ;                 // time of the previous record
+    uint32_t      records ;                 // records in the capture
+    uint32_t      ftm_reports ;
+    uint32_t      scans ;
+    uint32_t      dropped ;                 // records lost ( partition or staging ring full )
+    uint32_t      errors ;                  // failed flash operations
+    unsigned int  stage_head ;              // staging ring ( free running , capture_stage_mutex )
+    unsigned int  stage_tail ;
+    unsigned char stage[CAPTURE_STAGE_SIZE] ;   // records packed by the event handlers
+    unsigned char image[CAPTURE_SECTOR_SIZE] ;  // RAM image of the current sector
+} capture_control ;
+
+static SemaphoreHandle_t capture_mutex ;            // flash side ( sector image , program , erase )
+static SemaphoreHandle_t capture_stage_mutex ;      // staging ring and record counters ( never held across flash operations )
+static SemaphoreHandle_t capture_wake ;
+
+// FUNCTION PROTOTYPES
+void capture_init(void) ;
+void capture_ftm_report(const wifi_event_ftm_report_t *event) ;
+void capture_scan(const wifi_ap_record_t *records, unsigned int count) ;
+unsigned int capture_start(void) ;
+void capture_stop(void) ;
+void capture_info(void (*callback)(unsigned char *buffer, unsigned int len)) ;
+unsigned int capture_dump(void (*stream)(unsigned char *buffer, unsigned int len)) ;
+unsigned int capture_replay(unsigned int speed, const ftm_options_t *options, tool_timing_t *timing,
+                            void (*callback)(unsigned char *buffer, unsigned int len), void (*flush)(void)) ;
+static unsigned int capture_program(void) ;
+static void capture_enter_sector(unsigned int sector) ;
+static void capture_put(const void *data, unsigned int len) ;
+static unsigned int capture_begin_record(unsigned int type, unsigned int length, unsigned int count) ;
+static void capture_drain(void) ;
+static void capture_flush_task(void *pvParameters) ;
+static unsigned int capture_read_header(unsigned int offset, capture_header_t *header) ;
+static void capture_replay_ftm_report(const capture_header_t *header, const unsigned char *payload,
+                                      const ftm_options_t *options, tool_timing_t *timing,
+                                      void (*callback)(unsigned char *buffer, unsigned int len)) ;
+static void capture_replay_scan(const capture_header_t *header, const unsigned char *payload,
+                                void (*callback)(unsigned char *buffer, unsigned int len)) ;
+
+//
+// Program the staged bytes of the current sector ( caller holds the mutex )
+//
+static unsigned int capture_program(void)
+{
+    esp_err_t err ;
+
+    if (capture_control.flushed >= capture_control.offset)
+        return 1 ;
+
+    err = esp_partition_write(capture_control.partition, capture_control.flushed,
+                              capture_control.image + (capture_control.flushed % CAPTURE_SECTOR_SIZE),
+                              capture_control.offset - capture_control.flushed) ;
+    if (err != ESP_OK)
+    {
+        capture_control.errors++ ;
+        ESP_LOGE(TAG, "write failed at 0x%x (%s)", capture_control.flushed, esp_err_to_name(err)) ;
+        return 0 ;
+    }
+
+    capture_control.flushed = capture_control.offset ;
+
+    return 1 ;
+}
+
+//
+// Erase a sector and start its RAM image ( caller holds the mutex )
+//
+static void capture_enter_sector(unsigned int sector)
+{
+    esp_err_t err ;
+
+    err = esp_partition_erase_range(capture_control.partition, sector * CAPTURE_SECTOR_SIZE, CAPTURE_SECTOR_SIZE) ;
+    if (err != ESP_OK)
+    {
+        capture_control.errors++ ;
+        ESP_LOGE(TAG, "erase failed on sector %u (%s)", sector, esp_err_to_name(err)) ;
+    }
+
+    memset(capture_control.image, 0xFF, CAPTURE_SECTOR_SIZE) ;
+}
+
+//
+// Append bytes to the staging ring ( caller holds the stage mutex and checked the room left )
+//
+static void capture_put(const void *data, unsigned int len)
+{
+    const unsigned char *p = (const unsigned char *) data ;
+    unsigned int pos, n ;
+
+    while (len)
+    {
+        pos = capture_control.stage_head & (CAPTURE_STAGE_SIZE - 1) ;
+        n = MIN(len, CAPTURE_STAGE_SIZE - pos) ;
+
+        memcpy(capture_control.stage + pos, p, n) ;
+        capture_control.stage_head += n ;
+        p += n ;
+        len -= n ;
+    }
+}
+
+//
+// Start a record ( caller holds the stage mutex )
+//
+// returns 0 if the partition cannot hold the record ( the capture is stopped ) or if
+// the staging ring is full ( the record is dropped )
+//
+static unsigned int capture_begin_record(unsigned int type, unsigned int length, unsigned int count)
+{
+    int64_t now_us = esp_timer_get_time() ;
+    capture_header_t header = {
+        .magic = CAPTURE_RECORD_MAGIC,
+        .type = (uint8_t) type,
+        .reserved = 0xFF,
+        .length = (uint16_t) length,
+        .count = (uint16_t) count,
+        .delta_us = (uint32_t) (now_us - capture_control.last_us),
+    } ;
+
+    if (capture_control.reserved + CAPTURE_HEADER_SIZE + length > capture_control.partition->size)
+    {
+        capture_control.dropped++ ;
+        capture_control.capturing = 0 ;
+        ESP_LOGW(TAG, "capture full (%u records)", capture_control.records) ;
+        return 0 ;
+    }
+
+    if ( (capture_control.stage_head - capture_control.stage_tail) + CAPTURE_HEADER_SIZE + length > CAPTURE_STAGE_SIZE )
+    {
+        capture_control.dropped++ ;
+        return 0 ;
+    }
+
+    capture_control.last_us = now_us ;
+    capture_control.records++ ;
+    capture_control.reserved += CAPTURE_HEADER_SIZE + length ;
+    capture_put(&header, CAPTURE_HEADER_SIZE) ;
+
+    return 1 ;
+}
+
+//
+// Move the staged records to the sector image and program them ( caller holds the mutex )
+//
+// A full sector is programmed and the next one erased with the stage mutex released ,
+// so the event handlers keep staging records meanwhile.
+//
+static void capture_drain(void)
+{
+    unsigned int pos, n ;
+
+    while (1)
+    {
+        xSemaphoreTake(capture_stage_mutex, portMAX_DELAY) ;
+
+        pos = capture_control.offset % CAPTURE_SECTOR_SIZE ;
+        n = MIN(capture_control.stage_head - capture_control.stage_tail, CAPTURE_SECTOR_SIZE - pos) ;
+        n = MIN(n, CAPTURE_STAGE_SIZE - (capture_control.stage_tail & (CAPTURE_STAGE_SIZE - 1))) ;
+
+        memcpy(capture_control.image + pos, capture_control.stage + (capture_control.stage_tail & (CAPTURE_STAGE_SIZE - 1)), n) ;
+        capture_control.stage_tail += n ;
+        capture_control.offset += n ;
+
+        xSemaphoreGive(capture_stage_mutex) ;
+
+        if (!n)
+            break ;
+
+        // SECTOR COMPLETE : PROGRAM IT AND MOVE TO THE NEXT ONE
+        if ( !(capture_control.offset % CAPTURE_SECTOR_SIZE) )
+        {
+            capture_program() ;
+            if (capture_control.offset < capture_control.partition->size)
+            {
+                capture_enter_sector(capture_control.offset / CAPTURE_SECTOR_SIZE) ;
+            }
+        }
+    }
+
+    capture_program() ;
+}
+
+//
+// Program the records staged by the event handlers
+//
+static void capture_flush_task(void *pvParameters)
+{
+    while (1)
+    {
+        xSemaphoreTake(capture_wake, CAPTURE_FLUSH_IDLE_WAIT_MS / portTICK_PERIOD_MS) ;
+
+        xSemaphoreTake(capture_mutex, portMAX_DELAY) ;
+        capture_drain() ;
+        xSemaphoreGive(capture_mutex) ;
+    }
+
+    vTaskDelete(NULL) ;
+}
+
+//
+// Record a FTM report event ( called by ftm_event_handler() , before the report is consumed )
+//
+// Runs on the Wi-Fi driver event task : the record is only staged in RAM.
+//
+void capture_ftm_report(const wifi_event_ftm_report_t *event)
+{
+    unsigned char fixed[CAPTURE_FTM_FIXED_SIZE] ;
+    unsigned char packed[CAPTURE_ENTRY_SIZE] ;
+    const wifi_ftm_report_entry_t *e ;
+    unsigned int k, count ;
+
+    if (!capture_control.capturing || capture_control.replaying || !event)
+        return ;
+
+    count = (event->status == FTM_STATUS_SUCCESS) && event->ftm_report_data ? event->ftm_report_num_entries : 0 ;
+
+    memcpy(fixed, event->peer_mac, 6) ;
+    fixed[6] = (uint8_t) event->status ;
+    fixed[7] = 0xFF ;
+    memcpy(fixed + 8, &event->rtt_raw, 4) ;
+    memcpy(fixed + 12, &event->rtt_est, 4) ;
+    memcpy(fixed + 16, &event->dist_est, 4) ;
+
+    xSemaphoreTake(capture_stage_mutex, portMAX_DELAY) ;
+
+    if (capture_control.capturing &&
+        capture_begin_record(CAPTURE_RECORD_FTM_REPORT, CAPTURE_FTM_FIXED_SIZE + count * CAPTURE_ENTRY_SIZE, count))
+    {
+        capture_put(fixed, CAPTURE_FTM_FIXED_SIZE) ;
+
+        for (k=0; k<count; k++)
+        {
+            e = &event->ftm_report_data[k] ;
+            packed[0] = e->dlog_token ;
+            packed[1] = (uint8_t) e->rssi ;
+            memcpy(packed + 2, &e->rtt, 4) ;
+            memcpy(packed + 6, &e->t1, 8) ;
+            memcpy(packed + 14, &e->t2, 8) ;
+            memcpy(packed + 22, &e->t3, 8) ;
+            memcpy(packed + 30, &e->t4, 8) ;
+            capture_put(packed, CAPTURE_ENTRY_SIZE) ;
+        }
+
+        capture_control.ftm_reports++ ;
+    }
+
+    xSemaphoreGive(capture_stage_mutex) ;
+    xSemaphoreGive(capture_wake) ;
+}
+
+//
+// Record the AP list of a scan ( staged in RAM , as the FTM reports )
+//
+void capture_scan(const wifi_ap_record_t *records, unsigned int count)
+{
+    unsigned char packed[CAPTURE_AP_SIZE] ;
+    unsigned int k ;
+
+    if (!capture_control.capturing || capture_control.replaying || !records)
+        return ;
+
+    count = MIN(count, CAPTURE_MAX_AP_RECORDS) ;
+
+    xSemaphoreTake(capture_stage_mutex, portMAX_DELAY) ;
+
+    if (capture_control.capturing &&
+        capture_begin_record(CAPTURE_RECORD_SCAN, count * CAPTURE_AP_SIZE, count))
+    {
+        for (k=0; k<count; k++)
+        {
+            memcpy(packed, records[k].bssid, 6) ;
+            memcpy(packed + 6, records[k].ssid, 33) ;
+            packed[39] = records[k].primary ;
+            packed[40] = (uint8_t) records[k].rssi ;
+            packed[41] = records[k].ftm_responder ? 0x01 : 0x00 ;
+            capture_put(packed, CAPTURE_AP_SIZE) ;
+        }
+
+        capture_control.scans++ ;
+    }
+
+    xSemaphoreGive(capture_stage_mutex) ;
+    xSemaphoreGive(capture_wake) ;
+}
+
+//
+// Start a new capture ( the previous one is discarded )
+//
+unsigned int capture_start(void)
+{
+    unsigned char preamble[CAPTURE_PREAMBLE_SIZE] ;
+    uint16_t version = CAPTURE_VERSION ;
+    uint16_t header_size = CAPTURE_HEADER_SIZE ;
+    uint16_t entry_size = CAPTURE_ENTRY_SIZE ;
+    uint16_t ap_size = CAPTURE_AP_SIZE ;
+
+    if (!capture_control.partition || capture_control.replaying)
+        return 0 ;
+
+    memcpy(preamble, CAPTURE_MAGIC, 4) ;
+    memcpy(preamble + 4, &version, 2) ;
+    memcpy(preamble + 6, &header_size, 2) ;
+    memcpy(preamble + 8, &entry_size, 2) ;
+    memcpy(preamble + 10, &ap_size, 2) ;
+    memset(preamble + 12, 0xFF, 4) ;
+
+    xSemaphoreTake(capture_mutex, portMAX_DELAY) ;
+    xSemaphoreTake(capture_stage_mutex, portMAX_DELAY) ;
+
+    capture_control.capturing = 0 ;
+    capture_control.stage_head = capture_control.stage_tail = 0 ;
+    capture_control.records = capture_control.ftm_reports = capture_control.scans = 0 ;
+    capture_control.dropped = 0 ;
+
+    xSemaphoreGive(capture_stage_mutex) ;
+
+    capture_control.offset = capture_control.flushed = 0 ;
+    capture_enter_sector(0) ;
+    memcpy(capture_control.image, preamble, CAPTURE_PREAMBLE_SIZE) ;
+    capture_control.offset = capture_control.reserved = CAPTURE_PREAMBLE_SIZE ;
+    capture_program() ;
+
+    capture_control.last_us = esp_timer_get_time() ;
+    capture_control.capturing = 1 ;
+
+    xSemaphoreGive(capture_mutex) ;
+
+    ESP_LOGI(TAG, "capture started") ;
+
+    return 1 ;
+}
+
+//
+// Stop capturing ( the capture is kept )
+//
+void capture_stop(void)
+{
+    if (!capture_control.partition)
+        return ;
+
+    xSemaphoreTake(capture_mutex, portMAX_DELAY) ;
+    capture_control.capturing = 0 ;
+    capture_drain() ;
+    xSemaphoreGive(capture_mutex) ;
+}
+
+//
+// Report the capture state
+//
+void capture_info(void (*callback)(unsigned char *buffer, unsigned int len))
+{
+    char line[CAPTURE_LINE_BUFFER_LENGTH] ;
+
+    if (!capture_control.partition)
+    {
+        sprintf(line, "Capture - disabled") ;
+        tool_log(TAG, line, 0, callback) ;
+        return ;
+    }
+
+    xSemaphoreTake(capture_stage_mutex, portMAX_DELAY) ;
+
+    sprintf(line, "Capture - Partition %s @ 0x%x , %u bytes",
+                  capture_control.partition->label, capture_control.partition->address,
+                  capture_control.partition->size) ;
+    tool_log(TAG, line, 0, callback) ;
+
+    sprintf(line, "Capture - %s , Records %u (FTM %u , Scan %u) , Used %u bytes (%u%%) , Dropped %u , Errors %u",
+                  capture_control.capturing ? "Capturing" : "Stopped",
+                  capture_control.records, capture_control.ftm_reports, capture_control.scans,
+                  capture_control.reserved, (unsigned int) ((capture_control.reserved * 100ULL) / capture_control.partition->size),
+                  capture_control.dropped, capture_control.errors) ;
+    tool_log(TAG, line, 0, callback) ;
+
+    xSemaphoreGive(capture_stage_mutex) ;
+}
+
+//
+// Dump the capture ( preamble , records , end record )
+//
+// The partition is read through 64 KB memory mapped windows and handed to <stream>
+// directly from flash.
+//
+// returns the number of records dumped
+//
+unsigned int capture_dump(void (*stream)(unsigned char *buffer, unsigned int len))
+{
+    capture_header_t end = {
+        .magic = CAPTURE_RECORD_MAGIC,
+        .type = CAPTURE_RECORD_END,
+        .reserved = 0xFF,
+    } ;
+    spi_flash_mmap_handle_t handle ;
+    const void *window ;
+    unsigned int address, len, records ;
+    esp_err_t err ;
+
+    if (!capture_control.partition || !stream)
+        return 0 ;
+
+    xSemaphoreTake(capture_mutex, portMAX_DELAY) ;
+
+    // FLASH MUST HOLD EVERY RECORD
+    capture_drain() ;
+
+    for (address=0; address<capture_control.offset; address+=len)
+    {
+        len = MIN(CAPTURE_MMAP_WINDOW, capture_control.offset - address) ;
+
+        err = esp_partition_mmap(capture_control.partition, address, len, SPI_FLASH_MMAP_DATA, &window, &handle) ;
+        if (err != ESP_OK)
+        {
+            ESP_LOGE(TAG, "mmap failed at 0x%x (%s)", address, esp_err_to_name(err)) ;
+            break ;
+        }
+        stream((unsigned char *) window, len) ;
+        spi_flash_munmap(handle) ;
+    }
+
+    stream((unsigned char *) &end, CAPTURE_HEADER_SIZE) ;
+
+    records = capture_control.records ;
+
+    xSemaphoreGive(capture_mutex) ;
+
+    ESP_LOGI(TAG, "capture dump : %u records", records) ;
+
+    return records ;
+}
+
+//
+// Read a record header ( 0 : end of the capture )
+//
+static unsigned int capture_read_header(unsigned int offset, capture_header_t *header)
+{
+    if (offset + CAPTURE_HEADER_SIZE > capture_control.partition->size)
+        return 0 ;
+
+    if (esp_partition_read(capture_control.partition, offset, header, CAPTURE_HEADER_SIZE) != ESP_OK)
+        return 0 ;
+
+    if ( (header->magic != CAPTURE_RECORD_MAGIC) || (header->type == CAPTURE_RECORD_END) ||
+         (offset + CAPTURE_HEADER_SIZE + header->length > capture_control.partition->size) )
+        return 0 ;
+
+    if (header->type == CAPTURE_RECORD_FTM_REPORT)
+        return (header->count <= CAPTURE_MAX_ENTRIES) &&
+               (header->length == CAPTURE_FTM_FIXED_SIZE + header->count * CAPTURE_ENTRY_SIZE) ;
+
+    if (header->type == CAPTURE_RECORD_SCAN)
+        return (header->count <= CAPTURE_MAX_AP_RECORDS) && (header->length == header->count * CAPTURE_AP_SIZE) ;
+
+    return 0 ;
+}
+
+//
+// Replay a FTM report record ( the event goes through ftm_event_handler() as a driver event )
+//
+static void capture_replay_ftm_report(const capture_header_t *header, const unsigned char *payload,
+                                      const ftm_options_t *options, tool_timing_t *timing,
+                                      void (*callback)(unsigned char *buffer, unsigned int len))
+{
+    wifi_event_ftm_report_t event ;
+    const unsigned char *p ;
+    unsigned int k ;
+
+    memset(&event, 0, sizeof(event)) ;
+    memcpy(event.peer_mac, payload, 6) ;
+    event.status = (wifi_ftm_status_t) payload[6] ;
+    memcpy(&event.rtt_raw, payload + 8, 4) ;
+    memcpy(&event.rtt_est, payload + 12, 4) ;
+    memcpy(&event.dist_est, payload + 16, 4) ;
+
+    // REPORT ENTRIES IN A DRIVER STYLE BUFFER ( RELEASED BY THE EVENT HANDLER )
+    if (header->count)
+    {
+        if ( !(event.ftm_report_data = malloc(header->count * sizeof(wifi_ftm_report_entry_t))) )
+        {
+            ESP_LOGE(TAG, "Failed to alloc %u report entries", header->count) ;
+            return ;
+        }
+        event.ftm_report_num_entries = (uint8_t) header->count ;
+
+        for (k=0, p=payload+CAPTURE_FTM_FIXED_SIZE; k<header->count; k++, p+=CAPTURE_ENTRY_SIZE)
+        {
+            wifi_ftm_report_entry_t *e = &event.ftm_report_data[k] ;
+
+            e->dlog_token = p[0] ;
+            e->rssi = (int8_t) p[1] ;
+            memcpy(&e->rtt, p + 2, 4) ;
+            memcpy(&e->t1, p + 6, 8) ;
+            memcpy(&e->t2, p + 14, 8) ;
+            memcpy(&e->t3, p + 22, 8) ;
+            memcpy(&e->t4, p + 30, 8) ;
+        }
+    }
+
+    ftm_replay_report(&event, options, timing, callback) ;
+}
+
+//
+// Replay a scan record ( formatted as a scan report )
+//
+static void capture_replay_scan(const capture_header_t *header, const unsigned char *payload,
+                                void (*callback)(unsigned char *buffer, unsigned int len))
+{
+    wifi_ap_record_t *records ;
+    const unsigned char *p ;
+    unsigned int k ;
+
+    if ( !(records = pool_alloc_or_heap(MAX(1, header->count) * sizeof(wifi_ap_record_t))) )
+        return ;
+
+    memset(records, 0, MAX(1, header->count) * sizeof(wifi_ap_record_t)) ;
+
+    for (k=0, p=payload; k<header->count; k++, p+=CAPTURE_AP_SIZE)
+    {
+        memcpy(records[k].bssid, p, 6) ;
+        memcpy(records[k].ssid, p + 6, 33) ;
+        records[k].ssid[32] = 0 ;
+        records[k].primary = p[39] ;
+        records[k].rssi = (int8_t) p[40] ;
+        records[k].ftm_responder = p[41] & 0x01 ;
+    }
+
+    tool_scan_report(records, header->count, callback) ;
+
+    pool_free(records) ;
+}
+
+//
+// Replay the capture ( capturing stops first )
+//
+// speed : CAPTURE_SPEED_MAX ( back to back ) or CAPTURE_SPEED_REALTIME ( recorded spacing )
+//
+// FTM reports follow the session path ( event handler , estimator , history , output )
+// with <options> ; the replay ends with its throughput.
+//
+// flush ( optional ) sends the output of each record right away , so a long replay
+// never has to fit in the outgoing FIFO
+//
+// returns the number of records replayed
+//
+unsigned int capture_replay(unsigned int speed, const ftm_options_t *options, tool_timing_t *timing,
+                            void (*callback)(unsigned char *buffer, unsigned int len), void (*flush)(void))
+{
+    char line[CAPTURE_LINE_BUFFER_LENGTH] ;
+    capture_header_t header ;
+    unsigned char *payload ;
+    unsigned int offset, end ;
+    uint32_t records = 0, ftm_reports = 0, scans = 0, entries = 0 ;
+    int64_t start_us, due_us = 0, elapsed_us ;
+
+    if (!capture_control.partition)
+    {
+        capture_info(callback) ;
+        return 0 ;
+    }
+
+    xSemaphoreTake(capture_mutex, portMAX_DELAY) ;
+    capture_control.capturing = 0 ;
+    capture_drain() ;
+    capture_control.replaying = 1 ;
+    end = capture_control.offset ;
+    xSemaphoreGive(capture_mutex) ;
+
+    start_us = esp_timer_get_time() ;
+
+    for (offset=CAPTURE_PREAMBLE_SIZE; (offset<end) && capture_read_header(offset, &header); offset+=CAPTURE_HEADER_SIZE+header.length)
+    {
+        if ( !(payload = pool_alloc_or_heap(MAX(1, header.length))) )
+        {
+            ESP_LOGE(TAG, "Failed to alloc a %u byte record", header.length) ;
+            break ;
+        }
+
+        if (esp_partition_read(capture_control.partition, offset + CAPTURE_HEADER_SIZE, payload, header.length) != ESP_OK)
+        {
+            pool_free(payload) ;
+            break ;
+        }
+
+        // 1x : WAIT FOR THE RECORDED TIME OF THE RECORD
+        if (speed == CAPTURE_SPEED_REALTIME)
+        {
+            due_us += header.delta_us ;
+            elapsed_us = esp_timer_get_time() - start_us ;
+            if (due_us > elapsed_us)
+            {
+                vTaskDelay(((due_us - elapsed_us) / 1000) / portTICK_PERIOD_MS) ;
+            }
+        }
+
+        if (header.type == CAPTURE_RECORD_FTM_REPORT)
+        {
+            capture_replay_ftm_report(&header, payload, options, timing, callback) ;
+            ftm_reports++ ;
+            entries += header.count ;
+        }
+        else
+        {
+            capture_replay_scan(&header, payload, callback) ;
+            scans++ ;
+        }
+
+        records++ ;
+        pool_free(payload) ;
+
+        if (flush) flush() ;
+    }
+
+    elapsed_us = esp_timer_get_time() - start_us ;
+    capture_control.replaying = 0 ;
+
+    sprintf(line, "Capture Replay - %u Records (FTM %u , Scan %u) , %u Entries , %u mSec (%s) , %.1f Reports/s , %.0f Entries/s",
+                  records, ftm_reports, scans, entries, (unsigned int) (elapsed_us / 1000),
+                  (speed == CAPTURE_SPEED_REALTIME) ? "1x" : "max",
+                  elapsed_us ? ftm_reports * 1e6 / elapsed_us : 0.0,
+                  elapsed_us ? entries * 1e6 / elapsed_us : 0.0) ;
+    tool_log(TAG, line, 0, callback) ;
+
+    return records ;
+}
+
+//
+// Capture Initialization ( recovers the end of the capture left in the partition )
+//
+void capture_init(void)
+{
+    capture_header_t header ;
+    unsigned char preamble[CAPTURE_PREAMBLE_SIZE] ;
+
+    TaskHandle_t task ;
+
+    memset(&capture_control, 0, sizeof(capture_control)) ;
+    capture_mutex = xSemaphoreCreateMutex() ;
+    capture_stage_mutex = xSemaphoreCreateMutex() ;
+    capture_wake = xSemaphoreCreateBinary() ;
+
+    #if (CONFIG_ESP_CAPTURE_ENABLE)
+        capture_control.partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, CAPTURE_PARTITION_SUBTYPE, CAPTURE_PARTITION_LABEL) ;
+    #endif
+
+    if (!capture_control.partition)
+    {
+        ESP_LOGW(TAG, "capture disabled (no \"%s\" partition)", CAPTURE_PARTITION_LABEL) ;
+        return ;
+    }
+
+    if (xTaskCreate(capture_flush_task, "capture_flush", 3072, (void*) 0, 3, &task) == pdPASS) metrics_register_task(task) ;
+
+    if ( (esp_partition_read(capture_control.partition, 0, preamble, CAPTURE_PREAMBLE_SIZE) != ESP_OK) ||
+         memcmp(preamble, CAPTURE_MAGIC, 4) )
+    {
+        ESP_LOGI(TAG, "capture : empty") ;
+        return ;
+    }
+
+    // WALK THE RECORDS UP TO THE END OF THE CAPTURE
+    capture_control.offset = CAPTURE_PREAMBLE_SIZE ;
+
+    while (capture_read_header(capture_control.offset, &header))
+    {
+        capture_control.offset += CAPTURE_HEADER_SIZE + header.length ;
+        capture_control.records++ ;
+        if (header.type == CAPTURE_RECORD_FTM_REPORT) capture_control.ftm_reports++ ;
+        else capture_control.scans++ ;
+    }
+
+    capture_control.flushed = capture_control.reserved = capture_control.offset ;
+
+    ESP_LOGI(TAG, "capture : %u records , %u bytes", capture_control.records, capture_control.offset) ;
+}
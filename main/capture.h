@@ -0,0 +1,76 @@
+/*
+    capture.h - Raw Driver Event Capture and Replay
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+#ifndef _CAPTURE_H
+
+#define _CAPTURE_H	1
+
+    #ifdef __cplusplus
+    extern "C" {
+    #endif
+
+        #include "esp_wifi.h"               // { wifi_event_ftm_report_t , wifi_ap_record_t }
+        #include "ftm.h"                    // { ftm_options_t }
+        #include "tool.h"                   // { tool_timing_t }
+
+        #define CAPTURE_PARTITION_LABEL     "capture"
+        #define CAPTURE_PARTITION_SUBTYPE   0x41
+
+        #define CAPTURE_ACTION_INFO         0
+        #define CAPTURE_ACTION_START        1
+        #define CAPTURE_ACTION_STOP         2
+        #define CAPTURE_ACTION_DUMP         3
+        #define CAPTURE_ACTION_REPLAY       4
+
+        #define CAPTURE_SPEED_MAX           0       // replay records back to back
+        #define CAPTURE_SPEED_REALTIME      1       // replay records with their recorded spacing ( 1x )
+
+        // RECORD TYPES
+        #define CAPTURE_RECORD_END          0       // end of a dump
+        #define CAPTURE_RECORD_FTM_REPORT   1       // wifi_event_ftm_report_t and its report entries
+        #define CAPTURE_RECORD_SCAN         2       // wifi_ap_record_t list of a scan
+
+        extern void capture_init(void) ;
+        extern void capture_ftm_report(const wifi_event_ftm_report_t *event) ;
+        extern void capture_scan(const wifi_ap_record_t *records, unsigned int count) ;
+        extern unsigned int capture_start(void) ;
+        extern void capture_stop(void) ;
+        extern void capture_info(void (*callback)(unsigned char *buffer, unsigned int len)) ;
+        extern unsigned int capture_dump(void (*stream)(unsigned char *buffer, unsigned int len)) ;
+        extern unsigned int capture_replay(unsigned int speed, const ftm_options_t *options, tool_timing_t *timing,
+                                           void (*callback)(unsigned char *buffer, unsigned int len),
+                                           void (*flush)(void)) ;
+
+    #ifdef __cplusplus
+    }
+    #endif
+
+#endif
+
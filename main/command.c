@@ -33,10 +33,22 @@
 extern void json_test(void) ;
 
 #include <string.h>
+#include "esp_timer.h"
 #include "server.h"
 #include "tool.h"
 #include "ftm.h"
 #include "parser.h"
+#include "pool.h"
+#include "history.h"
+#include "journal.h"
+#include "metrics.h"
+#include "trace.h"
+#include "capture.h"
+#include "stream.h"
+#include "udp.h"
+#include "survey.h"
+#include "radio.h"
+#include "responder.h"
 
 #define COMMAND_BUFFER_LENGTH   4096
 
@@ -48,8 +60,48 @@ static struct {
 
 void command_processing(void) ;
 static void command_parsing(void) ;
+static void command_timing_report(tool_timing_t *timing, int64_t start_us) ;
+static unsigned int command_ftm(cJSON *root, int64_t start_us) ;
+static unsigned int command_ftm_all(cJSON *root, int64_t start_us) ;
+static unsigned int command_scan(cJSON *root, int64_t start_us) ;
+static unsigned int command_pool(cJSON *root, int64_t start_us) ;
+static unsigned int command_history(cJSON *root, int64_t start_us) ;
+static unsigned int command_journal(cJSON *root, int64_t start_us) ;
+static unsigned int command_stats(cJSON *root, int64_t start_us) ;
+static unsigned int command_trace(cJSON *root, int64_t start_us) ;
+static unsigned int command_log(cJSON *root, int64_t start_us) ;
+static unsigned int command_capture(cJSON *root, int64_t start_us) ;
+static unsigned int command_streams(cJSON *root, int64_t start_us) ;
+static unsigned int command_udp(cJSON *root, int64_t start_us) ;
+static unsigned int command_survey(cJSON *root, int64_t start_us) ;
+static unsigned int command_radio(cJSON *root, int64_t start_us) ;
+static unsigned int command_responder(cJSON *root, int64_t start_us) ;
 void command_init(void) ;
 
+// remote commands : "function" and its handler ( returns 0 for malformed parameters )
+static const struct {
+    const char    *function ;
+    unsigned int (*handler)(cJSON *root, int64_t start_us) ;
+} command_table[] = {
+    { "ftm",        command_ftm },              // FTM COMMAND (BY SSID OR BY MAC)
+    { "ftm_all",    command_ftm_all },          // FTM COMMAND (ALL RESPONDERS)
+    { "scan",       command_scan },             // SCAN COMMAND
+    { "pool",       command_pool },             // MEMORY POOL REPORT
+    { "history",    command_history },          // RANGING HISTORY
+    { "journal",    command_journal },          // MEASUREMENT JOURNAL
+    { "stats",      command_stats },            // RUNTIME METRICS
+    { "trace",      command_trace },            // HOT-PATH TRACE
+    { "log",        command_log },              // LOG LEVELS
+    { "capture",    command_capture },          // RAW EVENT CAPTURE
+    { "streams",    command_streams },          // PUBLISH/SUBSCRIBE STREAMS
+    { "udp",        command_udp },              // UDP DATAGRAM STREAMING
+    { "survey",     command_survey },           // ANCHOR SURVEY
+    { "radio",      command_radio },            // RADIO CONFIGURATION
+    { "responder",  command_responder },        // FTM RESPONDER
+} ;
+
+#define COMMAND_TABLE_SIZE      (sizeof(command_table) / sizeof(command_table[0]))
+
 //
 // Process incoming data frame ( commands )
 //
@@ -66,6 +118,7 @@ void command_processing(void)
                         break ;
 
             case ';'  : // semicolon denotes the completion of a command                  
+                        TRACE(TRACE_CMD_FRAMED, command_control.index) ;
                         // PARSE FULL COMMAND
                         command_parsing() ;
                         // RESET INDEX
@@ -81,44 +134,391 @@ void command_processing(void)
 }
 
 //
-// Parse and execute individual commands
+// Flush the response and append the latency footer of a request
 //
-static void command_parsing(void)
+static void command_timing_report(tool_timing_t *timing, int64_t start_us)
+{
+    int64_t flush_us = esp_timer_get_time() ;
+
+    server_flush() ;
+
+    timing->flush_us = (uint32_t) (esp_timer_get_time() - flush_us) ;
+    timing->total_us = (uint32_t) (esp_timer_get_time() - start_us) ;
+
+    tool_timing_report(timing, server_put_bytes) ;
+}
+
+//
+// FTM command ( by SSID or by MAC address )
+//
+static unsigned int command_ftm(cJSON *root, int64_t start_us)
 {
     char ssid[128] ;
     unsigned char mac[6] ;
     unsigned int  channel ;
     unsigned int  count ;
     unsigned int  burst_period ;
-            
-    // INSERT A NULL TERMINATION
-    command_control.buffer[command_control.index++] = 0 ;   
+    ftm_options_t options ;
+    tool_timing_t timing ;
 
-    //
-    // PARSE REMOTE COMMANDS
-    //
-    if (parser_ftm_by_ssid(command_control.buffer, ssid, &count, &burst_period))                // FTM COMMAND (BY SSID)
+    memset(&timing, 0, sizeof(timing)) ;
+
+    if (parser_ftm_by_ssid(root, ssid, &count, &burst_period, &options))                                    // BY SSID
     {
-        ftm_query_by_ssid(ssid, count, burst_period, server_put_bytes) ;
+        metrics_count(METRICS_CMD_FTM, 1) ;
+        ftm_query_by_ssid(ssid, count, burst_period, &options, &timing, server_put_bytes) ;
     }
-    else if (parser_ftm_by_mac(command_control.buffer, mac, &channel, &count, &burst_period))   // FTM COMMAND (BY MAC)
+    else if (parser_ftm_by_mac(root, mac, &channel, &count, &burst_period, &options))                       // BY MAC
     {
-        ftm_query_by_mac(mac, channel, count, burst_period, server_put_bytes) ;            
+        metrics_count(METRICS_CMD_FTM, 1) ;
+        ftm_query_by_mac(mac, channel, count, burst_period, &options, &timing, server_put_bytes) ;
     }
-    else if (parser_scan(command_control.buffer, ssid))                                         // SCAN COMMAND
+    else
     {
-        if (!strcmp(ssid,"?"))
-        {
-            // SCAN ALL SSIDs
-            tool_perform_scan(0, false, server_put_bytes) ;                                     
-        }
-        else
+        return 0 ;
+    }
+
+    if (options.timing) command_timing_report(&timing, start_us) ;
+
+    return 1 ;
+}
+
+//
+// FTM command ( every responder in range )
+//
+static unsigned int command_ftm_all(cJSON *root, int64_t start_us)
+{
+    unsigned int  count ;
+    unsigned int  burst_period ;
+    int           min_rssi ;
+    ftm_options_t options ;
+    tool_timing_t timing ;
+
+    if (!parser_ftm_all(root, &count, &burst_period, &min_rssi, &options))
+        return 0 ;
+
+    memset(&timing, 0, sizeof(timing)) ;
+
+    metrics_count(METRICS_CMD_FTM_ALL, 1) ;
+    ftm_query_all(count, burst_period, min_rssi, &options, &timing, server_put_bytes, server_flush) ;
+    if (options.timing) command_timing_report(&timing, start_us) ;
+
+    return 1 ;
+}
+
+//
+// Scan command
+//
+static unsigned int command_scan(cJSON *root, int64_t start_us)
+{
+    char ssid[128] ;
+    unsigned int  scan_timing ;
+    tool_timing_t timing ;
+
+    if (!parser_scan(root, ssid, &scan_timing))
+        return 0 ;
+
+    memset(&timing, 0, sizeof(timing)) ;
+
+    metrics_count(METRICS_CMD_SCAN, 1) ;
+    if (!strcmp(ssid,"?"))
+    {
+        // SCAN ALL SSIDs
+        tool_perform_scan(0, false, &timing, server_put_bytes) ;
+    }
+    else
+    {
+        // SCAN SPECIFIC SSID
+        tool_perform_scan(ssid, false, &timing, server_put_bytes) ;
+    }
+    if (scan_timing) command_timing_report(&timing, start_us) ;
+
+    return 1 ;
+}
+
+//
+// Memory pool report
+//
+static unsigned int command_pool(cJSON *root, int64_t start_us)
+{
+    if (!parser_pool(root))
+        return 0 ;
+
+    metrics_count(METRICS_CMD_POOL, 1) ;
+    pool_report(server_put_bytes) ;
+
+    return 1 ;
+}
+
+//
+// Ranging history
+//
+static unsigned int command_history(cJSON *root, int64_t start_us)
+{
+    history_query_t query ;
+
+    if (!parser_history(root, &query))
+        return 0 ;
+
+    metrics_count(METRICS_CMD_HISTORY, 1) ;
+    history_query(&query, server_put_bytes) ;
+
+    return 1 ;
+}
+
+//
+// Measurement journal
+//
+static unsigned int command_journal(cJSON *root, int64_t start_us)
+{
+    unsigned int action ;
+
+    if (!parser_journal(root, &action))
+        return 0 ;
+
+    metrics_count(METRICS_CMD_JOURNAL, 1) ;
+    if (action == JOURNAL_ACTION_EXPORT)
+    {
+        // BINARY DUMP , STREAMED STRAIGHT FROM FLASH
+        journal_export(server_stream_bytes) ;
+    }
+    else
+    {
+        if (action == JOURNAL_ACTION_FLUSH) journal_flush() ;
+        if (action == JOURNAL_ACTION_ERASE) journal_erase() ;
+        journal_info(server_put_bytes) ;
+    }
+
+    return 1 ;
+}
+
+//
+// Runtime metrics
+//
+static unsigned int command_stats(cJSON *root, int64_t start_us)
+{
+    unsigned int format ;
+
+    if (!parser_stats(root, &format))
+        return 0 ;
+
+    metrics_count(METRICS_CMD_STATS, 1) ;
+    metrics_report(format, server_put_bytes) ;
+
+    return 1 ;
+}
+
+//
+// Hot-path trace
+//
+static unsigned int command_trace(cJSON *root, int64_t start_us)
+{
+    unsigned int action ;
+
+    if (!parser_trace(root, &action))
+        return 0 ;
+
+    metrics_count(METRICS_CMD_TRACE, 1) ;
+    if (action == TRACE_ACTION_CLEAR)
+    {
+        trace_clear() ;
+    }
+    else
+    {
+        // BINARY DUMP , STREAMED STRAIGHT FROM THE RING
+        trace_dump(server_stream_bytes, server_put_bytes) ;
+    }
+
+    return 1 ;
+}
+
+//
+// Log levels
+//
+static unsigned int command_log(cJSON *root, int64_t start_us)
+{
+    char module[32] ;
+    int  level, console, report ;
+
+    if (!parser_log(root, module, &level, &console, &report))
+        return 0 ;
+
+    metrics_count(METRICS_CMD_LOG, 1) ;
+    tool_log_configure(module, level, console, server_put_bytes) ;
+    ftm_set_report_level(report, server_put_bytes) ;
+
+    return 1 ;
+}
+
+//
+// Raw event capture
+//
+static unsigned int command_capture(cJSON *root, int64_t start_us)
+{
+    unsigned int  action ;
+    unsigned int  speed ;
+    ftm_options_t options ;
+    tool_timing_t timing ;
+
+    if (!parser_capture(root, &action, &speed, &options))
+        return 0 ;
+
+    metrics_count(METRICS_CMD_CAPTURE, 1) ;
+    if (action == CAPTURE_ACTION_DUMP)
+    {
+        // BINARY DUMP , STREAMED STRAIGHT FROM FLASH
+        capture_dump(server_stream_bytes) ;
+    }
+    else if (action == CAPTURE_ACTION_REPLAY)
+    {
+        memset(&timing, 0, sizeof(timing)) ;
+        capture_replay(speed, &options, &timing, server_put_bytes, server_flush) ;
+        if (options.timing) command_timing_report(&timing, start_us) ;
+    }
+    else
+    {
+        if (action == CAPTURE_ACTION_START) capture_start() ;
+        if (action == CAPTURE_ACTION_STOP) capture_stop() ;
+        capture_info(server_put_bytes) ;
+    }
+
+    return 1 ;
+}
+
+//
+// Publish/subscribe streams
+//
+static unsigned int command_streams(cJSON *root, int64_t start_us)
+{
+    if (!parser_streams(root))
+        return 0 ;
+
+    metrics_count(METRICS_CMD_STREAMS, 1) ;
+    stream_info(server_put_bytes) ;
+
+    return 1 ;
+}
+
+//
+// UDP datagram streaming
+//
+static unsigned int command_udp(cJSON *root, int64_t start_us)
+{
+    unsigned int action ;
+    char         host[48] ;
+    unsigned int port ;
+    unsigned int format ;
+
+    if (!parser_udp(root, &action, host, &port, &format))
+        return 0 ;
+
+    metrics_count(METRICS_CMD_UDP, 1) ;
+    if (action == UDP_ACTION_START) udp_start(host, port, format, server_put_bytes) ;
+    if (action == UDP_ACTION_STOP) udp_stop() ;
+    udp_info(server_put_bytes) ;
+
+    return 1 ;
+}
+
+//
+// Anchor survey
+//
+static unsigned int command_survey(cJSON *root, int64_t start_us)
+{
+    survey_request_t survey ;
+
+    if (!parser_survey(root, &survey))
+        return 0 ;
+
+    metrics_count(METRICS_CMD_SURVEY, 1) ;
+    survey_run(&survey, server_put_bytes) ;
+
+    return 1 ;
+}
+
+//
+// Radio configuration
+//
+static unsigned int command_radio(cJSON *root, int64_t start_us)
+{
+    unsigned int   action ;
+    radio_config_t radio ;
+    unsigned int   fields ;
+
+    if (!parser_radio(root, &action, &radio, &fields))
+        return 0 ;
+
+    metrics_count(METRICS_CMD_RADIO, 1) ;
+    if (action == RADIO_ACTION_SET)
+    {
+        // THE CLIENT IS DROPPED WHEN THE CHANNEL CHANGES : ANNOUNCE THE SWITCH FIRST
+        if (radio_check(&radio, fields, server_put_bytes))
         {
-            // SCAN SPECIFIC SSID
-            tool_perform_scan(ssid, false, server_put_bytes) ;                                  
+            server_flush() ;
+            radio_set(&radio, fields, server_put_bytes) ;
         }
     }
- 
+    if (action == RADIO_ACTION_RESET) radio_reset(server_put_bytes) ;
+    radio_info(server_put_bytes) ;
+
+    return 1 ;
+}
+
+//
+// FTM responder
+//
+static unsigned int command_responder(cJSON *root, int64_t start_us)
+{
+    unsigned int action ;
+    responder_calibration_t calibration ;
+
+    if (!parser_responder(root, &action, &calibration))
+        return 0 ;
+
+    metrics_count(METRICS_CMD_RESPONDER, 1) ;
+    if (action == RESPONDER_ACTION_CALIBRATE) responder_calibrate(&calibration, server_put_bytes) ;
+    if (action == RESPONDER_ACTION_RESET) responder_reset(server_put_bytes) ;
+    if (action == RESPONDER_ACTION_CLEAR) responder_clear() ;
+    responder_info(server_put_bytes) ;
+
+    return 1 ;
+}
+
+//
+// Parse and execute individual commands
+//
+// The command is parsed once ; its "function" selects the handler of command_table[] , which
+// reads its parameters from the parsed tree . Unknown functions and malformed commands or
+// parameters are counted as parse errors.
+//
+static void command_parsing(void)
+{
+    cJSON *root ;
+    const char *function ;
+    unsigned int k ;
+    int64_t start_us = esp_timer_get_time() ;
+
+    TRACE(TRACE_CMD_BEGIN, 0) ;
+
+    // INSERT A NULL TERMINATION
+    command_control.buffer[command_control.index++] = 0 ;
+
+    //
+    // PARSE AND DISPATCH REMOTE COMMANDS
+    //
+    root = parser_parse(command_control.buffer) ;
+
+    function = parser_function(root) ;
+    for (k=0; function && (k<COMMAND_TABLE_SIZE) && strcmp(function, command_table[k].function); k++) ;
+
+    if (!function || (k == COMMAND_TABLE_SIZE) || !command_table[k].handler(root, start_us))     // UNKNOWN OR MALFORMED COMMAND
+    {
+        metrics_count(METRICS_PARSE_ERRORS, 1) ;
+    }
+
+    parser_release(root) ;
+
+    TRACE(TRACE_CMD_END, 0) ;
 
     // COPY INPUT BYTES TO OUTPUT
     #if (COMMAND_TCP_ECHO_ENABLED)
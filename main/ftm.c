@@ -29,82 +29,211 @@
  */
 
 #include <stdlib.h>
+#include <math.h>
 #include <string.h>
 #include "esp_system.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "freertos/event_groups.h"
 #include "tool.h"
 #include "server.h"
+#include "pool.h"
+#include "rtt.h"
+#include "history.h"
+#include "journal.h"
+#include "cache.h"
+#include "metrics.h"
+#include "trace.h"
+#include "capture.h"
+#include "stream.h"
+#include "udp.h"
+#include "ftm.h"
 
 #define FTM_LINE_BUFFER_LENGTH       1024
 #define FTM_LOG_BUFFER_LENGTH        400
 
+#define FTM_SESSION_QUEUE_LENGTH     8
+#define FTM_SESSION_TIMEOUT_MS       CONFIG_ESP_FTM_SESSION_TIMEOUT_MS      // default deadline of each attempt
+#define FTM_SESSION_RETRIES          CONFIG_ESP_FTM_SESSION_RETRIES         // default number of retries
+#define FTM_SESSION_BACKOFF_MS       CONFIG_ESP_FTM_SESSION_BACKOFF_MS      // default delay before the first retry
+#define FTM_SESSION_MIN_TIMEOUT_MS   100
+#define FTM_SESSION_MAX_TIMEOUT_MS   60000
+#define FTM_SESSION_MAX_RETRIES      10
+#define FTM_SESSION_MAX_BACKOFF_MS   10000
+
+#define FTM_MAX_BURST_PERIOD         255
+
+#define FTM_ALL_MAX_RESPONDERS       16     // responders ranged by ftm_query_all()
+#define FTM_ALL_PIPELINE_DEPTH       2      // sessions queued ahead ( the driver never waits for the command task )
+
 static const char *TAG = "ftm" ;
 
-static uint32_t g_rtt_est, g_dist_est ;
-wifi_ftm_report_entry_t *g_ftm_report ;
-uint8_t g_ftm_report_num_entries ;
+static QueueHandle_t ftm_session_queue ;        // pending sessions ( ftm_session_t * )
+static ftm_session_t *ftm_active_session ;      // session currently owned by the driver
+static portMUX_TYPE ftm_spinlock = portMUX_INITIALIZER_UNLOCKED ;
 static EventGroupHandle_t ftm_event_group ;
 const int FTM_REPORT_BIT  = BIT0 ;
 const int FTM_FAILURE_BIT = BIT1 ;
 
-static void (*ftm_callback)(unsigned char *buffer, unsigned int len) ;
-
-const int g_report_lvl =
+static unsigned int g_report_lvl =
         #ifdef CONFIG_ESP_FTM_REPORT_SHOW_DIAG
-            BIT0 |
+            FTM_FIELD_DIAG |
         #endif
         #ifdef CONFIG_ESP_FTM_REPORT_SHOW_RTT
-            BIT1 |
+            FTM_FIELD_RTT |
         #endif
         #ifdef CONFIG_ESP_FTM_REPORT_SHOW_T1T2T3T4
-            BIT2 |
+            FTM_FIELD_T1T2T3T4 |
         #endif
         #ifdef CONFIG_ESP_FTM_REPORT_SHOW_RSSI
-            BIT3 |
+            FTM_FIELD_RSSI |
         #endif
         0 ;
 
 
 // FUNCTION PROTOTYPES
-void ftm_event_handler(void *arg, esp_event_base_t event_base,
-                        int32_t event_id, void *event_data) ;
-void ftm_process_report(void) ;     
+void ftm_event_handler(const bus_event_t *event, void *arg) ;
+void ftm_process_report(ftm_session_t *session) ;     
+static int ftm_row_generic(char *log, unsigned int fields, const wifi_ftm_report_entry_t *entry) ;
+static int ftm_row_rtt(char *log, unsigned int fields, const wifi_ftm_report_entry_t *entry) ;
+static int ftm_row_rssi(char *log, unsigned int fields, const wifi_ftm_report_entry_t *entry) ;
+static int ftm_row_rtt_rssi(char *log, unsigned int fields, const wifi_ftm_report_entry_t *entry) ;
+static int ftm_row_diag_rtt_rssi(char *log, unsigned int fields, const wifi_ftm_report_entry_t *entry) ;
+static int ftm_row_t1t2t3t4(char *log, unsigned int fields, const wifi_ftm_report_entry_t *entry) ;
+static int ftm_row_all(char *log, unsigned int fields, const wifi_ftm_report_entry_t *entry) ;
+
+void ftm_options_default(ftm_options_t *options) ;
+const char *ftm_status_string(unsigned int status) ;
+void ftm_set_report_level(int level, void (*callback)(unsigned char *buffer, unsigned int len)) ;
+void ftm_session_setup(ftm_session_t *session, unsigned char *mac, unsigned int channel,
+                       unsigned int count, unsigned int burst_period, const ftm_options_t *options,
+                       void (*callback)(unsigned char *buffer, unsigned int len)) ;
+unsigned int ftm_session_run(ftm_session_t *session) ;
+void ftm_session_release(ftm_session_t *session) ;
+unsigned int ftm_replay_report(wifi_event_ftm_report_t *event, const ftm_options_t *options,
+                               tool_timing_t *timing,
+                               void (*callback)(unsigned char *buffer, unsigned int len)) ;
+static ftm_session_t *ftm_session_claim(ftm_session_t *session) ;
+static void ftm_session_execute(ftm_session_t *session) ;
+static void ftm_task(void *pvParameters) ;
+static void ftm_session_record(ftm_session_t *session) ;
+static unsigned int ftm_session_run_adaptive(ftm_session_t *session) ;
+static void ftm_session_output(ftm_session_t *session, tool_timing_t *timing) ;
+static void ftm_session_save(const ftm_session_t *session, cache_result_t *result) ;
+static void ftm_session_load(ftm_session_t *session, const cache_result_t *result) ;
+static void ftm_session_start(ftm_session_t *session) ;
+static void ftm_session_wait(ftm_session_t *session) ;
+static unsigned int ftm_check_parameters(unsigned int count, unsigned int burst_period, const ftm_options_t *options,
+                                         void (*callback)(unsigned char *buffer, unsigned int len)) ;
 
 int  ftm_query_by_ssid(const char *ssid, unsigned int count, unsigned int burst_period,
+                       const ftm_options_t *options, tool_timing_t *timing,
                        void (*callback)(unsigned char *buffer, unsigned int len)) ;
 
 int  ftm_query_by_mac(unsigned char *mac, unsigned int channel,
                       unsigned int count, unsigned int burst_period,
+                      const ftm_options_t *options, tool_timing_t *timing,
                       void (*callback)(unsigned char *buffer, unsigned int len)) ;
 
+int  ftm_query_all(unsigned int count, unsigned int burst_period, int min_rssi,
+                   const ftm_options_t *options, tool_timing_t *timing,
+                   void (*callback)(unsigned char *buffer, unsigned int len),
+                   void (*flush)(void)) ;
+
 void ftm_init(void) ;
 
 //
-// FTM Event Handler
+// Take ownership of the active session ( a single owner : event handler or FTM task )
+//
+// returns the claimed session, or 0 if it's not active anymore
 //
-void ftm_event_handler(void *arg, esp_event_base_t event_base,
-                       int32_t event_id, void *event_data)
+static ftm_session_t *ftm_session_claim(ftm_session_t *session)
 {
-    if (event_id == WIFI_EVENT_FTM_REPORT) 
+    ftm_session_t *claimed = 0 ;
+
+    portENTER_CRITICAL(&ftm_spinlock) ;
+    if (ftm_active_session && (session == ftm_active_session))
     {
-        wifi_event_ftm_report_t *event = (wifi_event_ftm_report_t *) event_data ;
+        claimed = ftm_active_session ;
+        ftm_active_session = 0 ;
+    }
+    portEXIT_CRITICAL(&ftm_spinlock) ;
+
+    return claimed ;
+}
+
+//
+// FTM Event Handler ( inline bus subscriber : runs on the driver event task )
+//
+void ftm_event_handler(const bus_event_t *bus_event, void *arg)
+{
+    if (bus_event->type == BUS_FTM_REPORT) 
+    {
+        const wifi_event_ftm_report_t *event = &bus_event->data.ftm_report ;
+        ftm_session_t *session = 0 ;
+
+        // RAW EVENT CAPTURE ( before the report is consumed )
+        capture_ftm_report(event) ;
+
+        portENTER_CRITICAL(&ftm_spinlock) ;
+        if (ftm_active_session && !memcmp(ftm_active_session->mac, event->peer_mac, 6))
+        {
+            session = ftm_active_session ;
+            ftm_active_session = 0 ;
+        }
+        portEXIT_CRITICAL(&ftm_spinlock) ;
+
+        if (!session)
+        {
+            // late report of a session that already timed out
+            ESP_LOGW(TAG, "Discarding FTM report from Peer("MACSTR") (no pending session)",
+                     MAC2STR(event->peer_mac)) ;
+            if (event->status == FTM_STATUS_SUCCESS)
+            {
+                free(event->ftm_report_data) ;
+            }
+            return ;
+        }
+
+        session->status = event->status ;
 
         if (event->status == FTM_STATUS_SUCCESS) 
         {
-            g_rtt_est = event->rtt_est ;                                // Estimated Round-Trip-Time with peer in Nano-Seconds
-            g_dist_est = event->dist_est ;                              // Estimated one-way distance in Centi-Meters
-            g_ftm_report = event->ftm_report_data ;                     // Pointer to FTM Report with multiple entries, should be freed after use
-            g_ftm_report_num_entries = event->ftm_report_num_entries ;  // Number of entries in the FTM Report data
+            unsigned int size = event->ftm_report_num_entries * sizeof(wifi_ftm_report_entry_t) ;
+
+            session->rtt_raw = event->rtt_raw ;                                 // Raw average Round-Trip-Time with peer in Nano-Seconds
+            session->rtt_est = event->rtt_est ;                                 // Estimated Round-Trip-Time with peer in Nano-Seconds
+            session->dist_est = event->dist_est ;                               // Estimated one-way distance in Centi-Meters
+            session->report = event->ftm_report_data ;                          // Pointer to FTM Report with multiple entries, should be freed after use
+            session->report_num_entries = event->ftm_report_num_entries ;       // Number of entries in the FTM Report data
+
+            // Move the report into a pool block and hand the driver buffer back right away
+            // ( if the pools are exhausted, the driver buffer is kept and pool_free() releases it to the heap )
+            if (session->report && size)
+            {
+                wifi_ftm_report_entry_t *report = pool_alloc(size) ;
+                if (report)
+                {
+                    memcpy(report, session->report, size) ;
+                    free(session->report) ;
+                    session->report = report ;
+                }
+            }
+
+            session->outcome = FTM_SESSION_REPORT ;
             xEventGroupSetBits(ftm_event_group, FTM_REPORT_BIT) ;
         } 
         else 
         {
             ESP_LOGI(TAG, "FTM procedure with Peer("MACSTR") failed! (Status - %d)",
                      MAC2STR(event->peer_mac), event->status) ;
+            session->outcome = FTM_SESSION_FAILURE ;
             xEventGroupSetBits(ftm_event_group, FTM_FAILURE_BIT) ;
         }        
     }
@@ -112,83 +241,691 @@ void ftm_event_handler(void *arg, esp_event_base_t event_base,
 
 
 //
-// Process a successful FTM report
+// FTM report row writers ( one per column combination , selected once per report )
+//
+// Each writer formats a whole row with a single sprintf ; uncommon combinations
+// fall back to the column by column writer.
+//
+static int ftm_row_generic(char *log, unsigned int fields, const wifi_ftm_report_entry_t *entry)
+{
+    char *log_ptr = log ;
+
+    log_ptr += sprintf(log_ptr,"|") ;
+
+    if (fields & FTM_FIELD_DIAG) 
+    {
+        log_ptr += sprintf(log_ptr, "%6d|", entry->dlog_token) ;      // Dialog Token
+    }
+    if (fields & FTM_FIELD_RTT) 
+    {
+        log_ptr += sprintf(log_ptr, "%7u  |", entry->rtt) ;           // RTT
+    }
+    if (fields & FTM_FIELD_T1T2T3T4) 
+    {
+        log_ptr += sprintf(log_ptr, "%14llu  |%14llu  |%14llu  |%14llu  |", entry->t1,
+                                    entry->t2, entry->t3, entry->t4) ;
+    }
+    if (fields & FTM_FIELD_RSSI) 
+    {
+        log_ptr += sprintf(log_ptr, "%6d  |", entry->rssi) ;
+    }
+    return log_ptr - log ;
+}
+
+static int ftm_row_rtt(char *log, unsigned int fields, const wifi_ftm_report_entry_t *entry)
+{
+    return sprintf(log, "|%7u  |", entry->rtt) ;
+}
+
+static int ftm_row_rssi(char *log, unsigned int fields, const wifi_ftm_report_entry_t *entry)
+{
+    return sprintf(log, "|%6d  |", entry->rssi) ;
+}
+
+static int ftm_row_rtt_rssi(char *log, unsigned int fields, const wifi_ftm_report_entry_t *entry)
+{
+    return sprintf(log, "|%7u  |%6d  |", entry->rtt, entry->rssi) ;
+}
+
+static int ftm_row_diag_rtt_rssi(char *log, unsigned int fields, const wifi_ftm_report_entry_t *entry)
+{
+    return sprintf(log, "|%6d|%7u  |%6d  |", entry->dlog_token, entry->rtt, entry->rssi) ;
+}
+
+static int ftm_row_t1t2t3t4(char *log, unsigned int fields, const wifi_ftm_report_entry_t *entry)
+{
+    return sprintf(log, "|%14llu  |%14llu  |%14llu  |%14llu  |", entry->t1, entry->t2, entry->t3, entry->t4) ;
+}
+
+static int ftm_row_all(char *log, unsigned int fields, const wifi_ftm_report_entry_t *entry)
+{
+    return sprintf(log, "|%6d|%7u  |%14llu  |%14llu  |%14llu  |%14llu  |%6d  |", entry->dlog_token, entry->rtt,
+                        entry->t1, entry->t2, entry->t3, entry->t4, entry->rssi) ;
+}
+
+static int (*const ftm_row_writer[FTM_FIELD_ALL + 1])(char *log, unsigned int fields, const wifi_ftm_report_entry_t *entry) = {
+    [0x0] = ftm_row_generic,
+    [0x1] = ftm_row_generic,
+    [0x2] = ftm_row_rtt,
+    [0x3] = ftm_row_generic,
+    [0x4] = ftm_row_t1t2t3t4,
+    [0x5] = ftm_row_generic,
+    [0x6] = ftm_row_generic,
+    [0x7] = ftm_row_generic,
+    [0x8] = ftm_row_rssi,
+    [0x9] = ftm_row_generic,
+    [0xA] = ftm_row_rtt_rssi,
+    [0xB] = ftm_row_diag_rtt_rssi,
+    [0xC] = ftm_row_generic,
+    [0xD] = ftm_row_generic,
+    [0xE] = ftm_row_generic,
+    [0xF] = ftm_row_all,
+} ;
+
+//
+// Process a successful FTM report ( columns requested by the session , or the "log" command default )
 //
-void ftm_process_report(void)
+void ftm_process_report(ftm_session_t *session)
 {
     int i;
-    char *log = malloc(FTM_LOG_BUFFER_LENGTH) ;
+    char *log ;
+    wifi_ftm_report_entry_t *report = session->report ;
+    unsigned int fields ;
+    int (*writer)(char *log, unsigned int fields, const wifi_ftm_report_entry_t *entry) ;
 
-    if (!g_report_lvl)
+    fields = (session->options.fields < 0) ? g_report_lvl : (session->options.fields & FTM_FIELD_ALL) ;
+
+    if (!fields)
         return ;
 
+    log = pool_alloc(FTM_LOG_BUFFER_LENGTH) ;
+
     if (!log) 
     {
         ESP_LOGE(TAG, "Failed to alloc buffer for FTM report") ;
         return ;
     }
 
-    bzero(log, FTM_LOG_BUFFER_LENGTH) ;
-
     // [ FTM REPORT TITLE ]
     sprintf(log, "FTM Report:") ;    
-    tool_log(TAG, log, 0, ftm_callback) ;
+    tool_log(TAG, log, 0, session->callback) ;
 
     // [ FTM REPORT HEADER ]
     sprintf(log, "|%s%s%s%s", 
-                 g_report_lvl & BIT0 ? " Diag |":"", 
-                 g_report_lvl & BIT1 ? "   RTT   |":"",
-                 g_report_lvl & BIT2 ? "       T1       |       T2       |       T3       |       T4       |":"",
-                 g_report_lvl & BIT3 ? "  RSSI  |":"") ;
-    tool_log(TAG, log, 0, ftm_callback) ;
+                 fields & FTM_FIELD_DIAG ? " Diag |":"", 
+                 fields & FTM_FIELD_RTT ? "   RTT   |":"",
+                 fields & FTM_FIELD_T1T2T3T4 ? "       T1       |       T2       |       T3       |       T4       |":"",
+                 fields & FTM_FIELD_RSSI ? "  RSSI  |":"") ;
+    tool_log(TAG, log, 0, session->callback) ;
 
     // [ FTM REPORT ROWS ]
-    for (i = 0; i < g_ftm_report_num_entries; i++) 
+    writer = ftm_row_writer[fields] ;
+
+    for (i = 0; i < session->report_num_entries; i++) 
+    {
+        writer(log, fields, &report[i]) ;
+        tool_log(TAG, log, 0, session->callback) ;
+    }
+    pool_free(log) ;
+}
+
+//
+// Set the default FTM report columns ( FTM_FIELD_xxx ; 0 : no report )
+//
+// level < 0 : only report the current detail
+//
+void ftm_set_report_level(int level, void (*callback)(unsigned char *buffer, unsigned int len))
+{
+    char line[FTM_LOG_BUFFER_LENGTH] ;
+
+    if (level >= 0)
+    {
+        g_report_lvl = level & FTM_FIELD_ALL ;
+    }
+
+    sprintf(line, "FTM report level 0x%x%s%s%s%s", g_report_lvl,
+                  g_report_lvl & FTM_FIELD_DIAG ? " Diag":"",
+                  g_report_lvl & FTM_FIELD_RTT ? " RTT":"",
+                  g_report_lvl & FTM_FIELD_T1T2T3T4 ? " T1T2T3T4":"",
+                  g_report_lvl & FTM_FIELD_RSSI ? " RSSI":"") ;
+    tool_log(TAG, line, 0, callback) ;
+}
+
+//
+// Default session options ( from the project configuration )
+//
+void ftm_options_default(ftm_options_t *options)
+{
+    options->timeout_ms = FTM_SESSION_TIMEOUT_MS ;
+    options->retries = FTM_SESSION_RETRIES ;
+    options->backoff_ms = FTM_SESSION_BACKOFF_MS ;
+    options->precision_cm = 0 ;
+    options->max_age_ms = 0 ;
+    options->timing = 0 ;
+    options->fields = FTM_FIELDS_DEFAULT ;
+}
+
+//
+// Description of a driver FTM status code
+//
+const char *ftm_status_string(unsigned int status)
+{
+    switch (status)
+    {
+        case FTM_STATUS_SUCCESS :       return "success" ;
+        case FTM_STATUS_UNSUPPORTED :   return "unsupported" ;
+        case FTM_STATUS_CONF_REJECTED : return "configuration rejected" ;
+        case FTM_STATUS_NO_RESPONSE :   return "no response" ;
+        case FTM_STATUS_FAIL :          return "failure" ;
+        default :                       return "unknown" ;
+    }
+}
+
+//
+// Prepare a session context ( the context usually lives in the caller's stack )
+//
+// options == 0 : use the default options
+//
+void ftm_session_setup(ftm_session_t *session, unsigned char *mac, unsigned int channel,
+                       unsigned int count, unsigned int burst_period, const ftm_options_t *options,
+                       void (*callback)(unsigned char *buffer, unsigned int len))
+{
+    memset(session, 0, sizeof(ftm_session_t)) ;
+
+    memcpy(session->mac, mac, 6) ;
+    session->channel = channel ;
+    session->count = count ;
+    session->burst_period = burst_period ;
+    if (options)
+    {
+        session->options = *options ;
+    }
+    else
+    {
+        ftm_options_default(&session->options) ;
+    }
+    session->status = FTM_STATUS_FAIL ;
+    session->outcome = FTM_SESSION_PENDING ;
+    session->callback = callback ;
+    session->done = xSemaphoreCreateBinaryStatic(&session->done_buffer) ;
+}
+
+//
+// Queue a session and wait for its completion ( retrying with exponential backoff )
+//
+// Every failed attempt is reported through the session callback, so the client
+// sees the partial results even if the last attempt also fails.
+//
+// returns 1 if a report was received
+//
+unsigned int ftm_session_run(ftm_session_t *session)
+{
+    char line[FTM_LINE_BUFFER_LENGTH] ;
+    unsigned int backoff_ms = session->options.backoff_ms ;
+
+    session->attempts = 0 ;
+
+    while (1)
     {
-        char *log_ptr = log ;
+        ftm_session_start(session) ;
+        ftm_session_wait(session) ;
+
+        if ( (session->outcome == FTM_SESSION_REPORT) || (session->attempts > session->options.retries) )
+            break ;
+
+        sprintf(line,"Attempt %u/%u : %s (Status - %u, %s), retrying in %u mSec",
+                     session->attempts, session->options.retries + 1,
+                     (session->outcome == FTM_SESSION_TIMEOUT) ? "Timeout" : 
+                     (session->outcome == FTM_SESSION_START_FAILED) ? "Start Failure" : "Failure",
+                     session->status, ftm_status_string(session->status), backoff_ms) ;
+        tool_log(TAG, line, 0, session->callback) ;
+
+        // wait outside the FTM task, so other queued sessions can proceed meanwhile
+        vTaskDelay(backoff_ms / portTICK_PERIOD_MS) ;
+        backoff_ms = (backoff_ms * 2 > FTM_SESSION_MAX_BACKOFF_MS) ? FTM_SESSION_MAX_BACKOFF_MS : backoff_ms * 2 ;
+    }
+
+    return (session->outcome == FTM_SESSION_REPORT) ;
+}
+
+//
+// Queue an attempt of a session ( returns once queued )
+//
+static void ftm_session_start(ftm_session_t *session)
+{
+    session->outcome = FTM_SESSION_PENDING ;
+    session->attempts++ ;
+
+    session->queued_at_us = esp_timer_get_time() ;
+    xQueueSend(ftm_session_queue, &session, portMAX_DELAY) ;
+}
+
+//
+// Wait for the completion of a queued attempt
+//
+static void ftm_session_wait(ftm_session_t *session)
+{
+    xSemaphoreTake(session->done, portMAX_DELAY) ;
+}
+
+//
+// Release the results of a session
+//
+void ftm_session_release(ftm_session_t *session)
+{
+    pool_free(session->report) ;
+    session->report = 0 ;
+    session->report_num_entries = 0 ;
+}
 
-        bzero(log, FTM_LOG_BUFFER_LENGTH) ;
+//
+// Replay a recorded driver event through the session pipeline ( event handler , estimator ,
+// history , report and summary ) , without retries nor the result cache
+//
+// event->ftm_report_data must be a heap buffer : it's released by the event handler , as a driver report
+//
+// returns 1 if the event was a successful report
+//
+unsigned int ftm_replay_report(wifi_event_ftm_report_t *event, const ftm_options_t *options,
+                               tool_timing_t *timing,
+                               void (*callback)(unsigned char *buffer, unsigned int len))
+{
+    ftm_session_t session ;
+
+    ftm_session_setup(&session, event->peer_mac, 0, event->ftm_report_num_entries, 2, options, callback) ;
+    session.options.retries = 0 ;
+    session.replay = event ;
 
-        log_ptr += sprintf(log_ptr,"|") ;
+    ftm_session_run(&session) ;
+    ftm_session_output(&session, timing) ;
 
-        if (g_report_lvl & BIT0) 
+    return (session.outcome == FTM_SESSION_REPORT) ;
+}
+
+//
+// Drive a single session through the WiFi driver ( FTM task context )
+//
+static void ftm_session_execute(ftm_session_t *session)
+{
+    int64_t start_us ;
+    uint32_t air_us ;
+    EventBits_t bits ;
+    const TickType_t xMaxTicksToWait = session->options.timeout_ms / portTICK_PERIOD_MS ;
+
+    wifi_ftm_initiator_cfg_t ftmi_cfg = {
+        .channel = session->channel,
+        .frm_count = session->count,
+        .burst_period = session->burst_period,
+    } ;
+
+    memcpy(ftmi_cfg.resp_mac, session->mac, 6) ;
+    session->status = FTM_STATUS_FAIL ;
+
+    // forget bits left behind by a previous session
+    xEventGroupClearBits(ftm_event_group, FTM_REPORT_BIT | FTM_FAILURE_BIT) ;
+
+    portENTER_CRITICAL(&ftm_spinlock) ;
+    ftm_active_session = session ;
+    portEXIT_CRITICAL(&ftm_spinlock) ;
+
+    start_us = esp_timer_get_time() ;
+    TRACE(TRACE_FTM_START, session->count) ;
+
+    if (session->replay)
+    {
+        // RECORDED DRIVER EVENT : POSTED AS THE DRIVER WOULD ( ftm_event_handler() releases its report )
+        if (ESP_OK != esp_event_post(WIFI_EVENT, WIFI_EVENT_FTM_REPORT, session->replay,
+                                     sizeof(wifi_event_ftm_report_t), portMAX_DELAY))
         {
-            log_ptr += sprintf(log_ptr, "%6d|", g_ftm_report[i].dlog_token) ;   // Dialog Token
+            free(session->replay->ftm_report_data) ;
+            session->replay->ftm_report_data = 0 ;
+            ftm_session_claim(session) ;
+            session->outcome = FTM_SESSION_START_FAILED ;
+            metrics_count(METRICS_FTM_START_FAILED, 1) ;
+            TRACE(TRACE_FTM_REPORT, session->outcome) ;
+            return ;
         }
-        if (g_report_lvl & BIT1) 
+        session->replay->ftm_report_data = 0 ;
+    }
+    else if (ESP_OK != esp_wifi_ftm_initiate_session(&ftmi_cfg)) 
+    {
+        ftm_session_claim(session) ;
+        session->outcome = FTM_SESSION_START_FAILED ;
+        metrics_count(METRICS_FTM_START_FAILED, 1) ;
+        TRACE(TRACE_FTM_REPORT, session->outcome) ;
+        return ;
+    }
+
+    bits = xEventGroupWaitBits(ftm_event_group, FTM_REPORT_BIT | FTM_FAILURE_BIT,
+                               pdTRUE, pdFALSE, xMaxTicksToWait) ;
+
+    if ( !(bits & (FTM_REPORT_BIT | FTM_FAILURE_BIT)) )
+    {
+        if (ftm_session_claim(session))
+        {
+            // cancel the session in the driver, so the next one can start right away
+            session->outcome = FTM_SESSION_TIMEOUT ;
+            session->status = FTM_STATUS_NO_RESPONSE ;
+            esp_wifi_ftm_end_session() ;
+        }
+        else
+        {
+            // the report arrived at the deadline : the event handler is completing it
+            xEventGroupWaitBits(ftm_event_group, FTM_REPORT_BIT | FTM_FAILURE_BIT,
+                                pdTRUE, pdFALSE, portMAX_DELAY) ;
+        }
+    }
+
+    TRACE(TRACE_FTM_REPORT, session->outcome) ;
+    air_us = (uint32_t) (esp_timer_get_time() - start_us) ;
+    session->timing.air_us += air_us ;
+    metrics_observe(METRICS_FTM_SESSION_MS, air_us / 1000) ;
+    metrics_count( (session->outcome == FTM_SESSION_REPORT) ? METRICS_FTM_SUCCESS :
+                   (session->outcome == FTM_SESSION_TIMEOUT) ? METRICS_FTM_TIMEOUT : METRICS_FTM_FAILURE, 1) ;
+
+    if (session->outcome == FTM_SESSION_REPORT)
+    {
+        rtt_estimate(session->report, session->report_num_entries, &session->estimate) ;
+    }
+}
+
+//
+// Keep a summary of a session in the ranging history and in the flash journal ( and publish it )
+//
+static void ftm_session_record(ftm_session_t *session)
+{
+    history_record_t record ;
+    unsigned int i ;
+    int rssi_sum = 0 ;
+
+    memset(&record, 0, sizeof(record)) ;
+    memcpy(record.mac, session->mac, 6) ;
+    record.status = session->status ;
+
+    if (session->outcome == FTM_SESSION_REPORT)
+    {
+        record.entries = session->estimate.used ;
+        record.rtt_ns = session->rtt_est ;
+        record.dist_cm = session->dist_est ;
+        record.rtt_ps = session->estimate.rtt_ps ;
+        record.std_cm = session->estimate.std_cm ;
+
+        if (session->report_num_entries)
         {
-            log_ptr += sprintf(log_ptr, "%7u  |", g_ftm_report[i].rtt) ;        // RTT
+            record.rssi_min = record.rssi_max = session->report[0].rssi ;
+            for (i = 0; i < session->report_num_entries; i++)
+            {
+                int8_t rssi = session->report[i].rssi ;
+
+                rssi_sum += rssi ;
+                if (rssi < record.rssi_min) record.rssi_min = rssi ;
+                if (rssi > record.rssi_max) record.rssi_max = rssi ;
+            }
+            record.rssi_mean = (int8_t) (rssi_sum / (int) session->report_num_entries) ;
         }
-        if (g_report_lvl & BIT2) 
+    }
+
+    history_append(&record) ;
+
+    // RANGING STREAM ( the history record , as exported )
+    if (stream_subscribed(STREAM_RANGING))
+    {
+        char line[HISTORY_LINE_LENGTH] ;
+
+        stream_publish(STREAM_RANGING, (unsigned char *) line, history_format(&record, line)) ;
+    }
+
+    // UDP DATAGRAM ( the same record , sequenced and time stamped )
+    udp_publish(&record) ;
+
+    // replayed sessions never reach the flash journal
+    if (!session->replay)
+    {
+        journal_append(&record) ;
+    }
+}
+
+//
+// FTM task ( executes queued sessions, one at a time )
+//
+static void ftm_task(void *pvParameters)
+{
+    ftm_session_t *session ;
+
+    while(1)
+    {
+        if (xQueueReceive(ftm_session_queue, &session, portMAX_DELAY) == pdTRUE)
         {
-            log_ptr += sprintf(log_ptr, "%14llu  |%14llu  |%14llu  |%14llu  |", g_ftm_report[i].t1,
-                                        g_ftm_report[i].t2, g_ftm_report[i].t3, g_ftm_report[i].t4) ;
+            session->timing.queued_us += (uint32_t) (esp_timer_get_time() - session->queued_at_us) ;
+            ftm_session_execute(session) ;
+            if (session->outcome != FTM_SESSION_START_FAILED)
+            {
+                ftm_session_record(session) ;
+            }
+            xSemaphoreGive(session->done) ;
         }
-        if (g_report_lvl & BIT3) 
+    }
+
+    vTaskDelete(NULL) ;
+}
+
+//
+// Adaptive session : escalate the frame count until the precision target is met
+//
+// The session starts with the smallest frame count; after every session the standard
+// error of the drift-corrected RTT decides whether a longer session is worth the air time.
+// If the responder rejects the configuration, the burst period is doubled.
+//
+// returns 1 if a report was received ( the report of the last session is kept )
+//
+static unsigned int ftm_session_run_adaptive(ftm_session_t *session)
+{
+    static const unsigned int ladder[] = { 8, 16, 24, 32, 64 } ;
+    const unsigned int steps = sizeof(ladder) / sizeof(ladder[0]) ;
+    char line[FTM_LINE_BUFFER_LENGTH] ;
+    unsigned int step = 0, sessions = 0 ;
+    float precision_cm = INFINITY ;
+
+    while (step < steps)
+    {
+        session->count = ladder[step] ;
+        ftm_session_run(session) ;
+        sessions++ ;
+
+        if (session->outcome != FTM_SESSION_REPORT)
         {
-            log_ptr += sprintf(log_ptr, "%6d  |", g_ftm_report[i].rssi) ;
+            if ( (session->status == FTM_STATUS_CONF_REJECTED) && (session->burst_period * 2 <= FTM_MAX_BURST_PERIOD) )
+            {
+                session->burst_period *= 2 ;
+                sprintf(line,"Adaptive : configuration rejected, Burst Period - %umSec", session->burst_period * 100) ;
+                tool_log(TAG, line, 0, session->callback) ;
+                continue ;
+            }
+            precision_cm = INFINITY ;
+            break ;
         }
 
-        tool_log(TAG, log, 0, ftm_callback) ;
+        // NO PRECISION WITHOUT AT LEAST 2 USABLE EXCHANGES ( THE ESTIMATE IS CLEARED )
+        precision_cm = (session->estimate.used > 1) ? session->estimate.sem_cm : INFINITY ;
+
+        sprintf(line,"Adaptive : Frm Count - %u, Valid Entries - %u, Dispersion - %.2f cm, Precision - %.2f cm",
+                     session->count, session->estimate.used, session->estimate.std_cm, precision_cm) ;
+        tool_log(TAG, line, 0, session->callback) ;
+
+        if ( (precision_cm <= (float) session->options.precision_cm) || (step == steps - 1) )
+            break ;
+
+        ftm_session_release(session) ;
+        step++ ;
+    }
+
+    sprintf(line,"Adaptive Parameters - Frm Count %u, Burst Period %umSec, Sessions %u, Precision %.2f cm (target %u cm, %s)",
+                 session->count, session->burst_period * 100, sessions, precision_cm, session->options.precision_cm,
+                 (precision_cm <= (float) session->options.precision_cm) ? "met" : "not met") ;
+    tool_log(TAG, line, 0, session->callback) ;
+
+    return (session->outcome == FTM_SESSION_REPORT) ;
+}
+
+//
+// Report the outcome of a session to its callback ( and release its results )
+//
+// timing != 0 : the session queue and air times and the formatting time are added to <timing>
+//
+static void ftm_session_output(ftm_session_t *session, tool_timing_t *timing)
+{
+    char line[FTM_LINE_BUFFER_LENGTH] ;
+    int64_t start_us = esp_timer_get_time() ;
+
+    TRACE(TRACE_FORMAT_BEGIN, session->report_num_entries) ;
+
+    /* Processing data from FTM session */
+    switch (session->outcome)
+    {
+        case FTM_SESSION_REPORT :
+                    if (session->report_num_entries)
+                    {
+                        ftm_process_report(session) ;
+                        ftm_session_release(session) ;
+                    }
+                    sprintf(line,"Estimated RTT - %d nSec, Estimated Distance - %d.%02d meters",
+                                 session->rtt_est, session->dist_est / 100, session->dist_est % 100) ;
+                    tool_log(TAG, line, 0, session->callback) ;                    
+                    if (session->estimate.used)
+                    {
+                        sprintf(line,"Timestamp RTT - %.1f pSec (raw %.1f pSec, drift %.2f ppm), Distance - %.2f meters, "
+                                     "Precision - %.2f cm, Confidence - %u%% (%u/%u entries)",
+                                     session->estimate.rtt_ps, session->estimate.rtt_raw_ps, session->estimate.drift_ppm,
+                                     session->estimate.dist_cm / 100.0f, session->estimate.sem_cm,
+                                     session->estimate.confidence, session->estimate.used, session->estimate.entries) ;
+                        tool_log(TAG, line, 0, session->callback) ;
+                    }
+                    break ;
+
+        case FTM_SESSION_START_FAILED :
+                    sprintf(line,"Failed to start FTM session") ;
+                    tool_log(TAG, line, 1, session->callback) ;        
+                    break ;
+
+        case FTM_SESSION_FAILURE :
+                    sprintf(line,"FTM Failure") ;
+                    tool_log(TAG, line, 0, session->callback) ;        
+                    break ;
+
+        default :
+                    sprintf(line,"FTM Timeout") ;            
+                    tool_log(TAG, line, 0, session->callback) ;        
+                    break ;
+    }
+
+    sprintf(line,"Session Status - %u (%s), Attempts - %u",
+                 session->status, ftm_status_string(session->status), session->attempts) ;
+    tool_log(TAG, line, 0, session->callback) ;
+
+    TRACE(TRACE_FORMAT_END, 0) ;
+
+    if (timing)
+    {
+        timing->queued_us += session->timing.queued_us ;
+        timing->air_us += session->timing.air_us ;
+        timing->format_us += (uint32_t) (esp_timer_get_time() - start_us) ;
+    }
+}
+
+//
+// Copy the results of a session into a cache result
+//
+static void ftm_session_save(const ftm_session_t *session, cache_result_t *result)
+{
+    memset(result, 0, sizeof(cache_result_t)) ;
+
+    result->outcome = session->outcome ;
+    result->attempts = session->attempts ;
+    result->status = session->status ;
+    result->rtt_raw = session->rtt_raw ;
+    result->rtt_est = session->rtt_est ;
+    result->dist_est = session->dist_est ;
+    result->count = session->count ;
+    result->burst_period = session->burst_period ;
+    result->estimate = session->estimate ;
+}
+
+//
+// Restore the results of a session from a cache result ( no report entries )
+//
+static void ftm_session_load(ftm_session_t *session, const cache_result_t *result)
+{
+    session->outcome = result->outcome ;
+    session->attempts = result->attempts ;
+    session->status = result->status ;
+    session->rtt_raw = result->rtt_raw ;
+    session->rtt_est = result->rtt_est ;
+    session->dist_est = result->dist_est ;
+    session->count = result->count ;
+    session->burst_period = result->burst_period ;
+    session->estimate = result->estimate ;
+    session->report = 0 ;
+    session->report_num_entries = 0 ;
+}
+
+//
+// Check the frame count , burst period and session options of a query
+//
+// returns 1 if they are valid
+//
+static unsigned int ftm_check_parameters(unsigned int count, unsigned int burst_period, const ftm_options_t *options,
+                                         void (*callback)(unsigned char *buffer, unsigned int len))
+{
+    char line[FTM_LINE_BUFFER_LENGTH] ;
+
+    // COUNT
+    if ( count != 0 && count != 8 && count != 16 &&
+         count != 24 && count != 32 && count != 64 )
+    {
+        sprintf(line,"Invalid Frame Count! Valid options are 0/8/16/24/32/64") ;
+        tool_log(TAG, line, 1, callback) ;        
+        return 0 ;
+    }
+
+    // BURST PERIOD
+    if ( (burst_period < 2) || (burst_period >= 256) )
+    {
+        sprintf(line,"Invalid Burst Period! Valid range is 2-255") ;
+        tool_log(TAG, line, 1, callback) ;        
+        return 0 ;
+    }
 
+    // SESSION OPTIONS
+    if ( options && ( (options->timeout_ms < FTM_SESSION_MIN_TIMEOUT_MS) || (options->timeout_ms > FTM_SESSION_MAX_TIMEOUT_MS) ||
+                      (options->retries > FTM_SESSION_MAX_RETRIES) || (options->backoff_ms > FTM_SESSION_MAX_BACKOFF_MS) ||
+                      (options->precision_cm > FTM_MAX_PRECISION_CM) || (options->max_age_ms > FTM_MAX_AGE_MS) ) )
+    {
+        sprintf(line,"Invalid Session Options! Valid ranges are timeout %d-%d mSec, retries 0-%d, backoff 0-%d mSec, precision 0-%d cm, "
+                     "max_age_ms 0-%d mSec",
+                     FTM_SESSION_MIN_TIMEOUT_MS, FTM_SESSION_MAX_TIMEOUT_MS, FTM_SESSION_MAX_RETRIES, FTM_SESSION_MAX_BACKOFF_MS,
+                     FTM_MAX_PRECISION_CM, FTM_MAX_AGE_MS) ;
+        tool_log(TAG, line, 1, callback) ;        
+        return 0 ;
     }
-    free(log) ;
+
+    return 1 ;
 }
 
 //
 // Execute a FTM query by SSID
 //
 int ftm_query_by_ssid(const char *ssid, unsigned int count, unsigned int burst_period,
+                      const ftm_options_t *options, tool_timing_t *timing,
                       void (*callback)(unsigned char *buffer, unsigned int len))
 {
     wifi_ap_record_t *ap_record ;
    
-    ap_record = tool_find_ftm_responder_ap(ssid) ;
+    ap_record = tool_find_ftm_responder_ap(ssid, timing) ;
 
     if (ap_record) 
     {
         return ftm_query_by_mac(ap_record->bssid, ap_record->primary, 
-                                count, burst_period, 
+                                count, burst_period, options, timing,
                                 callback) ;        
     } 
     else 
@@ -200,96 +937,245 @@ int ftm_query_by_ssid(const char *ssid, unsigned int count, unsigned int burst_p
 //
 // Execute a FTM query by MAC address ( and channel )
 //
+// timing != 0 : queue, air and formatting times are added to <timing>
+//
 int ftm_query_by_mac(unsigned char *mac, unsigned int channel,
                      unsigned int count, unsigned int burst_period,
+                     const ftm_options_t *options, tool_timing_t *timing,
                      void (*callback)(unsigned char *buffer, unsigned int len))
 {
-    EventBits_t bits ;
-    const TickType_t xMaxTicksToWait = 30000 / portTICK_PERIOD_MS ;      // 30 seconds of maximum waiting before Timoeout
-
-    wifi_ftm_initiator_cfg_t ftmi_cfg = {
-        .frm_count = 32,
-        .burst_period = 2,
-    } ;
-
+    ftm_session_t session ;
+    cache_key_t key ;
+    cache_result_t result ;
+    unsigned int lookup ;
+    int slot ;
     char line[FTM_LINE_BUFFER_LENGTH] ;
    
-    ftm_callback = callback ;
+    if (!ftm_check_parameters(count, burst_period, options, callback))
+        return 0 ;
 
-    // MAC ADDRESS
-    memcpy(ftmi_cfg.resp_mac, mac, 6) ;
-    ftmi_cfg.channel = channel ;
+    // START FTM QUERY 
+    ftm_session_setup(&session, mac, channel, count, burst_period, options, callback) ;
 
-    // COUNT
-    if ( count != 0 && count != 8 && count != 16 &&
-         count != 24 && count != 32 && count != 64 )
+    // RECENT RESULT
+    memset(&key, 0, sizeof(key)) ;
+    memcpy(key.mac, mac, 6) ;
+    key.channel = channel ;
+    key.count = count ;
+    key.burst_period = burst_period ;
+    key.precision_cm = session.options.precision_cm ;
+
+    lookup = cache_acquire(&key, session.options.max_age_ms, &result, &slot) ;
+
+    if (lookup == CACHE_HIT)
     {
-        sprintf(line,"Invalid Frame Count! Valid options are 0/8/16/24/32/64") ;
-        tool_log(TAG, line, 1, ftm_callback) ;        
-        return 0 ;
+        ftm_session_load(&session, &result) ;
+        metrics_count(METRICS_FTM_CACHED, 1) ;
+
+        sprintf(line,"Cached Result - Age %u mSec, Frm Count - %u, Burst Period - %umSec",
+                     (unsigned int) ((uint32_t) (esp_timer_get_time() / 1000) - result.time_ms),
+                     session.count, session.burst_period * 100) ;
+        tool_log(TAG, line, 0, callback) ;
+
+        ftm_session_output(&session, timing) ;
+
+        return (session.outcome == FTM_SESSION_REPORT) ;
+    }
+
+    if (session.options.precision_cm)
+    {
+        sprintf(line,"Requesting adaptive FTM session with Precision Target - %u cm, Burst Period - %dmSec",
+                     session.options.precision_cm, burst_period*100) ;
+        tool_log(TAG, line, 0, callback) ;                 
+
+        ftm_session_run_adaptive(&session) ;
     }
     else
     {
-        ftmi_cfg.frm_count = count ;
+        sprintf(line,"Requesting FTM session with Frm Count - %d, Burst Period - %dmSec (0: No Preference)",
+                     count, burst_period*100) ;
+        tool_log(TAG, line, 0, callback) ;                 
+
+        ftm_session_run(&session) ;
     }
 
-    // BURST PERIOD
-    if ( (burst_period >= 2) && (burst_period < 256) )
+    if (lookup == CACHE_MISS)
     {
-        ftmi_cfg.burst_period = burst_period ;
-    } 
-    else 
+        ftm_session_save(&session, &result) ;
+        cache_complete(slot, &result) ;
+    }
+
+    ftm_session_output(&session, timing) ;
+
+    return (session.outcome == FTM_SESSION_REPORT) ;
+}
+
+//
+// Range every FTM responder in range ( one scan , no client round trip between the sessions )
+//
+// The FTM responders of a full scan are ranged in channel order, keeping FTM_ALL_PIPELINE_DEPTH
+// sessions queued : the next session starts as soon as the driver is done with the previous
+// one, while the previous result is reported. A failed attempt is queued again right away
+// ( behind the sessions already queued , instead of a backoff delay ). Results are fresh
+// ( no cache , no adaptive precision ) and recorded in the history as any session.
+//
+// min_rssi : weaker responders are left out
+// timing != 0 : scan ( lookup ) , queue , air and formatting times are added to <timing>
+// flush ( optional ) : sends each summary line as soon as the responder is done
+//
+// returns the number of responders with a distance
+//
+int ftm_query_all(unsigned int count, unsigned int burst_period, int min_rssi,
+                  const ftm_options_t *options, tool_timing_t *timing,
+                  void (*callback)(unsigned char *buffer, unsigned int len),
+                  void (*flush)(void))
+{
+    wifi_ap_record_t *records ;
+    ftm_session_t session[FTM_ALL_PIPELINE_DEPTH] ;
+    struct {
+        unsigned int outcome ;
+        unsigned int status ;
+        unsigned int attempts ;
+        float        dist_cm ;
+        float        sem_cm ;                       // 0 : driver estimate only
+    } result[FTM_ALL_MAX_RESPONDERS] ;
+    char line[FTM_LINE_BUFFER_LENGTH] ;
+    char mac_string[32] ;
+    unsigned int i , k , n , found , ranged = 0 ;
+    unsigned int retries = options ? options->retries : FTM_SESSION_RETRIES ;
+    ftm_session_t *s ;
+    int64_t start_us = esp_timer_get_time() ;
+    int64_t format_us ;
+    uint32_t scan_ms ;
+
+    if (!ftm_check_parameters(count, burst_period, options, callback))
+        return 0 ;
+
+    if (!(records = pool_alloc_or_heap(FTM_ALL_MAX_RESPONDERS * sizeof(wifi_ap_record_t))))
     {
-        sprintf(line,"Invalid Burst Period! Valid range is 2-255") ;
-        tool_log(TAG, line, 1, ftm_callback) ;        
+        sprintf(line,"Failed to alloc buffer for the FTM responders") ;
+        tool_log(TAG, line, 1, callback) ;
         return 0 ;
     }
 
-    // START FTM QUERY 
-    sprintf(line,"Requesting FTM session with Frm Count - %d, Burst Period - %dmSec (0: No Preference)",
-                 ftmi_cfg.frm_count, ftmi_cfg.burst_period*100) ;
-    tool_log(TAG, line, 0, ftm_callback) ;                 
+    // ONE FULL SCAN , FTM RESPONDERS IN CHANNEL ORDER
+    tool_perform_scan(0, true, 0, 0) ;
+    found = tool_ftm_responders(records, FTM_ALL_MAX_RESPONDERS) ;
+
+    for (i = 0, n = 0; i < found; i++)
+    {
+        if (records[i].rssi >= min_rssi) records[n++] = records[i] ;
+    }
 
+    scan_ms = (uint32_t) ((esp_timer_get_time() - start_us) / 1000) ;
+    if (timing) timing->lookup_us += (uint32_t) (esp_timer_get_time() - start_us) ;
 
-    if (ESP_OK != esp_wifi_ftm_initiate_session(&ftmi_cfg)) 
+    sprintf(line,"FTM All - %u FTM responders (%u found , RSSI >= %d dBm) , Frm Count - %u, Burst Period - %umSec , Scan %u mSec",
+                 n, found, min_rssi, count, burst_period * 100, scan_ms) ;
+    tool_log(TAG, line, 0, callback) ;
+    if (flush) flush() ;
+
+    // FILL THE PIPELINE
+    for (k = 0; (k < FTM_ALL_PIPELINE_DEPTH) && (k < n); k++)
     {
-        sprintf(line,"Failed to start FTM session") ;
-        tool_log(TAG, line, 1, ftm_callback) ;        
-        return 0 ;
+        ftm_session_setup(&session[k], records[k].bssid, records[k].primary, count, burst_period, options, 0) ;
+        ftm_session_start(&session[k]) ;
     }
 
-    bits = xEventGroupWaitBits(ftm_event_group, FTM_REPORT_BIT | FTM_FAILURE_BIT,
-                               pdFALSE, pdFALSE, xMaxTicksToWait) ;
+    for (i = 0; i < n; i++)
+    {
+        s = &session[i % FTM_ALL_PIPELINE_DEPTH] ;
 
-    /* Processing data from FTM session */
-    if (bits & FTM_REPORT_BIT) 
-    {
-        ftm_process_report() ;
-        free(g_ftm_report) ;
-        g_ftm_report = NULL ;
-        g_ftm_report_num_entries = 0 ;
-        sprintf(line,"Estimated RTT - %d nSec, Estimated Distance - %d.%02d meters",
-                    g_rtt_est, g_dist_est / 100, g_dist_est % 100) ;
-        tool_log(TAG, line, 0, ftm_callback) ;                    
-
-        xEventGroupClearBits(ftm_event_group, FTM_REPORT_BIT) ;
-        return 1 ;
-    } 
-    else 
+        ftm_session_wait(s) ;
+        while ( (s->outcome != FTM_SESSION_REPORT) && (s->attempts <= retries) )
+        {
+            ftm_session_start(s) ;
+            ftm_session_wait(s) ;
+        }
+
+        format_us = esp_timer_get_time() ;
+
+        result[i].outcome = s->outcome ;
+        result[i].status = s->status ;
+        result[i].attempts = s->attempts ;
+        result[i].dist_cm = s->estimate.used ? s->estimate.dist_cm : (float) s->dist_est ;
+        result[i].sem_cm = s->estimate.used ? s->estimate.sem_cm : 0.0f ;
+        if (timing)
+        {
+            timing->queued_us += s->timing.queued_us ;
+            timing->air_us += s->timing.air_us ;
+        }
+        ftm_session_release(s) ;
+
+        // NEXT RESPONDER IN THE FREED SLOT
+        if (i + FTM_ALL_PIPELINE_DEPTH < n)
+        {
+            k = i + FTM_ALL_PIPELINE_DEPTH ;
+            ftm_session_setup(s, records[k].bssid, records[k].primary, count, burst_period, options, 0) ;
+            ftm_session_start(s) ;
+        }
+
+        // SUMMARY OF THIS RESPONDER ( while the next session runs )
+        tool_array_to_mac_string(mac_string, records[i].bssid) ;
+        if (result[i].outcome == FTM_SESSION_REPORT)
+        {
+            ranged++ ;
+            sprintf(line,"FTM All - %u/%u %s (%s) ch %u rssi %d : Distance - %.2f meters, Precision - %.2f cm, Attempts - %u",
+                         i + 1, n, records[i].ssid, mac_string, records[i].primary, records[i].rssi,
+                         result[i].dist_cm / 100.0f, result[i].sem_cm, result[i].attempts) ;
+        }
+        else
+        {
+            sprintf(line,"FTM All - %u/%u %s (%s) ch %u rssi %d : %s (Status - %u, %s), Attempts - %u",
+                         i + 1, n, records[i].ssid, mac_string, records[i].primary, records[i].rssi,
+                         (result[i].outcome == FTM_SESSION_TIMEOUT) ? "Timeout" :
+                         (result[i].outcome == FTM_SESSION_START_FAILED) ? "Start Failure" : "Failure",
+                         result[i].status, ftm_status_string(result[i].status), result[i].attempts) ;
+        }
+        tool_log(TAG, line, 0, callback) ;
+
+        if (timing) timing->format_us += (uint32_t) (esp_timer_get_time() - format_us) ;
+
+        if (flush) flush() ;
+    }
+
+    // FINAL TABLE
+    format_us = esp_timer_get_time() ;
+
+    sprintf(line,"FTM All Report:") ;
+    tool_log(TAG, line, 0, callback) ;
+    sprintf(line,"|  #  | Ch | RSSI |        MAC        | Distance (m) | Precision (cm) | Attempts |   Status   | SSID") ;
+    tool_log(TAG, line, 0, callback) ;
+
+    for (i = 0; i < n; i++)
     {
-        /* Failure case */
-        if (bits & FTM_FAILURE_BIT)
+        tool_array_to_mac_string(mac_string, records[i].bssid) ;
+        if (result[i].outcome == FTM_SESSION_REPORT)
         {
-            sprintf(line,"FTM Failure") ;
+            sprintf(line,"| %3u | %2u | %4d | %s | %12.2f | %14.2f | %8u | %-10s | %s",
+                         i + 1, records[i].primary, records[i].rssi, mac_string,
+                         result[i].dist_cm / 100.0f, result[i].sem_cm, result[i].attempts,
+                         ftm_status_string(result[i].status), records[i].ssid) ;
         }
         else
         {
-            sprintf(line,"FTM Timeout") ;            
-        }    
-        tool_log(TAG, line, 0, ftm_callback) ;        
+            sprintf(line,"| %3u | %2u | %4d | %s | %12s | %14s | %8u | %-10s | %s",
+                         i + 1, records[i].primary, records[i].rssi, mac_string, "-", "-", result[i].attempts,
+                         (result[i].outcome == FTM_SESSION_TIMEOUT) ? "timeout" : ftm_status_string(result[i].status),
+                         records[i].ssid) ;
+        }
+        tool_log(TAG, line, 0, callback) ;
     }
 
-    return 0 ;
+    sprintf(line,"FTM All Complete - %u/%u responders in %u mSec", ranged, n,
+                 (unsigned int) ((esp_timer_get_time() - start_us) / 1000)) ;
+    tool_log(TAG, line, 0, callback) ;
+
+    if (timing) timing->format_us += (uint32_t) (esp_timer_get_time() - format_us) ;
+
+    pool_free(records) ;
+
+    return ranged ;
 }
 
 
@@ -298,7 +1184,21 @@ int ftm_query_by_mac(unsigned char *mac, unsigned int channel,
 //
 void ftm_init(void)
 {
+    TaskHandle_t task ;
+
     ftm_event_group = xEventGroupCreate() ; 
-    ftm_callback = 0 ;
-}
+    ftm_session_queue = xQueueCreate(FTM_SESSION_QUEUE_LENGTH, sizeof(ftm_session_t *)) ;
+    ftm_active_session = 0 ;
 
+    // RECENT RESULT CACHE
+    cache_init() ;
+
+    // SESSION REPORTS ( completed on the driver event task , the session task is waiting )
+    bus_subscribe(BUS_MASK(BUS_FTM_REPORT), BUS_INLINE, ftm_event_handler, NULL) ;
+
+    // CREATE FTM SESSION TASK
+    if (xTaskCreate(ftm_task, "ftm_session", 8192, (void*) 0, 6, &task) == pdPASS)
+    {
+        metrics_register_task(task) ;
+    }
+}
@@ -37,15 +37,98 @@
     extern "C" {
     #endif
 
-        extern void ftm_event_handler(void *arg, esp_event_base_t event_base,
-                                      int32_t event_id, void *event_data) ;
-        extern void ftm_process_report(void) ;
+        #include "freertos/FreeRTOS.h"      // { SemaphoreHandle_t }
+        #include "freertos/semphr.h"
+        #include "esp_wifi.h"               // { wifi_ftm_report_entry_t }
+        #include "rtt.h"                    // { rtt_estimate_t }
+        #include "tool.h"                   // { tool_timing_t }
+        #include "bus.h"                    // { bus_event_t }
+
+        // SESSION OUTCOME
+        #define FTM_SESSION_PENDING          0
+        #define FTM_SESSION_REPORT           1      // report received (driver status FTM_STATUS_SUCCESS)
+        #define FTM_SESSION_FAILURE          2      // report received with a failure status
+        #define FTM_SESSION_TIMEOUT          3      // no report before the session deadline
+        #define FTM_SESSION_START_FAILED     4      // esp_wifi_ftm_initiate_session() refused the session
+
+        #define FTM_FIELD_DIAG               0x01   // report columns ( "fields" )
+        #define FTM_FIELD_RTT                0x02
+        #define FTM_FIELD_T1T2T3T4           0x04
+        #define FTM_FIELD_RSSI               0x08
+        #define FTM_FIELD_ALL                0x0F
+        #define FTM_FIELDS_DEFAULT           -1     // columns set by the "log" command
+
+        #define FTM_MAX_PRECISION_CM         1000   // adaptive mode precision targets ( 1 - 1000 cm , 0 : fixed frame count )
+        #define FTM_MAX_AGE_MS               600000 // oldest cached result a request may accept ( 0 - 10 minutes )
+
+        //
+        // Per-request session options ( deadline, retries, backoff, adaptive precision target and cache freshness )
+        //
+        typedef struct {
+            unsigned int  timeout_ms ;                      // deadline of each attempt
+            unsigned int  retries ;                         // additional attempts after a failure or timeout
+            unsigned int  backoff_ms ;                      // delay before the first retry ( doubled at every retry )
+            unsigned int  precision_cm ;                    // adaptive mode precision target ( 0 : fixed frame count )
+            unsigned int  max_age_ms ;                      // accept a cached result up to this age ( 0 : always measure )
+            unsigned int  timing ;                          // append a latency breakdown footer to the response
+            int           fields ;                          // report columns ( FTM_FIELD_xxx , 0 : summary only )
+        } ftm_options_t ;
+
+        //
+        // FTM session context ( parameters, results, output callback and completion signal )
+        //
+        typedef struct {
+            // PARAMETERS
+            unsigned char mac[6] ;
+            unsigned int  channel ;
+            unsigned int  count ;
+            unsigned int  burst_period ;
+            ftm_options_t options ;
+            // RESULTS
+            unsigned int  outcome ;
+            unsigned int  attempts ;                        // attempts performed ( including the successful one )
+            unsigned int  status ;                          // wifi_event_ftm_report_t status
+            uint32_t      rtt_raw ;                         // nano-seconds
+            uint32_t      rtt_est ;                         // nano-seconds
+            uint32_t      dist_est ;                        // centi-meters
+            wifi_ftm_report_entry_t *report ;               // report entries ( released by ftm_session_release() )
+            unsigned int  report_num_entries ;
+            rtt_estimate_t estimate ;                       // drift-corrected RTT from the T1..T4 timestamps
+            tool_timing_t timing ;                          // queue and air time ( every attempt )
+            int64_t       queued_at_us ;                    // last time the session was queued
+            wifi_event_ftm_report_t *replay ;               // recorded driver event posted instead of a driver session
+            // OUTPUT
+            void (*callback)(unsigned char *buffer, unsigned int len) ;
+            // COMPLETION
+            SemaphoreHandle_t done ;
+            StaticSemaphore_t done_buffer ;
+        } ftm_session_t ;
+
+        extern void ftm_event_handler(const bus_event_t *event, void *arg) ;
+        extern void ftm_process_report(ftm_session_t *session) ;
+        extern void ftm_options_default(ftm_options_t *options) ;
+        extern const char *ftm_status_string(unsigned int status) ;
+        extern void ftm_set_report_level(int level, void (*callback)(unsigned char *buffer, unsigned int len)) ;
+        extern void ftm_session_setup(ftm_session_t *session, unsigned char *mac, unsigned int channel,
+                                      unsigned int count, unsigned int burst_period, const ftm_options_t *options,
+                                      void (*callback)(unsigned char *buffer, unsigned int len)) ;
+        extern unsigned int ftm_session_run(ftm_session_t *session) ;
+        extern void ftm_session_release(ftm_session_t *session) ;
+        extern unsigned int ftm_replay_report(wifi_event_ftm_report_t *event, const ftm_options_t *options,
+                                              tool_timing_t *timing,
+                                              void (*callback)(unsigned char *buffer, unsigned int len)) ;
         extern int  ftm_query_by_ssid(const char *ssid, unsigned int count, unsigned int burst_period,
+                                      const ftm_options_t *options, tool_timing_t *timing,
                                       void (*callback)(unsigned char *buffer, unsigned int len)) ;
 
         extern int  ftm_query_by_mac(unsigned char *mac, unsigned int channel,
                                      unsigned int count, unsigned int burst_period,
+                                     const ftm_options_t *options, tool_timing_t *timing,
                                      void (*callback)(unsigned char *buffer, unsigned int len)) ;                              
+        extern int  ftm_query_all(unsigned int count, unsigned int burst_period, int min_rssi,
+                                  const ftm_options_t *options, tool_timing_t *timing,
+                                  void (*callback)(unsigned char *buffer, unsigned int len),
+                                  void (*flush)(void)) ;
         extern void ftm_init(void) ;
 
     #ifdef __cplusplus
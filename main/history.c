@@ -0,0 +1,424 @@
+/*
+    history.c - Ranging History
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+//
+// Fixed-size ring of recent FTM session summaries, stored as a structure of
+// arrays : queries scan only the time and BSSID columns, and formatting touches
+// the remaining columns of matching records only. Responder MACs are interned
+// in a small BSSID table, so each record keeps a single byte index.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "tool.h"
+#include "pool.h"
+#include "history.h"
+
+#define HISTORY_LINE_BUFFER_LENGTH      HISTORY_LINE_LENGTH
+#define HISTORY_INVALID_BSSID           0xFF
+
+#define HISTORY_BINARY_MAGIC            "CHRH"
+#define HISTORY_BINARY_VERSION          1
+
+static const char *TAG = "history" ;
+
+static struct {
+    // RECORD COLUMNS
+    uint32_t      seq[HISTORY_LENGTH] ;
+    uint32_t      time_ms[HISTORY_LENGTH] ;
+    uint8_t       bssid[HISTORY_LENGTH] ;
+    uint8_t       status[HISTORY_LENGTH] ;
+    uint8_t       entries[HISTORY_LENGTH] ;
+    uint32_t      rtt_ns[HISTORY_LENGTH] ;
+    uint32_t      dist_cm[HISTORY_LENGTH] ;
+    float         rtt_ps[HISTORY_LENGTH] ;
+    float         std_cm[HISTORY_LENGTH] ;
+    int8_t        rssi_mean[HISTORY_LENGTH] ;
+    int8_t        rssi_min[HISTORY_LENGTH] ;
+    int8_t        rssi_max[HISTORY_LENGTH] ;
+    // BSSID TABLE
+    unsigned char bssids[HISTORY_MAX_BSSIDS][6] ;
+    uint32_t      bssid_last_ms[HISTORY_MAX_BSSIDS] ;
+    unsigned int  bssid_count ;
+    // RING CONTROL
+    unsigned int  head ;            // next slot to be written
+    unsigned int  count ;           // valid records
+    uint32_t      next_seq ;
+} history_control ;
+
+static SemaphoreHandle_t history_mutex ;
+
+// FUNCTION PROTOTYPES
+void history_init(void) ;
+void history_append(history_record_t *record) ;
+unsigned int history_query(const history_query_t *query,
+                           void (*callback)(unsigned char *buffer, unsigned int len)) ;
+unsigned int history_pack(const history_record_t *record, unsigned char *buffer) ;
+unsigned int history_format(const history_record_t *record, char *line) ;
+float history_spread(uint32_t from_ms, uint32_t to_ms, unsigned int *sessions) ;
+static uint8_t history_bssid_index(const unsigned char *mac, uint32_t now_ms) ;
+static int history_find_bssid(const unsigned char *mac) ;
+static unsigned int history_match(unsigned int pos, const history_query_t *query, int bssid) ;
+static void history_get(unsigned int pos, history_record_t *record) ;
+
+//
+// Index of a BSSID in the BSSID table ( -1 if unknown )
+//
+static int history_find_bssid(const unsigned char *mac)
+{
+    unsigned int k ;
+
+    for (k=0; k<history_control.bssid_count; k++)
+    {
+        if (!memcmp(history_control.bssids[k], mac, 6))
+            return k ;
+    }
+    return -1 ;
+}
+
+//
+// Intern a BSSID ( the least recently seen entry is recycled when the table is full )
+//
+static uint8_t history_bssid_index(const unsigned char *mac, uint32_t now_ms)
+{
+    unsigned int k, oldest = 0 ;
+    int index = history_find_bssid(mac) ;
+
+    if (index < 0)
+    {
+        if (history_control.bssid_count < HISTORY_MAX_BSSIDS)
+        {
+            index = history_control.bssid_count++ ;
+        }
+        else
+        {
+            for (k=1; k<HISTORY_MAX_BSSIDS; k++)
+            {
+                if (history_control.bssid_last_ms[k] < history_control.bssid_last_ms[oldest]) oldest = k ;
+            }
+            index = oldest ;
+
+            // records of the recycled responder lose their BSSID
+            for (k=0; k<HISTORY_LENGTH; k++)
+            {
+                if (history_control.bssid[k] == index) history_control.bssid[k] = HISTORY_INVALID_BSSID ;
+            }
+        }
+        memcpy(history_control.bssids[index], mac, 6) ;
+    }
+
+    history_control.bssid_last_ms[index] = now_ms ;
+
+    return (uint8_t) index ;
+}
+
+//
+// Append a session summary ( the oldest record is overwritten when the ring is full )
+//
+// record->seq and record->time_ms are assigned here
+//
+void history_append(history_record_t *record)
+{
+    unsigned int pos ;
+    uint32_t now_ms = (uint32_t) (esp_timer_get_time() / 1000) ;
+
+    xSemaphoreTake(history_mutex, portMAX_DELAY) ;
+
+    pos = history_control.head ;
+
+    record->seq = history_control.next_seq++ ;
+    record->time_ms = now_ms ;
+
+    history_control.seq[pos] = record->seq ;
+    history_control.time_ms[pos] = record->time_ms ;
+    history_control.bssid[pos] = history_bssid_index(record->mac, now_ms) ;
+    history_control.status[pos] = record->status ;
+    history_control.entries[pos] = record->entries ;
+    history_control.rtt_ns[pos] = record->rtt_ns ;
+    history_control.dist_cm[pos] = record->dist_cm ;
+    history_control.rtt_ps[pos] = record->rtt_ps ;
+    history_control.std_cm[pos] = record->std_cm ;
+    history_control.rssi_mean[pos] = record->rssi_mean ;
+    history_control.rssi_min[pos] = record->rssi_min ;
+    history_control.rssi_max[pos] = record->rssi_max ;
+
+    history_control.head = (pos + 1) % HISTORY_LENGTH ;
+    if (history_control.count < HISTORY_LENGTH) history_control.count++ ;
+
+    xSemaphoreGive(history_mutex) ;
+}
+
+//
+// Check a record against a query ( only the seq, time and BSSID columns are touched )
+//
+static unsigned int history_match(unsigned int pos, const history_query_t *query, int bssid)
+{
+    if (query->filter_mac && (history_control.bssid[pos] != bssid))
+        return 0 ;
+    if (query->since_seq && (history_control.seq[pos] <= query->since_seq))
+        return 0 ;
+    if (history_control.time_ms[pos] < query->from_ms)
+        return 0 ;
+    if (query->to_ms && (history_control.time_ms[pos] > query->to_ms))
+        return 0 ;
+    return 1 ;
+}
+
+//
+// Gather the columns of a record
+//
+static void history_get(unsigned int pos, history_record_t *record)
+{
+    uint8_t bssid = history_control.bssid[pos] ;
+
+    record->seq = history_control.seq[pos] ;
+    record->time_ms = history_control.time_ms[pos] ;
+    if (bssid == HISTORY_INVALID_BSSID)
+    {
+        memset(record->mac, 0, 6) ;
+    }
+    else
+    {
+        memcpy(record->mac, history_control.bssids[bssid], 6) ;
+    }
+    record->status = history_control.status[pos] ;
+    record->entries = history_control.entries[pos] ;
+    record->rtt_ns = history_control.rtt_ns[pos] ;
+    record->dist_cm = history_control.dist_cm[pos] ;
+    record->rtt_ps = history_control.rtt_ps[pos] ;
+    record->std_cm = history_control.std_cm[pos] ;
+    record->rssi_mean = history_control.rssi_mean[pos] ;
+    record->rssi_min = history_control.rssi_min[pos] ;
+    record->rssi_max = history_control.rssi_max[pos] ;
+}
+
+//
+// Serialize a record ( little endian, HISTORY_BINARY_RECORD_SIZE bytes )
+//
+unsigned int history_pack(const history_record_t *record, unsigned char *buffer)
+{
+    unsigned char *p = buffer ;
+
+    memcpy(p, &record->seq, 4) ;        p += 4 ;
+    memcpy(p, &record->time_ms, 4) ;    p += 4 ;
+    memcpy(p, record->mac, 6) ;         p += 6 ;
+    *p++ = record->status ;
+    *p++ = record->entries ;
+    memcpy(p, &record->rtt_ns, 4) ;     p += 4 ;
+    memcpy(p, &record->dist_cm, 4) ;    p += 4 ;
+    memcpy(p, &record->rtt_ps, 4) ;     p += 4 ;
+    memcpy(p, &record->std_cm, 4) ;     p += 4 ;
+    *p++ = (unsigned char) record->rssi_mean ;
+    *p++ = (unsigned char) record->rssi_min ;
+    *p++ = (unsigned char) record->rssi_max ;
+    *p++ = 0 ;                          // padding
+
+    return (unsigned int) (p - buffer) ;
+}
+
+//
+// Query the history ( records are emitted from the oldest to the newest )
+//
+// max_records keeps the newest matching records. The records are copied out of the
+// ring first : the output may block , and history_append() must not wait for it.
+//
+// NDJSON : a header line {"history":<count>,...} followed by one JSON object per record
+// BINARY : "CHRH" , version (u16) , record size (u16) , count (u32) , packed records
+//
+// returns the number of records emitted
+//
+unsigned int history_query(const history_query_t *query,
+                           void (*callback)(unsigned char *buffer, unsigned int len))
+{
+    char line[HISTORY_LINE_BUFFER_LENGTH] ;
+    unsigned char packed[HISTORY_BINARY_RECORD_SIZE] ;
+    history_record_t *records = 0 ;
+    unsigned int k, pos, newest, first = 0, total = 0, copied = 0 ;
+    uint32_t now_ms = (uint32_t) (esp_timer_get_time() / 1000) ;
+    uint32_t next_seq ;
+    int bssid = -1 ;
+
+    if (!callback)
+        return 0 ;
+
+    if (query->invalid)
+    {
+        sprintf(line, "Invalid History Query! Malformed MAC address") ;
+        tool_log(TAG, line, 1, callback) ;
+        return 0 ;
+    }
+
+    xSemaphoreTake(history_mutex, portMAX_DELAY) ;
+
+    if (query->filter_mac)
+    {
+        bssid = history_find_bssid(query->mac) ;
+    }
+
+    newest = (history_control.head + HISTORY_LENGTH - 1) % HISTORY_LENGTH ;
+
+    // [ MATCHING RECORDS , FROM THE NEWEST ( first : age of the oldest one kept ) ]
+    if ( !query->filter_mac || (bssid >= 0) )
+    {
+        for (k=0; k<history_control.count; k++)
+        {
+            if (history_match((newest + HISTORY_LENGTH - k) % HISTORY_LENGTH, query, bssid))
+            {
+                first = k ;
+                total++ ;
+                if (query->max_records && (total == query->max_records))
+                    break ;
+            }
+        }
+    }
+
+    // [ COPY , FROM THE OLDEST ]
+    if (total && !(records = pool_alloc_or_heap(total * sizeof(history_record_t))))
+    {
+        xSemaphoreGive(history_mutex) ;
+        sprintf(line, "Failed to alloc buffer for %u history records", total) ;
+        tool_log(TAG, line, 1, callback) ;
+        return 0 ;
+    }
+
+    for (k=first+1; (k-- > 0) && (copied < total); )
+    {
+        pos = (newest + HISTORY_LENGTH - k) % HISTORY_LENGTH ;
+        if (history_match(pos, query, bssid))
+        {
+            history_get(pos, &records[copied++]) ;
+        }
+    }
+    next_seq = history_control.next_seq ;
+
+    xSemaphoreGive(history_mutex) ;
+
+    // [ HEADER ]
+    if (query->format == HISTORY_FORMAT_BINARY)
+    {
+        uint16_t version = HISTORY_BINARY_VERSION, size = HISTORY_BINARY_RECORD_SIZE ;
+        uint32_t count = copied ;
+
+        memcpy(&packed[0], HISTORY_BINARY_MAGIC, 4) ;
+        memcpy(&packed[4], &version, 2) ;
+        memcpy(&packed[6], &size, 2) ;
+        memcpy(&packed[8], &count, 4) ;
+        callback(packed, 12) ;
+    }
+    else
+    {
+        sprintf(line, "{\"history\":%u,\"now\":%u,\"next_seq\":%u}\n",
+                      copied, now_ms, next_seq) ;
+        callback((unsigned char *) line, strlen(line)) ;
+    }
+
+    // [ RECORDS ]
+    for (k=0; k<copied; k++)
+    {
+        if (query->format == HISTORY_FORMAT_BINARY)
+        {
+            callback(packed, history_pack(&records[k], packed)) ;
+        }
+        else
+        {
+            callback((unsigned char *) line, history_format(&records[k], line)) ;
+        }
+    }
+
+    pool_free(records) ;
+
+    ESP_LOGI(TAG, "history query : %u records", copied) ;
+
+    return copied ;
+}
+
+//
+// Mean per-exchange distance spread ( std_cm ) of the successful sessions ( status 0 ,
+// two entries at least ) completed between <from_ms> and <to_ms> ( 0 : up to now )
+//
+// returns 0 if no session matches ( <sessions> is set to the number of sessions )
+//
+float history_spread(uint32_t from_ms, uint32_t to_ms, unsigned int *sessions)
+{
+    unsigned int k, pos, n = 0 ;
+    float sum = 0.0f ;
+
+    xSemaphoreTake(history_mutex, portMAX_DELAY) ;
+
+    pos = (history_control.head + HISTORY_LENGTH - history_control.count) % HISTORY_LENGTH ;
+
+    for (k=0; k<history_control.count; k++, pos = (pos + 1) % HISTORY_LENGTH)
+    {
+        if ( (history_control.time_ms[pos] < from_ms) || (to_ms && (history_control.time_ms[pos] > to_ms)) )
+            continue ;
+        if ( (history_control.status[pos] != 0) || (history_control.entries[pos] < 2) )
+            continue ;
+
+        sum += history_control.std_cm[pos] ;
+        n++ ;
+    }
+
+    xSemaphoreGive(history_mutex) ;
+
+    if (sessions) *sessions = n ;
+
+    return n ? sum / n : 0.0f ;
+}
+
+//
+// Format a record as an NDJSON line ( <line> holds HISTORY_LINE_LENGTH bytes )
+//
+unsigned int history_format(const history_record_t *record, char *line)
+{
+    char mac_string[32] ;
+
+    tool_array_to_mac_string(mac_string, (unsigned char *) record->mac) ;
+
+    return sprintf(line, "{\"seq\":%u,\"t\":%u,\"mac\":\"%s\",\"status\":%u,\"entries\":%u,"
+                         "\"rtt_ns\":%u,\"dist_cm\":%u,\"rtt_ps\":%.1f,\"std_cm\":%.2f,"
+                         "\"rssi\":%d,\"rssi_min\":%d,\"rssi_max\":%d}\n",
+                         record->seq, record->time_ms, mac_string, record->status, record->entries,
+                         record->rtt_ns, record->dist_cm, record->rtt_ps, record->std_cm,
+                         record->rssi_mean, record->rssi_min, record->rssi_max) ;
+}
+
+//
+// History Initialization
+//
+void history_init(void)
+{
+    memset(&history_control, 0, sizeof(history_control)) ;
+    history_control.next_seq = 1 ;
+    history_mutex = xSemaphoreCreateMutex() ;
+}
@@ -0,0 +1,96 @@
+/*
+    history.h - Ranging History
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+#ifndef _HISTORY_H
+
+#define _HISTORY_H	1
+
+    #ifdef __cplusplus
+    extern "C" {
+    #endif
+
+        #include <stdint.h>
+
+        #define HISTORY_LENGTH              CONFIG_ESP_HISTORY_LENGTH
+        #define HISTORY_MAX_BSSIDS          CONFIG_ESP_HISTORY_MAX_BSSIDS
+
+        #define HISTORY_FORMAT_NDJSON       0
+        #define HISTORY_FORMAT_BINARY       1
+
+        #define HISTORY_BINARY_RECORD_SIZE  36              // size of a packed record
+        #define HISTORY_LINE_LENGTH         256             // NDJSON record ( history_format() )
+
+        //
+        // Session summary ( a single history record )
+        //
+        typedef struct {
+            uint32_t      seq ;             // record sequence number ( monotonic )
+            uint32_t      time_ms ;         // completion time ( milli-seconds since boot )
+            unsigned char mac[6] ;          // responder BSSID
+            uint8_t       status ;          // wifi_event_ftm_report_t status
+            uint8_t       entries ;         // entries kept by the RTT estimator
+            uint32_t      rtt_ns ;          // driver estimated RTT
+            uint32_t      dist_cm ;         // driver estimated distance
+            float         rtt_ps ;          // drift-corrected RTT
+            float         std_cm ;          // per-exchange distance standard deviation
+            int8_t        rssi_mean ;
+            int8_t        rssi_min ;
+            int8_t        rssi_max ;
+        } history_record_t ;
+
+        //
+        // History query
+        //
+        typedef struct {
+            unsigned char mac[6] ;
+            unsigned int  filter_mac ;      // 0 : every responder
+            uint32_t      from_ms ;
+            uint32_t      to_ms ;           // 0 : up to now
+            uint32_t      since_seq ;       // only records with seq > since_seq
+            unsigned int  max_records ;     // 0 : no limit
+            unsigned int  format ;          // HISTORY_FORMAT_NDJSON / HISTORY_FORMAT_BINARY
+            unsigned int  invalid ;         // malformed filter ( the query is rejected )
+        } history_query_t ;
+
+        extern void history_init(void) ;
+        extern void history_append(history_record_t *record) ;
+        extern unsigned int history_format(const history_record_t *record, char *line) ;
+        extern unsigned int history_pack(const history_record_t *record, unsigned char *buffer) ;
+        extern float history_spread(uint32_t from_ms, uint32_t to_ms, unsigned int *sessions) ;
+        extern unsigned int history_query(const history_query_t *query,
+                                          void (*callback)(unsigned char *buffer, unsigned int len)) ;
+
+    #ifdef __cplusplus
+    }
+    #endif
+
+#endif
+
+
@@ -0,0 +1,565 @@
+/*
+    journal.c - Flash-Backed Measurement Journal
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+//
+// Append-only log of FTM session summaries on a dedicated data partition.
+//
+// The partition is used as a ring of 4 KB sectors. Every sector starts with a
+// header ( magic , sequence number , boot id ) followed by CRC-protected frames,
+// and frames never span two sectors. Frames are staged in a RAM image of the
+// current sector, which is programmed in a single write once it's full ; a
+// partial block is programmed when the flush interval expires ( checked on every
+// append and by the journal_flush task , so an idle journal is flushed as well )
+// or on demand. Sectors are erased right before they are entered.
+//
+// Export reads the partition through esp_partition_mmap(), so a dump goes
+// straight from flash to the socket without any RAM staging.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "tool.h"
+#include "history.h"
+#include "metrics.h"
+#include "journal.h"
+
+#define JOURNAL_FLUSH_INTERVAL_MS       (CONFIG_ESP_JOURNAL_FLUSH_INTERVAL_S * 1000)
+#define JOURNAL_FLUSH_CHECK_MS          1000        // journal_flush task period
+
+#define JOURNAL_SECTOR_SIZE             4096
+#define JOURNAL_MMAP_WINDOW             0x10000                 // export mapping window ( 64 KB MMU page )
+#define JOURNAL_LINE_BUFFER_LENGTH      256
+
+#define JOURNAL_SECTOR_MAGIC            0x534A4843              // "CHJS"
+#define JOURNAL_FRAME_MAGIC             0xA55A
+#define JOURNAL_EXPORT_MAGIC            "CHRJ"
+#define JOURNAL_EXPORT_VERSION          1
+
+#define JOURNAL_SECTOR_HEADER_SIZE      12
+#define JOURNAL_FRAME_HEADER_SIZE       12
+#define JOURNAL_FRAME_SIZE              (JOURNAL_FRAME_HEADER_SIZE + HISTORY_BINARY_RECORD_SIZE)
+#define JOURNAL_FRAMES_PER_SECTOR       ((JOURNAL_SECTOR_SIZE - JOURNAL_SECTOR_HEADER_SIZE) / JOURNAL_FRAME_SIZE)
+
+typedef struct {
+    uint32_t magic ;
+    uint32_t seq ;                  // sector sequence number ( incremented on every sector change )
+    uint16_t boot_id ;              // boot that entered the sector
+    uint16_t reserved ;
+} journal_sector_header_t ;
+
+typedef struct {
+    uint16_t magic ;
+    uint16_t length ;               // payload length ( 0 : end of export )
+    uint16_t boot_id ;              // boot that appended the frame
+    uint16_t reserved ;
+    uint32_t crc ;                  // CRC32 of the first 8 header bytes and the payload
+} journal_frame_header_t ;
+
+static const char *TAG = "journal" ;
+
+static struct {
+    const esp_partition_t *partition ;      // 0 : journal disabled
+    unsigned int  sectors ;                 // number of sectors in the partition
+    unsigned int  sector ;                  // current sector
+    uint32_t      sector_seq ;              // sequence number of the current sector
+    unsigned int  offset ;                  // bytes used in the current sector
+    unsigned int  flushed ;                 // bytes of the current sector already programmed
+    uint16_t      boot_id ;
+    uint32_t      last_flush_ms ;
+    uint32_t      appended ;                // frames appended since boot
+    uint32_t      writes ;                  // flash program operations since boot
+    uint32_t      erases ;                  // sector erase operations since boot
+    uint32_t      errors ;                  // failed flash operations since boot
+    unsigned char image[JOURNAL_SECTOR_SIZE] ;  // RAM image of the current sector
+} journal_control ;
+
+static SemaphoreHandle_t journal_mutex ;
+
+// FUNCTION PROTOTYPES
+void journal_init(void) ;
+void journal_append(const history_record_t *record) ;
+unsigned int journal_flush(void) ;
+unsigned int journal_erase(void) ;
+void journal_info(void (*callback)(unsigned char *buffer, unsigned int len)) ;
+unsigned int journal_export(void (*stream)(unsigned char *buffer, unsigned int len)) ;
+static uint32_t journal_crc(const unsigned char *header, const unsigned char *payload, unsigned int len) ;
+static unsigned int journal_frame_valid(const unsigned char *frame, unsigned int room, journal_frame_header_t *header) ;
+static unsigned int journal_sector_used(const unsigned char *sector, uint16_t *boot_id) ;
+static unsigned int journal_program(void) ;
+static void journal_enter_sector(unsigned int sector, uint32_t seq, unsigned int erase) ;
+static void journal_flush_task(void *pvParameters) ;
+
+//
+// Frame CRC ( first 8 header bytes , then the payload )
+//
+static uint32_t journal_crc(const unsigned char *header, const unsigned char *payload, unsigned int len)
+{
+    uint32_t crc = esp_rom_crc32_le(0, header, 8) ;
+
+    return (len) ? esp_rom_crc32_le(crc, payload, len) : crc ;
+}
+
+//
+// Check a frame stored at <frame> ( <room> bytes available up to the end of the sector )
+//
+static unsigned int journal_frame_valid(const unsigned char *frame, unsigned int room, journal_frame_header_t *header)
+{
+    if (room < JOURNAL_FRAME_SIZE)
+        return 0 ;
+
+    memcpy(header, frame, JOURNAL_FRAME_HEADER_SIZE) ;
+
+    if ( (header->magic != JOURNAL_FRAME_MAGIC) || (header->length != HISTORY_BINARY_RECORD_SIZE) )
+        return 0 ;
+
+    return (header->crc == journal_crc(frame, frame + JOURNAL_FRAME_HEADER_SIZE, header->length)) ;
+}
+
+//
+// Walk the frames of a sector image
+//
+// returns the offset of the first byte after the last valid frame
+// ( boot_id, if given, is raised to the highest boot id found )
+//
+static unsigned int journal_sector_used(const unsigned char *sector, uint16_t *boot_id)
+{
+    journal_frame_header_t header ;
+    unsigned int offset = JOURNAL_SECTOR_HEADER_SIZE ;
+
+    while (journal_frame_valid(sector + offset, JOURNAL_SECTOR_SIZE - offset, &header))
+    {
+        if (boot_id && (header.boot_id > *boot_id)) *boot_id = header.boot_id ;
+        offset += JOURNAL_FRAME_SIZE ;
+    }
+
+    return offset ;
+}
+
+//
+// Program the staged bytes of the current sector ( caller holds the mutex )
+//
+// Only the bytes appended since the previous program operation are written :
+// they land on an erased area, so no read-modify-write cycle is ever needed.
+//
+static unsigned int journal_program(void)
+{
+    unsigned int address = journal_control.sector * JOURNAL_SECTOR_SIZE ;
+    esp_err_t err ;
+
+    journal_control.last_flush_ms = (uint32_t) (esp_timer_get_time() / 1000) ;
+
+    if (journal_control.flushed >= journal_control.offset)
+        return 1 ;
+
+    err = esp_partition_write(journal_control.partition, address + journal_control.flushed,
+                              journal_control.image + journal_control.flushed,
+                              journal_control.offset - journal_control.flushed) ;
+    if (err != ESP_OK)
+    {
+        journal_control.errors++ ;
+        ESP_LOGE(TAG, "write failed at 0x%x (%s)", address + journal_control.flushed, esp_err_to_name(err)) ;
+        return 0 ;
+    }
+
+    journal_control.flushed = journal_control.offset ;
+    journal_control.writes++ ;
+
+    return 1 ;
+}
+
+//
+// Start a new sector ( caller holds the mutex )
+//
+static void journal_enter_sector(unsigned int sector, uint32_t seq, unsigned int erase)
+{
+    journal_sector_header_t header = {
+        .magic = JOURNAL_SECTOR_MAGIC,
+        .seq = seq,
+        .boot_id = journal_control.boot_id,
+        .reserved = 0xFFFF,
+    } ;
+    esp_err_t err ;
+
+    if (erase)
+    {
+        err = esp_partition_erase_range(journal_control.partition, sector * JOURNAL_SECTOR_SIZE, JOURNAL_SECTOR_SIZE) ;
+        if (err != ESP_OK)
+        {
+            journal_control.errors++ ;
+            ESP_LOGE(TAG, "erase failed on sector %u (%s)", sector, esp_err_to_name(err)) ;
+        }
+        journal_control.erases++ ;
+    }
+
+    memset(journal_control.image, 0xFF, JOURNAL_SECTOR_SIZE) ;
+    memcpy(journal_control.image, &header, JOURNAL_SECTOR_HEADER_SIZE) ;
+
+    journal_control.sector = sector ;
+    journal_control.sector_seq = seq ;
+    journal_control.offset = JOURNAL_SECTOR_HEADER_SIZE ;
+    journal_control.flushed = 0 ;
+}
+
+//
+// Append a session summary to the journal
+//
+void journal_append(const history_record_t *record)
+{
+    journal_frame_header_t header = {
+        .magic = JOURNAL_FRAME_MAGIC,
+        .length = HISTORY_BINARY_RECORD_SIZE,
+        .reserved = 0xFFFF,
+    } ;
+    unsigned char *frame ;
+    uint32_t now_ms ;
+
+    if (!journal_control.partition || !record)
+        return ;
+
+    xSemaphoreTake(journal_mutex, portMAX_DELAY) ;
+
+    // CURRENT SECTOR IS FULL : MOVE TO THE NEXT ONE ( THE OLDEST SECTOR IS RECYCLED )
+    if (journal_control.offset + JOURNAL_FRAME_SIZE > JOURNAL_SECTOR_SIZE)
+    {
+        journal_program() ;
+        journal_enter_sector((journal_control.sector + 1) % journal_control.sectors, journal_control.sector_seq + 1, 1) ;
+    }
+
+    // STAGE THE FRAME
+    frame = journal_control.image + journal_control.offset ;
+    header.boot_id = journal_control.boot_id ;
+    history_pack(record, frame + JOURNAL_FRAME_HEADER_SIZE) ;
+    header.crc = journal_crc((const unsigned char *) &header, frame + JOURNAL_FRAME_HEADER_SIZE, header.length) ;
+    memcpy(frame, &header, JOURNAL_FRAME_HEADER_SIZE) ;
+
+    journal_control.offset += JOURNAL_FRAME_SIZE ;
+    journal_control.appended++ ;
+
+    // PROGRAM THE WHOLE SECTOR ONCE IT'S FULL , OR THE PARTIAL BLOCK WHEN THE FLUSH INTERVAL EXPIRES
+    now_ms = (uint32_t) (esp_timer_get_time() / 1000) ;
+
+    if ( (journal_control.offset + JOURNAL_FRAME_SIZE > JOURNAL_SECTOR_SIZE) ||
+         ((now_ms - journal_control.last_flush_ms) >= JOURNAL_FLUSH_INTERVAL_MS) )
+    {
+        journal_program() ;
+    }
+
+    xSemaphoreGive(journal_mutex) ;
+}
+
+//
+// Program the staged frames now
+//
+unsigned int journal_flush(void)
+{
+    unsigned int ret ;
+
+    if (!journal_control.partition)
+        return 0 ;
+
+    xSemaphoreTake(journal_mutex, portMAX_DELAY) ;
+    ret = journal_program() ;
+    xSemaphoreGive(journal_mutex) ;
+
+    return ret ;
+}
+
+//
+// Program the partial sector once the flush interval expires , even if no record arrives
+//
+static void journal_flush_task(void *pvParameters)
+{
+    uint32_t now_ms ;
+
+    while (1)
+    {
+        vTaskDelay(JOURNAL_FLUSH_CHECK_MS / portTICK_PERIOD_MS) ;
+
+        xSemaphoreTake(journal_mutex, portMAX_DELAY) ;
+        now_ms = (uint32_t) (esp_timer_get_time() / 1000) ;
+        if ( (journal_control.flushed < journal_control.offset) &&
+             ((now_ms - journal_control.last_flush_ms) >= JOURNAL_FLUSH_INTERVAL_MS) )
+        {
+            journal_program() ;
+        }
+        xSemaphoreGive(journal_mutex) ;
+    }
+
+    vTaskDelete(NULL) ;
+}
+
+//
+// Erase the whole journal
+//
+unsigned int journal_erase(void)
+{
+    esp_err_t err ;
+
+    if (!journal_control.partition)
+        return 0 ;
+
+    xSemaphoreTake(journal_mutex, portMAX_DELAY) ;
+
+    err = esp_partition_erase_range(journal_control.partition, 0, journal_control.sectors * JOURNAL_SECTOR_SIZE) ;
+    if (err != ESP_OK)
+    {
+        journal_control.errors++ ;
+        ESP_LOGE(TAG, "erase failed (%s)", esp_err_to_name(err)) ;
+    }
+    journal_control.erases += journal_control.sectors ;
+
+    journal_enter_sector(0, 1, 0) ;
+    journal_program() ;
+
+    xSemaphoreGive(journal_mutex) ;
+
+    return (err == ESP_OK) ;
+}
+
+//
+// Report the journal state
+//
+void journal_info(void (*callback)(unsigned char *buffer, unsigned int len))
+{
+    char line[JOURNAL_LINE_BUFFER_LENGTH] ;
+
+    if (!journal_control.partition)
+    {
+        sprintf(line, "Journal - disabled") ;
+        tool_log(TAG, line, 0, callback) ;
+        return ;
+    }
+
+    xSemaphoreTake(journal_mutex, portMAX_DELAY) ;
+
+    sprintf(line, "Journal - Partition %s @ 0x%x , %u Sectors , %u Frames/Sector",
+                  journal_control.partition->label, journal_control.partition->address,
+                  journal_control.sectors, JOURNAL_FRAMES_PER_SECTOR) ;
+    tool_log(TAG, line, 0, callback) ;
+
+    sprintf(line, "Journal - Sector %u (seq %u) , Offset %u , Pending %u bytes",
+                  journal_control.sector, journal_control.sector_seq,
+                  journal_control.offset, journal_control.offset - journal_control.flushed) ;
+    tool_log(TAG, line, 0, callback) ;
+
+    sprintf(line, "Journal - Boot %u , Appended %u , Writes %u , Erases %u , Errors %u",
+                  journal_control.boot_id, journal_control.appended, journal_control.writes,
+                  journal_control.erases, journal_control.errors) ;
+    tool_log(TAG, line, 0, callback) ;
+
+    xSemaphoreGive(journal_mutex) ;
+}
+
+//
+// Export the journal ( from the oldest to the newest frame )
+//
+// "CHRJ" , version (u16) , record size (u16) , frames ( header + packed record ) ,
+// end frame ( header with length 0 )
+//
+// Sectors are read through 64 KB memory mapped windows and handed to <stream>
+// directly from flash.
+//
+// returns the number of frames exported
+//
+unsigned int journal_export(void (*stream)(unsigned char *buffer, unsigned int len))
+{
+    unsigned char preamble[8] ;
+    unsigned char end_frame[JOURNAL_FRAME_HEADER_SIZE] ;
+    journal_frame_header_t end = {
+        .magic = JOURNAL_FRAME_MAGIC,
+        .length = 0,
+        .reserved = 0xFFFF,
+    } ;
+    journal_sector_header_t header ;
+    spi_flash_mmap_handle_t handle = 0 ;
+    const void *window = 0 ;
+    unsigned int window_offset = 0 ;
+    unsigned int k, sector, address, used ;
+    unsigned int frames = 0 ;
+    uint16_t version = JOURNAL_EXPORT_VERSION ;
+    uint16_t record_size = HISTORY_BINARY_RECORD_SIZE ;
+    esp_err_t err ;
+
+    if (!journal_control.partition || !stream)
+        return 0 ;
+
+    xSemaphoreTake(journal_mutex, portMAX_DELAY) ;
+
+    // FLASH MUST HOLD EVERY FRAME
+    journal_program() ;
+
+    memcpy(preamble, JOURNAL_EXPORT_MAGIC, 4) ;
+    memcpy(preamble + 4, &version, 2) ;
+    memcpy(preamble + 6, &record_size, 2) ;
+    stream(preamble, sizeof(preamble)) ;
+
+    // OLDEST SECTOR FOLLOWS THE CURRENT ONE
+    for (k=1; k<=journal_control.sectors; k++)
+    {
+        sector = (journal_control.sector + k) % journal_control.sectors ;
+        address = sector * JOURNAL_SECTOR_SIZE ;
+
+        // MAP THE WINDOW HOLDING THE SECTOR
+        if (!window || (address < window_offset) || (address >= window_offset + JOURNAL_MMAP_WINDOW))
+        {
+            if (window) spi_flash_munmap(handle) ;
+
+            window_offset = address - (address % JOURNAL_MMAP_WINDOW) ;
+            err = esp_partition_mmap(journal_control.partition, window_offset,
+                                     MIN(JOURNAL_MMAP_WINDOW, journal_control.partition->size - window_offset),
+                                     SPI_FLASH_MMAP_DATA, &window, &handle) ;
+            if (err != ESP_OK)
+            {
+                ESP_LOGE(TAG, "mmap failed at 0x%x (%s)", window_offset, esp_err_to_name(err)) ;
+                window = 0 ;
+                break ;
+            }
+        }
+
+        const unsigned char *p = (const unsigned char *) window + (address - window_offset) ;
+
+        memcpy(&header, p, JOURNAL_SECTOR_HEADER_SIZE) ;
+        if (header.magic != JOURNAL_SECTOR_MAGIC)
+            continue ;
+
+        used = (sector == journal_control.sector) ? journal_control.offset : journal_sector_used(p, 0) ;
+
+        if (used > JOURNAL_SECTOR_HEADER_SIZE)
+        {
+            stream((unsigned char *) p + JOURNAL_SECTOR_HEADER_SIZE, used - JOURNAL_SECTOR_HEADER_SIZE) ;
+            frames += (used - JOURNAL_SECTOR_HEADER_SIZE) / JOURNAL_FRAME_SIZE ;
+        }
+    }
+
+    if (window) spi_flash_munmap(handle) ;
+
+    // END FRAME
+    end.boot_id = journal_control.boot_id ;
+    end.crc = journal_crc((const unsigned char *) &end, 0, 0) ;
+    memcpy(end_frame, &end, JOURNAL_FRAME_HEADER_SIZE) ;
+    stream(end_frame, sizeof(end_frame)) ;
+
+    xSemaphoreGive(journal_mutex) ;
+
+    ESP_LOGI(TAG, "journal export : %u frames", frames) ;
+
+    return frames ;
+}
+
+//
+// Journal Initialization ( recovers the write position from the newest sector )
+//
+void journal_init(void)
+{
+    journal_sector_header_t header ;
+    unsigned int k, found = 0 ;
+    uint16_t boot_id = 0 ;
+
+    memset(&journal_control, 0, sizeof(journal_control)) ;
+    journal_mutex = xSemaphoreCreateMutex() ;
+
+    #if (CONFIG_ESP_JOURNAL_ENABLE)
+        journal_control.partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, JOURNAL_PARTITION_SUBTYPE, JOURNAL_PARTITION_LABEL) ;
+    #endif
+
+    if (!journal_control.partition)
+    {
+        ESP_LOGW(TAG, "journal disabled (no \"%s\" partition)", JOURNAL_PARTITION_LABEL) ;
+        return ;
+    }
+
+    journal_control.sectors = journal_control.partition->size / JOURNAL_SECTOR_SIZE ;
+
+    // FIND THE NEWEST SECTOR
+    for (k=0; k<journal_control.sectors; k++)
+    {
+        if ( (esp_partition_read(journal_control.partition, k * JOURNAL_SECTOR_SIZE, &header, JOURNAL_SECTOR_HEADER_SIZE) == ESP_OK) &&
+             (header.magic == JOURNAL_SECTOR_MAGIC) &&
+             (!found || ((int32_t) (header.seq - journal_control.sector_seq) > 0)) )
+        {
+            found = 1 ;
+            journal_control.sector = k ;
+            journal_control.sector_seq = header.seq ;
+        }
+    }
+
+    if (!found)
+    {
+        // EMPTY JOURNAL
+        journal_control.boot_id = 1 ;
+        journal_enter_sector(0, 1, 1) ;
+        journal_program() ;
+    }
+    else
+    {
+        // RECOVER THE WRITE POSITION
+        esp_partition_read(journal_control.partition, journal_control.sector * JOURNAL_SECTOR_SIZE,
+                           journal_control.image, JOURNAL_SECTOR_SIZE) ;
+
+        memcpy(&header, journal_control.image, JOURNAL_SECTOR_HEADER_SIZE) ;
+        boot_id = header.boot_id ;
+
+        journal_control.offset = journal_sector_used(journal_control.image, &boot_id) ;
+        journal_control.flushed = journal_control.offset ;
+        journal_control.boot_id = boot_id + 1 ;
+
+        // A TORN FRAME IS NEVER OVERWRITTEN : CONTINUE ON THE NEXT SECTOR
+        for (k=journal_control.offset; (k<JOURNAL_SECTOR_SIZE) && (journal_control.image[k] == 0xFF); k++) ;
+
+        if (k < JOURNAL_SECTOR_SIZE)
+        {
+            ESP_LOGW(TAG, "sector %u has a torn frame at offset %u", journal_control.sector, journal_control.offset) ;
+            journal_enter_sector((journal_control.sector + 1) % journal_control.sectors, journal_control.sector_seq + 1, 1) ;
+            journal_program() ;
+        }
+    }
+
+    journal_control.last_flush_ms = (uint32_t) (esp_timer_get_time() / 1000) ;
+
+    // PERIODIC FLUSH ( interval 0 : every append programs its record )
+    if (JOURNAL_FLUSH_INTERVAL_MS)
+    {
+        TaskHandle_t task ;
+
+        if (xTaskCreate(journal_flush_task, "journal_flush", 3072, (void*) 0, 3, &task) == pdPASS) metrics_register_task(task) ;
+    }
+
+    ESP_LOGI(TAG, "journal : boot %u , sector %u (seq %u) , offset %u",
+                  journal_control.boot_id, journal_control.sector,
+                  journal_control.sector_seq, journal_control.offset) ;
+}
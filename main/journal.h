@@ -0,0 +1,61 @@
+/*
+    journal.h - Flash-Backed Measurement Journal
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+#ifndef _JOURNAL_H
+
+#define _JOURNAL_H	1
+
+    #ifdef __cplusplus
+    extern "C" {
+    #endif
+
+        #include "history.h"
+
+        #define JOURNAL_PARTITION_LABEL     "journal"
+        #define JOURNAL_PARTITION_SUBTYPE   0x40
+
+        #define JOURNAL_ACTION_INFO         0
+        #define JOURNAL_ACTION_EXPORT       1
+        #define JOURNAL_ACTION_FLUSH        2
+        #define JOURNAL_ACTION_ERASE        3
+
+        extern void journal_init(void) ;
+        extern void journal_append(const history_record_t *record) ;
+        extern unsigned int journal_flush(void) ;
+        extern unsigned int journal_erase(void) ;
+        extern void journal_info(void (*callback)(unsigned char *buffer, unsigned int len)) ;
+        extern unsigned int journal_export(void (*stream)(unsigned char *buffer, unsigned int len)) ;
+
+    #ifdef __cplusplus
+    }
+    #endif
+
+#endif
+
@@ -32,6 +32,14 @@
 #include "nvs_flash.h"
 #include "ap.h"
 #include "server.h"
+#include "pool.h"
+#include "history.h"
+#include "journal.h"
+#include "metrics.h"
+#include "trace.h"
+#include "capture.h"
+#include "stream.h"
+#include "udp.h"
 
 static const char *TAG = "Main App";
 
@@ -48,6 +56,27 @@ void global_initialization(void)
       ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
+
+    // Initialize Runtime Metrics
+    metrics_init() ;
+
+    // Initialize Hot-Path Trace
+    trace_init() ;
+
+    // Initialize Memory Pools
+    pool_init() ;
+
+    // Initialize Ranging History
+    history_init() ;
+
+    // Initialize Measurement Journal ( flash partition )
+    journal_init() ;
+
+    // Initialize Raw Driver Event Capture ( flash partition )
+    capture_init() ;
+
+    // Initialize UDP Datagram Streaming
+    udp_init() ;
 }
 
 void app_main(void)
@@ -62,5 +91,8 @@ void app_main(void)
 
     // INITIALIZE TCP/IP SERVER
     server_init() ;
+
+    // INITIALIZE PUBLISH/SUBSCRIBE STREAMS ( second port )
+    stream_init() ;
 }
 
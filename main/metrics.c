@@ -0,0 +1,327 @@
+/*
+    metrics.c - Runtime Metrics
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+//
+// Registry of counters, gauges ( with high-water marks ) and latency histograms,
+// updated from the hot paths and reported by the "stats" command together with
+// the free heap and the stack high-water marks of the registered tasks.
+//
+// Updates take a short critical section ; reports work on a snapshot, so
+// formatting never runs with the spinlock held.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "tool.h"
+#include "metrics.h"
+
+#define METRICS_LINE_BUFFER_LENGTH      256
+#define METRICS_TASK_NAME_LENGTH        16
+
+#define METRICS_BINARY_MAGIC            "CHRS"
+#define METRICS_BINARY_VERSION          1
+
+typedef struct {
+    uint32_t count ;
+    uint32_t sum_ms ;
+    uint32_t min_ms ;
+    uint32_t max_ms ;
+    uint32_t buckets[METRICS_NUM_BUCKETS] ;
+} metrics_histogram_t ;
+
+typedef struct {
+    uint32_t counters[METRICS_NUM_COUNTERS] ;
+    uint32_t gauges[METRICS_NUM_GAUGES] ;
+    uint32_t gauges_max[METRICS_NUM_GAUGES] ;
+    metrics_histogram_t histograms[METRICS_NUM_HISTOGRAMS] ;
+} metrics_snapshot_t ;
+
+static const char *TAG = "metrics" ;
+
+static const char *metrics_counter_name[METRICS_NUM_COUNTERS] = {
+    "rx_bytes", "tx_bytes", "rx_fifo_drops", "tx_fifo_drops",
+    "cmd_ftm", "cmd_scan", "cmd_pool", "cmd_history", "cmd_journal", "cmd_stats",
+    "parse_errors",
+    "ftm_success", "ftm_failure", "ftm_timeout", "ftm_start_failed", "ftm_cached",
+    "cmd_trace", "cmd_log", "cmd_capture", "cmd_streams",
+    "stream_messages", "stream_drops",
+    "cmd_udp", "udp_datagrams", "udp_errors",
+    "cmd_survey", "cmd_radio", "cmd_responder", "cmd_ftm_all",
+    "bus_events", "bus_drops"
+} ;
+
+static const char *metrics_gauge_name[METRICS_NUM_GAUGES] = { "rx_fifo_level", "tx_fifo_level", "bus_queue_level" } ;
+
+static const char *metrics_histogram_name[METRICS_NUM_HISTOGRAMS] = { "ftm_session_ms", "scan_ms" } ;
+
+static metrics_snapshot_t metrics_control ;
+static TaskHandle_t metrics_task[METRICS_MAX_TASKS] ;
+static unsigned int metrics_num_tasks ;
+
+static portMUX_TYPE metrics_spinlock = portMUX_INITIALIZER_UNLOCKED ;
+static SemaphoreHandle_t metrics_report_mutex ;     // report snapshot
+
+// FUNCTION PROTOTYPES
+void metrics_init(void) ;
+void metrics_count(unsigned int counter, uint32_t n) ;
+void metrics_gauge(unsigned int gauge, uint32_t value) ;
+void metrics_observe(unsigned int histogram, uint32_t ms) ;
+void metrics_register_task(TaskHandle_t task) ;
+void metrics_report(unsigned int format, void (*callback)(unsigned char *buffer, unsigned int len)) ;
+static void metrics_report_text(const metrics_snapshot_t *s, const char *tag, void (*callback)(unsigned char *buffer, unsigned int len)) ;
+static void metrics_report_binary(const metrics_snapshot_t *s, void (*callback)(unsigned char *buffer, unsigned int len)) ;
+
+//
+// Add <n> to a counter
+//
+void metrics_count(unsigned int counter, uint32_t n)
+{
+    if (counter >= METRICS_NUM_COUNTERS)
+        return ;
+
+    portENTER_CRITICAL(&metrics_spinlock) ;
+    metrics_control.counters[counter] += n ;
+    portEXIT_CRITICAL(&metrics_spinlock) ;
+}
+
+//
+// Set a gauge ( its high-water mark follows )
+//
+void metrics_gauge(unsigned int gauge, uint32_t value)
+{
+    if (gauge >= METRICS_NUM_GAUGES)
+        return ;
+
+    portENTER_CRITICAL(&metrics_spinlock) ;
+    metrics_control.gauges[gauge] = value ;
+    if (value > metrics_control.gauges_max[gauge]) metrics_control.gauges_max[gauge] = value ;
+    portEXIT_CRITICAL(&metrics_spinlock) ;
+}
+
+//
+// Record a duration in a histogram
+//
+void metrics_observe(unsigned int histogram, uint32_t ms)
+{
+    metrics_histogram_t *h ;
+    unsigned int bucket = 0 ;
+
+    if (histogram >= METRICS_NUM_HISTOGRAMS)
+        return ;
+
+    // bucket k holds [2^(k-1), 2^k) mSec , the last one is open ended
+    while ( (bucket < METRICS_NUM_BUCKETS - 1) && (ms >> bucket) ) bucket++ ;
+
+    h = &metrics_control.histograms[histogram] ;
+
+    portENTER_CRITICAL(&metrics_spinlock) ;
+    h->count++ ;
+    h->sum_ms += ms ;
+    if (ms < h->min_ms) h->min_ms = ms ;
+    if (ms > h->max_ms) h->max_ms = ms ;
+    h->buckets[bucket]++ ;
+    portEXIT_CRITICAL(&metrics_spinlock) ;
+}
+
+//
+// Track the stack high-water mark of a task
+//
+void metrics_register_task(TaskHandle_t task)
+{
+    portENTER_CRITICAL(&metrics_spinlock) ;
+    if (task && (metrics_num_tasks < METRICS_MAX_TASKS))
+    {
+        metrics_task[metrics_num_tasks++] = task ;
+    }
+    portEXIT_CRITICAL(&metrics_spinlock) ;
+}
+
+//
+// Text report ( one metric per line , tag == 0 : not mirrored to the console )
+//
+static void metrics_report_text(const metrics_snapshot_t *s, const char *tag, void (*callback)(unsigned char *buffer, unsigned int len))
+{
+    char line[METRICS_LINE_BUFFER_LENGTH] ;
+    char *p ;
+    unsigned int k, m ;
+
+    sprintf(line, "Stats Report:") ;
+    tool_log(tag, line, 0, callback) ;
+
+    for (k=0; k<METRICS_NUM_COUNTERS; k++)
+    {
+        sprintf(line, "%s %u", metrics_counter_name[k], s->counters[k]) ;
+        tool_log(tag, line, 0, callback) ;
+    }
+
+    for (k=0; k<METRICS_NUM_GAUGES; k++)
+    {
+        sprintf(line, "%s %u (high %u)", metrics_gauge_name[k], s->gauges[k], s->gauges_max[k]) ;
+        tool_log(tag, line, 0, callback) ;
+    }
+
+    for (k=0; k<METRICS_NUM_HISTOGRAMS; k++)
+    {
+        const metrics_histogram_t *h = &s->histograms[k] ;
+
+        sprintf(line, "%s count %u, mean %u, min %u, max %u", metrics_histogram_name[k], h->count,
+                      h->count ? (h->sum_ms / h->count) : 0, h->count ? h->min_ms : 0, h->max_ms) ;
+        tool_log(tag, line, 0, callback) ;
+
+        // NON EMPTY BUCKETS ( "<upper bound>:<count>" )
+        p = line ;
+        p += sprintf(p, "%s buckets", metrics_histogram_name[k]) ;
+        for (m=0; m<METRICS_NUM_BUCKETS; m++)
+        {
+            if (!h->buckets[m])
+                continue ;
+            if (m < METRICS_NUM_BUCKETS - 1)
+                p += sprintf(p, " <%u:%u", 1u << m, h->buckets[m]) ;
+            else
+                p += sprintf(p, " >=%u:%u", 1u << (m-1), h->buckets[m]) ;
+        }
+        tool_log(tag, line, 0, callback) ;
+    }
+
+    sprintf(line, "heap_free %u (min %u)", esp_get_free_heap_size(), esp_get_minimum_free_heap_size()) ;
+    tool_log(tag, line, 0, callback) ;
+
+    for (k=0; k<metrics_num_tasks; k++)
+    {
+        sprintf(line, "stack_free %s %u", pcTaskGetTaskName(metrics_task[k]),
+                      (unsigned int) uxTaskGetStackHighWaterMark(metrics_task[k])) ;
+        tool_log(tag, line, 0, callback) ;
+    }
+}
+
+//
+// Binary report ( little endian )
+//
+// "CHRS" , version (u16) , counters (u8) , gauges (u8) , histograms (u8) , buckets (u8) , tasks (u16) ,
+// counters (u32 each) , gauges (u32 value , u32 high) ,
+// histograms (u32 count , sum , min , max , buckets) ,
+// heap (u32 free , u32 min free) , tasks (16 byte name , u32 free stack)
+//
+// Entries are positional : a release only appends counters and gauges , so an older
+// decoder reads the entries it knows and skips the rest using the header counts.
+// METRICS_BINARY_VERSION changes whenever an existing entry moves or changes meaning.
+//
+static void metrics_report_binary(const metrics_snapshot_t *s, void (*callback)(unsigned char *buffer, unsigned int len))
+{
+    unsigned char header[12] ;
+    char name[METRICS_TASK_NAME_LENGTH] ;
+    uint32_t value[2] ;
+    uint16_t version = METRICS_BINARY_VERSION ;
+    uint16_t tasks = (uint16_t) metrics_num_tasks ;
+    unsigned int k ;
+
+    memcpy(header, METRICS_BINARY_MAGIC, 4) ;
+    memcpy(header + 4, &version, 2) ;
+    header[6] = METRICS_NUM_COUNTERS ;
+    header[7] = METRICS_NUM_GAUGES ;
+    header[8] = METRICS_NUM_HISTOGRAMS ;
+    header[9] = METRICS_NUM_BUCKETS ;
+    memcpy(header + 10, &tasks, 2) ;
+    callback(header, sizeof(header)) ;
+
+    callback((unsigned char *) s->counters, sizeof(s->counters)) ;
+
+    for (k=0; k<METRICS_NUM_GAUGES; k++)
+    {
+        value[0] = s->gauges[k] ;
+        value[1] = s->gauges_max[k] ;
+        callback((unsigned char *) value, sizeof(value)) ;
+    }
+
+    for (k=0; k<METRICS_NUM_HISTOGRAMS; k++)
+    {
+        metrics_histogram_t h = s->histograms[k] ;
+
+        if (!h.count) h.min_ms = 0 ;
+        callback((unsigned char *) &h, sizeof(h)) ;
+    }
+
+    value[0] = esp_get_free_heap_size() ;
+    value[1] = esp_get_minimum_free_heap_size() ;
+    callback((unsigned char *) value, sizeof(value)) ;
+
+    for (k=0; k<tasks; k++)
+    {
+        memset(name, 0, sizeof(name)) ;
+        strncpy(name, pcTaskGetTaskName(metrics_task[k]), sizeof(name) - 1) ;
+        value[0] = (uint32_t) uxTaskGetStackHighWaterMark(metrics_task[k]) ;
+        callback((unsigned char *) name, sizeof(name)) ;
+        callback((unsigned char *) value, sizeof(uint32_t)) ;
+    }
+}
+
+//
+// Report every metric ( METRICS_FORMAT_TEXT , METRICS_FORMAT_BINARY or METRICS_FORMAT_STREAM )
+//
+void metrics_report(unsigned int format, void (*callback)(unsigned char *buffer, unsigned int len))
+{
+    static metrics_snapshot_t snapshot ;    // command context and metrics stream ( keeps the stack small )
+
+    xSemaphoreTake(metrics_report_mutex, portMAX_DELAY) ;
+
+    portENTER_CRITICAL(&metrics_spinlock) ;
+    snapshot = metrics_control ;
+    portEXIT_CRITICAL(&metrics_spinlock) ;
+
+    if (format == METRICS_FORMAT_BINARY)
+        metrics_report_binary(&snapshot, callback) ;
+    else
+        metrics_report_text(&snapshot, (format == METRICS_FORMAT_STREAM) ? 0 : TAG, callback) ;
+
+    xSemaphoreGive(metrics_report_mutex) ;
+}
+
+//
+// Metrics Initialization
+//
+void metrics_init(void)
+{
+    unsigned int k ;
+
+    memset(&metrics_control, 0, sizeof(metrics_control)) ;
+
+    for (k=0; k<METRICS_NUM_HISTOGRAMS; k++)
+    {
+        metrics_control.histograms[k].min_ms = UINT32_MAX ;
+    }
+    metrics_num_tasks = 0 ;
+
+    if (!metrics_report_mutex) metrics_report_mutex = xSemaphoreCreateMutex() ;
+}
@@ -0,0 +1,107 @@
+/*
+    metrics.h - Runtime Metrics
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+#ifndef _METRICS_H
+
+#define _METRICS_H	1
+
+    #ifdef __cplusplus
+    extern "C" {
+    #endif
+
+        #include <stdint.h>
+        #include "freertos/FreeRTOS.h"      // { TaskHandle_t }
+        #include "freertos/task.h"
+
+        // COUNTERS ( the "CHRS" binary report is positional : new counters are appended , never inserted )
+        #define METRICS_RX_BYTES            0       // bytes received from the socket
+        #define METRICS_TX_BYTES            1       // bytes sent to the socket
+        #define METRICS_RX_FIFO_DROPS       2       // bytes lost ( incoming FIFO full )
+        #define METRICS_TX_FIFO_DROPS       3       // bytes lost ( outgoing FIFO full )
+        #define METRICS_CMD_FTM             4       // commands parsed ( per type )
+        #define METRICS_CMD_SCAN            5
+        #define METRICS_CMD_POOL            6
+        #define METRICS_CMD_HISTORY         7
+        #define METRICS_CMD_JOURNAL         8
+        #define METRICS_CMD_STATS           9
+        #define METRICS_PARSE_ERRORS        10      // commands not recognized by any parser
+        #define METRICS_FTM_SUCCESS         11      // FTM sessions ( per outcome )
+        #define METRICS_FTM_FAILURE         12
+        #define METRICS_FTM_TIMEOUT         13
+        #define METRICS_FTM_START_FAILED    14
+        #define METRICS_FTM_CACHED          15      // FTM requests served without a new session
+        #define METRICS_CMD_TRACE           16
+        #define METRICS_CMD_LOG             17
+        #define METRICS_CMD_CAPTURE         18
+        #define METRICS_CMD_STREAMS         19
+        #define METRICS_STREAM_MESSAGES     20      // messages published to the streams
+        #define METRICS_STREAM_DROPS        21      // stream messages dropped ( slow subscribers , no memory )
+        #define METRICS_CMD_UDP             22
+        #define METRICS_UDP_DATAGRAMS       23      // ranging datagrams sent
+        #define METRICS_UDP_ERRORS          24      // ranging datagrams not sent ( socket errors )
+        #define METRICS_CMD_SURVEY          25
+        #define METRICS_CMD_RADIO           26
+        #define METRICS_CMD_RESPONDER       27
+        #define METRICS_CMD_FTM_ALL         28
+        #define METRICS_BUS_EVENTS          29      // events published on the internal bus
+        #define METRICS_BUS_DROPS           30      // bus events not delivered to the worker ( queue full )
+        #define METRICS_NUM_COUNTERS        31
+
+        // GAUGES ( current value and high-water mark , appended like the counters )
+        #define METRICS_RX_FIFO_LEVEL       0
+        #define METRICS_TX_FIFO_LEVEL       1
+        #define METRICS_BUS_QUEUE_LEVEL     2       // events waiting for the bus worker
+        #define METRICS_NUM_GAUGES          3
+
+        // HISTOGRAMS ( milli-seconds , power of two buckets )
+        #define METRICS_FTM_SESSION_MS      0       // esp_wifi_ftm_initiate_session() to completion
+        #define METRICS_SCAN_MS             1       // WiFi scan
+        #define METRICS_NUM_HISTOGRAMS      2
+        #define METRICS_NUM_BUCKETS         16      // [0,1) [1,2) [2,4) ... [16384,inf) mSec
+
+        #define METRICS_MAX_TASKS           12
+
+        #define METRICS_FORMAT_TEXT         0
+        #define METRICS_FORMAT_BINARY       1
+        #define METRICS_FORMAT_STREAM       2       // text , without the console mirror ( metrics stream )
+
+        extern void metrics_init(void) ;
+        extern void metrics_count(unsigned int counter, uint32_t n) ;
+        extern void metrics_gauge(unsigned int gauge, uint32_t value) ;
+        extern void metrics_observe(unsigned int histogram, uint32_t ms) ;
+        extern void metrics_register_task(TaskHandle_t task) ;
+        extern void metrics_report(unsigned int format, void (*callback)(unsigned char *buffer, unsigned int len)) ;
+
+    #ifdef __cplusplus
+    }
+    #endif
+
+#endif
+
@@ -34,178 +34,886 @@
 #include "esp_log.h"
 #include "cJSON.h"
 #include "tool.h"
+#include "ftm.h"
+#include "history.h"
+#include "journal.h"
+#include "metrics.h"
+#include "trace.h"
+#include "capture.h"
+#include "stream.h"
+#include "udp.h"
+#include "survey.h"
+#include "radio.h"
+#include "responder.h"
 
 static const char *TAG = "parser";
 
 // FUNCTION PROTOTYPES
-unsigned int parser_ftm_by_ssid(unsigned char *string, char *ssid, unsigned int *count, unsigned int *burst_period) ;
-unsigned int parser_ftm_by_mac(unsigned char *string, unsigned char *mac, unsigned int *channel, unsigned int *count, unsigned int *burst_period) ;
-unsigned int parser_scan(unsigned char *string, char *ssid) ;
+cJSON *parser_parse(unsigned char *string) ;
+const char *parser_function(cJSON *root) ;
+void parser_release(cJSON *root) ;
+unsigned int parser_ftm_by_ssid(cJSON *root, char *ssid, unsigned int *count, unsigned int *burst_period, ftm_options_t *options) ;
+unsigned int parser_ftm_by_mac(cJSON *root, unsigned char *mac, unsigned int *channel, unsigned int *count, unsigned int *burst_period, ftm_options_t *options) ;
+unsigned int parser_ftm_all(cJSON *root, unsigned int *count, unsigned int *burst_period, int *min_rssi, ftm_options_t *options) ;
+static void parser_ftm_options(cJSON *parameters, ftm_options_t *options) ;
+static int parser_ftm_fields(cJSON *fields) ;
+unsigned int parser_scan(cJSON *root, char *ssid, unsigned int *timing) ;
+unsigned int parser_pool(cJSON *root) ;
+unsigned int parser_history(cJSON *root, history_query_t *query) ;
+unsigned int parser_journal(cJSON *root, unsigned int *action) ;
+unsigned int parser_stats(cJSON *root, unsigned int *format) ;
+unsigned int parser_trace(cJSON *root, unsigned int *action) ;
+unsigned int parser_log(cJSON *root, char *module, int *level, int *console, int *report) ;
+unsigned int parser_capture(cJSON *root, unsigned int *action, unsigned int *speed, ftm_options_t *options) ;
+unsigned int parser_streams(cJSON *root) ;
+unsigned int parser_subscribe(cJSON *root, unsigned int *mask, unsigned int *policy) ;
+unsigned int parser_udp(cJSON *root, unsigned int *action, char *host, unsigned int *port, unsigned int *format) ;
+unsigned int parser_survey(cJSON *root, survey_request_t *request) ;
+unsigned int parser_radio(cJSON *root, unsigned int *action, radio_config_t *config, unsigned int *fields) ;
+unsigned int parser_responder(cJSON *root, unsigned int *action, responder_calibration_t *request) ;
 
 //
-// Parse and detect "FTM by SSID" command
+// Parse a JSON command ( traced ) , once : the parsers below read their parameters from the
+// returned tree , which is released by parser_release()
 //
-unsigned int parser_ftm_by_ssid(unsigned char *string, char *ssid, unsigned int *count, unsigned int *burst_period)
+cJSON *parser_parse(unsigned char *string)
 {
-    unsigned int ret = 0 ;
-	cJSON *root , *parameters ;
+    cJSON *root ;
+
+    TRACE(TRACE_PARSE_BEGIN, 0) ;
+    root = string ? cJSON_Parse((const char *) string) : 0 ;
+    TRACE(TRACE_PARSE_END, root != 0) ;
+
+    return root ;
+}
+
+//
+// "function" of a parsed command ( 0 : malformed command , or no function name )
+//
+const char *parser_function(cJSON *root)
+{
+    cJSON *function = cJSON_GetObjectItem(root, "function") ;
+
+    return cJSON_IsString(function) ? function->valuestring : 0 ;
+}
+
+//
+// Release a parsed command
+//
+void parser_release(cJSON *root)
+{
+    cJSON_Delete(root) ;
+}
 
-    if (string) 
+//
+// Parse the FTM report columns ( "fields" : [ "diag" , "rtt" , "t1t2t3t4" , "rssi" ] , "all" or "summary" )
+//
+static int parser_ftm_fields(cJSON *fields)
+{
+    cJSON *item ;
+    int mask = 0 ;
+
+    if (cJSON_IsString(fields))
     {
-        root = cJSON_Parse((const char *) string);        
+        if (!strcmp(fields->valuestring,"all")) return FTM_FIELD_ALL ;
+        if (!strcmp(fields->valuestring,"summary")) return 0 ;
+        return FTM_FIELDS_DEFAULT ;
+    }
 
-        if (cJSON_GetObjectItem(root, "function")) 
+    cJSON_ArrayForEach(item, fields)
+    {
+        if (!cJSON_IsString(item)) continue ;
+
+        if (!strcmp(item->valuestring,"diag")) mask |= FTM_FIELD_DIAG ;
+        else if (!strcmp(item->valuestring,"rtt")) mask |= FTM_FIELD_RTT ;
+        else if (!strcmp(item->valuestring,"t1t2t3t4")) mask |= FTM_FIELD_T1T2T3T4 ;
+        else if (!strcmp(item->valuestring,"rssi")) mask |= FTM_FIELD_RSSI ;
+    }
+    return mask ;
+}
+
+//
+// Parse the optional session parameters of FTM commands ( "timeout", "retries", "backoff", "precision", "max_age_ms", "timing" and "fields" )
+//
+static void parser_ftm_options(cJSON *parameters, ftm_options_t *options)
+{
+    if (!options)
+        return ;
+
+    ftm_options_default(options) ;
+
+    if (cJSON_GetObjectItem(parameters, "timeout")) 
+    {
+        options->timeout_ms = cJSON_GetObjectItem(parameters,"timeout")->valueint ;
+    }
+
+    if (cJSON_GetObjectItem(parameters, "retries")) 
+    {
+        options->retries = cJSON_GetObjectItem(parameters,"retries")->valueint ;
+    }
+
+    if (cJSON_GetObjectItem(parameters, "backoff")) 
+    {
+        options->backoff_ms = cJSON_GetObjectItem(parameters,"backoff")->valueint ;
+    }
+
+    if (cJSON_GetObjectItem(parameters, "precision")) 
+    {
+        int precision_cm = cJSON_GetObjectItem(parameters,"precision")->valueint ;
+
+        // NEGATIVE TARGETS ARE KEPT OUT OF RANGE ( rejected with the other session options )
+        options->precision_cm = (precision_cm < 0) ? FTM_MAX_PRECISION_CM + 1 : (unsigned int) precision_cm ;
+    }
+
+    if (cJSON_GetObjectItem(parameters, "max_age_ms")) 
+    {
+        int max_age_ms = cJSON_GetObjectItem(parameters,"max_age_ms")->valueint ;
+
+        // NEGATIVE AGES ARE KEPT OUT OF RANGE ( rejected with the other session options )
+        options->max_age_ms = (max_age_ms < 0) ? FTM_MAX_AGE_MS + 1 : (unsigned int) max_age_ms ;
+    }
+
+    if (cJSON_GetObjectItem(parameters, "timing")) 
+    {
+        options->timing = cJSON_IsTrue(cJSON_GetObjectItem(parameters,"timing")) ;
+    }
+
+    if (cJSON_GetObjectItem(parameters, "fields")) 
+    {
+        options->fields = parser_ftm_fields(cJSON_GetObjectItem(parameters,"fields")) ;
+    }
+}
+
+//
+// Parse the "FTM by SSID" command
+//
+unsigned int parser_ftm_by_ssid(cJSON *root, char *ssid, unsigned int *count, unsigned int *burst_period, ftm_options_t *options)
+{
+    unsigned int ret = 0 ;
+	cJSON *parameters ;
+
+    if (root) 
+    {
+        if ( (parameters = cJSON_GetObjectItem(root, "parameters"))  ) 
         {
-            char *function = cJSON_GetObjectItem(root,"function")->valuestring ;
+            if (ssid && cJSON_GetObjectItem(parameters, "ssid")) 
+            {
+                char *s ;
+                if ( (s = cJSON_GetObjectItem(parameters,"ssid")->valuestring) )
+                {
+                    strncpy(ssid,s,127) ;                            
+                    ret = 1 ;
+                    ESP_LOGI(TAG, "ftm function (by ssid)");            
+                }
+            }
 
-            if (!strcmp(function,"ftm"))
+            if (count)
             {
-                if ( (parameters = cJSON_GetObjectItem(root, "parameters"))  ) 
+                if (cJSON_GetObjectItem(parameters, "count")) 
                 {
-                    if (ssid && cJSON_GetObjectItem(parameters, "ssid")) 
-                    {
-                        char *s ;
-                        if ( (s = cJSON_GetObjectItem(parameters,"ssid")->valuestring) )
-                        {
-                            strncpy(ssid,s,127) ;                            
-                            ret = 1 ;
-                            ESP_LOGI(TAG, "ftm function (by ssid)");            
-                        }
-                    }
+                    *count = cJSON_GetObjectItem(parameters,"count")->valueint;
+                }
+                else
+                {
+                    *count = 8 ;
+                }
+            }
 
-                    if (count)
-                    {
-                        if (cJSON_GetObjectItem(parameters, "count")) 
-                        {
-                            *count = cJSON_GetObjectItem(parameters,"count")->valueint;
-                        }
-                        else
-                        {
-                            *count = 8 ;
-                        }
-                    }
+            if (burst_period)
+            {
+                if (cJSON_GetObjectItem(parameters, "burst"))
+                {
+                    *burst_period = cJSON_GetObjectItem(parameters,"burst")->valueint;
+                }
+                else
+                {
+                    *burst_period = 4 ;
+                }
+            }
 
-                    if (burst_period)
-                    {
-                        if (cJSON_GetObjectItem(parameters, "burst"))
-                        {
-                            *burst_period = cJSON_GetObjectItem(parameters,"burst")->valueint;
-                        }
-                        else
-                        {
-                            *burst_period = 4 ;
-                        }
-                    }
+            parser_ftm_options(parameters, options) ;
+        }
+    }
+    return ret ;
+}
+
+//
+// Parse the "FTM by MAC address" command
+//
+unsigned int parser_ftm_by_mac(cJSON *root, unsigned char *mac, unsigned int *channel, unsigned int *count, unsigned int *burst_period, ftm_options_t *options)
+{
+    unsigned int ret = 0 ;
+	cJSON *parameters ;
+
+    if (root) 
+    {
+        if ( (parameters = cJSON_GetObjectItem(root, "parameters"))  ) 
+        {
+            if ( (mac && cJSON_GetObjectItem(parameters, "mac")) && (channel && cJSON_GetObjectItem(parameters, "channel")) ) 
+            {
+                char *s ;
+                s = cJSON_GetObjectItem(parameters,"mac")->valuestring ;
+                if (tool_mac_string_to_array(s, mac))
+                {
+                    *channel = cJSON_GetObjectItem(parameters,"channel")->valueint ;
+                    ret = 1 ;
+                    ESP_LOGI(TAG, "ftm function (by mac)") ;
+                }
+            }
+
+            if (count)
+            {
+                if (cJSON_GetObjectItem(parameters, "count")) 
+                {
+                    *count = cJSON_GetObjectItem(parameters,"count")->valueint;
+                }
+                else
+                {
+                    *count = 8 ;
                 }
             }
+
+            if (burst_period)
+            {
+                if (cJSON_GetObjectItem(parameters, "burst"))
+                {
+                    *burst_period = cJSON_GetObjectItem(parameters,"burst")->valueint;
+                }
+                else
+                {
+                    *burst_period = 4 ;
+                }
+            }
+
+            parser_ftm_options(parameters, options) ;
         }
-	    cJSON_Delete(root);
     }
     return ret ;
 }
 
+
+//
+// Parse the "ftm_all" command ( range every FTM responder in range )
 //
-// Parse and detect "FTM by MAC address" command
+// "count" ( default 8 ) , "burst" ( default 4 ) , "min_rssi" ( default -100 dBm ) and the session options
 //
-unsigned int parser_ftm_by_mac(unsigned char *string, unsigned char *mac, unsigned int *channel, unsigned int *count, unsigned int *burst_period)
+unsigned int parser_ftm_all(cJSON *root, unsigned int *count, unsigned int *burst_period, int *min_rssi, ftm_options_t *options)
 {
     unsigned int ret = 0 ;
-	cJSON *root , *parameters ;
+	cJSON *parameters ;
 
-    if (string) 
+    if (root && count && burst_period && min_rssi) 
     {
-        root = cJSON_Parse((const char *) string);        
+        *count = 8 ;
+        *burst_period = 4 ;
+        *min_rssi = -100 ;
+
+        parameters = cJSON_GetObjectItem(root, "parameters") ;
+
+        if (parameters && cJSON_GetObjectItem(parameters, "count")) 
+        {
+            *count = cJSON_GetObjectItem(parameters,"count")->valueint ;
+        }
 
-        if (cJSON_GetObjectItem(root, "function")) 
+        if (parameters && cJSON_GetObjectItem(parameters, "burst")) 
         {
-            char *function = cJSON_GetObjectItem(root,"function")->valuestring ;
+            *burst_period = cJSON_GetObjectItem(parameters,"burst")->valueint ;
+        }
 
-            if (!strcmp(function,"ftm"))
+        if (parameters && cJSON_GetObjectItem(parameters, "min_rssi")) 
+        {
+            *min_rssi = cJSON_GetObjectItem(parameters,"min_rssi")->valueint ;
+        }
+
+        parser_ftm_options(parameters, options) ;
+
+        ret = 1 ;
+        ESP_LOGI(TAG, "ftm_all function") ;
+    }
+    return ret ;
+}
+
+
+//
+// Parse the "WiFi scanning" command ( "timing" : true requests a latency footer )
+//
+unsigned int parser_scan(cJSON *root, char *ssid, unsigned int *timing)
+{
+    unsigned int ret = 0 ;
+	cJSON *parameters ;
+
+    if (root) 
+    {
+        if (timing) *timing = 0 ;
+        if (ssid)
+        {
+            strcpy(ssid,"?") ;
+            if ( (parameters = cJSON_GetObjectItem(root, "parameters"))  ) 
             {
-                if ( (parameters = cJSON_GetObjectItem(root, "parameters"))  ) 
+                if (cJSON_GetObjectItem(parameters, "ssid"))
                 {
-                    if ( (mac && cJSON_GetObjectItem(parameters, "mac")) && (channel && cJSON_GetObjectItem(parameters, "channel")) ) 
+                    char *s ;
+                    if ( (s = cJSON_GetObjectItem(parameters,"ssid")->valuestring) )
                     {
-                        char *s ;
-                        s = cJSON_GetObjectItem(parameters,"mac")->valuestring ;
-                        if (tool_mac_string_to_array(s, mac))
-                        {
-                            *channel = cJSON_GetObjectItem(parameters,"channel")->valueint ;
-                            ret = 1 ;
-                            ESP_LOGI(TAG, "ftm function (by mac)") ;
-                        }
+                        strncpy(ssid,s,127) ;
                     }
+                }
+                if (timing && cJSON_GetObjectItem(parameters, "timing"))
+                {
+                    *timing = cJSON_IsTrue(cJSON_GetObjectItem(parameters,"timing")) ;
+                }
+            }
+        }
+        ret = 1 ;
+        ESP_LOGI(TAG, "scan function") ;
+    }
+    return ret ;
+}
 
-                    if (count)
-                    {
-                        if (cJSON_GetObjectItem(parameters, "count")) 
-                        {
-                            *count = cJSON_GetObjectItem(parameters,"count")->valueint;
-                        }
-                        else
-                        {
-                            *count = 8 ;
-                        }
-                    }
+//
+// Parse the "Memory pool report" command
+//
+unsigned int parser_pool(cJSON *root)
+{
+    unsigned int ret = 0 ;
 
-                    if (burst_period)
-                    {
-                        if (cJSON_GetObjectItem(parameters, "burst"))
-                        {
-                            *burst_period = cJSON_GetObjectItem(parameters,"burst")->valueint;
-                        }
-                        else
-                        {
-                            *burst_period = 4 ;
-                        }
-                    }
+    if (root) 
+    {
+        ret = 1 ;
+        ESP_LOGI(TAG, "pool function") ;
+    }
+    return ret ;
+}
+
+//
+// Parse the "Ranging history" command
+//
+unsigned int parser_history(cJSON *root, history_query_t *query)
+{
+    unsigned int ret = 0 ;
+	cJSON *parameters ;
+
+    if (root && query) 
+    {
+        memset(query, 0, sizeof(history_query_t)) ;
+        query->format = HISTORY_FORMAT_NDJSON ;
+
+        if ( (parameters = cJSON_GetObjectItem(root, "parameters"))  ) 
+        {
+            if (cJSON_GetObjectItem(parameters, "mac")) 
+            {
+                query->filter_mac = 1 ;
+                query->invalid = !tool_mac_string_to_array(cJSON_GetObjectItem(parameters,"mac")->valuestring, query->mac) ;
+            }
+            if (cJSON_GetObjectItem(parameters, "from")) 
+            {
+                query->from_ms = (uint32_t) cJSON_GetObjectItem(parameters,"from")->valuedouble ;
+            }
+            if (cJSON_GetObjectItem(parameters, "to")) 
+            {
+                query->to_ms = (uint32_t) cJSON_GetObjectItem(parameters,"to")->valuedouble ;
+            }
+            if (cJSON_GetObjectItem(parameters, "since")) 
+            {
+                query->since_seq = (uint32_t) cJSON_GetObjectItem(parameters,"since")->valuedouble ;
+            }
+            if (cJSON_GetObjectItem(parameters, "max")) 
+            {
+                query->max_records = cJSON_GetObjectItem(parameters,"max")->valueint ;
+            }
+            if (cJSON_GetObjectItem(parameters, "format")) 
+            {
+                char *s = cJSON_GetObjectItem(parameters,"format")->valuestring ;
+                if (s && !strcmp(s,"binary"))
+                {
+                    query->format = HISTORY_FORMAT_BINARY ;
+                }
+            }
+        }
+        ret = 1 ;
+        ESP_LOGI(TAG, "history function") ;
+    }
+    return ret ;
+}
+
+//
+// Parse the "journal" command ( "action" : "info" , "export" , "flush" or "erase" )
+//
+unsigned int parser_journal(cJSON *root, unsigned int *action)
+{
+    unsigned int ret = 0 ;
+	cJSON *parameters ;
+
+    if (root && action) 
+    {
+        *action = JOURNAL_ACTION_INFO ;
+
+        if ( (parameters = cJSON_GetObjectItem(root, "parameters")) && cJSON_GetObjectItem(parameters, "action") ) 
+        {
+            char *s = cJSON_GetObjectItem(parameters,"action")->valuestring ;
+
+            if (s && !strcmp(s,"export"))       *action = JOURNAL_ACTION_EXPORT ;
+            else if (s && !strcmp(s,"flush"))   *action = JOURNAL_ACTION_FLUSH ;
+            else if (s && !strcmp(s,"erase"))   *action = JOURNAL_ACTION_ERASE ;
+        }
+        ret = 1 ;
+        ESP_LOGI(TAG, "journal function") ;
+    }
+    return ret ;
+}
+
+//
+// Parse the "stats" command ( "format" : "text" or "binary" )
+//
+unsigned int parser_stats(cJSON *root, unsigned int *format)
+{
+    unsigned int ret = 0 ;
+	cJSON *parameters ;
+
+    if (root && format) 
+    {
+        *format = METRICS_FORMAT_TEXT ;
+
+        if ( (parameters = cJSON_GetObjectItem(root, "parameters")) && cJSON_GetObjectItem(parameters, "format") ) 
+        {
+            char *s = cJSON_GetObjectItem(parameters,"format")->valuestring ;
+
+            if (s && !strcmp(s,"binary")) *format = METRICS_FORMAT_BINARY ;
+        }
+        ret = 1 ;
+        ESP_LOGI(TAG, "stats function") ;
+    }
+    return ret ;
+}
+
+//
+// Parse the "trace" command ( "action" : "dump" or "clear" )
+//
+unsigned int parser_trace(cJSON *root, unsigned int *action)
+{
+    unsigned int ret = 0 ;
+	cJSON *parameters ;
+
+    if (root && action) 
+    {
+        *action = TRACE_ACTION_DUMP ;
+
+        if ( (parameters = cJSON_GetObjectItem(root, "parameters")) && cJSON_GetObjectItem(parameters, "action") ) 
+        {
+            char *s = cJSON_GetObjectItem(parameters,"action")->valuestring ;
+
+            if (s && !strcmp(s,"clear")) *action = TRACE_ACTION_CLEAR ;
+        }
+        ret = 1 ;
+        ESP_LOGI(TAG, "trace function") ;
+    }
+    return ret ;
+}
+
+//
+// Parse the "log" command
+//
+// "module" : log tag ( "*" for every module , the default ) , "level" : "none" ... "verbose"
+// "console" : mirror socket reports to the console , "report" : FTM report detail bits
+//
+// absent parameters are returned as -1
+//
+unsigned int parser_log(cJSON *root, char *module, int *level, int *console, int *report)
+{
+    unsigned int ret = 0 ;
+	cJSON *parameters ;
+
+    if (root && module && level && console && report) 
+    {
+        strcpy(module,"*") ;
+        *level = *console = *report = -1 ;
+
+        if ( (parameters = cJSON_GetObjectItem(root, "parameters")) ) 
+        {
+            if (cJSON_GetObjectItem(parameters, "module"))
+            {
+                char *s ;
+                if ( (s = cJSON_GetObjectItem(parameters,"module")->valuestring) )
+                {
+                    strncpy(module,s,31) ;
+                    module[31] = 0 ;
                 }
             }
+            if (cJSON_GetObjectItem(parameters, "level"))
+            {
+                *level = tool_log_level_from_string(cJSON_GetObjectItem(parameters,"level")->valuestring) ;
+                if (*level < 0) *level = -2 ;       // unknown level name
+            }
+            if (cJSON_GetObjectItem(parameters, "console"))
+            {
+                *console = cJSON_IsTrue(cJSON_GetObjectItem(parameters,"console")) ;
+            }
+            if (cJSON_GetObjectItem(parameters, "report"))
+            {
+                *report = cJSON_GetObjectItem(parameters,"report")->valueint ;
+            }
         }
-	    cJSON_Delete(root);
+        ret = 1 ;
+        ESP_LOGI(TAG, "log function") ;
     }
     return ret ;
 }
 
+//
+// Parse the "capture" command ( "action" : "info", "start", "stop", "dump" or "replay" )
+//
+// replay : "speed" : "max" ( default ) or "1x" , FTM report options ( "fields", "timing" )
+//
+unsigned int parser_capture(cJSON *root, unsigned int *action, unsigned int *speed, ftm_options_t *options)
+{
+    unsigned int ret = 0 ;
+	cJSON *parameters ;
+
+    if (root && action && speed && options) 
+    {
+        *action = CAPTURE_ACTION_INFO ;
+        *speed = CAPTURE_SPEED_MAX ;
+
+        parameters = cJSON_GetObjectItem(root, "parameters") ;
+        parser_ftm_options(parameters, options) ;
+
+        if (parameters && cJSON_GetObjectItem(parameters, "action")) 
+        {
+            char *s = cJSON_GetObjectItem(parameters,"action")->valuestring ;
+
+            if (s && !strcmp(s,"start"))        *action = CAPTURE_ACTION_START ;
+            else if (s && !strcmp(s,"stop"))    *action = CAPTURE_ACTION_STOP ;
+            else if (s && !strcmp(s,"dump"))    *action = CAPTURE_ACTION_DUMP ;
+            else if (s && !strcmp(s,"replay"))  *action = CAPTURE_ACTION_REPLAY ;
+        }
+
+        if (parameters && cJSON_GetObjectItem(parameters, "speed")) 
+        {
+            char *s = cJSON_GetObjectItem(parameters,"speed")->valuestring ;
+
+            if (s && !strcmp(s,"1x")) *speed = CAPTURE_SPEED_REALTIME ;
+        }
+        ret = 1 ;
+        ESP_LOGI(TAG, "capture function") ;
+    }
+    return ret ;
+}
+
+//
+// Parse the "streams" command ( publish/subscribe streams report )
+//
+unsigned int parser_streams(cJSON *root)
+{
+    unsigned int ret = 0 ;
+
+    if (root) 
+    {
+        ret = 1 ;
+        ESP_LOGI(TAG, "streams function") ;
+    }
+    return ret ;
+}
+
+//
+// Parse the "subscribe" command ( stream connections only )
+//
+// "streams" : [ "ranging" , "scan" , "metrics" , "log" ] ( default : every stream ) ,
+// "policy" : "drop_newest" , "drop_oldest" ( default ) or "disconnect"
+//
+// mask == 0 : unknown stream or policy
+//
+unsigned int parser_subscribe(cJSON *root, unsigned int *mask, unsigned int *policy)
+{
+    unsigned int ret = 0 ;
+    unsigned int k ;
+	cJSON *parameters , *streams , *item ;
+
+    if (root && mask && policy) 
+    {
+        *mask = (1 << STREAM_NUM) - 1 ;
+        *policy = STREAM_POLICY_DROP_OLDEST ;
+
+        parameters = cJSON_GetObjectItem(root, "parameters") ;
+
+        if (parameters && (streams = cJSON_GetObjectItem(parameters, "streams")) && cJSON_IsArray(streams)) 
+        {
+            *mask = 0 ;
+            cJSON_ArrayForEach(item, streams)
+            {
+                for (k=0; (k<STREAM_NUM) && !(cJSON_IsString(item) && !strcmp(item->valuestring, stream_name(k))); k++) ;
+
+                if (k == STREAM_NUM)
+                {
+                    *mask = 0 ;
+                    break ;
+                }
+                *mask |= 1 << k ;
+            }
+        }
+
+        if (parameters && cJSON_GetObjectItem(parameters, "policy")) 
+        {
+            char *s = cJSON_GetObjectItem(parameters,"policy")->valuestring ;
+
+            if (s && !strcmp(s,"drop_newest"))          *policy = STREAM_POLICY_DROP_NEWEST ;
+            else if (s && !strcmp(s,"drop_oldest"))     *policy = STREAM_POLICY_DROP_OLDEST ;
+            else if (s && !strcmp(s,"disconnect"))      *policy = STREAM_POLICY_DISCONNECT ;
+            else *mask = 0 ;
+        }
+        ret = 1 ;
+        ESP_LOGI(TAG, "subscribe function") ;
+    }
+    return ret ;
+}
 
 //
-// Parse and detect "WiFi scanning" command
+// Parse the "udp" command ( "action" : "info" ( default ) , "start" or "stop" )
 //
-unsigned int parser_scan(unsigned char *string, char *ssid)
+// start : "host" ( IPv4 , default : the command client ) , "port" ( default : UDP_DEFAULT_PORT ) ,
+//         "format" : "text" ( default ) or "binary"
+//
+// <host> holds 48 bytes ; unknown formats are returned as UDP_FORMAT_BINARY + 1
+//
+unsigned int parser_udp(cJSON *root, unsigned int *action, char *host, unsigned int *port, unsigned int *format)
 {
     unsigned int ret = 0 ;
-	cJSON *root , *parameters ;
+	cJSON *parameters ;
 
-    if (string) 
+    if (root && action && host && port && format) 
     {
-        root = cJSON_Parse((const char *) string);        
+        *action = UDP_ACTION_INFO ;
+        host[0] = 0 ;
+        *port = 0 ;
+        *format = UDP_FORMAT_TEXT ;
+
+        parameters = cJSON_GetObjectItem(root, "parameters") ;
+
+        if (parameters && cJSON_GetObjectItem(parameters, "action")) 
+        {
+            char *s = cJSON_GetObjectItem(parameters,"action")->valuestring ;
+
+            if (s && !strcmp(s,"start"))        *action = UDP_ACTION_START ;
+            else if (s && !strcmp(s,"stop"))    *action = UDP_ACTION_STOP ;
+        }
+
+        if (parameters && cJSON_GetObjectItem(parameters, "host")) 
+        {
+            char *s = cJSON_GetObjectItem(parameters,"host")->valuestring ;
 
-        if (cJSON_GetObjectItem(root, "function")) 
+            if (s)
+            {
+                strncpy(host, s, 47) ;
+                host[47] = 0 ;
+            }
+        }
+
+        if (parameters && cJSON_GetObjectItem(parameters, "port")) 
+        {
+            *port = cJSON_GetObjectItem(parameters,"port")->valueint ;
+        }
+
+        if (parameters && cJSON_GetObjectItem(parameters, "format")) 
         {
-            char *function = cJSON_GetObjectItem(root,"function")->valuestring ;
+            char *s = cJSON_GetObjectItem(parameters,"format")->valuestring ;
+
+            if (s && !strcmp(s,"binary"))       *format = UDP_FORMAT_BINARY ;
+            else if (!s || strcmp(s,"text"))    *format = UDP_FORMAT_BINARY + 1 ;
+        }
+        ret = 1 ;
+        ESP_LOGI(TAG, "udp function") ;
+    }
+    return ret ;
+}
+
+//
+// Parse the "survey" command
+//
+// "ssids" : [ peer anchors ] ( required ) , "rounds" ( sessions per peer ) , "count" , "burst"
+//
+// request->peers == 0 : missing ssids , or more than SURVEY_MAX_SSIDS ( the peer limit is
+//                       checked by survey_run() , once this anchor is left out )
+//
+unsigned int parser_survey(cJSON *root, survey_request_t *request)
+{
+    unsigned int ret = 0 ;
+	cJSON *parameters , *ssids , *item ;
 
-            if (!strcmp(function,"scan"))
+    if (root && request) 
+    {
+        memset(request, 0, sizeof(survey_request_t)) ;
+        request->rounds = SURVEY_DEFAULT_ROUNDS ;
+        request->count = SURVEY_DEFAULT_COUNT ;
+        request->burst_period = SURVEY_DEFAULT_BURST ;
+
+        parameters = cJSON_GetObjectItem(root, "parameters") ;
+
+        if (parameters && (ssids = cJSON_GetObjectItem(parameters, "ssids")) && cJSON_IsArray(ssids)) 
+        {
+            cJSON_ArrayForEach(item, ssids)
             {
-                if (ssid)
+                if (!cJSON_IsString(item) || (request->peers == SURVEY_MAX_SSIDS))
                 {
-                    strcpy(ssid,"?") ;
-                    if ( (parameters = cJSON_GetObjectItem(root, "parameters"))  ) 
-                    {
-                        if (cJSON_GetObjectItem(parameters, "ssid"))
-                        {
-                            char *s ;
-                            if ( (s = cJSON_GetObjectItem(parameters,"ssid")->valuestring) )
-                            {
-                                strncpy(ssid,s,127) ;
-                            }
-                        }
-                    }
+                    request->peers = 0 ;
+                    break ;
                 }
-                ret = 1 ;
-                ESP_LOGI(TAG, "scan function") ;
+                strncpy(request->ssid[request->peers], item->valuestring, SURVEY_SSID_LENGTH - 1) ;
+                request->ssid[request->peers][SURVEY_SSID_LENGTH - 1] = 0 ;
+                request->peers++ ;
             }
         }
-	    cJSON_Delete(root);        
+
+        if (parameters && cJSON_GetObjectItem(parameters, "rounds")) 
+        {
+            request->rounds = cJSON_GetObjectItem(parameters,"rounds")->valueint ;
+        }
+
+        if (parameters && cJSON_GetObjectItem(parameters, "count")) 
+        {
+            request->count = cJSON_GetObjectItem(parameters,"count")->valueint ;
+        }
+
+        if (parameters && cJSON_GetObjectItem(parameters, "burst")) 
+        {
+            request->burst_period = cJSON_GetObjectItem(parameters,"burst")->valueint ;
+        }
+        ret = 1 ;
+        ESP_LOGI(TAG, "survey function") ;
+    }
+    return ret ;
+}
+
+//
+// Parse the "radio" command
+//
+// "action" : "info" ( default ) , "set" ( implied by any field ) or "reset"
+// fields : "channel" , "bandwidth" ( 20 or 40 ) , "tx_power" ( dBm ) , "ftm_responder" ( true / false )
+//
+// out of range values are left for radio_check() to reject
+//
+unsigned int parser_radio(cJSON *root, unsigned int *action, radio_config_t *config, unsigned int *fields)
+{
+    unsigned int ret = 0 ;
+	cJSON *parameters , *item ;
+
+    if (root && action && config && fields) 
+    {
+        *action = RADIO_ACTION_INFO ;
+        *fields = 0 ;
+        memset(config, 0, sizeof(radio_config_t)) ;
+
+        parameters = cJSON_GetObjectItem(root, "parameters") ;
+
+        if (parameters && (item = cJSON_GetObjectItem(parameters, "channel"))) 
+        {
+            config->channel = ((item->valueint > 0) && (item->valueint < 256)) ? item->valueint : 0 ;
+            *fields |= RADIO_FIELD_CHANNEL ;
+        }
+
+        if (parameters && (item = cJSON_GetObjectItem(parameters, "bandwidth"))) 
+        {
+            config->bandwidth = ((item->valueint > 0) && (item->valueint < 256)) ? item->valueint : 0 ;
+            *fields |= RADIO_FIELD_BANDWIDTH ;
+        }
+
+        if (parameters && (item = cJSON_GetObjectItem(parameters, "tx_power"))) 
+        {
+            config->tx_power = ((item->valueint > 0) && (item->valueint < 128)) ? item->valueint : 0 ;
+            *fields |= RADIO_FIELD_TX_POWER ;
+        }
+
+        if (parameters && (item = cJSON_GetObjectItem(parameters, "ftm_responder"))) 
+        {
+            config->ftm_responder = cJSON_IsTrue(item) ;
+            *fields |= RADIO_FIELD_FTM_RESPONDER ;
+        }
+
+        if (*fields) *action = RADIO_ACTION_SET ;
+
+        if (parameters && cJSON_GetObjectItem(parameters, "action")) 
+        {
+            char *s = cJSON_GetObjectItem(parameters,"action")->valuestring ;
+
+            if (s && !strcmp(s,"set"))          *action = RADIO_ACTION_SET ;
+            else if (s && !strcmp(s,"reset"))   *action = RADIO_ACTION_RESET ;
+            else if (s && !strcmp(s,"info"))    *action = RADIO_ACTION_INFO ;
+        }
+        ret = 1 ;
+        ESP_LOGI(TAG, "radio function") ;
+    }
+    return ret ;
+}
+
+//
+// Parse the "responder" command
+//
+// "action" : "info" ( default ) , "calibrate" ( implied by "distance_cm" ) , "reset" or "clear"
+// calibrate : "distance_cm" and either "measured_cm" or a peer "ssid" ( "rounds" , "count" , "burst" )
+//
+unsigned int parser_responder(cJSON *root, unsigned int *action, responder_calibration_t *request)
+{
+    unsigned int ret = 0 ;
+	cJSON *parameters ;
+
+    if (root && action && request) 
+    {
+        *action = RESPONDER_ACTION_INFO ;
+        memset(request, 0, sizeof(responder_calibration_t)) ;
+        request->measured_cm = RESPONDER_NO_MEASUREMENT ;
+        request->rounds = RESPONDER_DEFAULT_ROUNDS ;
+        request->count = RESPONDER_DEFAULT_COUNT ;
+        request->burst_period = RESPONDER_DEFAULT_BURST ;
+
+        parameters = cJSON_GetObjectItem(root, "parameters") ;
+
+        if (parameters && cJSON_GetObjectItem(parameters, "distance_cm")) 
+        {
+            request->distance_cm = cJSON_GetObjectItem(parameters,"distance_cm")->valueint ;
+            *action = RESPONDER_ACTION_CALIBRATE ;
+        }
+
+        if (parameters && cJSON_GetObjectItem(parameters, "measured_cm")) 
+        {
+            request->measured_cm = cJSON_GetObjectItem(parameters,"measured_cm")->valueint ;
+            if (request->measured_cm < 0) request->distance_cm = 0 ;            // rejected by responder_calibrate()
+        }
+
+        if (parameters && cJSON_GetObjectItem(parameters, "ssid")) 
+        {
+            char *s = cJSON_GetObjectItem(parameters,"ssid")->valuestring ;
+
+            if (s)
+            {
+                strncpy(request->ssid, s, RESPONDER_SSID_LENGTH - 1) ;
+                request->ssid[RESPONDER_SSID_LENGTH - 1] = 0 ;
+            }
+        }
+
+        if (parameters && cJSON_GetObjectItem(parameters, "rounds")) 
+        {
+            request->rounds = cJSON_GetObjectItem(parameters,"rounds")->valueint ;
+        }
+
+        if (parameters && cJSON_GetObjectItem(parameters, "count")) 
+        {
+            request->count = cJSON_GetObjectItem(parameters,"count")->valueint ;
+        }
+
+        if (parameters && cJSON_GetObjectItem(parameters, "burst")) 
+        {
+            request->burst_period = cJSON_GetObjectItem(parameters,"burst")->valueint ;
+        }
+
+        if (parameters && cJSON_GetObjectItem(parameters, "action")) 
+        {
+            char *s = cJSON_GetObjectItem(parameters,"action")->valuestring ;
+
+            if (s && !strcmp(s,"calibrate"))    *action = RESPONDER_ACTION_CALIBRATE ;
+            else if (s && !strcmp(s,"reset"))   *action = RESPONDER_ACTION_RESET ;
+            else if (s && !strcmp(s,"clear"))   *action = RESPONDER_ACTION_CLEAR ;
+            else if (s && !strcmp(s,"info"))    *action = RESPONDER_ACTION_INFO ;
+        }
+        ret = 1 ;
+        ESP_LOGI(TAG, "responder function") ;
     }
     return ret ;
 }
@@ -36,9 +36,37 @@
     extern "C" {
     #endif
 
-    extern unsigned int parser_ftm_by_ssid(unsigned char * string, char *ssid, unsigned int *count, unsigned int *burst_period) ;
-    extern unsigned int parser_ftm_by_mac(unsigned char * string, unsigned char *mac, unsigned int *channel, unsigned int *count, unsigned int *burst_period) ;
-    extern unsigned int parser_scan(unsigned char * string, char *ssid) ;
+    #include "cJSON.h"               // { cJSON }
+    #include "ftm.h"                 // { ftm_options_t }
+    #include "history.h"             // { history_query_t }
+    #include "journal.h"             // { JOURNAL_ACTION_xxx }
+    #include "metrics.h"             // { METRICS_FORMAT_xxx }
+    #include "trace.h"               // { TRACE_ACTION_xxx }
+    #include "capture.h"             // { CAPTURE_ACTION_xxx , CAPTURE_SPEED_xxx }
+    #include "survey.h"              // { survey_request_t }
+    #include "radio.h"               // { radio_config_t }
+    #include "responder.h"           // { responder_calibration_t }
+
+    extern cJSON *parser_parse(unsigned char * string) ;
+    extern const char *parser_function(cJSON *root) ;
+    extern void parser_release(cJSON *root) ;
+    extern unsigned int parser_ftm_by_ssid(cJSON *root, char *ssid, unsigned int *count, unsigned int *burst_period, ftm_options_t *options) ;
+    extern unsigned int parser_ftm_by_mac(cJSON *root, unsigned char *mac, unsigned int *channel, unsigned int *count, unsigned int *burst_period, ftm_options_t *options) ;
+    extern unsigned int parser_ftm_all(cJSON *root, unsigned int *count, unsigned int *burst_period, int *min_rssi, ftm_options_t *options) ;
+    extern unsigned int parser_scan(cJSON *root, char *ssid, unsigned int *timing) ;
+    extern unsigned int parser_pool(cJSON *root) ;
+    extern unsigned int parser_history(cJSON *root, history_query_t *query) ;
+    extern unsigned int parser_journal(cJSON *root, unsigned int *action) ;
+    extern unsigned int parser_stats(cJSON *root, unsigned int *format) ;
+    extern unsigned int parser_trace(cJSON *root, unsigned int *action) ;
+    extern unsigned int parser_log(cJSON *root, char *module, int *level, int *console, int *report) ;
+    extern unsigned int parser_capture(cJSON *root, unsigned int *action, unsigned int *speed, ftm_options_t *options) ;
+    extern unsigned int parser_streams(cJSON *root) ;
+    extern unsigned int parser_subscribe(cJSON *root, unsigned int *mask, unsigned int *policy) ;
+    extern unsigned int parser_udp(cJSON *root, unsigned int *action, char *host, unsigned int *port, unsigned int *format) ;
+    extern unsigned int parser_survey(cJSON *root, survey_request_t *request) ;
+    extern unsigned int parser_radio(cJSON *root, unsigned int *action, radio_config_t *config, unsigned int *fields) ;
+    extern unsigned int parser_responder(cJSON *root, unsigned int *action, responder_calibration_t *request) ;
 
     #ifdef __cplusplus
     }
@@ -0,0 +1,309 @@
+/*
+    pool.c - Fixed-Block Memory Pools
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+//
+// Three size classes (small/medium/large) of fixed-size blocks, carved out of
+// static arrays at build time. Allocation and release are O(1) (free-index stack)
+// and never touch the heap, so long ranging runs keep a flat heap profile.
+//
+// A request is served by the smallest class that fits; if that class is exhausted
+// the next larger class is tried before the allocation is refused.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "cJSON.h"
+#include "tool.h"
+#include "pool.h"
+
+#define POOL_LINE_BUFFER_LENGTH     256
+
+typedef struct {
+    unsigned char  *area ;          // block storage ( block_count * block_size bytes )
+    unsigned short *free_list ;     // stack of free block indexes
+    unsigned char  *used ;          // per block "in use" flag ( guards against double free )
+    unsigned int    free_top ;      // number of entries in the free stack
+    pool_stats_t    stats ;
+} pool_class_t ;
+
+static const char *TAG = "pool" ;
+
+static unsigned char  pool_small_area[POOL_SMALL_BLOCK_COUNT][POOL_SMALL_BLOCK_SIZE] __attribute__((aligned(8))) ;
+static unsigned char  pool_medium_area[POOL_MEDIUM_BLOCK_COUNT][POOL_MEDIUM_BLOCK_SIZE] __attribute__((aligned(8))) ;
+static unsigned char  pool_large_area[POOL_LARGE_BLOCK_COUNT][POOL_LARGE_BLOCK_SIZE] __attribute__((aligned(8))) ;
+
+static unsigned short pool_small_free[POOL_SMALL_BLOCK_COUNT] ;
+static unsigned short pool_medium_free[POOL_MEDIUM_BLOCK_COUNT] ;
+static unsigned short pool_large_free[POOL_LARGE_BLOCK_COUNT] ;
+
+static unsigned char  pool_small_used[POOL_SMALL_BLOCK_COUNT] ;
+static unsigned char  pool_medium_used[POOL_MEDIUM_BLOCK_COUNT] ;
+static unsigned char  pool_large_used[POOL_LARGE_BLOCK_COUNT] ;
+
+static pool_class_t pool_class[POOL_NUM_CLASSES] = {
+    { (unsigned char *) pool_small_area,  pool_small_free,  pool_small_used,  0, { POOL_SMALL_BLOCK_SIZE,  POOL_SMALL_BLOCK_COUNT  } },
+    { (unsigned char *) pool_medium_area, pool_medium_free, pool_medium_used, 0, { POOL_MEDIUM_BLOCK_SIZE, POOL_MEDIUM_BLOCK_COUNT } },
+    { (unsigned char *) pool_large_area,  pool_large_free,  pool_large_used,  0, { POOL_LARGE_BLOCK_SIZE,  POOL_LARGE_BLOCK_COUNT  } },
+} ;
+
+static const char *pool_class_name[POOL_NUM_CLASSES] = { "small", "medium", "large" } ;
+
+static portMUX_TYPE pool_spinlock = portMUX_INITIALIZER_UNLOCKED ;
+
+// FUNCTION PROTOTYPES
+void  pool_init(void) ;
+void *pool_alloc(unsigned int size) ;
+void *pool_alloc_or_heap(unsigned int size) ;
+void  pool_free(void *ptr) ;
+unsigned int pool_get_stats(unsigned int class_index, pool_stats_t *stats) ;
+void  pool_report(void (*callback)(unsigned char *buffer, unsigned int len)) ;
+static void *pool_take_block(pool_class_t *pc) ;
+static void *pool_take(unsigned int size, unsigned int *class_index) ;
+static void *pool_json_malloc(size_t size) ;
+
+//
+// Pop a free block from a pool class ( caller holds the spinlock )
+//
+static void *pool_take_block(pool_class_t *pc)
+{
+    unsigned int index ;
+
+    if (pc->free_top == 0)
+        return NULL ;
+
+    index = pc->free_list[--pc->free_top] ;
+    pc->used[index] = 1 ;
+
+    pc->stats.in_use++ ;
+    pc->stats.allocs++ ;
+    if (pc->stats.in_use > pc->stats.high_water)
+    {
+        pc->stats.high_water = pc->stats.in_use ;
+    }
+
+    return pc->area + (index * pc->stats.block_size) ;
+}
+
+//
+// Take a block of (at least) <size> bytes from the smallest class that has one ( caller holds the spinlock )
+//
+// <class_index> : class that should have served the request ( where a miss is accounted )
+//
+static void *pool_take(unsigned int size, unsigned int *class_index)
+{
+    void *ptr = NULL ;
+    int first = -1 ;
+    int k ;
+
+    for (k=0; k<POOL_NUM_CLASSES; k++)
+    {
+        if (size <= pool_class[k].stats.block_size)
+        {
+            if (first < 0) first = k ;
+
+            if ( (ptr = pool_take_block(&pool_class[k])) )
+                break ;
+        }
+    }
+
+    *class_index = (first < 0) ? (POOL_NUM_CLASSES-1) : first ;
+
+    return ptr ;
+}
+
+//
+// Allocate a block of (at least) <size> bytes
+//
+// returns NULL if no pool class can serve the request
+//
+void *pool_alloc(unsigned int size)
+{
+    void *ptr ;
+    unsigned int k ;
+
+    portENTER_CRITICAL(&pool_spinlock) ;
+
+    if ( !(ptr = pool_take(size, &k)) )
+    {
+        pool_class[k].stats.failures++ ;
+    }
+
+    portEXIT_CRITICAL(&pool_spinlock) ;
+
+    return ptr ;
+}
+
+//
+// Allocate from the pools, falling back to the heap when they cannot serve the request
+//
+// A heap fallback is only accounted as a fallback ; failures are the requests left without memory
+//
+void *pool_alloc_or_heap(unsigned int size)
+{
+    void *ptr ;
+    unsigned int k ;
+
+    portENTER_CRITICAL(&pool_spinlock) ;
+    ptr = pool_take(size, &k) ;
+    portEXIT_CRITICAL(&pool_spinlock) ;
+
+    if (ptr)
+        return ptr ;
+
+    ptr = malloc(size) ;
+
+    portENTER_CRITICAL(&pool_spinlock) ;
+    if (ptr) pool_class[k].stats.fallbacks++ ;
+    else pool_class[k].stats.failures++ ;
+    portEXIT_CRITICAL(&pool_spinlock) ;
+
+    return ptr ;
+}
+
+//
+// Release a block ( pointers that do not belong to any pool are returned to the heap )
+//
+void pool_free(void *ptr)
+{
+    unsigned char *p = (unsigned char *) ptr ;
+    unsigned int index, released ;
+    int k ;
+
+    if (!p)
+        return ;
+
+    for (k=0; k<POOL_NUM_CLASSES; k++)
+    {
+        pool_class_t *pc = &pool_class[k] ;
+
+        if ( (p >= pc->area) && (p < pc->area + (pc->stats.block_count * pc->stats.block_size)) )
+        {
+            index = (p - pc->area) / pc->stats.block_size ;
+            released = 0 ;
+
+            portENTER_CRITICAL(&pool_spinlock) ;
+            if (pc->used[index])
+            {
+                pc->used[index] = 0 ;
+                pc->free_list[pc->free_top++] = index ;
+                pc->stats.in_use-- ;
+                released = 1 ;
+            }
+            portEXIT_CRITICAL(&pool_spinlock) ;
+
+            if (!released)
+            {
+                ESP_LOGE(TAG, "double free in %s pool (block %u)", pool_class_name[k], index) ;
+            }
+            return ;
+        }
+    }
+
+    free(ptr) ;
+}
+
+//
+// cJSON allocation hook ( cJSON nodes and strings are served by the small pool )
+//
+static void *pool_json_malloc(size_t size)
+{
+    return pool_alloc_or_heap((unsigned int) size) ;
+}
+
+//
+// Copy the statistics of a pool class
+//
+unsigned int pool_get_stats(unsigned int class_index, pool_stats_t *stats)
+{
+    if ( (class_index >= POOL_NUM_CLASSES) || !stats )
+        return 0 ;
+
+    portENTER_CRITICAL(&pool_spinlock) ;
+    *stats = pool_class[class_index].stats ;
+    portEXIT_CRITICAL(&pool_spinlock) ;
+
+    return 1 ;
+}
+
+//
+// Report usage counters and failure statistics of every pool class
+//
+void pool_report(void (*callback)(unsigned char *buffer, unsigned int len))
+{
+    char line[POOL_LINE_BUFFER_LENGTH] ;
+    pool_stats_t stats ;
+    unsigned int k ;
+
+    sprintf(line, "Pool Report:") ;
+    tool_log(TAG, line, 0, callback) ;
+
+    sprintf(line, "| Class  | Block | Count | In Use | High |   Allocs   | Failures | Fallbacks |") ;
+    tool_log(TAG, line, 0, callback) ;
+
+    for (k=0; k<POOL_NUM_CLASSES; k++)
+    {
+        pool_get_stats(k, &stats) ;
+        sprintf(line, "| %-6s | %5u | %5u | %6u | %4u | %10u | %8u | %9u |",
+                      pool_class_name[k], stats.block_size, stats.block_count,
+                      stats.in_use, stats.high_water, stats.allocs,
+                      stats.failures, stats.fallbacks) ;
+        tool_log(TAG, line, 0, callback) ;
+    }
+}
+
+//
+// Pool Initialization
+//
+void pool_init(void)
+{
+    unsigned int k, m ;
+    cJSON_Hooks hooks = {
+        .malloc_fn = pool_json_malloc,
+        .free_fn = pool_free,
+    } ;
+
+    for (k=0; k<POOL_NUM_CLASSES; k++)
+    {
+        pool_class_t *pc = &pool_class[k] ;
+
+        for (m=0; m<pc->stats.block_count; m++)
+        {
+            pc->free_list[m] = (unsigned short) (pc->stats.block_count - 1 - m) ;
+            pc->used[m] = 0 ;
+        }
+        pc->free_top = pc->stats.block_count ;
+    }
+
+    // ROUTE cJSON ALLOCATIONS THROUGH THE POOLS
+    cJSON_InitHooks(&hooks) ;
+}
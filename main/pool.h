@@ -0,0 +1,71 @@
+/*
+    pool.h - Fixed-Block Memory Pools
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+#ifndef _POOL_H
+
+#define _POOL_H	1
+
+    #ifdef __cplusplus
+    extern "C" {
+    #endif
+
+        #define POOL_SMALL_BLOCK_SIZE       CONFIG_ESP_POOL_SMALL_BLOCK_SIZE
+        #define POOL_SMALL_BLOCK_COUNT      CONFIG_ESP_POOL_SMALL_BLOCK_COUNT
+        #define POOL_MEDIUM_BLOCK_SIZE      CONFIG_ESP_POOL_MEDIUM_BLOCK_SIZE
+        #define POOL_MEDIUM_BLOCK_COUNT     CONFIG_ESP_POOL_MEDIUM_BLOCK_COUNT
+        #define POOL_LARGE_BLOCK_SIZE       CONFIG_ESP_POOL_LARGE_BLOCK_SIZE
+        #define POOL_LARGE_BLOCK_COUNT      CONFIG_ESP_POOL_LARGE_BLOCK_COUNT
+
+        #define POOL_NUM_CLASSES            3
+
+        typedef struct {
+            unsigned int block_size ;       // size of each block (bytes)
+            unsigned int block_count ;      // number of blocks in the pool
+            unsigned int in_use ;           // blocks currently allocated
+            unsigned int high_water ;       // maximum number of blocks allocated at the same time
+            unsigned int allocs ;           // successful allocations
+            unsigned int failures ;         // allocations that returned NULL
+            unsigned int fallbacks ;        // allocations served by the heap instead of the pool
+        } pool_stats_t ;
+
+        extern void  pool_init(void) ;
+        extern void *pool_alloc(unsigned int size) ;
+        extern void *pool_alloc_or_heap(unsigned int size) ;
+        extern void  pool_free(void *ptr) ;
+        extern unsigned int pool_get_stats(unsigned int class_index, pool_stats_t *stats) ;
+        extern void  pool_report(void (*callback)(unsigned char *buffer, unsigned int len)) ;
+
+    #ifdef __cplusplus
+    }
+    #endif
+
+#endif
+
+
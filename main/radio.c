@@ -0,0 +1,409 @@
+/*
+    radio.c - Radio Configuration
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+//
+// SoftAP channel , bandwidth ( both interfaces ) , TX power and FTM responder flag ,
+// changed at run time by the "radio" command and kept in NVS across reboots :
+//
+//   { "function" : "radio" , "parameters" : { "channel" : 11 , "bandwidth" : 40 ,
+//                                               "tx_power" : 15 , "ftm_responder" : true }} ;
+//
+// The build configuration ( CONFIG_ESP_WIFI_CHANNEL , CONFIG_ESP_RADIO_xxx ) only gives
+// the defaults. A channel change restarts the SoftAP : its stations, including the
+// command client, have to associate again on the new channel.
+//
+// Each switch splits the ranging history : the report compares the mean RTT spread
+// ( per-exchange distance deviation ) of the sessions run before and after it.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "nvs_flash.h"
+#include "tool.h"
+#include "history.h"
+#include "radio.h"
+
+#define RADIO_NVS_VERSION               1
+#define RADIO_NVS_SIZE                  5           // version , channel , bandwidth , tx power , ftm responder
+#define RADIO_LINE_BUFFER_LENGTH        256
+
+#if (CONFIG_ESP_RADIO_HT40)
+    #define RADIO_DEFAULT_BANDWIDTH     40
+#else
+    #define RADIO_DEFAULT_BANDWIDTH     20
+#endif
+
+static struct {
+    radio_config_t config ;                         // current configuration
+    radio_config_t previous ;                       // configuration before the last switch
+    unsigned int  saved ;                           // current configuration read from or written to NVS
+    unsigned int  switches ;
+    uint32_t      switch_ms ;                       // last switch ( 0 : none since boot )
+    uint32_t      previous_ms ;                     // switch before the last one ( 0 : boot )
+} radio_control ;
+
+static const char *TAG = "radio" ;
+
+// FUNCTION PROTOTYPES
+void radio_init(void) ;
+void radio_setup(wifi_config_t *wifi_config) ;
+void radio_start(void) ;
+unsigned int radio_check(const radio_config_t *config, unsigned int fields,
+                         void (*callback)(unsigned char *buffer, unsigned int len)) ;
+unsigned int radio_set(const radio_config_t *config, unsigned int fields,
+                       void (*callback)(unsigned char *buffer, unsigned int len)) ;
+void radio_reset(void (*callback)(unsigned char *buffer, unsigned int len)) ;
+void radio_info(void (*callback)(unsigned char *buffer, unsigned int len)) ;
+static void radio_default(radio_config_t *config) ;
+static unsigned int radio_valid(const radio_config_t *config) ;
+static void radio_merge(radio_config_t *config, const radio_config_t *update, unsigned int fields) ;
+static esp_err_t radio_apply(const radio_config_t *config) ;
+static unsigned int radio_load(radio_config_t *config) ;
+static unsigned int radio_save(const radio_config_t *config) ;
+static void radio_switch(const radio_config_t *config, const char *reason,
+                         void (*callback)(unsigned char *buffer, unsigned int len)) ;
+
+//
+// Build configuration
+//
+static void radio_default(radio_config_t *config)
+{
+    config->channel = CONFIG_ESP_WIFI_CHANNEL ;
+    config->bandwidth = RADIO_DEFAULT_BANDWIDTH ;
+    config->tx_power = CONFIG_ESP_RADIO_TX_POWER ;
+    config->ftm_responder = 1 ;
+}
+
+//
+// Check a configuration
+//
+static unsigned int radio_valid(const radio_config_t *config)
+{
+    return (config->channel >= RADIO_MIN_CHANNEL) && (config->channel <= RADIO_MAX_CHANNEL) &&
+           ((config->bandwidth == 20) || (config->bandwidth == 40)) &&
+           (config->tx_power >= RADIO_MIN_TX_POWER) && (config->tx_power <= RADIO_MAX_TX_POWER) &&
+           (config->ftm_responder <= 1) ;
+}
+
+//
+// Copy the given fields of a command over a configuration
+//
+static void radio_merge(radio_config_t *config, const radio_config_t *update, unsigned int fields)
+{
+    if (fields & RADIO_FIELD_CHANNEL)       config->channel = update->channel ;
+    if (fields & RADIO_FIELD_BANDWIDTH)     config->bandwidth = update->bandwidth ;
+    if (fields & RADIO_FIELD_TX_POWER)      config->tx_power = update->tx_power ;
+    if (fields & RADIO_FIELD_FTM_RESPONDER) config->ftm_responder = update->ftm_responder ;
+}
+
+//
+// Program the driver ( WiFi started )
+//
+static esp_err_t radio_apply(const radio_config_t *config)
+{
+    wifi_config_t wifi_config ;
+    wifi_bandwidth_t bandwidth = (config->bandwidth == 40) ? WIFI_BW_HT40 : WIFI_BW_HT20 ;
+    esp_err_t err ;
+
+    if ((err = esp_wifi_set_bandwidth(WIFI_IF_STA, bandwidth)) != ESP_OK) return err ;
+    if ((err = esp_wifi_set_bandwidth(WIFI_IF_AP, bandwidth)) != ESP_OK) return err ;
+
+    // THE SOFTAP RESTARTS ON THE NEW CHANNEL
+    if ((err = esp_wifi_get_config(WIFI_IF_AP, &wifi_config)) != ESP_OK) return err ;
+    wifi_config.ap.channel = config->channel ;
+    wifi_config.ap.ftm_responder = config->ftm_responder ;
+    if ((err = esp_wifi_set_config(WIFI_IF_AP, &wifi_config)) != ESP_OK) return err ;
+
+    return esp_wifi_set_max_tx_power(config->tx_power * 4) ;
+}
+
+//
+// Read the stored configuration
+//
+// returns 1 if a valid configuration was found
+//
+static unsigned int radio_load(radio_config_t *config)
+{
+    nvs_handle_t handle ;
+    uint8_t blob[RADIO_NVS_SIZE] ;
+    size_t len = sizeof(blob) ;
+    radio_config_t stored ;
+    esp_err_t err ;
+
+    if (nvs_open(RADIO_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK)
+        return 0 ;
+
+    err = nvs_get_blob(handle, RADIO_NVS_KEY, blob, &len) ;
+    nvs_close(handle) ;
+
+    if ( (err != ESP_OK) || (len != RADIO_NVS_SIZE) || (blob[0] != RADIO_NVS_VERSION) )
+        return 0 ;
+
+    stored.channel = blob[1] ;
+    stored.bandwidth = blob[2] ;
+    stored.tx_power = (int8_t) blob[3] ;
+    stored.ftm_responder = blob[4] ;
+
+    if (!radio_valid(&stored))
+        return 0 ;
+
+    *config = stored ;
+    return 1 ;
+}
+
+//
+// Store a configuration ( NULL : erase the stored configuration )
+//
+// returns 1 on success
+//
+static unsigned int radio_save(const radio_config_t *config)
+{
+    nvs_handle_t handle ;
+    uint8_t blob[RADIO_NVS_SIZE] ;
+    esp_err_t err ;
+
+    if ((err = nvs_open(RADIO_NVS_NAMESPACE, NVS_READWRITE, &handle)) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "nvs_open failed (%s)", esp_err_to_name(err)) ;
+        return 0 ;
+    }
+
+    if (config)
+    {
+        blob[0] = RADIO_NVS_VERSION ;
+        blob[1] = config->channel ;
+        blob[2] = config->bandwidth ;
+        blob[3] = (uint8_t) config->tx_power ;
+        blob[4] = config->ftm_responder ;
+        err = nvs_set_blob(handle, RADIO_NVS_KEY, blob, sizeof(blob)) ;
+    }
+    else
+    {
+        err = nvs_erase_key(handle, RADIO_NVS_KEY) ;
+        if (err == ESP_ERR_NVS_NOT_FOUND) err = ESP_OK ;
+    }
+
+    if (err == ESP_OK) err = nvs_commit(handle) ;
+    nvs_close(handle) ;
+
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "nvs write failed (%s)", esp_err_to_name(err)) ;
+        return 0 ;
+    }
+    return 1 ;
+}
+
+//
+// Switch to a configuration ( already checked ) and start a new spread period
+//
+static void radio_switch(const radio_config_t *config, const char *reason,
+                         void (*callback)(unsigned char *buffer, unsigned int len))
+{
+    char line[RADIO_LINE_BUFFER_LENGTH] ;
+    esp_err_t err ;
+
+    err = radio_apply(config) ;
+    if (err != ESP_OK)
+    {
+        sprintf(line, "Radio - Switch failed (%s), restoring the previous configuration", esp_err_to_name(err)) ;
+        tool_log(TAG, line, 1, callback) ;
+        radio_apply(&radio_control.config) ;
+        return ;
+    }
+
+    radio_control.previous = radio_control.config ;
+    radio_control.config = *config ;
+    radio_control.previous_ms = radio_control.switch_ms ;
+    radio_control.switch_ms = (uint32_t) (esp_timer_get_time() / 1000) ;
+    radio_control.switches++ ;
+
+    ESP_LOGI(TAG, "%s : channel %u , HT%u , %d dBm , FTM responder %s", reason,
+             config->channel, config->bandwidth, config->tx_power, config->ftm_responder ? "on" : "off") ;
+}
+
+//
+// Check the fields of a "radio" command and announce the switch
+//
+// The announcement should be flushed before radio_set() : a channel change drops
+// the connection of the command client.
+//
+// returns 1 if the configuration is valid
+//
+unsigned int radio_check(const radio_config_t *config, unsigned int fields,
+                         void (*callback)(unsigned char *buffer, unsigned int len))
+{
+    radio_config_t next = radio_control.config ;
+    char line[RADIO_LINE_BUFFER_LENGTH] ;
+
+    radio_merge(&next, config, fields) ;
+
+    if (!fields || !radio_valid(&next))
+    {
+        sprintf(line, "Invalid Radio Configuration! Valid options are channel %d-%d, bandwidth 20/40, tx_power %d-%d dBm, ftm_responder true/false",
+                      RADIO_MIN_CHANNEL, RADIO_MAX_CHANNEL, RADIO_MIN_TX_POWER, RADIO_MAX_TX_POWER) ;
+        tool_log(TAG, line, 1, callback) ;
+        return 0 ;
+    }
+
+    sprintf(line, "Radio - Switching to Channel %u , Bandwidth HT%u , TX Power %d dBm , FTM Responder %s%s",
+                  next.channel, next.bandwidth, next.tx_power, next.ftm_responder ? "on" : "off",
+                  (next.channel != radio_control.config.channel) ? " (the SoftAP restarts : reconnect on the new channel)" : "") ;
+    tool_log(TAG, line, 0, callback) ;
+
+    return 1 ;
+}
+
+//
+// Apply and store the fields of a "radio" command ( checked by radio_check() )
+//
+// returns 1 if the configuration was applied
+//
+unsigned int radio_set(const radio_config_t *config, unsigned int fields,
+                       void (*callback)(unsigned char *buffer, unsigned int len))
+{
+    radio_config_t next = radio_control.config ;
+    unsigned int switches = radio_control.switches ;
+
+    radio_merge(&next, config, fields) ;
+    if (!radio_valid(&next))
+        return 0 ;
+
+    radio_switch(&next, "switched", callback) ;
+    if (radio_control.switches == switches)
+        return 0 ;
+
+    radio_control.saved = radio_save(&radio_control.config) ;
+
+    return 1 ;
+}
+
+//
+// Back to the build configuration ( the stored configuration is erased )
+//
+void radio_reset(void (*callback)(unsigned char *buffer, unsigned int len))
+{
+    radio_config_t config ;
+
+    radio_default(&config) ;
+    radio_switch(&config, "reset", callback) ;
+    radio_save(0) ;
+    radio_control.saved = 0 ;
+}
+
+//
+// Report the configuration and the RTT spread before and after the last switch
+//
+void radio_info(void (*callback)(unsigned char *buffer, unsigned int len))
+{
+    char line[RADIO_LINE_BUFFER_LENGTH] ;
+    wifi_bandwidth_t bandwidth = WIFI_BW_HT20 ;
+    int8_t power = 0 ;
+    unsigned int before_n , after_n ;
+    float before , after ;
+
+    esp_wifi_get_bandwidth(WIFI_IF_AP, &bandwidth) ;
+    esp_wifi_get_max_tx_power(&power) ;
+
+    sprintf(line, "Radio - Channel %u , Bandwidth HT%u (driver HT%u) , TX Power %d dBm (driver %.2f dBm) , FTM Responder %s , %s",
+                  radio_control.config.channel, radio_control.config.bandwidth, (bandwidth == WIFI_BW_HT40) ? 40 : 20,
+                  radio_control.config.tx_power, power / 4.0f, radio_control.config.ftm_responder ? "on" : "off",
+                  radio_control.saved ? "Stored (NVS)" : "Build Configuration") ;
+    tool_log(TAG, line, 0, callback) ;
+
+    if (!radio_control.switch_ms)
+    {
+        after = history_spread(0, 0, &after_n) ;
+        sprintf(line, "Radio - No switch since boot , RTT Spread %.2f cm (%u sessions)", after, after_n) ;
+        tool_log(TAG, line, 0, callback) ;
+        return ;
+    }
+
+    before = history_spread(radio_control.previous_ms, radio_control.switch_ms, &before_n) ;
+    after = history_spread(radio_control.switch_ms, 0, &after_n) ;
+
+    sprintf(line, "Radio - Switch %u , %u mSec ago , from Channel %u HT%u %d dBm",
+                  radio_control.switches, (unsigned int) (esp_timer_get_time() / 1000) - radio_control.switch_ms,
+                  radio_control.previous.channel, radio_control.previous.bandwidth, radio_control.previous.tx_power) ;
+    tool_log(TAG, line, 0, callback) ;
+
+    if (before_n && after_n)
+    {
+        sprintf(line, "Radio - RTT Spread before %.2f cm (%u sessions) , after %.2f cm (%u sessions) , change %+.1f%%",
+                      before, before_n, after, after_n, (after - before) * 100.0f / before) ;
+    }
+    else
+    {
+        sprintf(line, "Radio - RTT Spread before %.2f cm (%u sessions) , after %.2f cm (%u sessions)",
+                      before, before_n, after, after_n) ;
+    }
+    tool_log(TAG, line, 0, callback) ;
+}
+
+//
+// Radio Initialization ( stored configuration , or the build configuration )
+//
+void radio_init(void)
+{
+    memset(&radio_control, 0, sizeof(radio_control)) ;
+    radio_default(&radio_control.config) ;
+
+    radio_control.saved = radio_load(&radio_control.config) ;
+
+    ESP_LOGI(TAG, "channel %u , HT%u , %d dBm , FTM responder %s (%s)",
+             radio_control.config.channel, radio_control.config.bandwidth, radio_control.config.tx_power,
+             radio_control.config.ftm_responder ? "on" : "off", radio_control.saved ? "NVS" : "build") ;
+}
+
+//
+// SoftAP configuration and bandwidth , before esp_wifi_start()
+//
+void radio_setup(wifi_config_t *wifi_config)
+{
+    wifi_bandwidth_t bandwidth = (radio_control.config.bandwidth == 40) ? WIFI_BW_HT40 : WIFI_BW_HT20 ;
+
+    wifi_config->ap.channel = radio_control.config.channel ;
+    wifi_config->ap.ftm_responder = radio_control.config.ftm_responder ;
+
+    esp_wifi_set_bandwidth(WIFI_IF_STA, bandwidth) ;
+    esp_wifi_set_bandwidth(WIFI_IF_AP, bandwidth) ;
+}
+
+//
+// TX power , after esp_wifi_start()
+//
+void radio_start(void)
+{
+    esp_wifi_set_max_tx_power(radio_control.config.tx_power * 4) ;
+}
@@ -0,0 +1,84 @@
+/*
+    radio.h - Radio Configuration
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+#ifndef _RADIO_H
+
+#define _RADIO_H	1
+
+    #ifdef __cplusplus
+    extern "C" {
+    #endif
+
+        #include <stdint.h>
+        #include "esp_wifi.h"               // { wifi_config_t }
+
+        #define RADIO_NVS_NAMESPACE         "radio"
+        #define RADIO_NVS_KEY               "config"
+
+        #define RADIO_ACTION_INFO           0
+        #define RADIO_ACTION_SET            1
+        #define RADIO_ACTION_RESET          2       // back to the build configuration ( NVS entry erased )
+
+        // FIELDS OF A "radio" COMMAND
+        #define RADIO_FIELD_CHANNEL         0x01
+        #define RADIO_FIELD_BANDWIDTH       0x02
+        #define RADIO_FIELD_TX_POWER        0x04
+        #define RADIO_FIELD_FTM_RESPONDER   0x08
+
+        #define RADIO_MIN_CHANNEL           1
+        #define RADIO_MAX_CHANNEL           13
+        #define RADIO_MIN_TX_POWER          2       // dBm ( esp_wifi_set_max_tx_power() : 8..84 quarters of dBm )
+        #define RADIO_MAX_TX_POWER          20
+
+        //
+        // Radio configuration ( SoftAP channel , bandwidth of both interfaces , TX power , FTM responder )
+        //
+        typedef struct {
+            uint8_t       channel ;
+            uint8_t       bandwidth ;                       // MHz : 20 ( HT20 ) or 40 ( HT40 )
+            int8_t        tx_power ;                        // dBm
+            uint8_t       ftm_responder ;
+        } radio_config_t ;
+
+        extern void radio_init(void) ;
+        extern void radio_setup(wifi_config_t *wifi_config) ;
+        extern void radio_start(void) ;
+        extern unsigned int radio_check(const radio_config_t *config, unsigned int fields,
+                                        void (*callback)(unsigned char *buffer, unsigned int len)) ;
+        extern unsigned int radio_set(const radio_config_t *config, unsigned int fields,
+                                      void (*callback)(unsigned char *buffer, unsigned int len)) ;
+        extern void radio_reset(void (*callback)(unsigned char *buffer, unsigned int len)) ;
+        extern void radio_info(void (*callback)(unsigned char *buffer, unsigned int len)) ;
+
+    #ifdef __cplusplus
+    }
+    #endif
+
+#endif
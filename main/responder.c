@@ -0,0 +1,460 @@
+/*
+    responder.c - FTM Responder Accounting and Calibration
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+//
+// Every Chronos answers FTM on its SoftAP. This module keeps the responder side :
+//
+// Accounting - the stations associated to the SoftAP ( WIFI_EVENT_AP_STACONNECTED ,
+// WIFI_EVENT_AP_STADISCONNECTED ) are tracked per MAC : joins , leaves , connected time.
+// The driver reports no event for the FTM requests it answers, so initiators ranging
+// this anchor without associating are not seen.
+//
+// Calibration - the responder offset ( esp_wifi_ftm_resp_set_offset() , in cm of
+// distance , added to the T1 timestamps ) removes the bias of the distances measured
+// against this anchor. The bias comes from a known distance and either :
+//
+//   { "function" : "responder" , "parameters" : { "action" : "calibrate" ,
+//                                                   "distance_cm" : 300 , "measured_cm" : 318 }} ;
+//
+//      the distance measured by an initiator ranging this anchor ( with the current
+//      offset applied : the bias is added to it )
+//
+//   { "function" : "responder" , "parameters" : { "action" : "calibrate" ,
+//                                                   "distance_cm" : 300 , "ssid" : "CHRONOS-REF" }} ;
+//
+//      the distance measured by this anchor to an uncalibrated peer of the same model
+//      ( robust reduction of "rounds" sessions , see survey.c ) : the round trip bias of
+//      the pair becomes the offset
+//
+// The offset is stored in NVS and applied at every boot.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "nvs_flash.h"
+#include "tool.h"
+#include "survey.h"
+#include "bus.h"
+#include "responder.h"
+
+#define RESPONDER_NVS_VERSION           1
+#define RESPONDER_NVS_SIZE              3           // version , offset ( int16 , little endian )
+#define RESPONDER_LINE_BUFFER_LENGTH    256
+
+//
+// Station ( initiator ) associated to the SoftAP
+//
+typedef struct {
+    uint8_t       mac[6] ;
+    uint8_t       aid ;
+    uint8_t       connected ;
+    uint32_t      joins ;
+    uint32_t      leaves ;
+    uint32_t      event_ms ;                        // last join or leave
+    uint32_t      connected_ms ;                    // closed connections
+} responder_station_t ;
+
+static struct {
+    responder_station_t station[RESPONDER_MAX_STATIONS] ;
+    unsigned int  stations ;
+    unsigned int  evictions ;
+    int16_t       offset_cm ;
+    unsigned int  saved ;                           // offset read from or written to NVS
+    esp_err_t     offset_err ;                      // last esp_wifi_ftm_resp_set_offset()
+} responder_control ;
+
+static SemaphoreHandle_t responder_mutex ;
+
+static const char *TAG = "responder" ;
+
+// FUNCTION PROTOTYPES
+void responder_init(void) ;
+void responder_start(void) ;
+void responder_station(const uint8_t *mac, unsigned int aid, unsigned int joined) ;
+unsigned int responder_calibrate(const responder_calibration_t *request,
+                                 void (*callback)(unsigned char *buffer, unsigned int len)) ;
+void responder_reset(void (*callback)(unsigned char *buffer, unsigned int len)) ;
+void responder_clear(void) ;
+void responder_info(void (*callback)(unsigned char *buffer, unsigned int len)) ;
+static void responder_event(const bus_event_t *event, void *arg) ;
+static uint32_t responder_now_ms(void) ;
+static responder_station_t *responder_find(const uint8_t *mac) ;
+static unsigned int responder_load(int16_t *offset_cm) ;
+static unsigned int responder_save(const int16_t *offset_cm) ;
+
+static uint32_t responder_now_ms(void)
+{
+    return (uint32_t) (esp_timer_get_time() / 1000) ;
+}
+
+//
+// Entry of a station , created when missing ( mutex held )
+//
+// A new station replaces the departed station with the oldest event when the table is full
+//
+static responder_station_t *responder_find(const uint8_t *mac)
+{
+    responder_station_t *s , *oldest = 0 ;
+    unsigned int k ;
+
+    for (k = 0; k < responder_control.stations; k++)
+    {
+        s = &responder_control.station[k] ;
+        if (!memcmp(s->mac, mac, 6))
+            return s ;
+
+        if ( !s->connected && (!oldest || ((int32_t) (s->event_ms - oldest->event_ms) < 0)) )
+            oldest = s ;
+    }
+
+    if (responder_control.stations < RESPONDER_MAX_STATIONS)
+    {
+        s = &responder_control.station[responder_control.stations++] ;
+    }
+    else if (oldest)
+    {
+        s = oldest ;
+        responder_control.evictions++ ;
+    }
+    else
+    {
+        return 0 ;
+    }
+
+    memset(s, 0, sizeof(responder_station_t)) ;
+    memcpy(s->mac, mac, 6) ;
+    return s ;
+}
+
+//
+// Station joined or left the SoftAP
+//
+void responder_station(const uint8_t *mac, unsigned int aid, unsigned int joined)
+{
+    responder_station_t *s ;
+    uint32_t now_ms = responder_now_ms() ;
+
+    if (!responder_mutex)
+        return ;
+
+    xSemaphoreTake(responder_mutex, portMAX_DELAY) ;
+    if ((s = responder_find(mac)))
+    {
+        if (joined)
+        {
+            s->joins++ ;
+            s->connected = 1 ;
+        }
+        else
+        {
+            s->leaves++ ;
+            if (s->connected) s->connected_ms += now_ms - s->event_ms ;
+            s->connected = 0 ;
+        }
+        s->aid = (uint8_t) aid ;
+        s->event_ms = now_ms ;
+    }
+    xSemaphoreGive(responder_mutex) ;
+}
+
+//
+// Station events ( bus worker )
+//
+static void responder_event(const bus_event_t *event, void *arg)
+{
+    responder_station(event->data.station.mac, event->data.station.aid, (event->type == BUS_STA_CONNECTED)) ;
+}
+
+//
+// Read the stored offset
+//
+// returns 1 if a valid offset was found
+//
+static unsigned int responder_load(int16_t *offset_cm)
+{
+    nvs_handle_t handle ;
+    uint8_t blob[RESPONDER_NVS_SIZE] ;
+    size_t len = sizeof(blob) ;
+    int16_t offset ;
+    esp_err_t err ;
+
+    if (nvs_open(RESPONDER_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK)
+        return 0 ;
+
+    err = nvs_get_blob(handle, RESPONDER_NVS_KEY, blob, &len) ;
+    nvs_close(handle) ;
+
+    if ( (err != ESP_OK) || (len != RESPONDER_NVS_SIZE) || (blob[0] != RESPONDER_NVS_VERSION) )
+        return 0 ;
+
+    offset = (int16_t) (blob[1] | (blob[2] << 8)) ;
+    if ( (offset < -RESPONDER_MAX_OFFSET_CM) || (offset > RESPONDER_MAX_OFFSET_CM) )
+        return 0 ;
+
+    *offset_cm = offset ;
+    return 1 ;
+}
+
+//
+// Store an offset ( NULL : erase the stored offset )
+//
+// returns 1 on success
+//
+static unsigned int responder_save(const int16_t *offset_cm)
+{
+    nvs_handle_t handle ;
+    uint8_t blob[RESPONDER_NVS_SIZE] ;
+    esp_err_t err ;
+
+    if ((err = nvs_open(RESPONDER_NVS_NAMESPACE, NVS_READWRITE, &handle)) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "nvs_open failed (%s)", esp_err_to_name(err)) ;
+        return 0 ;
+    }
+
+    if (offset_cm)
+    {
+        blob[0] = RESPONDER_NVS_VERSION ;
+        blob[1] = (uint8_t) (*offset_cm & 0xFF) ;
+        blob[2] = (uint8_t) ((uint16_t) *offset_cm >> 8) ;
+        err = nvs_set_blob(handle, RESPONDER_NVS_KEY, blob, sizeof(blob)) ;
+    }
+    else
+    {
+        err = nvs_erase_key(handle, RESPONDER_NVS_KEY) ;
+        if (err == ESP_ERR_NVS_NOT_FOUND) err = ESP_OK ;
+    }
+
+    if (err == ESP_OK) err = nvs_commit(handle) ;
+    nvs_close(handle) ;
+
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "nvs write failed (%s)", esp_err_to_name(err)) ;
+        return 0 ;
+    }
+    return 1 ;
+}
+
+//
+// Measure the bias at a known distance and apply it as the responder offset
+//
+// returns 1 if the offset was applied
+//
+unsigned int responder_calibrate(const responder_calibration_t *request,
+                                 void (*callback)(unsigned char *buffer, unsigned int len))
+{
+    char line[RESPONDER_LINE_BUFFER_LENGTH] ;
+    char mac_string[32] ;
+    survey_peer_t peer ;
+    float measured_cm , bias_cm ;
+    int offset ;
+    esp_err_t err ;
+
+    if ( (request->distance_cm <= 0) || (request->distance_cm > RESPONDER_MAX_DISTANCE_CM) ||
+         ((request->measured_cm == RESPONDER_NO_MEASUREMENT) && !request->ssid[0]) ||
+         !request->rounds || (request->rounds > SURVEY_MAX_ROUNDS) ||
+         ( request->count != 0 && request->count != 8 && request->count != 16 &&
+           request->count != 24 && request->count != 32 && request->count != 64 ) ||
+         (request->burst_period < 2) || (request->burst_period >= 256) )
+    {
+        sprintf(line, "Invalid Calibration! Valid options are distance_cm 1-%d with measured_cm or a peer ssid, rounds 1-%d, count 0/8/16/24/32/64, burst 2-255",
+                      RESPONDER_MAX_DISTANCE_CM, SURVEY_MAX_ROUNDS) ;
+        tool_log(TAG, line, 1, callback) ;
+        return 0 ;
+    }
+
+    if (request->measured_cm != RESPONDER_NO_MEASUREMENT)
+    {
+        // MEASURED AGAINST THIS ANCHOR : THE CURRENT OFFSET WAS ALREADY APPLIED
+        measured_cm = request->measured_cm ;
+        bias_cm = measured_cm - request->distance_cm ;
+        offset = responder_control.offset_cm + (int) (bias_cm >= 0.0f ? bias_cm + 0.5f : bias_cm - 0.5f) ;
+
+        sprintf(line, "Responder - Calibration from an initiator : Distance %d cm , Measured %.1f cm , Bias %+.1f cm",
+                      request->distance_cm, measured_cm, bias_cm) ;
+        tool_log(TAG, line, 0, callback) ;
+    }
+    else
+    {
+        // MEASURED BY THIS ANCHOR : BIAS OF THE PAIR ( THE PEER IS NOT CALIBRATED )
+        tool_perform_scan(0, true, 0, 0) ;
+
+        if (!survey_range(request->ssid, request->rounds, request->count, request->burst_period, &peer))
+        {
+            sprintf(line, "Responder - Calibration failed : %s %s", request->ssid, peer.found ? "gave no distance" : "not found") ;
+            tool_log(TAG, line, 1, callback) ;
+            return 0 ;
+        }
+
+        measured_cm = peer.dist_cm ;
+        bias_cm = measured_cm - request->distance_cm ;
+        offset = (int) (bias_cm >= 0.0f ? bias_cm + 0.5f : bias_cm - 0.5f) ;
+
+        tool_array_to_mac_string(mac_string, peer.mac) ;
+        sprintf(line, "Responder - Calibration from %s (%s) ch %u : Distance %d cm , Measured %.1f cm , Bias %+.1f cm , MAD %.2f cm , Sessions %u/%u , Inliers %u",
+                      request->ssid, mac_string, peer.channel, request->distance_cm, measured_cm, bias_cm,
+                      peer.mad_cm, peer.sessions, request->rounds, peer.inliers) ;
+        tool_log(TAG, line, 0, callback) ;
+    }
+
+    if ( (offset < -RESPONDER_MAX_OFFSET_CM) || (offset > RESPONDER_MAX_OFFSET_CM) )
+    {
+        sprintf(line, "Responder - Calibration rejected : offset %d cm out of range (+/-%d cm)", offset, RESPONDER_MAX_OFFSET_CM) ;
+        tool_log(TAG, line, 1, callback) ;
+        return 0 ;
+    }
+
+    if ((err = esp_wifi_ftm_resp_set_offset((int16_t) offset)) != ESP_OK)
+    {
+        sprintf(line, "Responder - Calibration failed : esp_wifi_ftm_resp_set_offset (%s)", esp_err_to_name(err)) ;
+        tool_log(TAG, line, 1, callback) ;
+        return 0 ;
+    }
+
+    sprintf(line, "Responder - Offset %d cm -> %d cm", responder_control.offset_cm, offset) ;
+    tool_log(TAG, line, 0, callback) ;
+
+    responder_control.offset_cm = (int16_t) offset ;
+    responder_control.offset_err = ESP_OK ;
+    responder_control.saved = responder_save(&responder_control.offset_cm) ;
+
+    return 1 ;
+}
+
+//
+// No offset ( the stored offset is erased )
+//
+void responder_reset(void (*callback)(unsigned char *buffer, unsigned int len))
+{
+    char line[RESPONDER_LINE_BUFFER_LENGTH] ;
+
+    responder_control.offset_err = esp_wifi_ftm_resp_set_offset(0) ;
+    if (responder_control.offset_err != ESP_OK)
+    {
+        sprintf(line, "Responder - Reset failed : esp_wifi_ftm_resp_set_offset (%s)", esp_err_to_name(responder_control.offset_err)) ;
+        tool_log(TAG, line, 1, callback) ;
+        return ;
+    }
+
+    responder_control.offset_cm = 0 ;
+    responder_save(0) ;
+    responder_control.saved = 0 ;
+}
+
+//
+// Forget the stations
+//
+void responder_clear(void)
+{
+    xSemaphoreTake(responder_mutex, portMAX_DELAY) ;
+    memset(responder_control.station, 0, sizeof(responder_control.station)) ;
+    responder_control.stations = 0 ;
+    responder_control.evictions = 0 ;
+    xSemaphoreGive(responder_mutex) ;
+}
+
+//
+// Report the offset and the stations
+//
+void responder_info(void (*callback)(unsigned char *buffer, unsigned int len))
+{
+    responder_station_t station[RESPONDER_MAX_STATIONS] ;
+    char line[RESPONDER_LINE_BUFFER_LENGTH] ;
+    char mac_string[32] ;
+    unsigned int k , stations , evictions , connected = 0 , joins = 0 , leaves = 0 ;
+    uint32_t now_ms = responder_now_ms() ;
+
+    xSemaphoreTake(responder_mutex, portMAX_DELAY) ;
+    stations = responder_control.stations ;
+    evictions = responder_control.evictions ;
+    memcpy(station, responder_control.station, stations * sizeof(responder_station_t)) ;
+    xSemaphoreGive(responder_mutex) ;
+
+    for (k = 0; k < stations; k++)
+    {
+        connected += station[k].connected ;
+        joins += station[k].joins ;
+        leaves += station[k].leaves ;
+    }
+
+    sprintf(line, "Responder - Offset %d cm (%s%s) , Stations %u connected / %u tracked , Joins %u , Leaves %u , Evicted %u",
+                  responder_control.offset_cm, responder_control.saved ? "NVS" : "none stored",
+                  (responder_control.offset_err != ESP_OK) ? " , not applied" : "",
+                  connected, stations, joins, leaves, evictions) ;
+    tool_log(TAG, line, 0, callback) ;
+
+    for (k = 0; k < stations; k++)
+    {
+        tool_array_to_mac_string(mac_string, station[k].mac) ;
+        sprintf(line, "Responder - Station %s , AID %u , %s , Joins %u , Leaves %u , Connected %u mSec , Last Event %u mSec ago",
+                      mac_string, station[k].aid, station[k].connected ? "Connected" : "Left",
+                      station[k].joins, station[k].leaves,
+                      station[k].connected_ms + (station[k].connected ? now_ms - station[k].event_ms : 0),
+                      now_ms - station[k].event_ms) ;
+        tool_log(TAG, line, 0, callback) ;
+    }
+}
+
+//
+// Responder Initialization ( before esp_wifi_start() , so that no station event is missed )
+//
+void responder_init(void)
+{
+    memset(&responder_control, 0, sizeof(responder_control)) ;
+    responder_mutex = xSemaphoreCreateMutex() ;
+
+    bus_subscribe(BUS_MASK(BUS_STA_CONNECTED) | BUS_MASK(BUS_STA_DISCONNECTED), BUS_WORKER, responder_event, NULL) ;
+}
+
+//
+// Stored offset , after esp_wifi_start()
+//
+void responder_start(void)
+{
+    int16_t offset = 0 ;
+
+    responder_control.saved = responder_load(&offset) ;
+    if (responder_control.saved)
+    {
+        responder_control.offset_err = esp_wifi_ftm_resp_set_offset(offset) ;
+        if (responder_control.offset_err == ESP_OK)
+            responder_control.offset_cm = offset ;
+        else
+            ESP_LOGE(TAG, "stored offset %d cm not applied (%s)", offset, esp_err_to_name(responder_control.offset_err)) ;
+    }
+
+    ESP_LOGI(TAG, "offset %d cm (%s)", responder_control.offset_cm, responder_control.saved ? "NVS" : "none stored") ;
+}
@@ -0,0 +1,84 @@
+/*
+    responder.h - FTM Responder Accounting and Calibration
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+#ifndef _RESPONDER_H
+
+#define _RESPONDER_H	1
+
+    #ifdef __cplusplus
+    extern "C" {
+    #endif
+
+        #include <stdint.h>
+
+        #define RESPONDER_NVS_NAMESPACE     "responder"
+        #define RESPONDER_NVS_KEY           "offset"
+
+        #define RESPONDER_ACTION_INFO       0
+        #define RESPONDER_ACTION_CALIBRATE  1
+        #define RESPONDER_ACTION_RESET      2       // offset back to 0 ( NVS entry erased )
+        #define RESPONDER_ACTION_CLEAR      3       // station counters cleared
+
+        #define RESPONDER_MAX_STATIONS      16      // initiators tracked ( the oldest departed one is replaced )
+        #define RESPONDER_MAX_OFFSET_CM     1000    // esp_wifi_ftm_resp_set_offset() range used
+        #define RESPONDER_MAX_DISTANCE_CM   10000
+        #define RESPONDER_DEFAULT_ROUNDS    8
+        #define RESPONDER_DEFAULT_COUNT     16
+        #define RESPONDER_DEFAULT_BURST     2
+        #define RESPONDER_SSID_LENGTH       33
+        #define RESPONDER_NO_MEASUREMENT    -1      // measured_cm : range the peer "ssid"
+
+        //
+        // Calibration request : a known distance and either the distance measured by an
+        // initiator ranging this anchor , or a peer to range
+        //
+        typedef struct {
+            int           distance_cm ;                     // true distance
+            int           measured_cm ;                     // RESPONDER_NO_MEASUREMENT : range <ssid>
+            char          ssid[RESPONDER_SSID_LENGTH] ;
+            unsigned int  rounds ;
+            unsigned int  count ;
+            unsigned int  burst_period ;
+        } responder_calibration_t ;
+
+        extern void responder_init(void) ;
+        extern void responder_start(void) ;
+        extern void responder_station(const uint8_t *mac, unsigned int aid, unsigned int joined) ;
+        extern unsigned int responder_calibrate(const responder_calibration_t *request,
+                                                void (*callback)(unsigned char *buffer, unsigned int len)) ;
+        extern void responder_reset(void (*callback)(unsigned char *buffer, unsigned int len)) ;
+        extern void responder_clear(void) ;
+        extern void responder_info(void (*callback)(unsigned char *buffer, unsigned int len)) ;
+
+    #ifdef __cplusplus
+    }
+    #endif
+
+#endif
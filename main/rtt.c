@@ -0,0 +1,204 @@
+/*
+    rtt.c - Timestamp-Level RTT Estimation
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+//
+// Every FTM exchange carries four pico-second timestamps :
+//
+//      T1 : FTM frame departure ( responder clock )
+//      T2 : FTM frame arrival   ( initiator clock )
+//      T3 : ACK departure       ( initiator clock )
+//      T4 : ACK arrival         ( responder clock )
+//
+// RTT = (T4-T1) - (T3-T2) mixes intervals of two free-running clocks, so the
+// turnaround time (T3-T2) is scaled by the relative clock rate before being
+// subtracted. The rate is the slope of the linear regression of T1 on T2 over
+// successive exchanges of the burst.
+//
+
+#include <string.h>
+#include <math.h>
+#include "esp_wifi.h"
+#include "rtt.h"
+
+#define RTT_MAX_DRIFT_PPM           100.0       // larger slopes are treated as bad timestamps ( no correction )
+#define RTT_MIN_REJECT_PS           300.0       // outlier window never narrower than 300 pSec ( ~4.5 cm )
+#define RTT_MAD_SIGMA               1.4826      // MAD to standard deviation ( gaussian )
+#define RTT_CONFIDENCE_SCALE_CM     10.0f       // standard error halving the confidence
+
+// FUNCTION PROTOTYPES
+unsigned int rtt_estimate(const wifi_ftm_report_entry_t *report, unsigned int num_entries, rtt_estimate_t *estimate) ;
+static double rtt_median(double *values, unsigned int n) ;
+
+//
+// Median of <n> values ( the array is sorted in place )
+//
+static double rtt_median(double *values, unsigned int n)
+{
+    unsigned int i, j ;
+    double v ;
+
+    // insertion sort ( n <= RTT_MAX_ENTRIES )
+    for (i = 1; i < n; i++)
+    {
+        v = values[i] ;
+        for (j = i; (j > 0) && (values[j-1] > v); j--)
+        {
+            values[j] = values[j-1] ;
+        }
+        values[j] = v ;
+    }
+
+    return (n & 1) ? values[n/2] : 0.5 * (values[n/2 - 1] + values[n/2]) ;
+}
+
+//
+// Estimate the drift-corrected RTT of a FTM report
+//
+// returns 1 if at least one exchange survived validation and outlier rejection
+//
+unsigned int rtt_estimate(const wifi_ftm_report_entry_t *report, unsigned int num_entries, rtt_estimate_t *estimate)
+{
+    double x[RTT_MAX_ENTRIES], y[RTT_MAX_ENTRIES] ;         // T2 , T1 relative to the first valid exchange
+    double round_trip[RTT_MAX_ENTRIES] ;                    // T4-T1 ( responder clock )
+    double turnaround[RTT_MAX_ENTRIES] ;                    // T3-T2 ( initiator clock )
+    double corrected[RTT_MAX_ENTRIES], sorted[RTT_MAX_ENTRIES] ;
+    double mx = 0.0, my = 0.0, sxx = 0.0, sxy = 0.0 ;
+    double slope = 1.0, raw_sum = 0.0, median, window, sum, sum2 ;
+    unsigned int i, n = 0, used ;
+    uint64_t t1_ref = 0, t2_ref = 0 ;
+
+    memset(estimate, 0, sizeof(rtt_estimate_t)) ;
+    estimate->entries = num_entries ;
+
+    if (!report)
+        return 0 ;
+
+    if (num_entries > RTT_MAX_ENTRIES)
+        num_entries = RTT_MAX_ENTRIES ;
+
+    // [ VALIDATE EXCHANGES ]
+    for (i = 0; i < num_entries; i++)
+    {
+        const wifi_ftm_report_entry_t *e = &report[i] ;
+        double raw ;
+
+        if ( !e->t1 || !e->t2 || (e->t4 <= e->t1) || (e->t3 < e->t2) )
+            continue ;
+
+        raw = (double) (e->t4 - e->t1) - (double) (e->t3 - e->t2) ;
+        if ( (raw <= 0.0) || (raw > RTT_MAX_VALID_PS) )
+            continue ;
+
+        if (n == 0)
+        {
+            t1_ref = e->t1 ;
+            t2_ref = e->t2 ;
+        }
+
+        x[n] = (double) (int64_t) (e->t2 - t2_ref) ;
+        y[n] = (double) (int64_t) (e->t1 - t1_ref) ;
+        round_trip[n] = (double) (e->t4 - e->t1) ;
+        turnaround[n] = (double) (e->t3 - e->t2) ;
+        raw_sum += raw ;
+        n++ ;
+    }
+
+    estimate->valid = n ;
+
+    if (n == 0)
+        return 0 ;
+
+    estimate->rtt_raw_ps = (float) (raw_sum / n) ;
+
+    // [ RELATIVE CLOCK RATE ( least squares slope of T1 on T2 ) ]
+    for (i = 0; i < n; i++)
+    {
+        mx += x[i] ;
+        my += y[i] ;
+    }
+    mx /= n ;
+    my /= n ;
+
+    for (i = 0; i < n; i++)
+    {
+        sxx += (x[i] - mx) * (x[i] - mx) ;
+        sxy += (x[i] - mx) * (y[i] - my) ;
+    }
+
+    if ( (n > 1) && (sxx > 0.0) && (fabs(sxy / sxx - 1.0) * 1e6 <= RTT_MAX_DRIFT_PPM) )
+    {
+        slope = sxy / sxx ;
+    }
+    estimate->drift_ppm = (float) ((slope - 1.0) * 1e6) ;
+
+    // [ DRIFT CORRECTION ]
+    for (i = 0; i < n; i++)
+    {
+        corrected[i] = round_trip[i] - (turnaround[i] * slope) ;
+        sorted[i] = corrected[i] ;
+    }
+
+    // [ OUTLIER REJECTION ( median absolute deviation ) ]
+    median = rtt_median(sorted, n) ;
+    for (i = 0; i < n; i++)
+    {
+        sorted[i] = fabs(corrected[i] - median) ;
+    }
+    window = 3.0 * RTT_MAD_SIGMA * rtt_median(sorted, n) ;
+    if (window < RTT_MIN_REJECT_PS)
+        window = RTT_MIN_REJECT_PS ;
+
+    sum = 0.0 ;
+    sum2 = 0.0 ;
+    used = 0 ;
+    for (i = 0; i < n; i++)
+    {
+        if (fabs(corrected[i] - median) <= window)
+        {
+            sum += corrected[i] ;
+            sum2 += corrected[i] * corrected[i] ;
+            used++ ;
+        }
+    }
+
+    // [ ESTIMATE ]
+    estimate->used = used ;
+    estimate->rtt_ps = (float) (sum / used) ;
+    estimate->std_ps = (used > 1) ? (float) sqrt(fmax(0.0, (sum2 - sum * sum / used) / (used - 1))) : 0.0f ;
+    estimate->dist_cm = estimate->rtt_ps * RTT_CM_PER_PS ;
+    estimate->std_cm = estimate->std_ps * RTT_CM_PER_PS ;
+    estimate->sem_cm = (used > 1) ? (estimate->std_cm / sqrtf((float) used)) : INFINITY ;
+
+    // confidence : share of the exchanges that were kept, scaled down by the standard error
+    estimate->confidence = (used > 1) ? 
+            (unsigned int) (100.0f * used / estimate->entries / (1.0f + estimate->sem_cm / RTT_CONFIDENCE_SCALE_CM) + 0.5f) : 0 ;
+
+    return 1 ;
+}
@@ -0,0 +1,70 @@
+/*
+    rtt.h - Timestamp-Level RTT Estimation
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+#ifndef _RTT_H
+
+#define _RTT_H	1
+
+    #ifdef __cplusplus
+    extern "C" {
+    #endif
+
+        #include "esp_wifi.h"               // { wifi_ftm_report_entry_t }
+
+        #define RTT_MAX_ENTRIES             64              // report entries considered by the estimator
+        #define RTT_MAX_VALID_PS            2000000         // exchanges above 2 uSec ( 300 meters ) are discarded
+        #define RTT_CM_PER_PS               0.0149896229f   // one-way distance ( cm ) per pico-second of RTT
+
+        //
+        // Drift-corrected RTT estimate of a FTM report
+        //
+        typedef struct {
+            unsigned int  entries ;         // entries in the report
+            unsigned int  valid ;           // entries with consistent T1..T4 timestamps
+            unsigned int  used ;            // entries kept after outlier rejection
+            float         drift_ppm ;       // responder clock drift relative to the initiator clock
+            float         rtt_raw_ps ;      // mean of (t4-t1)-(t3-t2) without drift correction
+            float         rtt_ps ;          // drift-corrected mean RTT
+            float         std_ps ;          // standard deviation of the corrected per-exchange RTT
+            float         dist_cm ;         // one-way distance
+            float         std_cm ;          // standard deviation of the per-exchange distance
+            float         sem_cm ;          // standard error of the mean distance
+            unsigned int  confidence ;      // 0..100 %
+        } rtt_estimate_t ;
+
+        extern unsigned int rtt_estimate(const wifi_ftm_report_entry_t *report, unsigned int num_entries, rtt_estimate_t *estimate) ;
+
+    #ifdef __cplusplus
+    }
+    #endif
+
+#endif
+
+
@@ -47,6 +47,8 @@
 
 #include "fifo.h"
 #include "command.h"
+#include "metrics.h"
+#include "trace.h"
 
 
 #define PARAM_PORT                        CONFIG_ESP_PORT
@@ -64,6 +66,10 @@ static void  server_process_data(char * data, int len) ;
 unsigned int server_get_byte(unsigned char *c) ;
 unsigned int server_put_byte(unsigned char c) ;
 void server_put_bytes(unsigned char *buffer, unsigned int len) ;
+void server_stream_bytes(unsigned char *buffer, unsigned int len) ;
+void server_flush(void) ;
+uint32_t server_peer_address(void) ;
+static void  server_flush_output(void) ;
 static void  server_transmit_tcp_data(const int sock, char * data, int len) ;
 static void  server_receive_tcp_data(const int sock,void (*callback)(char * data, int len)) ;
 static void  server_input_task(void *pvParameters) ;
@@ -73,6 +79,7 @@ void server_init(void) ;
 static const char *TAG = "tcp server";
 
 static int server_socket = -1 ; 
+static volatile uint32_t server_peer = 0 ;  // IPv4 address of the connected client ( network order , 0 : none )
 
 static fifo_type FIFO[2] ;  // incoming [index 0] and outgoing [index 1] FIFOs 
 static unsigned char FIFO_BUFFER[2][FIFO_BUFFER_SIZE] ; 
@@ -86,18 +93,22 @@ static SemaphoreHandle_t server_mutex ;
 //
 static void server_process_data(char * data, int len) 
 {
-    unsigned int k ;
+    unsigned int k, drops = 0 ;
 
     if (len > 0)
     {
-        data[len] = 0 ; // Null-terminate whatever is received and treat it like a string
-        ESP_LOGI(TAG, "Received %d bytes: %s", len, data) ;
+        ESP_LOGD(TAG, "Received %d bytes", len) ;
+        TRACE(TRACE_RX, len) ;
 
         for (k=0;k<len;k++)
         {
-            fifo_put(&FIFO[0],(unsigned char) data[k]) ;
+            if (!fifo_put(&FIFO[0],(unsigned char) data[k])) drops++ ;
         }
 
+        metrics_count(METRICS_RX_BYTES, len) ;
+        if (drops) metrics_count(METRICS_RX_FIFO_DROPS, drops) ;
+        metrics_gauge(METRICS_RX_FIFO_LEVEL, fifo_length(&FIFO[0])) ;
+
         // PROCESS COMMANDS
         xSemaphoreTake(server_mutex,portMAX_DELAY) ;  
         command_processing() ;  
@@ -128,6 +139,8 @@ unsigned int server_put_byte(unsigned char c)
 
     ret = fifo_put(&FIFO[1],c) ;
 
+    if (!ret) metrics_count(METRICS_TX_FIFO_DROPS, 1) ;
+
     return ret ;    
 }
 
@@ -140,6 +153,40 @@ void server_put_bytes(unsigned char *buffer, unsigned int len)
 
     for (k=0; k<len; k++) server_put_byte(buffer[k]) ;
 
+    TRACE(TRACE_FIFO_COMMIT, len) ;
+    metrics_gauge(METRICS_TX_FIFO_LEVEL, fifo_length(&FIFO[1])) ;
+}
+
+// 
+// Stream a (large) frame straight to the socket, bypassing the outgoing FIFO
+//
+// Bytes already queued in the outgoing FIFO are sent first, so the output order is kept.
+// Must be called from the command context ( which owns the server mutex ).
+//
+void server_stream_bytes(unsigned char *buffer, unsigned int len)
+{
+    server_flush_output() ;
+
+    if ( (len > 0) && (server_socket > 0) )
+    {
+        server_transmit_tcp_data(server_socket, (char *) buffer, len) ;
+    }
+}
+
+// 
+// Send the outgoing FIFO right away ( command context , which owns the server mutex )
+//
+void server_flush(void)
+{
+    server_flush_output() ;
+}
+
+//
+// IPv4 address of the connected client ( network order , 0 : no client or IPv6 client )
+//
+uint32_t server_peer_address(void)
+{
+    return server_peer ;
 }
 
 // 
@@ -151,15 +198,22 @@ static void server_transmit_tcp_data(const int sock, char * data, int len)
     // Walk-around for robust implementation.
     int to_write = len ;
 
+    TRACE(TRACE_SEND_BEGIN, len) ;
+
     while (to_write > 0) 
     {
         int written = send(sock, data + (len - to_write), to_write, 0) ;
         if (written < 0) 
         {
             ESP_LOGE(TAG, "Error occurred during sending: errno %d", errno) ;
+            break ;
         }
         to_write -= written ;
     }
+
+    TRACE(TRACE_SEND_END, len - to_write) ;
+
+    metrics_count(METRICS_TX_BYTES, len - to_write) ;
 }
 
 // 
@@ -282,6 +336,7 @@ static void server_input_task(void *pvParameters)
         if (source_addr.ss_family == PF_INET) 
         {
             inet_ntoa_r(((struct sockaddr_in *)&source_addr)->sin_addr, addr_str, sizeof(addr_str) - 1) ;
+            server_peer = ((struct sockaddr_in *)&source_addr)->sin_addr.s_addr ;
         }
 #ifdef CONFIG_ESP_IPV6
         else if (source_addr.ss_family == PF_INET6) 
@@ -298,6 +353,7 @@ static void server_input_task(void *pvParameters)
         server_receive_tcp_data(sock, server_process_data) ;
 
         // Terminate a TCP/IP socket connection
+        server_peer = 0 ;
         shutdown(sock, 0) ;
         close(sock) ;
     }
@@ -308,49 +364,54 @@ CLEAN_UP:
 }
 
 //
-// TCP/IP outgoing data task
+// Flush the outgoing FIFO ( TCP/IP transmission, caller owns the server mutex )
 //
-static void server_output_task(void *pvParameters)
+static void server_flush_output(void)
 {
     unsigned int k, m, len, blocks, remainder ;
     char tx_buffer[SERVER_TX_BUFFER_LENGTH] ;    
 
-    while(1)
+    len = fifo_length(&FIFO[1]) ;
+
+    if ( (len > 0) && (server_socket > 0) ) 
     {
-        xSemaphoreTake(server_mutex,portMAX_DELAY) ;
-        len = fifo_length(&FIFO[1]) ;
-        xSemaphoreGive(server_mutex) ;
+        blocks = len / SERVER_TX_BUFFER_LENGTH ;    // number of full blocks
+        remainder = len % SERVER_TX_BUFFER_LENGTH ; // size of remainder (final) block
 
-        // FLUSH OUTPUT FIFO ( TCP/IP TRANSMISSION )
-        if ( (len > 0) && (server_socket > 0) ) 
+        // TRANSMIT FULL BLOCKS
+        for (k=0; k<blocks; k++)
         {
-            xSemaphoreTake(server_mutex,portMAX_DELAY) ;
-
-            blocks = len / SERVER_TX_BUFFER_LENGTH ;    // number of full blocks
-            remainder = len % SERVER_TX_BUFFER_LENGTH ; // size of remainder (final) block
-
-            // TRANSMIT FULL BLOCKS
-            for (k=0; k<blocks; k++)
+            for (m=0; m<SERVER_TX_BUFFER_LENGTH; m++)
             {
-                for (m=0; m<SERVER_TX_BUFFER_LENGTH; m++)
-                {
-                    fifo_get(&FIFO[1], (unsigned char *) &tx_buffer[m]) ;
-                }    
-                server_transmit_tcp_data(server_socket, tx_buffer, SERVER_TX_BUFFER_LENGTH) ;
-            }
-
-            // TRANSMIT REMAINDER (FINAL) BLOCK
-            if (remainder)
+                fifo_get(&FIFO[1], (unsigned char *) &tx_buffer[m]) ;
+            }    
+            server_transmit_tcp_data(server_socket, tx_buffer, SERVER_TX_BUFFER_LENGTH) ;
+        }
+
+        // TRANSMIT REMAINDER (FINAL) BLOCK
+        if (remainder)
+        {
+            for (m=0; m<remainder; m++)
             {
-                for (m=0; m<remainder; m++)
-                {
-                    fifo_get(&FIFO[1], (unsigned char *) &tx_buffer[m]) ;
-                }    
-                server_transmit_tcp_data(server_socket, tx_buffer, remainder) ;
-            }
-
-            xSemaphoreGive(server_mutex) ;
+                fifo_get(&FIFO[1], (unsigned char *) &tx_buffer[m]) ;
+            }    
+            server_transmit_tcp_data(server_socket, tx_buffer, remainder) ;
         }
+    }
+}
+
+//
+// TCP/IP outgoing data task
+//
+static void server_output_task(void *pvParameters)
+{
+    while(1)
+    {
+        // FLUSH OUTPUT FIFO ( TCP/IP TRANSMISSION )
+        xSemaphoreTake(server_mutex,portMAX_DELAY) ;
+        server_flush_output() ;
+        xSemaphoreGive(server_mutex) ;
+
         vTaskDelay(100 / portTICK_PERIOD_MS) ;      
     }
 
@@ -362,6 +423,8 @@ static void server_output_task(void *pvParameters)
 //
 void server_init(void)
 {
+    TaskHandle_t task ;
+
     server_mutex = xSemaphoreCreateMutex() ;
 
     // CREATE FIFOS
@@ -369,15 +432,15 @@ void server_init(void)
     fifo_config( &FIFO[1], FIFO_BUFFER[1], FIFO_BUFFER_SIZE ) ; // OUTGOING FIFO
 
     // CREATE TCP/IP OUTPUT TASK
-    xTaskCreate(server_output_task, "tcp_output", 8192, (void*) 0, 10, NULL) ;
+    if (xTaskCreate(server_output_task, "tcp_output", 8192, (void*) 0, 10, &task) == pdPASS) metrics_register_task(task) ;
 
     // CREATE TCP/IP INPUT TASK
     #ifdef CONFIG_ESP_IPV4
-        xTaskCreate(server_input_task, "tcp_input", 8192, (void*)AF_INET, 5, NULL) ; 
+        if (xTaskCreate(server_input_task, "tcp_input", 8192, (void*)AF_INET, 5, &task) == pdPASS) metrics_register_task(task) ; 
     #endif
 
     #ifdef CONFIG_ESP_IPV6
-        xTaskCreate(server_input_task, "tcp_input", 8192, (void*)AF_INET6, 5, NULL) ;
+        if (xTaskCreate(server_input_task, "tcp_input", 8192, (void*)AF_INET6, 5, &task) == pdPASS) metrics_register_task(task) ;
     #endif
 
 }
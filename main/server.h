@@ -36,10 +36,15 @@
     extern "C" {
     #endif
 
+        #include <stdint.h>
+
         extern void server_init(void) ;
         extern unsigned int server_get_byte(unsigned char *c) ;
         extern unsigned int server_put_byte(unsigned char c) ;
         extern void server_put_bytes(unsigned char *buffer, unsigned int len) ;
+        extern void server_stream_bytes(unsigned char *buffer, unsigned int len) ;
+        extern void server_flush(void) ;
+        extern uint32_t server_peer_address(void) ;
 
     #ifdef __cplusplus
     }
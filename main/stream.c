@@ -0,0 +1,655 @@
+/*
+    stream.c - Publish/Subscribe Streams
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+//
+// Named streams ( ranging results, scan deltas, metrics and logs ) served on a port
+// of their own ( STREAM_PORT ) to up to STREAM_MAX_SUBSCRIBERS connections at the
+// same time, next to the command connection. A connection subscribes with a single
+// command and then only receives :
+//
+//   { "function" : "subscribe" , "parameters" : { "streams" : [ "ranging" , "log" ] ,
+//                                                  "policy" : "drop_oldest" }} ;
+//
+// A producer formats each message once into a reference-counted buffer, which is
+// queued to every subscriber of its stream. The output task sends the queues with
+// non-blocking sends, so a slow subscriber only fills its own queue ; a full queue
+// is handled by the policy of the subscriber ( drop the newest or the oldest
+// message , or disconnect ).
+//
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "lwip/sockets.h"
+#include "pool.h"
+#include "parser.h"
+#include "metrics.h"
+#include "stream.h"
+
+#define STREAM_COMMAND_LENGTH           256
+#define STREAM_LINE_BUFFER_LENGTH       256
+#define STREAM_METRICS_BUFFER_LENGTH    4096
+#define STREAM_HANDSHAKE_TIMEOUT_S      5           // time given to a new connection to subscribe
+#define STREAM_IDLE_WAIT_MS             100         // output task period without pending messages
+#define STREAM_BLOCKED_WAIT_MS          10          // output task period with full sockets
+
+//
+// Message ( shared by every subscriber queue holding it )
+//
+typedef struct {
+    unsigned int  refs ;
+    unsigned int  len ;
+    unsigned char data[] ;
+} stream_message_t ;
+
+//
+// Subscriber ( connection , subscribed streams and output queue )
+//
+typedef struct {
+    int           sock ;                            // -1 : free slot
+    unsigned int  mask ;                            // 1 << STREAM_xxx
+    unsigned int  policy ;
+    char          addr[48] ;
+    stream_message_t *queue[STREAM_QUEUE_DEPTH] ;
+    unsigned int  head ;
+    unsigned int  count ;
+    unsigned int  offset ;                          // bytes of the head message already sent
+    uint32_t      sent ;
+    uint32_t      dropped ;
+} stream_subscriber_t ;
+
+static struct {
+    stream_subscriber_t subscriber[STREAM_MAX_SUBSCRIBERS] ;
+    volatile unsigned int mask ;                    // streams with at least one subscriber
+    uint32_t      published ;
+    uint32_t      dropped ;
+    unsigned int  running ;
+} stream_control ;
+
+static SemaphoreHandle_t stream_mutex ;             // subscribers and their queues
+static SemaphoreHandle_t stream_wake ;              // new messages for the output task
+
+static const char *stream_names[STREAM_NUM] = { "ranging", "scan", "metrics", "log" } ;
+static const char *stream_policy_names[] = { "drop_newest", "drop_oldest", "disconnect" } ;
+
+static const char *TAG = "stream" ;
+
+// FUNCTION PROTOTYPES
+void stream_init(void) ;
+unsigned int stream_subscribed(unsigned int stream) ;
+void stream_publish(unsigned int stream, const unsigned char *buffer, unsigned int len) ;
+void stream_printf(unsigned int stream, const char *format, ...) ;
+const char *stream_name(unsigned int stream) ;
+const char *stream_policy_name(unsigned int policy) ;
+void stream_info(void (*callback)(unsigned char *buffer, unsigned int len)) ;
+static void stream_post(unsigned int stream, stream_message_t *message) ;
+static void stream_release(stream_message_t *message) ;
+static void stream_enqueue(stream_subscriber_t *s, stream_message_t *message) ;
+static void stream_remove(stream_subscriber_t *s, unsigned int position) ;
+static void stream_disconnect(stream_subscriber_t *s, const char *reason) ;
+static void stream_update_mask(void) ;
+static unsigned int stream_send(stream_subscriber_t *s) ;
+static unsigned int stream_mask_string(unsigned int mask, char *str) ;
+static void stream_handshake(int sock, const char *addr) ;
+static void stream_publish_metrics(void) ;
+static void stream_collect(unsigned char *buffer, unsigned int len) ;
+static void stream_accept_task(void *pvParameters) ;
+static void stream_output_task(void *pvParameters) ;
+
+static struct {
+    char         *buffer ;
+    unsigned int  len ;
+} stream_metrics ;                                  // output task only
+
+//
+// Check if a stream has subscribers ( producers skip the formatting otherwise )
+//
+unsigned int stream_subscribed(unsigned int stream)
+{
+    return (stream < STREAM_NUM) && (stream_control.mask & (1 << stream)) ;
+}
+
+//
+// Publish a message ( one or more lines ) to the subscribers of a stream
+//
+void stream_publish(unsigned int stream, const unsigned char *buffer, unsigned int len)
+{
+    stream_message_t *message ;
+
+    if (!len || !stream_subscribed(stream))
+        return ;
+
+    if ( !(message = pool_alloc_or_heap(sizeof(stream_message_t) + len)) )
+    {
+        metrics_count(METRICS_STREAM_DROPS, 1) ;
+        return ;
+    }
+
+    memcpy(message->data, buffer, len) ;
+    message->len = len ;
+
+    stream_post(stream, message) ;
+}
+
+//
+// Format and publish a message
+//
+void stream_printf(unsigned int stream, const char *format, ...)
+{
+    stream_message_t *message ;
+    va_list args ;
+    int len ;
+
+    if (!stream_subscribed(stream))
+        return ;
+
+    va_start(args, format) ;
+    len = vsnprintf(0, 0, format, args) ;
+    va_end(args) ;
+
+    if (len <= 0)
+        return ;
+
+    if ( !(message = pool_alloc_or_heap(sizeof(stream_message_t) + len + 1)) )
+    {
+        metrics_count(METRICS_STREAM_DROPS, 1) ;
+        return ;
+    }
+
+    // formatted straight into the shared buffer
+    va_start(args, format) ;
+    vsnprintf((char *) message->data, len + 1, format, args) ;
+    va_end(args) ;
+    message->len = len ;
+
+    stream_post(stream, message) ;
+}
+
+//
+// Queue a message to the subscribers of a stream ( the publisher reference is released )
+//
+static void stream_post(unsigned int stream, stream_message_t *message)
+{
+    unsigned int k ;
+
+    message->refs = 1 ;
+
+    xSemaphoreTake(stream_mutex, portMAX_DELAY) ;
+
+    for (k=0; k<STREAM_MAX_SUBSCRIBERS; k++)
+    {
+        stream_subscriber_t *s = &stream_control.subscriber[k] ;
+
+        if ( (s->sock >= 0) && (s->mask & (1 << stream)) )
+        {
+            stream_enqueue(s, message) ;
+        }
+    }
+    stream_control.published++ ;
+    stream_release(message) ;
+
+    xSemaphoreGive(stream_mutex) ;
+
+    metrics_count(METRICS_STREAM_MESSAGES, 1) ;
+    xSemaphoreGive(stream_wake) ;
+}
+
+//
+// Release a reference to a message ( caller holds the stream mutex )
+//
+static void stream_release(stream_message_t *message)
+{
+    if (--message->refs == 0)
+    {
+        pool_free(message) ;
+    }
+}
+
+//
+// Add a message to a subscriber queue ( slow subscriber policy when it's full )
+//
+static void stream_enqueue(stream_subscriber_t *s, stream_message_t *message)
+{
+    if (s->count == STREAM_QUEUE_DEPTH)
+    {
+        switch (s->policy)
+        {
+            case STREAM_POLICY_DROP_NEWEST :
+                        s->dropped++ ;
+                        stream_control.dropped++ ;
+                        metrics_count(METRICS_STREAM_DROPS, 1) ;
+                        return ;
+
+            case STREAM_POLICY_DROP_OLDEST :
+                        // a message partially sent must be completed
+                        stream_remove(s, (s->offset > 0) ? 1 : 0) ;
+                        s->dropped++ ;
+                        stream_control.dropped++ ;
+                        metrics_count(METRICS_STREAM_DROPS, 1) ;
+                        break ;
+
+            default :
+                        stream_disconnect(s, "queue full") ;
+                        return ;
+        }
+    }
+
+    s->queue[(s->head + s->count) % STREAM_QUEUE_DEPTH] = message ;
+    s->count++ ;
+    message->refs++ ;
+}
+
+//
+// Remove the message at <position> of a subscriber queue ( 0 : head )
+//
+static void stream_remove(stream_subscriber_t *s, unsigned int position)
+{
+    unsigned int k ;
+
+    stream_release(s->queue[(s->head + position) % STREAM_QUEUE_DEPTH]) ;
+
+    for (k=position; k>0; k--)
+    {
+        s->queue[(s->head + k) % STREAM_QUEUE_DEPTH] = s->queue[(s->head + k - 1) % STREAM_QUEUE_DEPTH] ;
+    }
+
+    s->head = (s->head + 1) % STREAM_QUEUE_DEPTH ;
+    s->count-- ;
+}
+
+//
+// Close a subscriber connection and release its queue ( caller holds the stream mutex )
+//
+static void stream_disconnect(stream_subscriber_t *s, const char *reason)
+{
+    ESP_LOGI(TAG, "%s unsubscribed (%s) , sent %u , dropped %u", s->addr, reason, s->sent, s->dropped) ;
+
+    while (s->count)
+    {
+        stream_release(s->queue[s->head]) ;
+        s->head = (s->head + 1) % STREAM_QUEUE_DEPTH ;
+        s->count-- ;
+    }
+
+    shutdown(s->sock, 0) ;
+    close(s->sock) ;
+    s->sock = -1 ;
+
+    stream_update_mask() ;
+}
+
+//
+// Streams with at least one subscriber ( caller holds the stream mutex )
+//
+static void stream_update_mask(void)
+{
+    unsigned int k, mask = 0 ;
+
+    for (k=0; k<STREAM_MAX_SUBSCRIBERS; k++)
+    {
+        if (stream_control.subscriber[k].sock >= 0) mask |= stream_control.subscriber[k].mask ;
+    }
+    stream_control.mask = mask ;
+}
+
+//
+// Send the queue of a subscriber as far as its socket takes it ( caller holds the stream mutex )
+//
+// returns 0 if the connection is closed
+//
+static unsigned int stream_send(stream_subscriber_t *s)
+{
+    stream_message_t *message ;
+    char discard[64] ;
+    int n ;
+
+    while (s->count)
+    {
+        message = s->queue[s->head] ;
+
+        n = send(s->sock, message->data + s->offset, message->len - s->offset, MSG_DONTWAIT) ;
+        if (n < 0)
+        {
+            return (errno == EAGAIN) || (errno == EWOULDBLOCK) ;
+        }
+
+        metrics_count(METRICS_TX_BYTES, n) ;
+
+        s->offset += n ;
+        if (s->offset == message->len)
+        {
+            s->offset = 0 ;
+            s->sent++ ;
+            stream_remove(s, 0) ;
+        }
+    }
+
+    // subscribers only listen : anything received is discarded , a closed connection is detected here
+    n = recv(s->sock, discard, sizeof(discard), MSG_DONTWAIT) ;
+
+    return (n > 0) || ( (n < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)) ) ;
+}
+
+//
+// Names of the streams of a mask ( "ranging,log" )
+//
+static unsigned int stream_mask_string(unsigned int mask, char *str)
+{
+    unsigned int k ;
+
+    str[0] = 0 ;
+    for (k=0; k<STREAM_NUM; k++)
+    {
+        if (mask & (1 << k))
+        {
+            if (str[0]) strcat(str, ",") ;
+            strcat(str, stream_names[k]) ;
+        }
+    }
+    return strlen(str) ;
+}
+
+const char *stream_name(unsigned int stream)
+{
+    return (stream < STREAM_NUM) ? stream_names[stream] : "?" ;
+}
+
+const char *stream_policy_name(unsigned int policy)
+{
+    return (policy <= STREAM_POLICY_DISCONNECT) ? stream_policy_names[policy] : "?" ;
+}
+
+//
+// Read the subscription of a new connection and register it
+//
+static void stream_handshake(int sock, const char *addr)
+{
+    char command[STREAM_COMMAND_LENGTH] ;
+    char line[STREAM_LINE_BUFFER_LENGTH] ;
+    char names[64] ;
+    cJSON *root ;
+    const char *function ;
+    unsigned int mask, policy, k, len = 0 ;
+    stream_subscriber_t *s = 0 ;
+    struct timeval timeout = { STREAM_HANDSHAKE_TIMEOUT_S, 0 } ;
+    int n ;
+
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) ;
+
+    // SUBSCRIBE COMMAND ( up to the semicolon )
+    while ( (len < sizeof(command) - 1) && ((n = recv(sock, command + len, 1, 0)) == 1) && (command[len] != ';') )
+    {
+        if ( (command[len] != 0x0A) && (command[len] != 0x0D) ) len++ ;
+    }
+    command[len] = 0 ;
+
+    root = parser_parse((unsigned char *) command) ;
+    function = parser_function(root) ;
+    if (!function || strcmp(function, "subscribe") || !parser_subscribe(root, &mask, &policy)) mask = 0 ;
+    parser_release(root) ;
+
+    if (!mask)
+    {
+        sprintf(line, "Invalid Subscription! Streams are ranging, scan, metrics and log ; policies are drop_newest, drop_oldest and disconnect\n") ;
+        send(sock, line, strlen(line), 0) ;
+        close(sock) ;
+        return ;
+    }
+
+    xSemaphoreTake(stream_mutex, portMAX_DELAY) ;
+    for (k=0; (k<STREAM_MAX_SUBSCRIBERS) && !s; k++)
+    {
+        if (stream_control.subscriber[k].sock < 0) s = &stream_control.subscriber[k] ;
+    }
+    xSemaphoreGive(stream_mutex) ;
+
+    if (!s)
+    {
+        sprintf(line, "Too Many Subscribers! Up to %d connections", STREAM_MAX_SUBSCRIBERS) ;
+        strcat(line, "\n") ;
+        send(sock, line, strlen(line), 0) ;
+        close(sock) ;
+        return ;
+    }
+
+    // the confirmation precedes the first message
+    stream_mask_string(mask, names) ;
+    sprintf(line, "Subscribed - Streams %s , Policy %s , Queue %d messages\n", names, stream_policy_name(policy), STREAM_QUEUE_DEPTH) ;
+    send(sock, line, strlen(line), 0) ;
+
+    xSemaphoreTake(stream_mutex, portMAX_DELAY) ;
+    memset(s, 0, sizeof(*s)) ;
+    snprintf(s->addr, sizeof(s->addr), "%s", addr) ;
+    s->mask = mask ;
+    s->policy = policy ;
+    s->sock = sock ;
+    stream_update_mask() ;
+    xSemaphoreGive(stream_mutex) ;
+
+    ESP_LOGI(TAG, "%s subscribed to %s (%s)", addr, names, stream_policy_name(policy)) ;
+}
+
+//
+// Report the streams and their subscribers
+//
+void stream_info(void (*callback)(unsigned char *buffer, unsigned int len))
+{
+    char line[STREAM_LINE_BUFFER_LENGTH] ;
+    char names[64] ;
+    unsigned int k, subscribers = 0 ;
+
+    if (!stream_control.running)
+    {
+        sprintf(line, "Streams - Disabled\n") ;
+        callback((unsigned char *) line, strlen(line)) ;
+        return ;
+    }
+
+    xSemaphoreTake(stream_mutex, portMAX_DELAY) ;
+
+    for (k=0; k<STREAM_MAX_SUBSCRIBERS; k++)
+    {
+        if (stream_control.subscriber[k].sock >= 0) subscribers++ ;
+    }
+
+    sprintf(line, "Streams - Port %d , Subscribers %u/%d , Published %u , Dropped %u\n",
+                  STREAM_PORT, subscribers, STREAM_MAX_SUBSCRIBERS, stream_control.published, stream_control.dropped) ;
+    callback((unsigned char *) line, strlen(line)) ;
+
+    for (k=0; k<STREAM_MAX_SUBSCRIBERS; k++)
+    {
+        stream_subscriber_t *s = &stream_control.subscriber[k] ;
+
+        if (s->sock < 0)
+            continue ;
+
+        stream_mask_string(s->mask, names) ;
+        sprintf(line, "[%u] %s , Streams %s , Policy %s , Queued %u , Sent %u , Dropped %u\n",
+                      k, s->addr, names, stream_policy_name(s->policy), s->count, s->sent, s->dropped) ;
+        callback((unsigned char *) line, strlen(line)) ;
+    }
+
+    xSemaphoreGive(stream_mutex) ;
+}
+
+//
+// Metrics report , collected into a single message
+//
+static void stream_collect(unsigned char *buffer, unsigned int len)
+{
+    if (stream_metrics.len + len <= STREAM_METRICS_BUFFER_LENGTH)
+    {
+        memcpy(stream_metrics.buffer + stream_metrics.len, buffer, len) ;
+        stream_metrics.len += len ;
+    }
+}
+
+static void stream_publish_metrics(void)
+{
+    if ( !(stream_metrics.buffer = pool_alloc_or_heap(STREAM_METRICS_BUFFER_LENGTH)) )
+        return ;
+
+    stream_metrics.len = 0 ;
+    metrics_report(METRICS_FORMAT_STREAM, stream_collect) ;
+    stream_publish(STREAM_METRICS, (unsigned char *) stream_metrics.buffer, stream_metrics.len) ;
+
+    pool_free(stream_metrics.buffer) ;
+}
+
+//
+// Stream connections ( accept and subscribe )
+//
+static void stream_accept_task(void *pvParameters)
+{
+    char addr_str[48] ;
+    struct sockaddr_in dest_addr ;
+    int opt = 1 ;
+
+    int listen_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP) ;
+    if (listen_sock < 0)
+    {
+        ESP_LOGE(TAG, "Unable to create socket: errno %d", errno) ;
+        vTaskDelete(NULL) ;
+        return ;
+    }
+    setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) ;
+
+    memset(&dest_addr, 0, sizeof(dest_addr)) ;
+    dest_addr.sin_addr.s_addr = htonl(INADDR_ANY) ;
+    dest_addr.sin_family = AF_INET ;
+    dest_addr.sin_port = htons(STREAM_PORT) ;
+
+    if ( (bind(listen_sock, (struct sockaddr *)&dest_addr, sizeof(dest_addr)) != 0) ||
+         (listen(listen_sock, STREAM_MAX_SUBSCRIBERS) != 0) )
+    {
+        ESP_LOGE(TAG, "Unable to listen on port %d: errno %d", STREAM_PORT, errno) ;
+        close(listen_sock) ;
+        vTaskDelete(NULL) ;
+        return ;
+    }
+
+    ESP_LOGI(TAG, "Streams listening, port %d", STREAM_PORT) ;
+
+    while (1)
+    {
+        struct sockaddr_in source_addr ;
+        socklen_t addr_len = sizeof(source_addr) ;
+        int sock = accept(listen_sock, (struct sockaddr *)&source_addr, &addr_len) ;
+
+        if (sock < 0)
+        {
+            ESP_LOGE(TAG, "Unable to accept connection: errno %d", errno) ;
+            break ;
+        }
+
+        inet_ntoa_r(source_addr.sin_addr, addr_str, sizeof(addr_str) - 1) ;
+        stream_handshake(sock, addr_str) ;
+    }
+
+    close(listen_sock) ;
+    vTaskDelete(NULL) ;
+}
+
+//
+// Stream output ( subscriber queues , periodic metrics )
+//
+static void stream_output_task(void *pvParameters)
+{
+    TickType_t metrics_tick = xTaskGetTickCount() ;
+    unsigned int k, blocked ;
+
+    while (1)
+    {
+        // PERIODIC METRICS REPORT
+        if ((xTaskGetTickCount() - metrics_tick) * portTICK_PERIOD_MS >= STREAM_METRICS_PERIOD_MS)
+        {
+            metrics_tick = xTaskGetTickCount() ;
+            if (stream_subscribed(STREAM_METRICS)) stream_publish_metrics() ;
+        }
+
+        // SUBSCRIBER QUEUES ( a full socket only holds back its own queue )
+        blocked = 0 ;
+        xSemaphoreTake(stream_mutex, portMAX_DELAY) ;
+        for (k=0; k<STREAM_MAX_SUBSCRIBERS; k++)
+        {
+            stream_subscriber_t *s = &stream_control.subscriber[k] ;
+
+            if (s->sock < 0)
+                continue ;
+
+            if (!stream_send(s))
+            {
+                stream_disconnect(s, "connection closed") ;
+            }
+            else if (s->count)
+            {
+                blocked++ ;
+            }
+        }
+        xSemaphoreGive(stream_mutex) ;
+
+        xSemaphoreTake(stream_wake, (blocked ? STREAM_BLOCKED_WAIT_MS : STREAM_IDLE_WAIT_MS) / portTICK_PERIOD_MS) ;
+    }
+
+    vTaskDelete(NULL) ;
+}
+
+//
+// Streams Initialization
+//
+void stream_init(void)
+{
+    unsigned int k ;
+    #if (CONFIG_ESP_STREAM_ENABLE)
+        TaskHandle_t task ;
+    #endif
+
+    memset(&stream_control, 0, sizeof(stream_control)) ;
+    for (k=0; k<STREAM_MAX_SUBSCRIBERS; k++)
+    {
+        stream_control.subscriber[k].sock = -1 ;
+    }
+
+    #if (CONFIG_ESP_STREAM_ENABLE)
+        stream_mutex = xSemaphoreCreateMutex() ;
+        stream_wake = xSemaphoreCreateBinary() ;
+
+        if (xTaskCreate(stream_output_task, "stream_output", 4096, (void*) 0, 9, &task) == pdPASS) metrics_register_task(task) ;
+        if (xTaskCreate(stream_accept_task, "stream_accept", 4096, (void*) 0, 5, &task) == pdPASS) metrics_register_task(task) ;
+
+        stream_control.running = 1 ;
+    #else
+        ESP_LOGW(TAG, "streams disabled") ;
+    #endif
+}
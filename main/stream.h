@@ -0,0 +1,68 @@
+/*
+    stream.h - Publish/Subscribe Streams
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+#ifndef _STREAM_H
+
+#define _STREAM_H	1
+
+    #ifdef __cplusplus
+    extern "C" {
+    #endif
+
+        #define STREAM_PORT                 CONFIG_ESP_STREAM_PORT
+        #define STREAM_MAX_SUBSCRIBERS      CONFIG_ESP_STREAM_MAX_SUBSCRIBERS
+        #define STREAM_QUEUE_DEPTH          CONFIG_ESP_STREAM_QUEUE_DEPTH
+        #define STREAM_METRICS_PERIOD_MS    CONFIG_ESP_STREAM_METRICS_PERIOD
+
+        // STREAMS
+        #define STREAM_RANGING              0       // FTM session results ( NDJSON , as the history export )
+        #define STREAM_SCAN                 1       // scan deltas ( NDJSON : new , lost and moved APs )
+        #define STREAM_METRICS              2       // periodic metrics report ( text )
+        #define STREAM_LOG                  3       // report and log lines ( text )
+        #define STREAM_NUM                  4
+
+        // SLOW SUBSCRIBER POLICIES ( queue full )
+        #define STREAM_POLICY_DROP_NEWEST   0       // discard the new message
+        #define STREAM_POLICY_DROP_OLDEST   1       // discard the oldest message not being sent
+        #define STREAM_POLICY_DISCONNECT    2       // close the subscriber connection
+
+        extern void stream_init(void) ;
+        extern unsigned int stream_subscribed(unsigned int stream) ;
+        extern void stream_publish(unsigned int stream, const unsigned char *buffer, unsigned int len) ;
+        extern void stream_printf(unsigned int stream, const char *format, ...) __attribute__ ((format (printf, 2, 3))) ;
+        extern const char *stream_name(unsigned int stream) ;
+        extern const char *stream_policy_name(unsigned int policy) ;
+        extern void stream_info(void (*callback)(unsigned char *buffer, unsigned int len)) ;
+
+    #ifdef __cplusplus
+    }
+    #endif
+
+#endif
@@ -0,0 +1,337 @@
+/*
+    survey.c - Anchor Survey
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+//
+// Inter-anchor distances of a site, measured from this anchor to its peers ( every
+// Chronos runs an FTM responder on its SoftAP ) :
+//
+//   { "function" : "survey" , "parameters" : { "ssids" : [ "CHRONOS-1" , "CHRONOS-2" ] ,
+//                                               "rounds" : 5 , "count" : 16 }} ;
+//
+// This anchor is left out of the list, so the same list can be sent to every anchor of
+// the site. Each peer is ranged <rounds> times. The drift-corrected distances of the
+// sessions are reduced to a robust estimate : sessions further than 3 scaled MADs from
+// the median ( multipath , late first path ) are rejected and the rest are averaged.
+//
+// The response holds one line per peer and the row of this anchor as a JSON line :
+//
+//   {"survey":"<own ssid>","anchors":[<own ssid>,<peers>],"d_m":[0.000,<distance or null>,..],
+//    "mad_cm":[..],"sessions":[..]}
+//
+// tools/chronos_survey.py merges the rows of every anchor into the distance matrix.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "tool.h"
+#include "pool.h"
+#include "ftm.h"
+#include "survey.h"
+
+#define SURVEY_OWN_SSID                 CONFIG_ESP_WIFI_SSID
+#define SURVEY_LINE_BUFFER_LENGTH       1024
+#define SURVEY_JSON_SSID_LENGTH         (6 * (SURVEY_SSID_LENGTH - 1) + 2)     // quoted SSID , every byte escaped as \u00XX
+#define SURVEY_ROW_LENGTH               ((SURVEY_MAX_PEERS + 2) * (SURVEY_JSON_SSID_LENGTH + 1) + SURVEY_MAX_PEERS * 32 + 64)
+#define SURVEY_MAD_SCALE                1.4826f     // MAD to standard deviation ( gaussian )
+#define SURVEY_GATE_MADS                3.0f        // outlier gate ( scaled MADs )
+#define SURVEY_MIN_GATE_CM              5.0f        // outlier gate floor ( identical sessions )
+
+static const char *TAG = "survey" ;
+
+// FUNCTION PROTOTYPES
+unsigned int survey_run(const survey_request_t *request,
+                        void (*callback)(unsigned char *buffer, unsigned int len)) ;
+static void survey_sort(float *values, unsigned int n) ;
+static float survey_median(const float *sorted, unsigned int n) ;
+static void survey_reduce(float *samples, unsigned int n, survey_peer_t *peer) ;
+static unsigned int survey_json_ssid(char *dst, const char *ssid) ;
+unsigned int survey_range(const char *ssid, unsigned int rounds, unsigned int count, unsigned int burst_period,
+                          survey_peer_t *peer) ;
+
+//
+// Sort a few values ( insertion sort )
+//
+static void survey_sort(float *values, unsigned int n)
+{
+    unsigned int i , j ;
+    float v ;
+
+    for (i = 1; i < n; i++)
+    {
+        v = values[i] ;
+        for (j = i; (j > 0) && (values[j-1] > v); j--)
+        {
+            values[j] = values[j-1] ;
+        }
+        values[j] = v ;
+    }
+}
+
+//
+// Median of sorted values
+//
+static float survey_median(const float *sorted, unsigned int n)
+{
+    return (n & 1) ? sorted[n/2] : 0.5f * (sorted[n/2 - 1] + sorted[n/2]) ;
+}
+
+//
+// Reduce the distances of a peer ( median , MAD , outlier rejection , inlier mean and spread )
+//
+static void survey_reduce(float *samples, unsigned int n, survey_peer_t *peer)
+{
+    float deviation[SURVEY_MAX_ROUNDS] ;
+    float gate , sum = 0.0f , sum2 = 0.0f ;
+    unsigned int i ;
+
+    peer->sessions = n ;
+    if (!n)
+        return ;
+
+    survey_sort(samples, n) ;
+    peer->median_cm = survey_median(samples, n) ;
+
+    for (i = 0; i < n; i++)
+    {
+        deviation[i] = fabsf(samples[i] - peer->median_cm) ;
+    }
+    survey_sort(deviation, n) ;
+    peer->mad_cm = survey_median(deviation, n) ;
+
+    gate = SURVEY_GATE_MADS * SURVEY_MAD_SCALE * peer->mad_cm ;
+    if (gate < SURVEY_MIN_GATE_CM) gate = SURVEY_MIN_GATE_CM ;
+
+    for (i = 0; i < n; i++)
+    {
+        if (fabsf(samples[i] - peer->median_cm) <= gate)
+        {
+            sum += samples[i] ;
+            sum2 += samples[i] * samples[i] ;
+            peer->inliers++ ;
+        }
+    }
+
+    // THE MEDIAN IS ALWAYS AN INLIER
+    peer->dist_cm = sum / peer->inliers ;
+    peer->spread_cm = sqrtf(fmaxf(sum2 / peer->inliers - peer->dist_cm * peer->dist_cm, 0.0f)) ;
+}
+
+//
+// Range a peer <rounds> times ( fresh sessions , the result cache is bypassed )
+//
+// The peer is looked up in the current scan list ; returns the sessions with a distance
+//
+unsigned int survey_range(const char *ssid, unsigned int rounds, unsigned int count, unsigned int burst_period,
+                          survey_peer_t *peer)
+{
+    float samples[SURVEY_MAX_ROUNDS] ;
+    unsigned int round , n = 0 ;
+    wifi_ap_record_t *ap_record ;
+    ftm_session_t session ;
+
+    memset(peer, 0, sizeof(survey_peer_t)) ;
+
+    ap_record = tool_find_ftm_responder_ap(ssid, 0) ;
+    if (!ap_record)
+        return 0 ;
+
+    // the scan list may be replaced by the next scan
+    peer->found = 1 ;
+    memcpy(peer->mac, ap_record->bssid, 6) ;
+    peer->channel = ap_record->primary ;
+
+    for (round = 0; (round < rounds) && (round < SURVEY_MAX_ROUNDS); round++)
+    {
+        ftm_session_setup(&session, peer->mac, peer->channel, count, burst_period, 0, 0) ;
+
+        if (ftm_session_run(&session))
+        {
+            // DRIFT-CORRECTED DISTANCE , OR THE DRIVER ESTIMATE
+            samples[n++] = session.estimate.used ? session.estimate.dist_cm : (float) session.dist_est ;
+        }
+        ftm_session_release(&session) ;
+    }
+
+    survey_reduce(samples, n, peer) ;
+
+    return n ;
+}
+
+//
+// Write <ssid> as a quoted JSON string ( '"' , '\\' and control characters escaped )
+//
+// returns the length written
+//
+static unsigned int survey_json_ssid(char *dst, const char *ssid)
+{
+    const unsigned char *s = (const unsigned char *) ssid ;
+    unsigned int len = 0 ;
+
+    dst[len++] = '"' ;
+    for ( ; *s; s++)
+    {
+        if ( (*s == '"') || (*s == '\\') )
+        {
+            dst[len++] = '\\' ;
+            dst[len++] = (char) *s ;
+        }
+        else if (*s < 0x20)
+        {
+            len += sprintf(dst + len, "\\u%04x", *s) ;
+        }
+        else
+        {
+            dst[len++] = (char) *s ;
+        }
+    }
+    dst[len++] = '"' ;
+    dst[len] = 0 ;
+
+    return len ;
+}
+
+//
+// Survey the peers of this anchor
+//
+// returns the number of peers with a distance
+//
+unsigned int survey_run(const survey_request_t *request,
+                        void (*callback)(unsigned char *buffer, unsigned int len))
+{
+    survey_request_t peers ;
+    survey_peer_t peer[SURVEY_MAX_PEERS] ;
+    char line[SURVEY_LINE_BUFFER_LENGTH] ;
+    char mac_string[32] ;
+    char *row ;
+    unsigned int k , len , measured = 0 ;
+    int64_t start_us = esp_timer_get_time() ;
+
+    // THE SAME SITE LIST CAN BE SENT TO EVERY ANCHOR ( this anchor is left out )
+    peers = *request ;
+    peers.peers = 0 ;
+    for (k = 0; k < request->peers; k++)
+    {
+        if (strcmp(request->ssid[k], SURVEY_OWN_SSID))
+        {
+            strcpy(peers.ssid[peers.peers++], request->ssid[k]) ;
+        }
+    }
+    request = &peers ;
+
+    if ( !request->peers || (request->peers > SURVEY_MAX_PEERS) ||
+         !request->rounds || (request->rounds > SURVEY_MAX_ROUNDS) ||
+         ( request->count != 0 && request->count != 8 && request->count != 16 &&
+           request->count != 24 && request->count != 32 && request->count != 64 ) ||
+         (request->burst_period < 2) || (request->burst_period >= 256) )
+    {
+        sprintf(line, "Invalid Survey! Valid options are 1-%d peer ssids (this anchor left out), rounds 1-%d, "
+                      "count 0/8/16/24/32/64, burst 2-255",
+                      SURVEY_MAX_PEERS, SURVEY_MAX_ROUNDS) ;
+        tool_log(TAG, line, 1, callback) ;
+        return 0 ;
+    }
+
+    sprintf(line, "Survey - Anchor %s , Peers %u , Rounds %u , Frm Count %u",
+                  SURVEY_OWN_SSID, request->peers, request->rounds, request->count) ;
+    tool_log(TAG, line, 0, callback) ;
+
+    // FRESH SCAN LIST ( peers and their channels )
+    tool_perform_scan(0, true, 0, 0) ;
+
+    for (k = 0; k < request->peers; k++)
+    {
+        survey_range(request->ssid[k], request->rounds, request->count, request->burst_period, &peer[k]) ;
+
+        if (!peer[k].found)
+        {
+            sprintf(line, "Survey - %s : Not Found", request->ssid[k]) ;
+        }
+        else if (!peer[k].sessions)
+        {
+            tool_array_to_mac_string(mac_string, peer[k].mac) ;
+            sprintf(line, "Survey - %s (%s) ch %u : No Distance , Sessions 0/%u",
+                          request->ssid[k], mac_string, peer[k].channel, request->rounds) ;
+        }
+        else
+        {
+            measured++ ;
+            tool_array_to_mac_string(mac_string, peer[k].mac) ;
+            sprintf(line, "Survey - %s (%s) ch %u : Distance %.3f m , Median %.3f m , MAD %.2f cm , "
+                          "Spread %.2f cm , Sessions %u/%u , Inliers %u",
+                          request->ssid[k], mac_string, peer[k].channel,
+                          peer[k].dist_cm / 100.0f, peer[k].median_cm / 100.0f, peer[k].mad_cm,
+                          peer[k].spread_cm, peer[k].sessions, request->rounds, peer[k].inliers) ;
+        }
+        tool_log(TAG, line, 0, callback) ;
+    }
+
+    // ROW OF THIS ANCHOR ( JSON , SSIDS ESCAPED )
+    if ( (row = pool_alloc_or_heap(SURVEY_ROW_LENGTH)) )
+    {
+        len = sprintf(row, "{\"survey\":") ;
+        len += survey_json_ssid(row + len, SURVEY_OWN_SSID) ;
+        len += sprintf(row + len, ",\"anchors\":[") ;
+        len += survey_json_ssid(row + len, SURVEY_OWN_SSID) ;
+        for (k = 0; k < request->peers; k++)
+        {
+            row[len++] = ',' ;
+            len += survey_json_ssid(row + len, request->ssid[k]) ;
+        }
+        len += sprintf(row + len, "],\"d_m\":[0.000") ;
+        for (k = 0; k < request->peers; k++)
+        {
+            len += peer[k].sessions ? sprintf(row + len, ",%.3f", peer[k].dist_cm / 100.0f) : sprintf(row + len, ",null") ;
+        }
+        len += sprintf(row + len, "],\"mad_cm\":[0.00") ;
+        for (k = 0; k < request->peers; k++)
+        {
+            len += peer[k].sessions ? sprintf(row + len, ",%.2f", peer[k].mad_cm) : sprintf(row + len, ",null") ;
+        }
+        len += sprintf(row + len, "],\"sessions\":[0") ;
+        for (k = 0; k < request->peers; k++)
+        {
+            len += sprintf(row + len, ",%u", peer[k].sessions) ;
+        }
+        sprintf(row + len, "]}") ;
+        tool_log(0, row, 0, callback) ;
+        pool_free(row) ;
+    }
+
+    sprintf(line, "Survey Complete - %u/%u peers in %u mSec",
+                  measured, request->peers, (unsigned int) ((esp_timer_get_time() - start_us) / 1000)) ;
+    tool_log(TAG, line, 0, callback) ;
+
+    return measured ;
+}
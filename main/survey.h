@@ -0,0 +1,82 @@
+/*
+    survey.h - Anchor Survey
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+#ifndef _SURVEY_H
+
+#define _SURVEY_H	1
+
+    #ifdef __cplusplus
+    extern "C" {
+    #endif
+
+        #define SURVEY_MAX_PEERS            8       // peers of a survey
+        #define SURVEY_MAX_SSIDS            (SURVEY_MAX_PEERS + 1)  // site list of a request ( a 9 anchor site , this anchor included )
+        #define SURVEY_MAX_ROUNDS           16      // sessions per peer
+        #define SURVEY_DEFAULT_ROUNDS       5
+        #define SURVEY_DEFAULT_COUNT        16      // frame count of each session
+        #define SURVEY_DEFAULT_BURST        2       // burst period ( 100 mSec units )
+        #define SURVEY_SSID_LENGTH          33
+
+        //
+        // Survey request ( peer anchors and sessions per peer )
+        //
+        typedef struct {
+            char          ssid[SURVEY_MAX_SSIDS][SURVEY_SSID_LENGTH] ;
+            unsigned int  peers ;                           // 0 : missing or invalid "ssids"
+            unsigned int  rounds ;
+            unsigned int  count ;
+            unsigned int  burst_period ;
+        } survey_request_t ;
+
+        //
+        // Distance to a peer ( robust reduction of its sessions )
+        //
+        typedef struct {
+            unsigned int  found ;
+            unsigned char mac[6] ;
+            unsigned int  channel ;
+            unsigned int  sessions ;                        // sessions with a distance
+            unsigned int  inliers ;
+            float         dist_cm ;                         // mean of the inliers
+            float         median_cm ;
+            float         mad_cm ;
+            float         spread_cm ;                       // standard deviation of the inliers
+        } survey_peer_t ;
+
+        extern unsigned int survey_range(const char *ssid, unsigned int rounds, unsigned int count, unsigned int burst_period,
+                                         survey_peer_t *peer) ;
+        extern unsigned int survey_run(const survey_request_t *request,
+                                       void (*callback)(unsigned char *buffer, unsigned int len)) ;
+
+    #ifdef __cplusplus
+    }
+    #endif
+
+#endif
@@ -29,25 +29,99 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "esp_system.h"
 #include "esp_wifi.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "tool.h"
+#include "pool.h"
+#include "metrics.h"
+#include "trace.h"
+#include "capture.h"
+#include "stream.h"
 
 #define TOOL_LINE_BUFFER_LENGTH       1024
+#define TOOL_MAX_AP_RECORDS           (POOL_LARGE_BLOCK_SIZE / sizeof(wifi_ap_record_t))
+#define TOOL_SCAN_DELTA_LINE_LENGTH   192         // NDJSON line of a scan delta
+#define TOOL_SCAN_DELTA_RSSI          6           // RSSI change ( dB ) reported as a delta
 
 static uint16_t g_scan_ap_num;
 static wifi_ap_record_t *g_ap_list_buffer;
 
+// APs of the previous full scan ( scan deltas )
+static struct {
+    unsigned char bssid[6] ;
+    uint8_t       primary ;
+    int8_t        rssi ;
+} tool_scan_previous[TOOL_MAX_AP_RECORDS] ;
+static unsigned int tool_scan_previous_count ;
+
+#ifdef CONFIG_ESP_LOG_CONSOLE_MIRROR
+    #define TOOL_LOG_CONSOLE_MIRROR   true
+#else
+    #define TOOL_LOG_CONSOLE_MIRROR   false
+#endif
+
 static const char *TAG = "tool";
 
+static bool tool_log_console = TOOL_LOG_CONSOLE_MIRROR ;       // mirror socket reports to the console
+
+// modules ( log tags ) reported by the "log" command : every module of the firmware ,
+// followed by the other tags set at run time ( driver and IDF components ) while room is left
+#define TOOL_LOG_MAX_MODULES    32
+#define TOOL_LOG_MODULE_LENGTH  16
+
+static struct {
+    char             module[TOOL_LOG_MODULE_LENGTH] ;
+    esp_log_level_t  level ;
+} tool_log_module[TOOL_LOG_MAX_MODULES] = {
+    { "Main App",    CONFIG_LOG_DEFAULT_LEVEL },
+    { "wifi softAP", CONFIG_LOG_DEFAULT_LEVEL },
+    { "tcp server",  CONFIG_LOG_DEFAULT_LEVEL },
+    { "parser",      CONFIG_LOG_DEFAULT_LEVEL },
+    { "tool",        CONFIG_LOG_DEFAULT_LEVEL },
+    { "fifo",        CONFIG_LOG_DEFAULT_LEVEL },
+    { "bus",         CONFIG_LOG_DEFAULT_LEVEL },
+    { "ftm",         CONFIG_LOG_DEFAULT_LEVEL },
+    { "cache",       CONFIG_LOG_DEFAULT_LEVEL },
+    { "pool",        CONFIG_LOG_DEFAULT_LEVEL },
+    { "history",     CONFIG_LOG_DEFAULT_LEVEL },
+    { "journal",     CONFIG_LOG_DEFAULT_LEVEL },
+    { "metrics",     CONFIG_LOG_DEFAULT_LEVEL },
+    { "trace",       CONFIG_LOG_DEFAULT_LEVEL },
+    { "capture",     CONFIG_LOG_DEFAULT_LEVEL },
+    { "stream",      CONFIG_LOG_DEFAULT_LEVEL },
+    { "udp",         CONFIG_LOG_DEFAULT_LEVEL },
+    { "survey",      CONFIG_LOG_DEFAULT_LEVEL },
+    { "radio",       CONFIG_LOG_DEFAULT_LEVEL },
+    { "responder",   CONFIG_LOG_DEFAULT_LEVEL },
+    { "wifi",        CONFIG_LOG_DEFAULT_LEVEL },
+} ;
+
+
+static const char *tool_log_level_name[] = { "none", "error", "warn", "info", "debug", "verbose" } ;
+
 // FUNCTION PROTOTYPES
-bool tool_perform_scan(const char *ssid, bool internal, void (*callback)(unsigned char *buffer, unsigned int len)) ;
-wifi_ap_record_t *tool_find_ftm_responder_ap(const char *ssid) ;
+bool tool_perform_scan(const char *ssid, bool internal, tool_timing_t *timing,
+                       void (*callback)(unsigned char *buffer, unsigned int len)) ;
+void tool_scan_report(const wifi_ap_record_t *records, unsigned int count,
+                      void (*callback)(unsigned char *buffer, unsigned int len)) ;
+static void tool_scan_delta(const wifi_ap_record_t *records, unsigned int count) ;
+wifi_ap_record_t *tool_find_ftm_responder_ap(const char *ssid, tool_timing_t *timing) ;
+unsigned int tool_ftm_responders(wifi_ap_record_t *records, unsigned int max) ;
 unsigned int tool_mac_string_to_array(char *str,unsigned char *array) ;
 unsigned int tool_array_to_mac_string(char *str,unsigned char *array) ;
 void tool_log(const char *tag, char *line, unsigned int type, void (*callback)(unsigned char *buffer, unsigned int len)) ;
+void tool_timing_report(const tool_timing_t *timing, void (*callback)(unsigned char *buffer, unsigned int len)) ;
+int  tool_log_level_from_string(const char *name) ;
+unsigned int tool_log_set_level(const char *module, int level) ;
+void tool_log_set_console(bool enable) ;
+void tool_log_report(void (*callback)(unsigned char *buffer, unsigned int len)) ;
+void tool_log_configure(const char *module, int level, int console,
+                        void (*callback)(unsigned char *buffer, unsigned int len)) ;
 
 //
 // Perform WiFi Scanning 
@@ -55,15 +129,23 @@ void tool_log(const char *tag, char *line, unsigned int type, void (*callback)(u
 // ssid == 0 : scan all available AP stations
 // ssid != 0 : scan specific SSID string (pointed by <ssid>)
 //
-bool tool_perform_scan(const char *ssid, bool internal, void (*callback)(unsigned char *buffer, unsigned int len))
+// timing != 0 : scan and formatting times are added to <timing>
+//
+bool tool_perform_scan(const char *ssid, bool internal, tool_timing_t *timing,
+                       void (*callback)(unsigned char *buffer, unsigned int len))
 {
     wifi_scan_config_t scan_config = { 0 } ;
     scan_config.ssid = (uint8_t *) ssid ;
-    uint8_t i;
+    unsigned int rows = 0 ;
     char line[TOOL_LINE_BUFFER_LENGTH] ;    
+    int64_t start_us = esp_timer_get_time() ;
 
     ESP_ERROR_CHECK( esp_wifi_scan_start(&scan_config, true) ) ;
 
+    metrics_observe(METRICS_SCAN_MS, (uint32_t) ((esp_timer_get_time() - start_us) / 1000)) ;
+    if (timing) timing->air_us += (uint32_t) (esp_timer_get_time() - start_us) ;
+    start_us = esp_timer_get_time() ;
+
     esp_wifi_scan_get_ap_num(&g_scan_ap_num) ;
 
     if (g_scan_ap_num == 0) 
@@ -75,59 +157,152 @@ bool tool_perform_scan(const char *ssid, bool internal, void (*callback)(unsigne
 
     if (g_ap_list_buffer) 
     {
-        free(g_ap_list_buffer) ;
+        pool_free(g_ap_list_buffer) ;
     }
 
-    g_ap_list_buffer = malloc(g_scan_ap_num * sizeof(wifi_ap_record_t)) ;
+    // the scan list lives in a single (large) pool block
+    if (g_scan_ap_num > TOOL_MAX_AP_RECORDS)
+    {
+        g_scan_ap_num = TOOL_MAX_AP_RECORDS ;
+    }
+
+    g_ap_list_buffer = pool_alloc(g_scan_ap_num * sizeof(wifi_ap_record_t)) ;
 
     if (g_ap_list_buffer == NULL) 
     {
-        sprintf(line, "Failed to malloc buffer to print scan results") ;
+        sprintf(line, "Failed to alloc buffer to print scan results") ;
         tool_log(TAG, line, 1, callback) ;            
         return false ;
     }
 
+    TRACE(TRACE_FORMAT_BEGIN, g_scan_ap_num) ;
+
+    if (esp_wifi_scan_get_ap_records(&g_scan_ap_num, (wifi_ap_record_t *)g_ap_list_buffer) == ESP_OK) 
+    {
+        capture_scan(g_ap_list_buffer, g_scan_ap_num) ;
+        if (!ssid) tool_scan_delta(g_ap_list_buffer, g_scan_ap_num) ;
+        if (!internal) 
+        {
+            rows = g_scan_ap_num ;
+        }
+    }
+
+    tool_scan_report(g_ap_list_buffer, rows, callback) ;
+
+    TRACE(TRACE_FORMAT_END, 0) ;
+    if (timing) timing->format_us += (uint32_t) (esp_timer_get_time() - start_us) ;
+
+
+    return true ;
+}
+
+//
+// Report a list of AP records ( title , one row per AP , completion line )
+//
+void tool_scan_report(const wifi_ap_record_t *records, unsigned int count,
+                      void (*callback)(unsigned char *buffer, unsigned int len))
+{
+    unsigned int i ;
+    char mac_string[32] ;
+    char line[TOOL_LINE_BUFFER_LENGTH] ;    
+
     // [ SCAN REPORT TITLE ]
     sprintf(line, "Scan Report:") ;
     tool_log(TAG, line, 0, callback) ;    
 
     // [ SCAN REPORT ROWS ]
-    if (esp_wifi_scan_get_ap_records(&g_scan_ap_num, (wifi_ap_record_t *)g_ap_list_buffer) == ESP_OK) 
+    for (i = 0; i < count; i++) 
     {
-        if (!internal) 
+        tool_array_to_mac_string(mac_string, (unsigned char *) records[i].bssid)  ;
+
+        sprintf(line, "[%s][rssi %d][ch %d][mac %s]%s", 
+                        records[i].ssid, 
+                        records[i].rssi, 
+                        records[i].primary,                                 
+                        mac_string,
+                        records[i].ftm_responder ? "[FTM]" : "") ;
+        tool_log(TAG, line, 0, callback) ;                                    
+    }
+
+    sprintf(line,"%s","sta scan done") ;
+    tool_log(TAG, line, 0, callback) ;        
+}
+
+//
+// Publish the changes since the previous full scan ( new , lost , moved channel or RSSI )
+//
+static void tool_scan_delta(const wifi_ap_record_t *records, unsigned int count)
+{
+    unsigned int i, k, len = 0 ;
+    unsigned char seen[TOOL_MAX_AP_RECORDS] ;
+    char mac_string[32] ;
+    char *buffer ;
+    uint32_t now_ms = (uint32_t) (esp_timer_get_time() / 1000) ;
+
+    if (stream_subscribed(STREAM_SCAN) &&
+        (buffer = pool_alloc_or_heap((count + tool_scan_previous_count) * TOOL_SCAN_DELTA_LINE_LENGTH + 1)) )
+    {
+        memset(seen, 0, sizeof(seen)) ;
+
+        for (i = 0; i < count; i++)
         {
-            for (i = 0; i < g_scan_ap_num; i++) 
+            for (k = 0; (k < tool_scan_previous_count) && memcmp(tool_scan_previous[k].bssid, records[i].bssid, 6); k++) ;
+
+            tool_array_to_mac_string(mac_string, (unsigned char *) records[i].bssid) ;
+
+            if (k == tool_scan_previous_count)
             {
-                char mac_string[32] ;
+                len += sprintf(buffer + len, "{\"scan\":\"new\",\"t\":%u,\"mac\":\"%s\",\"ssid\":\"%s\",\"ch\":%u,\"rssi\":%d,\"ftm\":%u}\n",
+                                             now_ms, mac_string, records[i].ssid, records[i].primary, records[i].rssi,
+                                             records[i].ftm_responder) ;
+                continue ;
+            }
 
-                tool_array_to_mac_string(mac_string, g_ap_list_buffer[i].bssid)  ;
+            seen[k] = 1 ;
 
-                sprintf(line, "[%s][rssi %d][ch %d][mac %s]%s", 
-                                g_ap_list_buffer[i].ssid, 
-                                g_ap_list_buffer[i].rssi, 
-                                g_ap_list_buffer[i].primary,                                 
-                                mac_string,
-                                g_ap_list_buffer[i].ftm_responder ? "[FTM]" : "") ;
-                tool_log(TAG, line, 0, callback) ;                                    
+            if ( (records[i].primary != tool_scan_previous[k].primary) ||
+                 (abs(records[i].rssi - tool_scan_previous[k].rssi) >= TOOL_SCAN_DELTA_RSSI) )
+            {
+                len += sprintf(buffer + len, "{\"scan\":\"moved\",\"t\":%u,\"mac\":\"%s\",\"ssid\":\"%s\",\"ch\":%u,\"rssi\":%d,\"rssi_was\":%d}\n",
+                                             now_ms, mac_string, records[i].ssid, records[i].primary, records[i].rssi,
+                                             tool_scan_previous[k].rssi) ;
             }
         }
-    }
 
-    sprintf(line,"%s","sta scan done") ;
-    tool_log(TAG, line, 0, callback) ;        
+        for (k = 0; k < tool_scan_previous_count; k++)
+        {
+            if (!seen[k])
+            {
+                tool_array_to_mac_string(mac_string, tool_scan_previous[k].bssid) ;
+                len += sprintf(buffer + len, "{\"scan\":\"lost\",\"t\":%u,\"mac\":\"%s\"}\n", now_ms, mac_string) ;
+            }
+        }
 
+        stream_publish(STREAM_SCAN, (unsigned char *) buffer, len) ;
+        pool_free(buffer) ;
+    }
 
-    return true ;
+    // THIS SCAN BECOMES THE REFERENCE
+    for (i = 0; i < count; i++)
+    {
+        memcpy(tool_scan_previous[i].bssid, records[i].bssid, 6) ;
+        tool_scan_previous[i].primary = records[i].primary ;
+        tool_scan_previous[i].rssi = records[i].rssi ;
+    }
+    tool_scan_previous_count = count ;
 }
 
 //
 // Return the Description (wifi_ap_record_t) of a WiFi AP
 // ( which contains bssid[], ssid[], primary channel, secondary channel), etc )
 //
-wifi_ap_record_t *tool_find_ftm_responder_ap(const char *ssid)
+// timing != 0 : the lookup time ( including scans ) is added to <timing>
+//
+wifi_ap_record_t *tool_find_ftm_responder_ap(const char *ssid, tool_timing_t *timing)
 {
     bool retry_scan = false ;
     uint8_t i ;
+    int64_t start_us = esp_timer_get_time() ;
 
     if (!ssid)
         return NULL ;
@@ -136,8 +311,9 @@ retry:
     if (!g_ap_list_buffer || (g_scan_ap_num == 0)) 
     {
         ESP_LOGI(TAG, "Scanning for %s", ssid) ;
-        if (false == tool_perform_scan(ssid, true, 0)) 
+        if (false == tool_perform_scan(ssid, true, 0, 0)) 
         {
+            if (timing) timing->lookup_us += (uint32_t) (esp_timer_get_time() - start_us) ;
             return NULL ;
         }
     }
@@ -145,7 +321,10 @@ retry:
     for (i = 0; i < g_scan_ap_num; i++) 
     {
         if (strcmp((const char *)g_ap_list_buffer[i].ssid, ssid) == 0)
+        {
+            if (timing) timing->lookup_us += (uint32_t) (esp_timer_get_time() - start_us) ;
             return &g_ap_list_buffer[i] ;
+        }
     }
 
     if (!retry_scan) 
@@ -153,7 +332,7 @@ retry:
         retry_scan = true ;
         if (g_ap_list_buffer) 
         {
-            free(g_ap_list_buffer) ;
+            pool_free(g_ap_list_buffer) ;
             g_ap_list_buffer = NULL ;
         }
         goto retry ;
@@ -161,9 +340,40 @@ retry:
 
     ESP_LOGI(TAG, "No matching AP found") ;
 
+    if (timing) timing->lookup_us += (uint32_t) (esp_timer_get_time() - start_us) ;
+
     return NULL ;
 }
 
+//
+// Copy the FTM responders of the last scan , in channel order ( strongest first on a channel )
+//
+// returns the number of records copied ( at most <max> )
+//
+unsigned int tool_ftm_responders(wifi_ap_record_t *records, unsigned int max)
+{
+    unsigned int i , j , n = 0 ;
+    wifi_ap_record_t record ;
+
+    for (i = 0; (i < g_scan_ap_num) && g_ap_list_buffer && (n < max); i++)
+    {
+        if (!g_ap_list_buffer[i].ftm_responder)
+            continue ;
+
+        // INSERTION SORT ( channel , then RSSI )
+        record = g_ap_list_buffer[i] ;
+        for (j = n; (j > 0) && ( (records[j-1].primary > record.primary) ||
+                                 ((records[j-1].primary == record.primary) && (records[j-1].rssi < record.rssi)) ); j--)
+        {
+            records[j] = records[j-1] ;
+        }
+        records[j] = record ;
+        n++ ;
+    }
+
+    return n ;
+}
+
 //
 // Convert MAC string to byte array (6 bytes)
 //
@@ -208,10 +418,12 @@ unsigned int tool_array_to_mac_string(char *str,unsigned char *array)
 //
 // type==0 : Information Log , type==1 : Error Log
 //
+// Lines sent through <callback> reach the console only when the console mirror is on
+//
 void tool_log(const char *tag, char *line, unsigned int type, void (*callback)(unsigned char *buffer, unsigned int len))
 {
     // Conventional ESP LOG
-    if (tag && line)
+    if (tag && line && (tool_log_console || !callback))
     {
         switch(type)
         {
@@ -222,6 +434,13 @@ void tool_log(const char *tag, char *line, unsigned int type, void (*callback)(u
         }
     }    
 
+    // LOG STREAM
+    if (tag && line && stream_subscribed(STREAM_LOG))
+    {
+        stream_printf(STREAM_LOG, "%c (%u) %s: %s\n", type ? 'E' : 'I',
+                                  (unsigned int) (esp_timer_get_time() / 1000), tag, line) ;
+    }
+
     // TCP/IP socket CALLBACK
     if (callback)
     {
@@ -229,3 +448,145 @@ void tool_log(const char *tag, char *line, unsigned int type, void (*callback)(u
         callback((unsigned char *)line,strlen(line)) ;
     }    
 }
+
+//
+// Report the latency breakdown of a request ( a single footer line )
+//
+void tool_timing_report(const tool_timing_t *timing, void (*callback)(unsigned char *buffer, unsigned int len))
+{
+    char line[TOOL_LINE_BUFFER_LENGTH] ;
+
+    if (!timing)
+        return ;
+
+    sprintf(line, "Timing - Queued %u uSec, Lookup %u uSec, Air %u uSec, Format %u uSec, Flush %u uSec, Total %u uSec",
+                  timing->queued_us, timing->lookup_us, timing->air_us,
+                  timing->format_us, timing->flush_us, timing->total_us) ;
+    tool_log(TAG, line, 0, callback) ;
+}
+
+//
+// Convert a level name ( "none" , "error" , "warn" , "info" , "debug" or "verbose" ) to esp_log_level_t
+//
+// returns -1 for unknown names
+//
+int tool_log_level_from_string(const char *name)
+{
+    int k ;
+
+    if (name)
+    {
+        for (k=0; k<=ESP_LOG_VERBOSE; k++)
+        {
+            if (!strcmp(name, tool_log_level_name[k]))
+                return k ;
+        }
+    }
+    return -1 ;
+}
+
+//
+// Set the log level of a module ( module == "*" : every module )
+//
+// Any tag is passed to esp_log_level_set() , "*" sets every tag
+// returns 0 for an empty module or an unknown level
+//
+unsigned int tool_log_set_level(const char *module, int level)
+{
+    unsigned int k ;
+
+    if (!module || !module[0] || (level < ESP_LOG_NONE) || (level > ESP_LOG_VERBOSE))
+        return 0 ;
+
+    if (!strcmp(module, "*"))
+    {
+        esp_log_level_set("*", (esp_log_level_t) level) ;
+
+        // RESET THE TAGS WITH THEIR OWN LEVEL AS WELL
+        for (k=0; (k<TOOL_LOG_MAX_MODULES) && tool_log_module[k].module[0]; k++)
+        {
+            tool_log_module[k].level = (esp_log_level_t) level ;
+            esp_log_level_set(tool_log_module[k].module, (esp_log_level_t) level) ;
+        }
+        return 1 ;
+    }
+
+    esp_log_level_set(module, (esp_log_level_t) level) ;
+
+    // RECORD THE LEVEL FOR THE REPORT ( NEW TAGS TAKE THE FIRST FREE ENTRY )
+    for (k=0; (k<TOOL_LOG_MAX_MODULES) && tool_log_module[k].module[0]; k++)
+    {
+        if (!strcmp(module, tool_log_module[k].module))
+            break ;
+    }
+
+    if ( (k < TOOL_LOG_MAX_MODULES) && (strlen(module) < TOOL_LOG_MODULE_LENGTH) )
+    {
+        strcpy(tool_log_module[k].module, module) ;
+        tool_log_module[k].level = (esp_log_level_t) level ;
+    }
+
+    return 1 ;
+}
+
+//
+// Enable or disable the console mirror of socket reports
+//
+void tool_log_set_console(bool enable)
+{
+    tool_log_console = enable ;
+}
+
+//
+// Report the level of every module and the console mirror setting
+//
+void tool_log_report(void (*callback)(unsigned char *buffer, unsigned int len))
+{
+    char line[TOOL_LINE_BUFFER_LENGTH] ;
+    unsigned int k ;
+
+    sprintf(line, "Log Report:") ;
+    tool_log(TAG, line, 0, callback) ;
+
+    sprintf(line, "| Module          | Level   |") ;
+    tool_log(TAG, line, 0, callback) ;
+
+    for (k=0; (k<TOOL_LOG_MAX_MODULES) && tool_log_module[k].module[0]; k++)
+    {
+        sprintf(line, "| %-15s | %-7s |", tool_log_module[k].module, tool_log_level_name[tool_log_module[k].level]) ;
+        tool_log(TAG, line, 0, callback) ;
+    }
+
+    sprintf(line, "Console mirror %s", tool_log_console ? "on" : "off") ;
+    tool_log(TAG, line, 0, callback) ;
+}
+
+//
+// Apply the settings of a "log" command and report the result
+//
+// level == -1 : keep levels , level < -1 : unknown level name
+// console < 0 : keep the console mirror setting
+//
+void tool_log_configure(const char *module, int level, int console,
+                        void (*callback)(unsigned char *buffer, unsigned int len))
+{
+    char line[TOOL_LINE_BUFFER_LENGTH] ;
+
+    if (level < -1)
+    {
+        sprintf(line, "Unknown log level") ;
+        tool_log(TAG, line, 1, callback) ;
+    }
+    else if ( (level >= 0) && !tool_log_set_level(module, level) )
+    {
+        sprintf(line, "Invalid log module! An empty module name matches no tag") ;
+        tool_log(TAG, line, 1, callback) ;
+    }
+
+    if (console >= 0)
+    {
+        tool_log_set_console(console ? true : false) ;
+    }
+
+    tool_log_report(callback) ;
+}
@@ -39,11 +39,34 @@
         #include "freertos/FreeRTOS.h"      // { bool } 
         #include "esp_wifi.h"               // { wifi_ap_record_t } 
 
-        extern bool tool_perform_scan(const char *ssid, bool internal, void (*callback)(unsigned char *buffer, unsigned int len)) ;
-        extern wifi_ap_record_t *tool_find_ftm_responder_ap(const char *ssid) ;
+        //
+        // Latency breakdown of a request ( micro-seconds )
+        //
+        typedef struct {
+            uint32_t queued_us ;            // waiting in the FTM session queue
+            uint32_t lookup_us ;            // responder lookup ( including scans )
+            uint32_t air_us ;               // session start to report ( or scan )
+            uint32_t format_us ;            // report formatting
+            uint32_t flush_us ;             // output flush to the socket
+            uint32_t total_us ;             // whole request
+        } tool_timing_t ;
+
+        extern bool tool_perform_scan(const char *ssid, bool internal, tool_timing_t *timing,
+                                      void (*callback)(unsigned char *buffer, unsigned int len)) ;
+        extern void tool_scan_report(const wifi_ap_record_t *records, unsigned int count,
+                                     void (*callback)(unsigned char *buffer, unsigned int len)) ;
+        extern wifi_ap_record_t *tool_find_ftm_responder_ap(const char *ssid, tool_timing_t *timing) ;
+        extern unsigned int tool_ftm_responders(wifi_ap_record_t *records, unsigned int max) ;
         extern unsigned int tool_mac_string_to_array(char *str,unsigned char *array) ;
         extern unsigned int tool_array_to_mac_string(char *str,unsigned char *array) ;    
         extern void tool_log(const char *tag, char *line, unsigned int type, void (*callback)(unsigned char *buffer, unsigned int len)) ;    
+        extern void tool_timing_report(const tool_timing_t *timing, void (*callback)(unsigned char *buffer, unsigned int len)) ;
+        extern int  tool_log_level_from_string(const char *name) ;
+        extern unsigned int tool_log_set_level(const char *module, int level) ;
+        extern void tool_log_set_console(bool enable) ;
+        extern void tool_log_report(void (*callback)(unsigned char *buffer, unsigned int len)) ;
+        extern void tool_log_configure(const char *module, int level, int console,
+                                       void (*callback)(unsigned char *buffer, unsigned int len)) ;
 
     #ifdef __cplusplus
     }
@@ -0,0 +1,241 @@
+/*
+    trace.c - Hot-Path Trace Buffer
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+//
+// Lock-free ring of timestamped events, written by the TRACE() points along the
+// command path ( receive , framing , parsing , FTM session , formatting , FIFO
+// commit and send ). Timestamps are CPU cycle counts, so a trace point costs a
+// handful of instructions ; with ESP_TRACE_ENABLE unset, TRACE() expands to
+// nothing and this module only answers "trace disabled".
+//
+// The "trace" command dumps the ring in binary form ( tools/trace_to_chrome.py
+// converts it to the Chrome trace JSON format ).
+//
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_cpu.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "tool.h"
+#include "trace.h"
+
+#define TRACE_LINE_BUFFER_LENGTH        128
+#define TRACE_MAX_TASKS                 16
+#define TRACE_TASK_NAME_LENGTH          16
+#define TRACE_CPU_FREQ_MHZ              CONFIG_ESP32S2_DEFAULT_CPU_FREQ_MHZ
+
+#define TRACE_BINARY_MAGIC              "CHRT"
+#define TRACE_BINARY_VERSION            1
+
+static const char *TAG = "trace" ;
+
+#if (CONFIG_ESP_TRACE_ENABLE)
+
+_Static_assert((TRACE_LENGTH & (TRACE_LENGTH - 1)) == 0, "ESP_TRACE_LENGTH must be a power of two") ;
+
+typedef struct {
+    uint32_t cycles ;               // CPU cycle counter
+    uint32_t arg ;
+    uint8_t  event ;
+    uint8_t  task ;                 // index in the task table
+    uint16_t reserved ;
+} trace_event_t ;
+
+static struct {
+    trace_event_t ring[TRACE_LENGTH] ;
+    uint32_t      head ;            // events written ( the ring keeps the last TRACE_LENGTH )
+    volatile unsigned int enabled ;
+    TaskHandle_t  task[TRACE_MAX_TASKS] ;
+    char          task_name[TRACE_MAX_TASKS][TRACE_TASK_NAME_LENGTH] ;
+    unsigned int  num_tasks ;
+} trace_control ;
+
+static portMUX_TYPE trace_spinlock = portMUX_INITIALIZER_UNLOCKED ;
+
+#endif
+
+// FUNCTION PROTOTYPES
+void trace_init(void) ;
+void trace_record(unsigned int event, uint32_t arg) ;
+void trace_clear(void) ;
+unsigned int trace_dump(void (*stream)(unsigned char *buffer, unsigned int len),
+                        void (*callback)(unsigned char *buffer, unsigned int len)) ;
+
+#if (CONFIG_ESP_TRACE_ENABLE)
+
+static uint8_t trace_task_index(void) ;
+
+//
+// Index of the running task in the task table ( names are captured on first sight )
+//
+static uint8_t trace_task_index(void)
+{
+    TaskHandle_t task = xTaskGetCurrentTaskHandle() ;
+    unsigned int k, n = trace_control.num_tasks ;
+
+    for (k=0; k<n; k++)
+    {
+        if (trace_control.task[k] == task)
+            return (uint8_t) k ;
+    }
+
+    portENTER_CRITICAL(&trace_spinlock) ;
+    for (k=0; k<trace_control.num_tasks; k++)
+    {
+        if (trace_control.task[k] == task)
+            break ;
+    }
+    if ( (k == trace_control.num_tasks) && (k < TRACE_MAX_TASKS) )
+    {
+        strncpy(trace_control.task_name[k], pcTaskGetTaskName(task), TRACE_TASK_NAME_LENGTH - 1) ;
+        trace_control.task[k] = task ;
+        trace_control.num_tasks++ ;
+    }
+    portEXIT_CRITICAL(&trace_spinlock) ;
+
+    return (k < TRACE_MAX_TASKS) ? (uint8_t) k : 0xFF ;
+}
+
+#endif
+
+//
+// Record an event ( called through TRACE() )
+//
+void trace_record(unsigned int event, uint32_t arg)
+{
+    #if (CONFIG_ESP_TRACE_ENABLE)
+        trace_event_t *e ;
+
+        if (!trace_control.enabled)
+            return ;
+
+        e = &trace_control.ring[__atomic_fetch_add(&trace_control.head, 1, __ATOMIC_RELAXED) & (TRACE_LENGTH - 1)] ;
+
+        e->cycles = esp_cpu_get_ccount() ;
+        e->arg = arg ;
+        e->event = (uint8_t) event ;
+        e->task = trace_task_index() ;
+    #endif
+}
+
+//
+// Forget the recorded events
+//
+void trace_clear(void)
+{
+    #if (CONFIG_ESP_TRACE_ENABLE)
+        trace_control.enabled = 0 ;
+        memset(trace_control.ring, 0, sizeof(trace_control.ring)) ;
+        trace_control.head = 0 ;
+        trace_control.enabled = 1 ;
+    #endif
+}
+
+//
+// Dump the ring ( from the oldest to the newest event , recording is paused meanwhile )
+//
+// "CHRT" , version (u16) , event size (u16) , cpu MHz (u32) , events (u32) , tasks (u32) ,
+// now cycles (u32) , now uSec (u64) , tasks ( 16 byte names ) , events
+//
+// The ring is handed to <stream> in place ; <callback> gets the text answer when tracing is disabled.
+//
+// returns the number of events dumped
+//
+unsigned int trace_dump(void (*stream)(unsigned char *buffer, unsigned int len),
+                        void (*callback)(unsigned char *buffer, unsigned int len))
+{
+    #if (CONFIG_ESP_TRACE_ENABLE)
+        unsigned char header[32] ;
+        uint16_t version = TRACE_BINARY_VERSION ;
+        uint16_t size = sizeof(trace_event_t) ;
+        uint32_t mhz = TRACE_CPU_FREQ_MHZ ;
+        uint32_t head, count, first, tasks, now_cycles ;
+        int64_t now_us ;
+
+        trace_control.enabled = 0 ;
+
+        head = trace_control.head ;
+        count = (head < TRACE_LENGTH) ? head : TRACE_LENGTH ;
+        first = (head - count) & (TRACE_LENGTH - 1) ;
+        tasks = trace_control.num_tasks ;
+        now_cycles = esp_cpu_get_ccount() ;
+        now_us = esp_timer_get_time() ;
+
+        memcpy(header, TRACE_BINARY_MAGIC, 4) ;
+        memcpy(header + 4, &version, 2) ;
+        memcpy(header + 6, &size, 2) ;
+        memcpy(header + 8, &mhz, 4) ;
+        memcpy(header + 12, &count, 4) ;
+        memcpy(header + 16, &tasks, 4) ;
+        memcpy(header + 20, &now_cycles, 4) ;
+        memcpy(header + 24, &now_us, 8) ;
+        stream(header, sizeof(header)) ;
+
+        stream((unsigned char *) trace_control.task_name, tasks * TRACE_TASK_NAME_LENGTH) ;
+
+        // OLDEST EVENTS UP TO THE END OF THE RING , THEN THE WRAPPED PART
+        if (first + count > TRACE_LENGTH)
+        {
+            stream((unsigned char *) &trace_control.ring[first], (TRACE_LENGTH - first) * sizeof(trace_event_t)) ;
+            stream((unsigned char *) &trace_control.ring[0], (first + count - TRACE_LENGTH) * sizeof(trace_event_t)) ;
+        }
+        else
+        {
+            stream((unsigned char *) &trace_control.ring[first], count * sizeof(trace_event_t)) ;
+        }
+
+        trace_control.enabled = 1 ;
+
+        ESP_LOGI(TAG, "trace dump : %u events", count) ;
+
+        return count ;
+    #else
+        char line[TRACE_LINE_BUFFER_LENGTH] ;
+
+        sprintf(line, "Trace - disabled (ESP_TRACE_ENABLE)") ;
+        tool_log(TAG, line, 0, callback) ;
+
+        return 0 ;
+    #endif
+}
+
+//
+// Trace Initialization
+//
+void trace_init(void)
+{
+    #if (CONFIG_ESP_TRACE_ENABLE)
+        memset(&trace_control, 0, sizeof(trace_control)) ;
+        trace_control.enabled = 1 ;
+    #endif
+}
@@ -0,0 +1,78 @@
+/*
+    trace.h - Hot-Path Trace Buffer
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+#ifndef _TRACE_H
+
+#define _TRACE_H	1
+
+    #ifdef __cplusplus
+    extern "C" {
+    #endif
+
+        #include <stdint.h>
+
+        #define TRACE_LENGTH                CONFIG_ESP_TRACE_LENGTH     // events in the ring ( power of two )
+
+        // EVENTS ( *_BEGIN / *_END pairs are spans , the others are instants )
+        #define TRACE_RX                    1       // bytes received ( arg : length )
+        #define TRACE_CMD_FRAMED            2       // command terminator found ( arg : command length )
+        #define TRACE_CMD_BEGIN             3       // command execution
+        #define TRACE_CMD_END               4
+        #define TRACE_PARSE_BEGIN           5       // JSON parsing
+        #define TRACE_PARSE_END             6
+        #define TRACE_FTM_START             7       // esp_wifi_ftm_initiate_session() ( arg : frame count )
+        #define TRACE_FTM_REPORT            8       // session completion ( arg : outcome )
+        #define TRACE_FORMAT_BEGIN          9       // report formatting
+        #define TRACE_FORMAT_END            10
+        #define TRACE_FIFO_COMMIT           11      // bytes committed to the outgoing FIFO ( arg : length )
+        #define TRACE_SEND_BEGIN            12      // socket send ( arg : length )
+        #define TRACE_SEND_END              13
+
+        #define TRACE_ACTION_DUMP           0
+        #define TRACE_ACTION_CLEAR          1
+
+        #if (CONFIG_ESP_TRACE_ENABLE)
+            #define TRACE(event, arg)       trace_record((event), (uint32_t) (arg))
+        #else
+            #define TRACE(event, arg)       do { } while (0)
+        #endif
+
+        extern void trace_init(void) ;
+        extern void trace_record(unsigned int event, uint32_t arg) ;
+        extern void trace_clear(void) ;
+        extern unsigned int trace_dump(void (*stream)(unsigned char *buffer, unsigned int len),
+                                       void (*callback)(unsigned char *buffer, unsigned int len)) ;
+
+    #ifdef __cplusplus
+    }
+    #endif
+
+#endif
+
@@ -0,0 +1,281 @@
+/*
+    udp.c - UDP Datagram Streaming
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+//
+// FTM session results sent as UDP datagrams to a host and port selected on the command
+// connection :
+//
+//   { "function" : "udp" , "parameters" : { "action" : "start" , "host" : "192.168.4.2" ,
+//                                            "port" : 5002 , "format" : "binary" }} ;
+//
+// A datagram is sent when the session completes, whatever the state of the command
+// connection, and is never retransmitted : a sample lost on the air doesn't delay the
+// following ones. Every datagram carries a sequence number ( 1 , 2 , ... from the start
+// of the streaming ) and the device time it was sent at, so the receiver can detect the
+// losses and the queuing delays.
+//
+// TEXT   : {"dgram":<seq>,"t_us":<device time>,<history record fields>}\n
+// BINARY : "CHRU" , version (u16) , record size (u16) , seq (u32) , device time in uSec (u64) ,
+//          packed history record ( little endian , HISTORY_BINARY_RECORD_SIZE bytes , the
+//          record size field ) : UDP_BINARY_DATAGRAM_SIZE bytes per datagram
+//
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+#include "tool.h"
+#include "server.h"
+#include "metrics.h"
+#include "udp.h"
+
+#define UDP_BINARY_MAGIC                "CHRU"
+#define UDP_BINARY_VERSION              1
+#define UDP_LINE_BUFFER_LENGTH          192
+#define UDP_DATAGRAM_BUFFER_LENGTH      (HISTORY_LINE_LENGTH + 48)
+
+static struct {
+    int           sock ;                            // -1 : no socket
+    volatile unsigned int active ;
+    struct sockaddr_in dest ;
+    unsigned int  format ;
+    uint32_t      seq ;                             // last datagram sequence number
+    uint32_t      sent ;
+    uint32_t      errors ;
+} udp_control ;
+
+static SemaphoreHandle_t udp_mutex ;
+
+static const char *udp_format_names[] = { "text", "binary" } ;
+
+static const char *TAG = "udp" ;
+
+// FUNCTION PROTOTYPES
+void udp_init(void) ;
+unsigned int udp_start(const char *host, unsigned int port, unsigned int format,
+                       void (*callback)(unsigned char *buffer, unsigned int len)) ;
+void udp_stop(void) ;
+unsigned int udp_active(void) ;
+void udp_publish(const history_record_t *record) ;
+void udp_info(void (*callback)(unsigned char *buffer, unsigned int len)) ;
+static unsigned int udp_build(const history_record_t *record, unsigned char *datagram) ;
+
+//
+// Check if the streaming is active ( the FTM task skips the formatting otherwise )
+//
+unsigned int udp_active(void)
+{
+    return udp_control.active ;
+}
+
+//
+// Build the datagram of a session result ( caller holds the mutex )
+//
+// returns the datagram length
+//
+static unsigned int udp_build(const history_record_t *record, unsigned char *datagram)
+{
+    uint64_t now_us = (uint64_t) esp_timer_get_time() ;
+    unsigned int len ;
+
+    if (udp_control.format == UDP_FORMAT_BINARY)
+    {
+        uint16_t version = UDP_BINARY_VERSION, size = HISTORY_BINARY_RECORD_SIZE ;
+
+        memcpy(&datagram[0], UDP_BINARY_MAGIC, 4) ;
+        memcpy(&datagram[4], &version, 2) ;
+        memcpy(&datagram[6], &size, 2) ;
+        memcpy(&datagram[8], &udp_control.seq, 4) ;
+        memcpy(&datagram[12], &now_us, 8) ;
+
+        return UDP_BINARY_HEADER_SIZE + history_pack(record, &datagram[UDP_BINARY_HEADER_SIZE]) ;
+    }
+
+    // THE HISTORY LINE WITHOUT ITS OPENING BRACE
+    len = sprintf((char *) datagram, "{\"dgram\":%u,\"t_us\":%llu,", udp_control.seq, (unsigned long long) now_us) ;
+    {
+        char line[HISTORY_LINE_LENGTH] ;
+        unsigned int line_len = history_format(record, line) ;
+
+        memcpy(&datagram[len], &line[1], line_len - 1) ;
+        len += line_len - 1 ;
+    }
+    return len ;
+}
+
+//
+// Send the result of a session ( FTM task , never blocks on the network )
+//
+void udp_publish(const history_record_t *record)
+{
+    unsigned char datagram[UDP_DATAGRAM_BUFFER_LENGTH] ;
+    unsigned int len ;
+
+    if (!udp_control.active)
+        return ;
+
+    xSemaphoreTake(udp_mutex, portMAX_DELAY) ;
+
+    if (udp_control.active)
+    {
+        udp_control.seq++ ;
+        len = udp_build(record, datagram) ;
+
+        if (sendto(udp_control.sock, datagram, len, MSG_DONTWAIT,
+                   (struct sockaddr *) &udp_control.dest, sizeof(udp_control.dest)) == (int) len)
+        {
+            udp_control.sent++ ;
+            metrics_count(METRICS_UDP_DATAGRAMS, 1) ;
+        }
+        else
+        {
+            // THE SEQUENCE NUMBER IS KEPT : THE RECEIVER SEES A LOST DATAGRAM
+            udp_control.errors++ ;
+            metrics_count(METRICS_UDP_ERRORS, 1) ;
+        }
+    }
+
+    xSemaphoreGive(udp_mutex) ;
+}
+
+//
+// Start ( or redirect ) the streaming
+//
+// <host> : IPv4 address ( empty : the client of the command connection ) , <port> : 0 for UDP_DEFAULT_PORT
+//
+// returns 1 if the streaming is active
+//
+unsigned int udp_start(const char *host, unsigned int port, unsigned int format,
+                       void (*callback)(unsigned char *buffer, unsigned int len))
+{
+    struct sockaddr_in dest ;
+    char line[UDP_LINE_BUFFER_LENGTH] ;
+
+    #if !(CONFIG_ESP_UDP_ENABLE)
+        return 0 ;
+    #endif
+
+    memset(&dest, 0, sizeof(dest)) ;
+    dest.sin_family = AF_INET ;
+    dest.sin_port = htons(port ? port : UDP_DEFAULT_PORT) ;
+
+    if (host && host[0])
+    {
+        if (!inet_aton(host, &dest.sin_addr)) dest.sin_addr.s_addr = 0 ;
+    }
+    else
+    {
+        dest.sin_addr.s_addr = server_peer_address() ;
+    }
+
+    if (!dest.sin_addr.s_addr || (port > 65535) || (format > UDP_FORMAT_BINARY))
+    {
+        sprintf(line, "Invalid UDP Destination! Host is an IPv4 address (default : this client), port 1-65535 ; formats are text and binary") ;
+        tool_log(TAG, line, 1, callback) ;
+        return 0 ;
+    }
+
+    xSemaphoreTake(udp_mutex, portMAX_DELAY) ;
+
+    if (udp_control.sock < 0)
+    {
+        udp_control.sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP) ;
+        if (udp_control.sock < 0)
+        {
+            ESP_LOGE(TAG, "Unable to create socket: errno %d", errno) ;
+        }
+    }
+
+    if (udp_control.sock >= 0)
+    {
+        udp_control.dest = dest ;
+        udp_control.format = format ;
+        udp_control.seq = 0 ;
+        udp_control.sent = 0 ;
+        udp_control.errors = 0 ;
+        udp_control.active = 1 ;
+    }
+
+    xSemaphoreGive(udp_mutex) ;
+
+    return udp_control.active ;
+}
+
+//
+// Stop the streaming ( the socket is kept for the next start )
+//
+void udp_stop(void)
+{
+    xSemaphoreTake(udp_mutex, portMAX_DELAY) ;
+    udp_control.active = 0 ;
+    xSemaphoreGive(udp_mutex) ;
+}
+
+//
+// Report the streaming state
+//
+void udp_info(void (*callback)(unsigned char *buffer, unsigned int len))
+{
+    char line[UDP_LINE_BUFFER_LENGTH] ;
+    char addr_str[16] ;
+
+    #if !(CONFIG_ESP_UDP_ENABLE)
+        sprintf(line, "UDP - disabled") ;
+        tool_log(TAG, line, 0, callback) ;
+        return ;
+    #endif
+
+    xSemaphoreTake(udp_mutex, portMAX_DELAY) ;
+
+    inet_ntoa_r(udp_control.dest.sin_addr, addr_str, sizeof(addr_str) - 1) ;
+    sprintf(line, "UDP - %s , Destination %s:%u , Format %s , Datagrams %u , Errors %u",
+                  udp_control.active ? "Streaming" : "Stopped",
+                  addr_str, ntohs(udp_control.dest.sin_port), udp_format_names[udp_control.format],
+                  udp_control.sent, udp_control.errors) ;
+
+    xSemaphoreGive(udp_mutex) ;
+
+    tool_log(TAG, line, 0, callback) ;
+}
+
+//
+// UDP Initialization
+//
+void udp_init(void)
+{
+    memset(&udp_control, 0, sizeof(udp_control)) ;
+    udp_control.sock = -1 ;
+    udp_control.dest.sin_family = AF_INET ;
+    udp_control.dest.sin_port = htons(UDP_DEFAULT_PORT) ;
+    udp_mutex = xSemaphoreCreateMutex() ;
+}
@@ -0,0 +1,65 @@
+/*
+    udp.h - UDP Datagram Streaming
+*/
+
+/*
+ * Created on Thu Dec 30 2021
+ *
+ * Copyright (c) 2021 Cezar Menezes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Contact: cezar.menezes@live.com
+ *
+ */
+
+#ifndef _UDP_H
+
+#define _UDP_H	1
+
+    #ifdef __cplusplus
+    extern "C" {
+    #endif
+
+        #include "history.h"                // { history_record_t }
+
+        #define UDP_DEFAULT_PORT            CONFIG_ESP_UDP_PORT
+
+        #define UDP_ACTION_INFO             0
+        #define UDP_ACTION_START            1
+        #define UDP_ACTION_STOP             2
+
+        #define UDP_FORMAT_TEXT             0       // NDJSON line ( history record with "dgram" and "t_us" )
+        #define UDP_FORMAT_BINARY           1       // "CHRU" header and packed history record
+
+        #define UDP_BINARY_HEADER_SIZE      20
+        #define UDP_BINARY_DATAGRAM_SIZE    (UDP_BINARY_HEADER_SIZE + HISTORY_BINARY_RECORD_SIZE)
+
+        extern void udp_init(void) ;
+        extern unsigned int udp_start(const char *host, unsigned int port, unsigned int format,
+                                      void (*callback)(unsigned char *buffer, unsigned int len)) ;
+        extern void udp_stop(void) ;
+        extern unsigned int udp_active(void) ;
+        extern void udp_publish(const history_record_t *record) ;
+        extern void udp_info(void (*callback)(unsigned char *buffer, unsigned int len)) ;
+
+    #ifdef __cplusplus
+    }
+    #endif
+
+#endif
@@ -0,0 +1,267 @@
+#! /usr/local/bin/python
+
+#
+# Created on Thu Dec 30 2021
+#
+# Copyright (c) 2021 Cezar Menezes
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#
+# Contact: cezar.menezes@live.com
+#
+#
+
+#
+# Generate FTM report entries ( wifi_ftm_report_entry_t : dlog_token, rssi, rtt, t1..t4 )
+# for a scene of anchors ( FTM responders ) and a moving initiator
+#
+# usage : ftm_scene.py scene.json -o out --rate 10 --duration 60 --frames 16
+#         chronos_host -r out/responders.conf
+#
+# The output directory holds one replay file per anchor ( "dlog_token,rssi,rtt,t1,t2,t3,t4"
+# per line, pico-seconds ), a responder table for the host build and the ground truth
+# ( initiator position and anchor distances ) of every session.
+#
+# Clock model ( t : true time ) :
+#   responder clock : r(t) = t * (1 + drift_r) + offset_r  ->  T1, T4
+#   initiator clock : i(t) = t * (1 + drift_i) + offset_i  ->  T2, T3
+#
+# Every frame exchange adds gaussian timestamp noise, may take a longer path ( multipath :
+# the first detected path is late by an exponential excess length ) and may be lost
+# ( dropout : the entry keeps its dialog token, with zeroed timestamps ).
+#
+
+import os
+import sys
+import json
+import math
+import random
+import argparse
+
+SPEED_OF_LIGHT  = 299792458.0       # meters / second
+TURNAROUND_PS   = 10000000.0        # T3 - T2 on the initiator clock ( 10 uSec )
+
+DEFAULT_SCENE = {
+    "initiator" : { "offset_us" : 3000000.0, "drift_ppm" : 0.0, "position" : [ 0.0, 0.0, 0.0 ] },
+    "noise"     : { "sigma_ps" : 300.0 },
+    "multipath" : { "probability" : 0.0, "excess_m" : 2.0 },
+    "dropout"   : { "probability" : 0.0, "fail" : 0.0 },
+    "rssi"      : { "ref_dbm" : -40.0, "exponent" : 2.2, "sigma_db" : 2.0 },
+}
+
+#
+# Load a scene ( JSON ), filling the missing models with their defaults
+#
+# every anchor may override the scene models ( "noise", "multipath", "dropout", "rssi" )
+#
+def load_scene(path):
+
+    with open(path) as f:
+        scene = json.load(f)
+
+    for key, value in DEFAULT_SCENE.items():
+        scene[key] = dict(value, **scene.get(key, {}))
+
+    if not scene.get("anchors"):
+        raise ValueError("scene has no anchors")
+
+    for k, anchor in enumerate(scene["anchors"]):
+        anchor.setdefault("ssid", "FTM-SIM-{}".format(k+1))
+        anchor.setdefault("mac", "02:00:00:00:01:{:02x}".format(k+1))
+        anchor.setdefault("channel", 6)
+        anchor.setdefault("offset_us", 1000000.0 * (k+1))
+        anchor.setdefault("drift_ppm", 0.0)
+        anchor.setdefault("bias_m", 0.0)
+        for key in ("noise", "multipath", "dropout", "rssi"):
+            anchor[key] = dict(scene[key], **anchor.get(key, {}))
+
+    return scene
+
+#
+# Position of the initiator at time t (seconds)
+#
+# "trajectory" : [ { "t" : 0, "position" : [x,y,z] }, ... ] is linearly interpolated between
+# waypoints ( held at both ends, or repeated when "loop" is true ); otherwise "position" is used
+#
+def initiator_position(initiator, t):
+
+    waypoints = initiator.get("trajectory")
+
+    if not waypoints:
+        return point(initiator["position"])
+
+    if initiator.get("loop") and (waypoints[-1]["t"] > waypoints[0]["t"]):
+        span = waypoints[-1]["t"] - waypoints[0]["t"]
+        t = waypoints[0]["t"] + math.fmod(t - waypoints[0]["t"], span)
+
+    if t <= waypoints[0]["t"]:
+        return point(waypoints[0]["position"])
+
+    for a, b in zip(waypoints, waypoints[1:]):
+        if t <= b["t"]:
+            u = (t - a["t"]) / (b["t"] - a["t"]) if (b["t"] > a["t"]) else 1.0
+            pa, pb = point(a["position"]), point(b["position"])
+            return tuple(pa[i] + u * (pb[i] - pa[i]) for i in range(3))
+
+    return point(waypoints[-1]["position"])
+
+#
+# 2D or 3D coordinates as a 3D point
+#
+def point(p):
+    return (float(p[0]), float(p[1]), float(p[2]) if (len(p) > 2) else 0.0)
+
+#
+# Distance between two points
+#
+def distance(p, q):
+    return math.sqrt(sum((p[i] - q[i]) ** 2 for i in range(3)))
+
+#
+# Report entries of one FTM session between the initiator and an anchor
+#
+# t        : session start (seconds)
+# frames   : number of frame exchanges
+# frame_us : interval between frame exchanges (uSec)
+#
+# returns a list of ( dlog_token, rssi, rtt, t1, t2, t3, t4 )
+#
+def session_entries(scene, anchor, t, frames, frame_us, rng):
+
+    initiator = scene["initiator"]
+    responder_rate = 1.0 + anchor["drift_ppm"] * 1e-6
+    initiator_rate = 1.0 + initiator["drift_ppm"] * 1e-6
+    responder_offset = anchor["offset_us"] * 1e6
+    initiator_offset = initiator["offset_us"] * 1e6
+    sigma = anchor["noise"]["sigma_ps"]
+    multipath = anchor["multipath"]
+    dropout = anchor["dropout"]
+    model = anchor["rssi"]
+    entries = []
+
+    for k in range(frames):
+        tk = t + k * frame_us * 1e-6
+        d = distance(initiator_position(initiator, tk), point(anchor["position"])) + anchor["bias_m"]
+
+        if rng.random() < multipath["probability"]:
+            d += rng.expovariate(1.0 / multipath["excess_m"])
+
+        tof = d / SPEED_OF_LIGHT * 1e12     # pico-seconds
+        tk *= 1e12
+
+        token = (k % 255) + 1
+        rssi = model["ref_dbm"] - 10.0 * model["exponent"] * math.log10(max(d, 0.1)) + rng.gauss(0.0, model["sigma_db"])
+        rssi = int(max(-127, min(0, round(rssi))))
+
+        if rng.random() < dropout["probability"]:
+            entries.append((token, rssi, 0, 0, 0, 0, 0))
+            continue
+
+        t1 = tk * responder_rate + responder_offset
+        t2 = (tk + tof) * initiator_rate + initiator_offset + rng.gauss(0.0, sigma)
+        t3 = t2 + TURNAROUND_PS
+        t4 = (tk + 2.0 * tof + TURNAROUND_PS / initiator_rate) * responder_rate + responder_offset + rng.gauss(0.0, sigma)
+        rtt = (t4 - t1) - (t3 - t2)
+
+        entries.append((token, rssi, int(max(rtt, 0.0)), int(t1), int(t2), int(t3), int(t4)))
+
+    return entries
+
+#
+# Generate the sessions of a scene
+#
+# rate     : sessions per second ( every anchor is ranged once per session )
+# duration : scene duration (seconds)
+#
+# yields ( session, t, initiator position, { ssid : entries } )
+#
+def generate(scene, rate, duration, frames, frame_us, seed=None):
+
+    rng = random.Random(seed)
+    count = max(1, int(round(rate * duration)))
+
+    for n in range(count):
+        t = n / rate
+        reports = { a["ssid"] : session_entries(scene, a, t, frames, frame_us, rng) for a in scene["anchors"] }
+        yield n, t, initiator_position(scene["initiator"], t), reports
+
+#
+# Write the replay files, the responder table and the ground truth of a scene
+#
+def write_output(scene, sessions, out):
+
+    os.makedirs(out, exist_ok=True)
+
+    anchors = scene["anchors"]
+    replay = { a["ssid"] : open(os.path.join(out, a["ssid"] + ".csv"), "w") for a in anchors }
+    truth = open(os.path.join(out, "truth.csv"), "w")
+    truth.write("session,t_s,x,y,z," + ",".join("d_" + a["ssid"] for a in anchors) + "\n")
+
+    entries = 0
+    start = None
+
+    for n, t, position, reports in sessions:
+        if start is None:
+            start = position
+        for ssid, rows in reports.items():
+            for row in rows:
+                replay[ssid].write(",".join(str(v) for v in row) + "\n")
+            entries += len(rows)
+        truth.write("{},{:.6f},{:.3f},{:.3f},{:.3f},".format(n, t, *position) +
+                    ",".join("{:.3f}".format(distance(position, point(a["position"]))) for a in anchors) + "\n")
+
+    for f in replay.values():
+        f.close()
+    truth.close()
+
+    with open(os.path.join(out, "responders.conf"), "w") as f:
+        f.write("# Generated by ftm_scene.py ( chronos_host -r {} )\n".format(os.path.join(out, "responders.conf")))
+        f.write("#\n# replay files hold sessions of a fixed frame count : request the same \"count\" to keep\n")
+        f.write("# every report aligned with the ground truth ( truth.csv )\n#\n")
+        f.write("# ssid        mac                channel  distance_m  rssi  sigma_ps  drift_ppm  fail   [replay.csv]\n")
+        for a in anchors:
+            d = distance(start, point(a["position"]))
+            rssi = a["rssi"]["ref_dbm"] - 10.0 * a["rssi"]["exponent"] * math.log10(max(d, 0.1))
+            f.write("{:<13} {}  {:<8} {:<11.2f} {:<5d} {:<9.0f} {:<10.1f} {:<6.2f} {}\n".format(
+                    a["ssid"], a["mac"], a["channel"], d, int(round(rssi)), a["noise"]["sigma_ps"],
+                    a["drift_ppm"], a["dropout"]["fail"], os.path.join(out, a["ssid"] + ".csv")))
+
+    return entries
+
+
+if __name__ == "__main__":
+
+    parser = argparse.ArgumentParser(prog='ftm_scene')
+    parser.add_argument('scene', help='scene description (JSON)')
+    parser.add_argument('-o', '--out', default='scene_out', help='output directory')
+    parser.add_argument('--rate', type=float, default=10.0, help='sessions per second')
+    parser.add_argument('--duration', type=float, default=10.0, help='scene duration (seconds)')
+    parser.add_argument('--frames', type=int, default=16, help='frame exchanges per session')
+    parser.add_argument('--frame-us', type=float, default=500.0, help='interval between frame exchanges (uSec)')
+    parser.add_argument('--seed', type=int, default=None, help='random seed')
+
+    args = parser.parse_args()
+
+    if (args.rate <= 0.0) or (args.frames < 1) or (args.frames > 64):
+        sys.exit("rate must be positive and frames between 1 and 64")
+
+    scene = load_scene(args.scene)
+    entries = write_output(scene, generate(scene, args.rate, args.duration, args.frames, args.frame_us, args.seed), args.out)
+
+    print("{} anchors, {} sessions, {} report entries -> {}".format(
+          len(scene["anchors"]), max(1, int(round(args.rate * args.duration))), entries, args.out))
@@ -1,9 +1,57 @@
 #! /bin/sh
 
-APP=./ftm_math.py
+PYTHON=${PYTHON:-python3}
+APP="$PYTHON ./ftm_math.py"
 
 $APP coordinates -x0 30 -y0 -30 -x1 0 -y1 0 -x2 100 -y2 0 -x3 50 -y3 86.60
 
 $APP distances -d01 42.43 -d02 76.16 -d03 118.30 -d12 100.00 -d13 100.00 -d23 100.00
 
 
+
+# scene generation : output in a temporary directory , checked against scene.json
+set -e
+
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+
+$PYTHON ./ftm_scene.py scene.json -o "$OUT" --rate 10 --duration 60 --frames 16 --seed 1
+
+$PYTHON - scene.json "$OUT" 600 16 <<'CHECK'
+import sys, csv, json, math, os, statistics
+
+scene, out, sessions, frames = json.load(open(sys.argv[1])), sys.argv[2], int(sys.argv[3]), int(sys.argv[4])
+anchors = scene["anchors"]
+start = scene["initiator"]["trajectory"][0]["position"]
+
+def check(condition, what):
+    print("%s : %s" % ("ok  " if condition else "FAIL", what))
+    if not condition:
+        sys.exit(1)
+
+truth = list(csv.DictReader(open(os.path.join(out, "truth.csv"))))
+check(len(truth) == sessions, "truth.csv holds %d sessions (%d)" % (sessions, len(truth)))
+check([ float(truth[0][k]) for k in "xyz" ] == start, "first session starts at the first waypoint")
+
+# TRUTH DISTANCES MATCH THE INITIATOR AND ANCHOR POSITIONS
+for a in anchors:
+    error = max(abs(float(row["d_" + a["ssid"]]) - math.dist([ float(row[k]) for k in "xyz" ], a["position"])) for row in truth)
+    check(error < 0.01, "truth distances to %s ( max error %.4f m )" % (a["ssid"], error))
+
+# REPLAY FILES : ONE FIXED SIZE SESSION PER TRUTH ROW , RTT CLOSE TO THE TRUE DISTANCE
+for a in anchors:
+    rows = [ [ int(v) for v in line.split(",") ] for line in open(os.path.join(out, a["ssid"] + ".csv")) ]
+    check(len(rows) == sessions * frames, "%s replay holds %d entries (%d)" % (a["ssid"], sessions * frames, len(rows)))
+    errors = []
+    for n, row in enumerate(truth):
+        rtt = [ r[2] for r in rows[n * frames:(n + 1) * frames] if r[2] ]
+        if rtt:
+            errors.append(min(rtt) * 299792458.0 * 1e-12 / 2.0 - float(row["d_" + a["ssid"]]))
+    bias = statistics.median(errors)
+    check(abs(bias) < 0.5, "%s first path distance within 0.5 m of the truth ( median error %.3f m )" % (a["ssid"], bias))
+
+# RESPONDER TABLE : EVERY ANCHOR , REPLAYING ITS FILE
+table = [ line.split() for line in open(os.path.join(out, "responders.conf")) if line.strip() and not line.startswith("#") ]
+check([ (t[0], t[1], t[-1]) for t in table ] == [ (a["ssid"], a["mac"], os.path.join(out, a["ssid"] + ".csv")) for a in anchors ],
+      "responders.conf lists every anchor with its replay file")
+CHECK
@@ -0,0 +1,396 @@
+#! /usr/local/bin/python
+
+#
+# Created on Thu Dec 30 2021
+#
+# Copyright (c) 2021 Cezar Menezes
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#
+# Contact: cezar.menezes@live.com
+#
+#
+
+#
+# Load generator and latency benchmark of the Chronos TCP command protocol
+#
+# usage : chronos_bench.py --host 192.168.4.1 --mix ftm:4,scan:1 --target FTM-ST-1 -o results.json
+#         chronos_bench.py --spawn build-host/chronos_host --responders host/responders.conf \
+#                          --target FTM-HOST-1 --target 02:00:00:00:00:02@6 --connections 2 --depth 4
+#         chronos_bench.py ... --compare baseline.json --tolerance 10
+#
+# Every connection keeps up to <depth> commands in flight ( pipelining ) ; a command is
+# complete when the last line of its response arrives ( "Session Status" for "ftm",
+# "sta scan done" for "scan" ). The server runs commands one at a time, so latency
+# includes the time spent behind the commands queued before it.
+#
+# Results ( configuration, throughput, latency percentiles overall and per command type )
+# are printed and optionally stored as JSON ; --compare checks them against a stored run.
+#
+
+import os
+import sys
+import json
+import time
+import socket
+import random
+import select
+import argparse
+import platform
+import threading
+import subprocess
+
+# last line of a response ( per command type )
+TERMINATORS = {
+    'ftm'  : ('Session Status - ', 'Invalid '),
+    'scan' : ('sta scan done', 'No matching AP found', 'Failed to alloc buffer'),
+}
+
+FIELDS = {
+    'summary' : '"summary"',
+    'all'     : '"all"',
+    'rtt'     : '[ "rtt" ]',
+}
+
+#
+# Build the command string of a request
+#
+# target : ssid , or "mac@channel"
+#
+def make_command(kind, target, count, fields, pad):
+
+    if kind == 'scan':
+        params = ' , "parameters" : { "ssid" : "%s" }' % target if target else ''
+        text = '{ "function" : "scan"%s' % params
+    else:
+        if '@' in target:
+            mac, channel = target.split('@')
+            where = '"mac" : "%s" , "channel" : %d' % (mac, int(channel))
+        else:
+            where = '"ssid" : "%s"' % target
+        text = '{ "function" : "ftm" , "parameters" : { %s , "count" : %d' % (where, count)
+        if fields != 'default':
+            text += ' , "fields" : %s' % FIELDS[fields]
+        text += ' }'
+
+    # request payload size : an extra ( ignored ) parameter pads the command
+    if pad and kind == 'ftm':
+        text = text[:-1] + ', "pad" : "%s" }' % ('x' * max(0, pad - len(text) - 20))
+
+    return (text + '} ;').encode()
+
+#
+# Weighted command types ( "ftm:4,scan:1" )
+#
+def parse_mix(mix):
+
+    kinds = []
+    for item in mix.split(','):
+        kind, _, weight = item.partition(':')
+        if kind not in TERMINATORS:
+            raise ValueError('unknown command type %r' % kind)
+        kinds += [ kind ] * int(weight or 1)
+    return kinds
+
+#
+# Percentile ( nearest rank ) of a sorted list
+#
+def percentile(values, p):
+
+    if not values:
+        return None
+    k = max(0, min(len(values) - 1, int(round(p / 100.0 * len(values) + 0.5)) - 1))
+    return values[k]
+
+#
+# Latency statistics ( milli-seconds )
+#
+def latency_stats(samples):
+
+    values = sorted(samples)
+    if not values:
+        return {}
+    return {
+        'count' : len(values),
+        'min'   : values[0],
+        'mean'  : sum(values) / len(values),
+        'p50'   : percentile(values, 50),
+        'p99'   : percentile(values, 99),
+        'p999'  : percentile(values, 99.9),
+        'max'   : values[-1],
+    }
+
+#
+# One client connection ( pipelined requests , responses matched in order )
+#
+class Connection(threading.Thread):
+
+    def __init__(self, index, args, kinds, deadline, requests):
+
+        threading.Thread.__init__(self, daemon=True)
+        self.args = args
+        self.kinds = kinds
+        self.deadline = deadline
+        self.requests = requests
+        self.rng = random.Random(args.seed + index)
+        self.samples = []               # ( kind , latency ms , completion time )
+        self.errors = 0
+        self.timeouts = 0
+        self.bytes_tx = 0
+        self.bytes_rx = 0
+
+    def next_command(self):
+
+        kind = self.rng.choice(self.kinds)
+        targets = self.args.target or [ '' ]
+        target = self.rng.choice(targets) if (kind == 'ftm' or self.args.scan_target) else ''
+        count = self.rng.choice(self.args.count)
+        return kind, make_command(kind, target, count, self.args.fields, self.args.pad)
+
+    def run(self):
+
+        sock = socket.create_connection((self.args.host, self.args.port), timeout=self.args.timeout)
+        sock.setblocking(False)
+        inflight = []                   # ( kind , send time )
+        sent = 0
+        pending = b''
+
+        try:
+            while True:
+                now = time.monotonic()
+                more = (sent < self.requests) if self.requests else (now < self.deadline)
+
+                while more and len(inflight) < self.args.depth:
+                    kind, command = self.next_command()
+                    sock.setblocking(True)
+                    sock.sendall(command)
+                    sock.setblocking(False)
+                    inflight.append((kind, time.monotonic()))
+                    self.bytes_tx += len(command)
+                    sent += 1
+                    more = (sent < self.requests) if self.requests else (time.monotonic() < self.deadline)
+
+                if not inflight:
+                    break
+
+                if now - inflight[0][1] > self.args.timeout:
+                    # no complete response : the rest of the stream cannot be matched anymore
+                    self.timeouts += len(inflight)
+                    break
+
+                ready, _, _ = select.select([ sock ], [], [], 0.1)
+                if not ready:
+                    continue
+
+                data = sock.recv(65536)
+                if not data:
+                    self.errors += len(inflight)
+                    break
+                self.bytes_rx += len(data)
+
+                lines = (pending + data).split(b'\n')
+                pending = lines.pop()
+
+                for line in lines:
+                    if not inflight:
+                        break
+                    text = line.decode(errors='replace').strip()
+                    kind, start = inflight[0]
+                    if text.startswith(TERMINATORS[kind]):
+                        done = time.monotonic()
+                        inflight.pop(0)
+                        if text.startswith(('Invalid ', 'No matching', 'Failed to')):
+                            self.errors += 1
+                        self.samples.append((kind, (done - start) * 1000.0, done))
+        finally:
+            sock.close()
+
+#
+# Start a local host build on a free port
+#
+def spawn(args):
+
+    probe = socket.socket()
+    probe.bind(('127.0.0.1', 0))
+    port = probe.getsockname()[1]
+    probe.close()
+
+    command = [ args.spawn, '-p', str(port) ]
+    if args.responders:
+        command += [ '-r', args.responders ]
+    process = subprocess.Popen(command, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+
+    for k in range(50):
+        try:
+            socket.create_connection(('127.0.0.1', port), timeout=1).close()
+            break
+        except OSError:
+            time.sleep(0.1)
+
+    # the probe connection above was the daemon's first client : let it go
+    time.sleep(0.2)
+    return process, port
+
+#
+# Run the benchmark
+#
+def run(args):
+
+    kinds = parse_mix(args.mix)
+    if 'ftm' in kinds and not args.target:
+        raise ValueError('"ftm" commands need at least one --target')
+
+    per_connection = (args.requests + args.connections - 1) // args.connections if args.requests else 0
+
+    # WARM-UP ( not measured )
+    if args.warmup:
+        warm = Connection(-1, args, kinds, 0, args.warmup)
+        warm.run()
+
+    start = time.monotonic()
+    clients = [ Connection(k, args, kinds, start + args.duration, per_connection) for k in range(args.connections) ]
+    for c in clients:
+        c.start()
+    for c in clients:
+        c.join()
+    elapsed = time.monotonic() - start
+
+    samples = [ s for c in clients for s in c.samples ]
+
+    results = {
+        'commands'     : len(samples),
+        'errors'       : sum(c.errors for c in clients),
+        'timeouts'     : sum(c.timeouts for c in clients),
+        'duration_s'   : elapsed,
+        'throughput'   : len(samples) / elapsed if elapsed > 0 else 0.0,
+        'bytes_tx'     : sum(c.bytes_tx for c in clients),
+        'bytes_rx'     : sum(c.bytes_rx for c in clients),
+        'latency_ms'   : latency_stats([ s[1] for s in samples ]),
+        'per_type'     : { kind : latency_stats([ s[1] for s in samples if s[0] == kind ]) for kind in sorted(set(kinds)) },
+    }
+
+    return {
+        'tool'    : 'chronos_bench',
+        'version' : 1,
+        'label'   : args.label,
+        'time'    : time.strftime('%Y-%m-%dT%H:%M:%S'),
+        'client'  : platform.node(),
+        'config'  : {
+            'host' : args.host if not args.spawn else 'spawn:' + os.path.basename(args.spawn),
+            'mix' : args.mix, 'target' : args.target, 'count' : args.count, 'fields' : args.fields,
+            'pad' : args.pad, 'connections' : args.connections, 'depth' : args.depth,
+            'requests' : args.requests, 'duration_s' : args.duration, 'warmup' : args.warmup,
+        },
+        'results' : results,
+    }
+
+#
+# Print a run
+#
+def report(run):
+
+    r = run['results']
+    print('%s : %d commands in %.2f s , %.1f commands/s , %d errors , %d timeouts , %d bytes sent , %d bytes received'
+          % (run['label'] or 'run', r['commands'], r['duration_s'], r['throughput'], r['errors'], r['timeouts'], r['bytes_tx'], r['bytes_rx']))
+
+    rows = [ ('all', r['latency_ms']) ] + sorted(r['per_type'].items())
+    print('%-6s %8s %10s %10s %10s %10s %10s %10s' % ('type', 'count', 'min', 'mean', 'p50', 'p99', 'p999', 'max'))
+    for name, s in rows:
+        if s:
+            print('%-6s %8d %10.2f %10.2f %10.2f %10.2f %10.2f %10.2f'
+                  % (name, s['count'], s['min'], s['mean'], s['p50'], s['p99'], s['p999'], s['max']))
+    print('( latency in mSec )')
+
+#
+# Compare a run with a baseline run
+#
+# returns the number of regressions beyond <tolerance> percent
+#
+def compare(run, baseline, tolerance):
+
+    regressions = 0
+    checks = [ ('throughput', run['results']['throughput'], baseline['results']['throughput'], +1) ]
+    for key in ('p50', 'p99', 'p999'):
+        checks.append((key, run['results']['latency_ms'].get(key), baseline['results']['latency_ms'].get(key), -1))
+
+    print('compared with %s (%s) :' % (baseline.get('label') or 'baseline', baseline.get('time')))
+    for name, value, reference, sign in checks:
+        if value is None or not reference:
+            continue
+        change = (value - reference) * 100.0 / reference
+        worse = (change * sign) < -tolerance
+        regressions += worse
+        print('  %-10s %12.2f -> %12.2f  %+7.1f%%%s' % (name, reference, value, change, '  REGRESSION' if worse else ''))
+
+    return regressions
+
+def main():
+
+    parser = argparse.ArgumentParser(description='Chronos command protocol load generator')
+    parser.add_argument('--host', default='192.168.4.1')
+    parser.add_argument('--port', type=int, default=5000)
+    parser.add_argument('--spawn', help='start this host build ( chronos_host ) on a free local port instead')
+    parser.add_argument('--responders', help='responder table of the spawned host build')
+    parser.add_argument('--mix', default='ftm:1', help='weighted command types, e.g. ftm:4,scan:1')
+    parser.add_argument('--target', action='append', help='FTM responder : ssid or mac@channel ( repeatable )')
+    parser.add_argument('--scan-target', action='store_true', help='scan the --target ssids instead of every AP')
+    parser.add_argument('--count', type=lambda s: [ int(v) for v in s.split(',') ], default=[ 8 ], help='FTM frame counts, e.g. 8,16,64')
+    parser.add_argument('--fields', choices=[ 'default', 'summary', 'rtt', 'all' ], default='summary', help='FTM report columns')
+    parser.add_argument('--pad', type=int, default=0, help='pad FTM commands to this many bytes')
+    parser.add_argument('--connections', type=int, default=1, help='concurrent connections')
+    parser.add_argument('--depth', type=int, default=1, help='commands in flight per connection')
+    parser.add_argument('--requests', type=int, default=100, help='total commands ( 0 : run for --duration )')
+    parser.add_argument('--duration', type=float, default=10.0, help='run time in seconds when --requests is 0')
+    parser.add_argument('--warmup', type=int, default=0, help='commands sent before measuring')
+    parser.add_argument('--timeout', type=float, default=30.0, help='seconds without a complete response')
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('--label', default='', help='name of the run ( e.g. firmware version )')
+    parser.add_argument('-o', '--output', help='store the run as JSON')
+    parser.add_argument('--compare', help='baseline run ( JSON ) to compare with')
+    parser.add_argument('--tolerance', type=float, default=10.0, help='regression threshold in percent')
+    args = parser.parse_args()
+
+    if (args.connections < 1) or (args.depth < 1):
+        parser.error('--connections and --depth must be at least 1')
+
+    process = None
+    if args.spawn:
+        process, args.port = spawn(args)
+        args.host = '127.0.0.1'
+
+    try:
+        result = run(args)
+    finally:
+        if process:
+            process.terminate()
+            process.wait()
+
+    report(result)
+
+    if args.output:
+        with open(args.output, 'w') as f:
+            json.dump(result, f, indent=1)
+
+    if args.compare:
+        with open(args.compare) as f:
+            baseline = json.load(f)
+        if compare(result, baseline, args.tolerance):
+            sys.exit(1)
+
+if __name__ == '__main__':
+    main()
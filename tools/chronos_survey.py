@@ -0,0 +1,190 @@
+#! /usr/local/bin/python
+
+#
+# Created on Thu Dec 30 2021
+#
+# Copyright (c) 2021 Cezar Menezes
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#
+# Contact: cezar.menezes@live.com
+#
+#
+
+#
+#
+# Inter-anchor distance matrix of a site ( "survey" command of every anchor )
+#
+# usage : chronos_survey.py --site CHRONOS-0,CHRONOS-1,CHRONOS-2,CHRONOS-3 --board 192.168.4.1 -o site.json
+#         chronos_survey.py --rows anchor0.ndjson --rows anchor1.ndjson ... -o site.json
+#
+# Every board ranges the other anchors of the site and answers its row of the matrix
+# ( one JSON line ). A board only reaches the anchors it can hear, and its own SoftAP
+# is usually the only way in, so the rows can also be collected one board at a time
+# ( --save-rows ) and merged later ( --rows ).
+#
+# Both directions of a pair are averaged ( weighted by their sessions ) ; their
+# difference is reported, as a large asymmetry points to multipath or a bad anchor.
+# The output lists the pairs as Dij ( site order ) , as expected by
+# simulation/ftm_math.py predict_xy() , and the full matrix as JSON.
+#
+
+import sys
+import json
+import time
+import socket
+import argparse
+
+COMPLETE = ( 'Survey Complete - ', 'Invalid Survey!' )
+
+#
+# Run the survey of a board and return its row ( dict )
+#
+def survey(board, site, rounds, count, timeout):
+
+    host, _, port = board.partition(':')
+    command = { 'function' : 'survey',
+                'parameters' : { 'ssids' : site, 'rounds' : rounds, 'count' : count } }
+
+    sock = socket.create_connection((host, int(port or 5000)), timeout=timeout)
+    sock.sendall((json.dumps(command) + ' ;').encode())
+
+    data, row, deadline = b'', None, time.time() + timeout
+    while time.time() < deadline:
+        chunk = sock.recv(4096)
+        if not chunk:
+            break
+        data += chunk
+        lines = data.decode(errors='replace').split('\n')
+        for line in lines[:-1]:
+            print('  ' + line)
+            if line.startswith('{"survey"'):
+                row = json.loads(line)
+        if any(line.startswith(COMPLETE) for line in lines[:-1]):
+            break
+    sock.close()
+
+    if not row:
+        raise RuntimeError('%s : no survey row' % board)
+    return row
+
+#
+# Merge the rows into the symmetric matrix
+#
+# returns ( anchors , pairs { (i,j) : ( distance , forward , backward ) } )
+#
+def merge(rows, site):
+
+    anchors = list(site)
+    for row in rows:
+        for name in row['anchors']:
+            if name not in anchors:
+                anchors.append(name)
+
+    # directed measurements : (from , to) -> ( distance , sessions )
+    directed = {}
+    for row in rows:
+        source = row['anchors'][0]
+        for name, d, n in zip(row['anchors'][1:], row['d_m'][1:], row['sessions'][1:]):
+            if d is not None and n:
+                directed[(source, name)] = (d, n)
+
+    pairs = {}
+    for i in range(len(anchors)):
+        for j in range(i + 1, len(anchors)):
+            forward = directed.get((anchors[i], anchors[j]))
+            backward = directed.get((anchors[j], anchors[i]))
+            both = [ m for m in (forward, backward) if m ]
+            if both:
+                distance = sum(d * n for d, n in both) / sum(n for d, n in both)
+                pairs[(i, j)] = (distance, forward and forward[0], backward and backward[0])
+    return anchors, pairs
+
+def report(anchors, pairs):
+
+    print('\nAnchors : ' + ' , '.join('%d %s' % (k, name) for k, name in enumerate(anchors)))
+
+    print('\n' + ' ' * 6 + ''.join('%10d' % k for k in range(len(anchors))))
+    for i in range(len(anchors)):
+        cells = []
+        for j in range(len(anchors)):
+            pair = pairs.get((min(i, j), max(i, j)))
+            cells.append('%10.3f' % (0.0 if i == j else pair[0]) if (i == j or pair) else '%10s' % '-')
+        print('%6d' % i + ''.join(cells))
+
+    print('')
+    missing = 0
+    for i in range(len(anchors)):
+        for j in range(i + 1, len(anchors)):
+            pair = pairs.get((i, j))
+            if not pair:
+                missing += 1
+                print('D%d%d = missing ( %s , %s )' % (i, j, anchors[i], anchors[j]))
+            elif pair[1] is not None and pair[2] is not None:
+                print('D%d%d = %.3f m ( %d->%d %.3f , %d->%d %.3f , asymmetry %.1f cm )' %
+                      (i, j, pair[0], i, j, pair[1], j, i, pair[2], abs(pair[1] - pair[2]) * 100))
+            else:
+                print('D%d%d = %.3f m ( one direction )' % (i, j, pair[0]))
+    return missing
+
+def main():
+
+    parser = argparse.ArgumentParser(description='Chronos anchor survey ( inter-anchor distance matrix )')
+    parser.add_argument('--site', type=lambda s: s.split(','), default=[], help='SSIDs of the anchors, in matrix order')
+    parser.add_argument('--board', action='append', default=[], help='anchor to survey : host[:port] ( repeatable )')
+    parser.add_argument('--rows', action='append', default=[], help='rows of an earlier survey ( JSON lines , repeatable )')
+    parser.add_argument('--rounds', type=int, default=5, help='sessions per peer')
+    parser.add_argument('--count', type=int, default=16, help='FTM frame count of each session')
+    parser.add_argument('--timeout', type=float, default=120.0, help='seconds allowed to each board')
+    parser.add_argument('--save-rows', help='append the rows of the surveyed boards to this file')
+    parser.add_argument('-o', '--output', help='store the matrix as JSON')
+    args = parser.parse_args()
+
+    if args.board and not args.site:
+        parser.error('--board needs the --site anchors')
+
+    rows = []
+    for name in args.rows:
+        with open(name) as f:
+            rows += [ json.loads(line) for line in f if line.startswith('{"survey"') ]
+
+    for board in args.board:
+        print('Surveying %s' % board)
+        row = survey(board, args.site, args.rounds, args.count, args.timeout)
+        rows.append(row)
+        if args.save_rows:
+            with open(args.save_rows, 'a') as f:
+                f.write(json.dumps(row) + '\n')
+
+    if not rows:
+        parser.error('nothing to merge : give --board or --rows')
+
+    anchors, pairs = merge(rows, args.site)
+    missing = report(anchors, pairs)
+
+    if args.output:
+        matrix = [ [ 0.0 if i == j else (pairs[(min(i, j), max(i, j))][0] if (min(i, j), max(i, j)) in pairs else None)
+                     for j in range(len(anchors)) ] for i in range(len(anchors)) ]
+        with open(args.output, 'w') as f:
+            json.dump({ 'anchors' : anchors, 'd_m' : matrix }, f, indent=1)
+
+    if missing:
+        sys.exit(1)
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,162 @@
+#! /usr/local/bin/python
+
+#
+# Created on Thu Dec 30 2021
+#
+# Copyright (c) 2021 Cezar Menezes
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#
+# Contact: cezar.menezes@live.com
+#
+#
+
+
+#
+# Convert a Chronos trace dump ( "trace" command ) to the Chrome trace JSON format
+# ( open the result in chrome://tracing or https://ui.perfetto.dev )
+#
+# usage : trace_to_chrome.py dump.bin -o trace.json
+#         trace_to_chrome.py --host 192.168.4.1 --port 5000 -o trace.json
+#
+
+import sys
+import json
+import socket
+import struct
+import argparse
+
+HEADER = struct.Struct('<4sHHIIIIQ')        # magic, version, event size, cpu MHz, events, tasks, now cycles, now uSec
+EVENT  = struct.Struct('<IIBBH')            # cycles, arg, event, task, reserved
+TASK_NAME_LENGTH = 16
+
+# event id : ( name , phase )  phase : 'B' begin , 'E' end , 'i' instant
+EVENTS = {
+     1 : ('rx',            'i'),
+     2 : ('command framed', 'i'),
+     3 : ('command',       'B'),
+     4 : ('command',       'E'),
+     5 : ('parse',         'B'),
+     6 : ('parse',         'E'),
+     7 : ('ftm session',   'B'),
+     8 : ('ftm session',   'E'),
+     9 : ('format',        'B'),
+    10 : ('format',        'E'),
+    11 : ('fifo commit',   'i'),
+    12 : ('send',          'B'),
+    13 : ('send',          'E'),
+}
+
+#
+# Read exactly <n> bytes from a socket
+#
+def recv_exactly(sock, n):
+
+    data = b''
+    while len(data) < n:
+        chunk = sock.recv(n - len(data))
+        if not chunk:
+            raise EOFError('connection closed after %d of %d bytes' % (len(data), n))
+        data += chunk
+    return data
+
+#
+# Request a dump from the device
+#
+def fetch(host, port):
+
+    with socket.create_connection((host, port), timeout=10) as sock:
+        sock.sendall(b'{ "function" : "trace" , "parameters" : { "action" : "dump" }} ;')
+        header = recv_exactly(sock, HEADER.size)
+        magic, version, size, mhz, count, tasks, now_cycles, now_us = HEADER.unpack(header)
+        if magic != b'CHRT':
+            raise ValueError('not a trace dump (magic %r)' % magic)
+        return header + recv_exactly(sock, tasks * TASK_NAME_LENGTH + count * size)
+
+#
+# Convert a dump to a list of Chrome trace events
+#
+def convert(dump):
+
+    magic, version, size, mhz, count, tasks, now_cycles, now_us = HEADER.unpack_from(dump, 0)
+    if magic != b'CHRT':
+        raise ValueError('not a trace dump (magic %r)' % magic)
+
+    offset = HEADER.size
+    names = []
+    for k in range(tasks):
+        raw = dump[offset:offset + TASK_NAME_LENGTH]
+        names.append(raw.split(b'\0')[0].decode(errors='replace'))
+        offset += TASK_NAME_LENGTH
+
+    events = []
+    for k in range(tasks):
+        events.append({ 'name' : 'thread_name', 'ph' : 'M', 'pid' : 0, 'tid' : k, 'args' : { 'name' : names[k] } })
+
+    # unwrap the 32 bit cycle counter ( small negative steps come from preempted trace points )
+    elapsed, previous, records = 0, None, []
+    for k in range(count):
+        cycles, arg, event, task, _ = EVENT.unpack_from(dump, offset + k * size)
+        if previous is not None:
+            delta = (cycles - previous) & 0xFFFFFFFF
+            elapsed += delta - (1 << 32) if delta >= (1 << 31) else delta
+        previous = cycles
+        records.append((elapsed, arg, event, task))
+
+    # anchor the timeline on the dump time ( micro-seconds since boot )
+    if previous is None:
+        return events
+    end = elapsed + ((now_cycles - previous) & 0xFFFFFFFF)
+    origin_us = now_us - end / mhz
+
+    for elapsed, arg, event, task in records:
+        name, phase = EVENTS.get(event, ('event %d' % event, 'i'))
+        e = { 'name' : name, 'ph' : phase, 'ts' : origin_us + elapsed / mhz, 'pid' : 0, 'tid' : task, 'args' : { 'arg' : arg } }
+        if phase == 'i':
+            e['s'] = 't'
+        events.append(e)
+
+    return events
+
+def main():
+
+    parser = argparse.ArgumentParser(description='Chronos trace dump to Chrome trace JSON')
+    parser.add_argument('dump', nargs='?', help='binary dump file')
+    parser.add_argument('--host', help='fetch the dump from the device at this address')
+    parser.add_argument('--port', type=int, default=5000)
+    parser.add_argument('-o', '--output', default='-', help='output JSON file (default: stdout)')
+    args = parser.parse_args()
+
+    if args.host:
+        dump = fetch(args.host, args.port)
+    elif args.dump:
+        with open(args.dump, 'rb') as f:
+            dump = f.read()
+    else:
+        parser.error('a dump file or --host is required')
+
+    trace = { 'traceEvents' : convert(dump), 'displayTimeUnit' : 'ns' }
+
+    if args.output == '-':
+        json.dump(trace, sys.stdout, indent=1)
+    else:
+        with open(args.output, 'w') as f:
+            json.dump(trace, f, indent=1)
+
+if __name__ == '__main__':
+    main()